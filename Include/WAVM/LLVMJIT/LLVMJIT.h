@@ -25,10 +25,52 @@ namespace WAVM { namespace Runtime {
 
 namespace WAVM { namespace LLVMJIT {
 
+	// How much effort the compiler spends optimizing code.
+	enum class OptimizationLevel
+	{
+		// No optimization: the fastest compilation.
+		none,
+
+		// Only the cheapest optimizations.
+		fast,
+
+		// The default: a short pipeline of cheap scalar optimizations.
+		standard,
+
+		// The standard optimizations, plus loop invariant code motion, global value numbering,
+		// loop unrolling, vectorization, and inlining of small functions.
+		aggressive
+	};
+
+	// How much debug information is kept for loaded modules.
+	enum class DebugInfoPolicy
+	{
+		// No debug information: the source of a JIT code address is only resolved to a function.
+		off,
+
+		// The default: a function's line table is only decoded the first time an address in it is
+		// resolved to a source instruction.
+		lazy,
+
+		// Decodes the line tables of all functions when a module is loaded, and registers the
+		// module's object code with GDB (and perf, if WAVM was built with perf events).
+		eager
+	};
+
+	// Sets the debug info policy used for modules loaded after the call.
+	WAVM_API void setDebugInfoPolicy(DebugInfoPolicy policy);
+	WAVM_API DebugInfoPolicy getDebugInfoPolicy();
+
 	struct TargetSpec
 	{
 		std::string triple;
 		std::string cpu;
+		OptimizationLevel optimizationLevel = OptimizationLevel::standard;
+
+		// If true, the compiled code checks that each memory access is within the memory's current
+		// size, instead of relying on the memory's reserved address space to trap out-of-bounds
+		// accesses. This allows the code to access memories with small reservations.
+		bool boundsCheckMemoryAccesses = false;
 	};
 
 	enum class TargetValidationResult
@@ -56,10 +98,56 @@ namespace WAVM { namespace LLVMJIT {
 
 	WAVM_API Version getVersion();
 
+	// The tiers of code that compileModule can produce.
+	enum class CompileTier
+	{
+		// Code optimized at the target spec's optimization level.
+		optimized,
+
+		// Unoptimized code that is quick to compile. Each function counts its calls using the
+		// FunctionTierUpData in its FunctionMutableData, calls the requestTierUp intrinsic when
+		// the count reaches zero, and forwards calls to optimized code once it is loaded.
+		baseline,
+	};
+
 	// Compile a module to object code with the host target spec.
 	// Cannot fail if validateTarget(targetSpec, irModule.featureSpec) == valid.
+	// If numShards > 1, the module's function definitions are partitioned into that many shards
+	// that are compiled in parallel, and the resulting object code contains one object file for
+	// each shard. Object code with multiple object files may be loaded with loadModule, but
+	// isn't a valid object file for other tools.
 	WAVM_API std::vector<U8> compileModule(const IR::Module& irModule,
-										   const TargetSpec& targetSpec);
+										   const TargetSpec& targetSpec,
+										   Uptr numShards = 1,
+										   CompileTier tier = CompileTier::optimized);
+
+	// Compiles optimized code for some of a module's function definitions, to replace their
+	// baseline tier code. The object code must be loaded with the same bindings as the baseline
+	// code, and with baselineFunctionDefs bound to the baseline code for all the module's function
+	// definitions.
+	WAVM_API std::vector<U8> compileTierUpFunctions(const IR::Module& irModule,
+													const TargetSpec& targetSpec,
+													const std::vector<Uptr>& functionDefIndices);
+
+	// Returns whether compileModule may partition modules into multiple shards for the target, and
+	// whether compileModuleShard may be used.
+	WAVM_API bool canShardModules(const TargetSpec& targetSpec);
+
+	// Compiles one shard of a module: the function definitions with the given indices, with the
+	// module's other function definitions left as declarations. The module's function declarations
+	// and all the sections that precede its code section must be complete, but the other function
+	// definitions need not be. The object files compiled for shards that partition the module's
+	// function definitions may be combined with packObjectFiles into object code for the module.
+	WAVM_API std::vector<U8> compileModuleShard(const IR::Module& irModule,
+												const TargetSpec& targetSpec,
+												const std::vector<Uptr>& functionDefIndices,
+												CompileTier tier = CompileTier::optimized);
+
+	// Packs the object files compiled for the shards of a module into object code for the module.
+	WAVM_API std::vector<U8> packObjectFiles(const std::vector<std::vector<U8>>& objectFiles);
+
+	// Returns the number of object files in object code produced by compileModule.
+	WAVM_API Uptr getNumObjectFiles(const std::vector<U8>& objectCode);
 
 	WAVM_API std::string emitLLVMIR(const IR::Module& irModule,
 									const TargetSpec& targetSpec,
@@ -111,8 +199,11 @@ namespace WAVM { namespace LLVMJIT {
 	};
 
 	// Loads a module from object code, and binds its undefined symbols to the provided bindings.
+	// The object code is only read while loading the module, so it may be a view of memory that is
+	// owned by something else.
 	WAVM_API std::shared_ptr<Module> loadModule(
-		const std::vector<U8>& objectFileBytes,
+		const U8* objectBytes,
+		Uptr numObjectBytes,
 		HashMap<std::string, FunctionBinding>&& wavmIntrinsicsExportMap,
 		std::vector<IR::FunctionType>&& types,
 		std::vector<FunctionBinding>&& functionImports,
@@ -123,7 +214,8 @@ namespace WAVM { namespace LLVMJIT {
 		InstanceBinding instance,
 		Uptr tableReferenceBias,
 		const std::vector<Runtime::FunctionMutableData*>& functionDefMutableDatas,
-		std::string&& debugName);
+		std::string&& debugName,
+		const std::vector<FunctionBinding>& baselineFunctionDefs = {});
 
 	struct InstructionSource
 	{
@@ -137,4 +229,18 @@ namespace WAVM { namespace LLVMJIT {
 
 	// Generates an invoke thunk for a specific function type.
 	WAVM_API Runtime::InvokeThunkPointer getInvokeThunk(IR::FunctionType functionType);
+
+	// The native function and data that a host thunk calls.
+	struct HostThunkBinding
+	{
+		void* nativeFunction;
+		void* boundData;
+	};
+
+	// Generates a host thunk for a specific function type: a function with the wasm calling
+	// convention that is passed a pointer to a HostThunkBinding in the register LLVM uses for nest
+	// parameters (r10 on X86-64, x18 on AArch64), and calls its native function with the
+	// cAPICallback calling convention. The native function receives the bound data as an i64
+	// argument before the thunk's parameters.
+	WAVM_API Runtime::Function* getHostThunk(IR::FunctionType functionType);
 }}
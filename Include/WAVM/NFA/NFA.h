@@ -38,10 +38,26 @@ namespace WAVM { namespace NFA {
 	// Dumps the NFA's states and edges to the GraphViz .dot format.
 	WAVM_API std::string dumpNFAGraphViz(const Builder* builder);
 
+	// The flat transition tables that a Machine executes. stateAndOffsetToNextStateMap has
+	// numClasses * numStates elements, indexed by state + charToOffsetMap[char].
+	struct MachineTables
+	{
+		const U32* charToOffsetMap;
+		const I16* stateAndOffsetToNextStateMap;
+		Uptr numClasses;
+		Uptr numStates;
+	};
+
 	// Encapsulates a NFA that has been translated into a DFA that can be efficiently executed.
 	struct WAVM_API Machine
 	{
-		Machine() : stateAndOffsetToNextStateMap(nullptr), numClasses(0), numStates(0) {}
+		Machine()
+		: stateAndOffsetToNextStateMap(nullptr)
+		, numClasses(0)
+		, numStates(0)
+		, ownsStateAndOffsetToNextStateMap(false)
+		{
+		}
 		~Machine();
 
 		Machine(Machine&& inMachine) noexcept { moveFrom(std::move(inMachine)); }
@@ -50,6 +66,17 @@ namespace WAVM { namespace NFA {
 		// Constructs a DFA from the abstract builder object (which is destroyed).
 		Machine(Builder* inBuilder);
 
+		// Constructs a DFA from tables that were previously returned by getTables. The transition
+		// map is referenced rather than copied, so it must outlive the Machine.
+		Machine(const MachineTables& tables);
+
+		// Returns the DFA's transition tables. They are only valid for the Machine's lifetime.
+		MachineTables getTables() const
+		{
+			return MachineTables{
+				charToOffsetMap, stateAndOffsetToNextStateMap, numClasses, numStates};
+		}
+
 		// Feeds characters into the DFA until it reaches a terminal state.
 		// Upon reaching a terminal state, the state is returned, and the nextChar pointer
 		// is updated to point to the first character not consumed by the DFA.
@@ -95,9 +122,10 @@ namespace WAVM { namespace NFA {
 		static constexpr InternalStateIndex internalMaxStates = INT16_MAX;
 
 		U32 charToOffsetMap[256];
-		InternalStateIndex* stateAndOffsetToNextStateMap;
+		const InternalStateIndex* stateAndOffsetToNextStateMap;
 		Uptr numClasses;
 		Uptr numStates;
+		bool ownsStateAndOffsetToNextStateMap;
 
 		void moveFrom(Machine&& inMachine) noexcept;
 	};
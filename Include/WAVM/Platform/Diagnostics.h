@@ -26,6 +26,27 @@ namespace WAVM { namespace Platform {
 		~CallStack() {}
 	};
 
+	// How the call stacks of signals and runtime exceptions are captured. The frames of a call stack
+	// are only symbolized when it is described, so the cost of capturing one is finding its frames.
+	enum class CallStackCapturePolicy
+	{
+		// Don't capture any frames.
+		none,
+
+		// Only capture the innermost frame.
+		innermostFrame,
+
+		// Capture frames by following the chain of saved frame pointers. This is much cheaper than
+		// unwinding, but may omit the callers of functions that don't maintain a frame pointer.
+		framePointers,
+
+		// Capture frames by unwinding the stack using the platform's unwind information.
+		unwind,
+	};
+
+	WAVM_API void setCallStackCapturePolicy(CallStackCapturePolicy policy);
+	WAVM_API CallStackCapturePolicy getCallStackCapturePolicy();
+
 	// Describes the source of an instruction in a native module.
 	struct InstructionSource
 	{
@@ -50,6 +71,9 @@ namespace WAVM { namespace Platform {
 	// Captures the execution context of the caller.
 	WAVM_API CallStack captureCallStack(Uptr numOmittedFramesFromTop = 0);
 
+	// Captures the execution context of the caller according to the call stack capture policy.
+	WAVM_API CallStack captureCallStackWithPolicy(Uptr numOmittedFramesFromTop = 0);
+
 	// Looks up the source of an instruction from a native module.
 	WAVM_API bool getInstructionSourceByAddress(Uptr ip, InstructionSource& outSource);
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include "WAVM/Inline/BasicTypes.h"
 #include "WAVM/Inline/Time.h"
 #include "WAVM/Platform/Defines.h"
@@ -25,24 +26,9 @@ namespace WAVM { namespace Platform {
 	private:
 #ifdef WIN32
 		void* handle;
-#elif defined(__linux__) && defined(__x86_64__)
-		struct PthreadMutex
-		{
-			Uptr data[5];
-		} pthreadMutex;
-		struct PthreadCond
-		{
-			Uptr data[6];
-		} pthreadCond;
-#elif defined(__linux__) && defined(__aarch64__)
-		struct PthreadMutex
-		{
-			Uptr data[6];
-		} pthreadMutex;
-		struct PthreadCond
-		{
-			Uptr data[6];
-		} pthreadCond;
+#elif defined(__linux__)
+		// 1 if the event is signaled, 0 if not. Waiting threads are parked on it with futex.
+		std::atomic<U32> futexWord;
 #elif defined(__APPLE__)
 		struct PthreadMutex
 		{
@@ -2,6 +2,8 @@
 
 #include <string>
 #include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Inline/Time.h"
+#include "WAVM/Platform/Clock.h"
 #include "WAVM/Platform/Defines.h"
 #include "WAVM/VFS/VFS.h"
 
@@ -24,4 +26,29 @@ namespace WAVM { namespace Platform {
 		virtual ~HostFS() override {}
 	};
 	WAVM_API HostFS& getHostFS();
+
+	// A VFD to wait on with pollVFDs, and the state of the VFD when pollVFDs returns.
+	struct VFDPoll
+	{
+		VFS::VFD* vfd;
+		bool waitForRead;
+		bool waitForWrite;
+
+		// Set by pollVFDs.
+		VFS::Result result;
+		bool isReadable;
+		bool isWritable;
+		bool isHungUp;
+		U64 numReadableBytes;
+	};
+
+	// Waits until at least one of the VFDs is ready for reading or writing, or until the clock
+	// reaches the deadline. An infinite deadline waits indefinitely. VFDs that can't be waited on
+	// are returned immediately with a result of VFS::Result::notSupported. Writes the number of VFDs
+	// that are ready or have failed to outNumReadyVFDs.
+	WAVM_API VFS::Result pollVFDs(VFDPoll* vfdPolls,
+								  Uptr numVFDPolls,
+								  Clock deadlineClock,
+								  Time deadline,
+								  Uptr& outNumReadyVFDs);
 }}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <vector>
 #include "WAVM/Inline/BasicTypes.h"
 #include "WAVM/Platform/Defines.h"
 
@@ -59,6 +60,46 @@ namespace WAVM { namespace Platform {
 										  Uptr numPages,
 										  Uptr alignmentLog2);
 
+	// An anonymous in-memory file whose pages may be mapped into the virtual address space, either
+	// shared with other mappings of the file, or copy-on-write.
+	struct MemoryFile;
+
+	// Creates a memory file with the given size. Returns nullptr if memory files aren't supported by
+	// the platform, or if the file couldn't be created.
+	WAVM_API MemoryFile* createMemoryFile(const char* debugName, Uptr numBytes);
+
+	// Opens an existing file on disk as a read-only memory file, which may only be mapped
+	// copy-on-write. Returns nullptr if memory files aren't supported by the platform, or if the
+	// file couldn't be opened.
+	WAVM_API MemoryFile* openMemoryFile(const char* path);
+
+	// Destroys a memory file. Existing mappings of the file remain valid until they are unmapped.
+	WAVM_API void destroyMemoryFile(MemoryFile* file);
+
+	// Changes the size of a memory file. Returns true if successful, or false if the file couldn't
+	// be resized.
+	WAVM_API bool resizeMemoryFile(MemoryFile* file, Uptr numBytes);
+
+	// Maps pages of a memory file over the specified virtual pages, which must have been allocated
+	// by allocateVirtualPages. If copyOnWrite is true, writes to the pages are private to this
+	// mapping; otherwise they are written through to the file, and visible to all its mappings.
+	// Pages of the file that haven't been written through a mapping read as zero.
+	// baseVirtualAddress and fileOffset must be multiples of the preferred page size.
+	// Returns true if successful, or false if the pages couldn't be mapped.
+	WAVM_API bool mapMemoryFile(MemoryFile* file,
+								Uptr fileOffset,
+								U8* baseVirtualAddress,
+								Uptr numPages,
+								bool copyOnWrite);
+
+	// Finds the pages of copy-on-write mappings of memory files that have been written since they
+	// were mapped, setting an element of outIsWrittenPage for each of the specified virtual pages.
+	// Pages that aren't mapped from a memory file may be reported as written. Returns false if the
+	// written pages can't be determined on this platform.
+	WAVM_API bool getWrittenCopyOnWritePages(U8* baseVirtualAddress,
+											 Uptr numPages,
+											 std::vector<bool>& outIsWrittenPage);
+
 	// Gets memory usage information for this process.
 	WAVM_API Uptr getPeakMemoryUsageBytes();
 }}
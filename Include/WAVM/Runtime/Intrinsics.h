@@ -29,6 +29,19 @@ namespace WAVM { namespace Intrinsics {
 		const std::initializer_list<const Intrinsics::Module*>& moduleRefs,
 		std::string&& debugName);
 
+	// Creates a function with the given type that calls a native function with the cAPICallback
+	// calling convention. The native function receives boundData as an i64 argument before the
+	// function's parameters. The thunk that calls the native function is compiled and loaded once
+	// for each function type, and shared by all host functions with that type, which only need a
+	// Function that binds the thunk to the native function and data. When the function is
+	// collected, finalizeBoundData is called with boundData, if it is non-null.
+	WAVM_API Runtime::Function* createHostFunction(Runtime::Compartment* compartment,
+												   IR::FunctionType type,
+												   void* nativeFunction,
+												   void* boundData,
+												   void (*finalizeBoundData)(void*),
+												   std::string&& debugName);
+
 	// An intrinsic function.
 	struct Function
 	{
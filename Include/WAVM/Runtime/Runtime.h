@@ -1,7 +1,9 @@
 #pragma once
 
+#include <string.h>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 #include "WAVM/IR/FeatureSpec.h"
 #include "WAVM/IR/Types.h"
@@ -15,6 +17,9 @@ namespace WAVM {
 	namespace IR {
 		struct Module;
 	}
+	namespace LLVMJIT {
+		enum class OptimizationLevel;
+	}
 	namespace WASM {
 		struct LoadError;
 	}
@@ -147,7 +152,9 @@ namespace WAVM { namespace Runtime {
 	// Decrements the object's counter of root referencers.
 	WAVM_API void removeGCRoot(const Object* object) noexcept;
 
-	// Frees any unreferenced objects owned by a compartment.
+	// Frees any unreferenced objects owned by a compartment. The compartment is only locked while
+	// its roots are snapshotted and while the unreferenced objects are freed, and its memories,
+	// tables, and instances are deleted by a background thread.
 	WAVM_API void collectCompartmentGarbage(Compartment* compartment);
 
 	// Clears the given GC root reference to a compartment, and collects garbage for it. Returns
@@ -212,7 +219,11 @@ namespace WAVM { namespace Runtime {
 	typedef const std::shared_ptr<ResourceQuota>& ResourceQuotaRefParam;
 	typedef const std::shared_ptr<const ResourceQuota>& ResourceQuotaConstRefParam;
 
-	WAVM_API ResourceQuotaRef createResourceQuota();
+	// Creates a resource quota. If a parent quota is given, resources allocated from the new quota
+	// are also charged to the parent, so e.g. a per-tenant quota may limit the total resources
+	// used by several per-instance quotas.
+	WAVM_API ResourceQuotaRef createResourceQuota(ResourceQuotaRefParam parent = nullptr);
+	WAVM_API ResourceQuotaRef getResourceQuotaParent(ResourceQuotaConstRefParam);
 
 	WAVM_API Uptr getResourceQuotaMaxTableElems(ResourceQuotaConstRefParam);
 	WAVM_API Uptr getResourceQuotaCurrentTableElems(ResourceQuotaConstRefParam);
@@ -316,6 +327,86 @@ namespace WAVM { namespace Runtime {
 								 const IR::UntaggedValue arguments[] = nullptr,
 								 IR::UntaggedValue results[] = nullptr);
 
+	// A Function that has been checked against an invoke signature, and the invoke thunk for that
+	// signature. Calling it through invokePrepared skips the per-call signature check, thunk lookup,
+	// and signal handler setup done by invokeFunction.
+	struct ContextRuntimeData;
+	struct PreparedInvoke
+	{
+		const Function* function = nullptr;
+		ContextRuntimeData* (*invokeThunk)(const Function*,
+										   ContextRuntimeData*,
+										   const IR::UntaggedValue* arguments,
+										   IR::UntaggedValue* results)
+			= nullptr;
+	};
+
+	// Checks that a Function may be invoked with the given signature, and resolves the invoke thunk
+	// for it. If the signature doesn't match the function's type, then an invokeSignatureMismatch
+	// exception is thrown.
+	WAVM_API PreparedInvoke prepareInvoke(const Function* function, IR::FunctionType invokeSig);
+
+	// Invokes a prepared Function with the given arguments and results arrays. Signals that occur
+	// in the invoked code are not translated to runtime exceptions by this function: the caller must
+	// call it from within unwindSignalsAsExceptions or catchRuntimeExceptions, which may wrap an
+	// entire batch of calls.
+	inline void invokePrepared(ContextRuntimeData* contextRuntimeData,
+							   const PreparedInvoke& prepared,
+							   const IR::UntaggedValue arguments[],
+							   IR::UntaggedValue results[])
+	{
+		WAVM_ASSERT(prepared.invokeThunk);
+		(*prepared.invokeThunk)(prepared.function, contextRuntimeData, arguments, results);
+	}
+
+	// A PreparedInvoke with a signature inferred from a C++ function type, e.g.
+	// TypedPreparedInvoke<I32(I32, F64)>. The same restrictions on signal handling apply as for
+	// invokePrepared.
+	template<typename Signature> struct TypedPreparedInvoke;
+
+	template<typename Result, typename... Args> struct TypedPreparedInvoke<Result(Args...)>
+	{
+		PreparedInvoke prepared;
+
+		TypedPreparedInvoke() {}
+		TypedPreparedInvoke(const Function* function)
+		: prepared(prepareInvoke(function,
+								 IR::FunctionType(IR::inferResultType<Result>(),
+												  IR::TypeTuple({IR::inferValueType<Args>()...}))))
+		{
+		}
+
+		Result operator()(ContextRuntimeData* contextRuntimeData, Args... args) const
+		{
+			const IR::UntaggedValue arguments[sizeof...(Args) + 1]{IR::UntaggedValue(args)...};
+			IR::UntaggedValue results[1];
+			invokePrepared(contextRuntimeData, prepared, arguments, results);
+
+			Result result;
+			memcpy(&result, results[0].bytes, sizeof(Result));
+			return result;
+		}
+	};
+
+	template<typename... Args> struct TypedPreparedInvoke<void(Args...)>
+	{
+		PreparedInvoke prepared;
+
+		TypedPreparedInvoke() {}
+		TypedPreparedInvoke(const Function* function)
+		: prepared(prepareInvoke(
+			function,
+			IR::FunctionType(IR::TypeTuple(), IR::TypeTuple({IR::inferValueType<Args>()...}))))
+		{
+		}
+
+		void operator()(ContextRuntimeData* contextRuntimeData, Args... args) const
+		{
+			const IR::UntaggedValue arguments[sizeof...(Args) + 1]{IR::UntaggedValue(args)...};
+			invokePrepared(contextRuntimeData, prepared, arguments, nullptr);
+		}
+	};
+
 	// Returns the type of a Function.
 	WAVM_API IR::FunctionType getFunctionType(const Function* function);
 
@@ -362,6 +453,19 @@ namespace WAVM { namespace Runtime {
 								  std::string&& debugName,
 								  ResourceQuotaRefParam resourceQuota = ResourceQuotaRef());
 
+	// Sets the maximum number of address-space reservations that are kept after the memories that
+	// reserved them are freed, for reuse by new memories. The pooled reservations' pages are
+	// decommitted, but remain mapped, which avoids remapping the address-space of each new memory.
+	WAVM_API void setMaxPooledMemoryReservations(Uptr maxPooledMemoryReservations);
+
+	// Sets whether memories reserve only enough address space for their declared maximum size, up
+	// to maxReservedBytes, instead of enough to elide bounds checks on accesses to them. Modules
+	// compiled while this is enabled check the bounds of each memory access, and only they may
+	// import the memories created while it is enabled: instantiating any other module that imports
+	// one of them throws an invalidArgument exception. The global object cache isn't used while
+	// it's enabled, since its object code isn't keyed by this setting. The default is disabled.
+	WAVM_API void setMemoryBoundsChecks(bool enable, Uptr maxReservedBytes = Uptr(1) << 30);
+
 	// Gets the base address of the memory's data.
 	WAVM_API U8* getMemoryBaseAddress(Memory* memory);
 
@@ -434,6 +538,20 @@ namespace WAVM { namespace Runtime {
 	// Compiles an IR module to object code.
 	WAVM_API ModuleRef compileModule(const IR::Module& irModule);
 
+	// Sets the number of shards that compileModule and loadBinaryModule partition a module's
+	// function definitions into, so they may be compiled in parallel. The default is 1.
+	WAVM_API void setNumCompileShards(Uptr numShards);
+
+	// Sets whether compileModule and loadBinaryModule compile quickly generated baseline code that
+	// is replaced by optimized code for each function once it has been called numCallsToTierUp
+	// times. The optimized code is compiled on a background thread. The default is disabled.
+	WAVM_API void setTieredCompilation(bool enable, U32 numCallsToTierUp = 1000);
+
+	// Sets the optimization level that compileModule and loadBinaryModule compile code at. With
+	// tiered compilation, this is the optimization level of the optimized code. The default is
+	// LLVMJIT::OptimizationLevel::standard.
+	WAVM_API void setOptimizationLevel(LLVMJIT::OptimizationLevel optimizationLevel);
+
 	// Load and compiles a binary module, returning either an error or a module.
 	// If true is returned, the load succeeded, and outModule contains the loaded module.
 	// If false is returned, the load failed. If outError != nullptr, *outError will contain the
@@ -444,11 +562,77 @@ namespace WAVM { namespace Runtime {
 								   const IR::FeatureSpec& featureSpec = IR::FeatureSpec(),
 								   WASM::LoadError* outError = nullptr);
 
+	// Incrementally loads and compiles a binary module from bytes that are fed to it in chunks of
+	// any size, e.g. while it is being read from a file or network connection. The module's
+	// function definitions are compiled in batches on background threads as they are loaded, so
+	// the time to load a large module approaches the larger of the time to read it and the time to
+	// compile it, rather than their sum. The number of compile threads is limited by the number
+	// of shards set by setNumCompileShards.
+	// If the module cache or a global object cache is enabled, or the host target doesn't support
+	// compiling modules in shards, the module isn't compiled until all of its bytes have been fed.
+	struct StreamingModuleLoader;
+
+	WAVM_API StreamingModuleLoader* createStreamingModuleLoader(
+		const IR::FeatureSpec& featureSpec = IR::FeatureSpec());
+	WAVM_API void destroyStreamingModuleLoader(StreamingModuleLoader* loader);
+
+	// Feeds the next chunk of bytes to a streaming module loader. If false is returned, the bytes
+	// fed so far are malformed or invalid, and if outError != nullptr, *outError will contain the
+	// error.
+	WAVM_API bool feedStreamingModuleLoader(StreamingModuleLoader* loader,
+											const U8* bytes,
+											Uptr numBytes,
+											WASM::LoadError* outError = nullptr);
+
+	// Finishes loading and compiling the module after all of its bytes have been fed. The result
+	// is the same as loadBinaryModule's for the concatenation of the bytes that were fed.
+	WAVM_API bool finishStreamingModuleLoader(StreamingModuleLoader* loader,
+											  ModuleRef& outModule,
+											  WASM::LoadError* outError = nullptr);
+
+	// Sets the maximum number of modules that loadBinaryModule keeps in a process-wide cache. The
+	// cache is keyed by a BLAKE2b hash of the binary module, the feature spec, and the compilation
+	// settings, and loading a module that is in the cache returns the cached module without
+	// decoding, validating, or compiling it. When the cache is full, the least recently loaded
+	// module is evicted. The default is 0, which disables the cache.
+	WAVM_API void setModuleCacheCapacity(Uptr maxModules);
+
+	struct ModuleCacheStats
+	{
+		Uptr numModules;
+		Uptr numHits;
+		Uptr numMisses;
+		Uptr numEvictions;
+	};
+
+	WAVM_API ModuleCacheStats getModuleCacheStats();
+
+	// A read-only view of a module's object code. The bytes remain valid until the view is
+	// destroyed, so a view may point into memory that is owned by something else, like the mapping
+	// of an object cache's database.
+	struct ObjectCodeView
+	{
+		const U8* bytes;
+		Uptr numBytes;
+
+		ObjectCodeView(const U8* inBytes, Uptr inNumBytes) : bytes(inBytes), numBytes(inNumBytes) {}
+		virtual ~ObjectCodeView() {}
+	};
+
+	// Creates a view of object code that owns the object code.
+	WAVM_API std::shared_ptr<const ObjectCodeView> createObjectCodeView(
+		std::vector<U8>&& objectCode);
+
 	// Loads a previously compiled module from a combination of an IR module and the object code
 	// returned by getObjectCode for the previously compiled module.
 	WAVM_API ModuleRef loadPrecompiledModule(const IR::Module& irModule,
 											 const std::vector<U8>& objectCode);
 
+	// Loads a previously compiled module without copying the IR module or the object code. The
+	// module references the object code view for as long as it exists.
+	WAVM_API ModuleRef loadPrecompiledModule(IR::Module&& irModule,
+											 std::shared_ptr<const ObjectCodeView>&& objectCode);
+
 	// Accesses the IR for a compiled module.
 	WAVM_API const IR::Module& getModuleIR(ModuleConstRefParam module);
 
@@ -463,13 +647,35 @@ namespace WAVM { namespace Runtime {
 	typedef std::vector<Object*> ImportBindings;
 
 	// Instantiates a module, bindings its imports to the specified objects. May throw a runtime
-	// exception for bad segment offsets.
+	// exception for bad segment offsets, or an invalidArgument exception if the module wasn't
+	// compiled with memory bounds checks, but imports a memory that requires them.
 	WAVM_API Instance* instantiateModule(Compartment* compartment,
 										 ModuleConstRefParam module,
 										 ImportBindings&& imports,
 										 std::string&& debugName,
 										 ResourceQuotaRefParam resourceQuota = ResourceQuotaRef());
 
+	// Instantiates a module numInstances times with the same imports. This is equivalent to calling
+	// instantiateModule numInstances times, but checks the imports and decodes the module's names
+	// once for all the instances, and initializes the instances' segments in parallel if they don't
+	// import memories or tables. May throw a runtime exception for bad segment offsets. Returns an
+	// empty vector if the compartment doesn't have room for numInstances more instances.
+	WAVM_API std::vector<Instance*> instantiateModules(
+		Compartment* compartment,
+		ModuleConstRefParam module,
+		Uptr numInstances,
+		const ImportBindings& imports,
+		const std::string& debugName,
+		ResourceQuotaRefParam resourceQuota = ResourceQuotaRef());
+
+	// Sets whether instantiating a module maps the pages written by its active data segments
+	// copy-on-write from an image of the module's initial memory contents, instead of copying the
+	// segments into each instance's memories. The image is built once per module, and is only used
+	// for memories defined by the module whose data segments have constant offsets within the
+	// memory's initial size. Bytes of segments that don't cover a whole page are still copied.
+	// The default is disabled.
+	WAVM_API void setDataSegmentImages(bool enable);
+
 	// Gets the start function of a Instance.
 	WAVM_API Function* getStartFunction(const Instance* instance);
 
@@ -511,8 +717,34 @@ namespace WAVM { namespace Runtime {
 
 	WAVM_API Compartment* createCompartment(std::string&& debugName = "");
 
+	// How the contents of a compartment's memories are cloned into the new compartment.
+	enum class MemoryCloneMode
+	{
+		// The cloned memories have the same size as the originals, but are zero-initialized.
+		none,
+
+		// The contents of the original memories are copied to the cloned memories.
+		copy,
+
+		// The original and cloned memories map a snapshot of the original memories' pages
+		// copy-on-write, so only the pages that each of them writes are copied. The snapshot is
+		// taken by the first copy-on-write clone of a memory, and reused by later clones until the
+		// original memory is written. Falls back to copy if the platform doesn't support memory
+		// files.
+		copyOnWrite,
+	};
+
 	WAVM_API Compartment* cloneCompartment(const Compartment* compartment,
-										   std::string&& debugName = "", bool copyMemoryContents = true);
+										   std::string&& debugName = "",
+										   MemoryCloneMode memoryCloneMode = MemoryCloneMode::copy);
+	inline Compartment* cloneCompartment(const Compartment* compartment,
+										 std::string&& debugName,
+										 bool copyMemoryContents)
+	{
+		return cloneCompartment(compartment,
+								std::move(debugName),
+								copyMemoryContents ? MemoryCloneMode::copy : MemoryCloneMode::none);
+	}
 
 	WAVM_API Object* remapToClonedCompartment(const Object* object,
 											  const Compartment* newCompartment);
@@ -530,12 +762,44 @@ namespace WAVM { namespace Runtime {
 	WAVM_API Foreign* remapToClonedCompartment(const Foreign* foreign,
 											   const Compartment* newCompartment);
 
+	// Saves the objects in a compartment and the contents of its memories to a file that may be
+	// restored by another process. If a context is given, the values of mutable globals in that
+	// context are saved, otherwise the values that new contexts are initialized with. Fails if the
+	// compartment references foreign objects or contexts. The snapshot is written to a temporary
+	// file that replaces the file at the path once it's complete, so an existing snapshot at the
+	// path, or a compartment restored from it, isn't affected if saving fails.
+	WAVM_API bool saveCompartmentSnapshot(const Compartment* compartment,
+										  const char* path,
+										  const Context* context = nullptr);
+
+	// Called to recreate an instance of a module with native function imports (e.g. an intrinsic
+	// module) when restoring a snapshot. The recreated instance must have the same objects as the
+	// saved instance, in the same order.
+	typedef std::function<Instance*(Compartment* compartment, const std::string& debugName)>
+		RestoreHostInstanceFunction;
+
+	// Restores a compartment saved by saveCompartmentSnapshot. The saved instances are recreated
+	// from the given modules, which are matched to the saved instances by their object code. The
+	// restored memories map the file's pages copy-on-write where possible, so restoring doesn't
+	// read pages until they are accessed. If outInstances is given, the restored instances are
+	// appended to it in the order of their IDs in the snapshotted compartment. Returns null if the
+	// snapshot couldn't be restored.
+	WAVM_API Compartment* restoreCompartmentSnapshot(
+		const char* path,
+		const std::vector<ModuleConstRef>& modules,
+		const RestoreHostInstanceFunction& restoreHostInstance,
+		std::string&& debugName = "",
+		ResourceQuotaRefParam resourceQuota = ResourceQuotaRef(),
+		std::vector<Instance*>* outInstances = nullptr);
+
 	WAVM_API bool isInCompartment(const Object* object, const Compartment* compartment);
 
 	//
 	// Contexts
 	//
 
+	// Creates a context in a compartment. Contexts that are collected are kept in a pool by their
+	// compartment, and reused by createContext without reallocating their runtime data.
 	WAVM_API Context* createContext(Compartment* compartment, std::string&& debugName = "");
 
 	WAVM_API struct ContextRuntimeData* getContextRuntimeData(const Context* context);
@@ -569,6 +833,17 @@ namespace WAVM { namespace Runtime {
 												Uptr numWASMBytes,
 												std::function<std::vector<U8>()>&& compileThunk)
 			= 0;
+
+		// Like getCachedObject, but returns a view of the object code. Caches that can return a
+		// view of their own storage should override this to avoid copying the object code.
+		virtual std::shared_ptr<const ObjectCodeView> getCachedObjectView(
+			const U8* wasmBytes,
+			Uptr numWASMBytes,
+			std::function<std::vector<U8>()>&& compileThunk)
+		{
+			return createObjectCodeView(
+				getCachedObject(wasmBytes, numWASMBytes, std::move(compileThunk)));
+		}
 	};
 
 	WAVM_API void setGlobalObjectCache(std::shared_ptr<ObjectCacheInterface>&& objectCache);
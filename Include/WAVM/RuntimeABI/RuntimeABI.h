@@ -6,6 +6,8 @@
 
 #include <atomic>
 #include <map>
+#include <string>
+#include <vector>
 #include "WAVM/IR/Types.h"
 #include "WAVM/IR/Value.h"
 #include "WAVM/Inline/BasicTypes.h"
@@ -117,6 +119,7 @@ namespace WAVM { namespace Runtime {
 		Uptr typeId;
 		ExceptionType* type;
 		U8 isUserException;
+		U8 isFromFreelist;
 		Platform::CallStack callStack;
 		void* userData;
 		void (*finalizeUserData)(void*);
@@ -129,6 +132,7 @@ namespace WAVM { namespace Runtime {
 		: typeId(inTypeId)
 		, type(inType)
 		, isUserException(inIsUserException ? 1 : 0)
+		, isFromFreelist(0)
 		, callStack(std::move(inCallStack))
 		, userData(nullptr)
 		, finalizeUserData(nullptr)
@@ -154,17 +158,40 @@ namespace WAVM { namespace Runtime {
 															   const IR::UntaggedValue* arguments,
 															   IR::UntaggedValue* results);
 
+	// The state used by baseline tier code for a function to switch to optimized code. The baseline
+	// code decrements numCallsUntilTierUp on each call until it reaches zero, and asks the runtime
+	// to compile optimized code for the function when it does. Once the optimized code is loaded,
+	// the runtime sets code to point to it, and the baseline code forwards calls to it.
+	struct FunctionTierUpData
+	{
+		std::atomic<const void*> code{nullptr};
+		std::atomic<U32> numCallsUntilTierUp{0};
+	};
+
+	// Maps an offset in a function's code to the index of the WebAssembly op it was compiled from.
+	struct OffsetToOpIndex
+	{
+		U32 offset;
+		U32 opIndex;
+	};
+
 	// Metadata about a function, used to hold data that can't be emitted directly in an object
 	// file, or must be mutable.
 	struct FunctionMutableData
 	{
 		LLVMJIT::Module* jitModule = nullptr;
+		// The function whose code this describes. For a function that forwards calls to a function
+		// in code that was loaded for another instance, that's the other instance's function.
 		Runtime::Function* function = nullptr;
 		Uptr numCodeBytes = 0;
 		std::atomic<Uptr> numRootReferences{0};
-		std::map<U32, U32> offsetToOpIndexMap;
+		// The function's line table, sorted by offset. It may not be decoded until the first time
+		// an address in the function is resolved to a source instruction.
+		std::vector<OffsetToOpIndex> offsetToOpIndexMap;
+		std::atomic<bool> isOffsetToOpIndexMapDecoded{false};
 		std::string debugName;
 		std::atomic<InvokeThunkPointer> invokeThunk{nullptr};
+		FunctionTierUpData tierUp;
 		void* userData{nullptr};
 		void (*finalizeUserData)(void*);
 
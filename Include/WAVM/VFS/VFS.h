@@ -213,6 +213,10 @@ namespace WAVM { namespace VFS {
 
 		virtual Result openDir(DirEntStream*& outStream) = 0;
 
+		// If the VFD is backed by a host file descriptor, writes it to outHostFD and returns true.
+		// This allows Platform::pollVFDs to wait on the VFD.
+		virtual bool getHostFD(I32& outHostFD) { return false; }
+
 		Result read(void* outData,
 					Uptr numBytes,
 					Uptr* outNumBytesRead = nullptr,
@@ -256,6 +260,7 @@ namespace WAVM { namespace VFS {
 		virtual Result openDir(const std::string& path, DirEntStream*& outStream) = 0;
 
 		virtual Result unlinkFile(const std::string& path) = 0;
+		virtual Result renameFile(const std::string& oldPath, const std::string& newPath) = 0;
 		virtual Result removeDir(const std::string& path) = 0;
 		virtual Result createDir(const std::string& path) = 0;
 	};
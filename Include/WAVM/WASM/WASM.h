@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+#include <string>
 #include <vector>
 #include "WAVM/IR/Validate.h"
 #include "WAVM/Inline/BasicTypes.h"
@@ -34,4 +36,34 @@ namespace WAVM { namespace WASM {
 								   Uptr numWASMBytes,
 								   IR::Module& outModule,
 								   LoadError* outError = nullptr);
+
+	// Incrementally loads a binary module from bytes that are fed to it in chunks of any size, so a
+	// module may be loaded while it is being read from a file or network connection.
+	// Each function body in the code section is loaded and validated as soon as all of its bytes
+	// have been fed, and then passed to onFunctionDefLoaded. Other sections are loaded once all
+	// of their bytes have been fed.
+	// When onFunctionDefLoaded is called, all the sections that precede the code section have been
+	// loaded. The loader doesn't modify those sections or the loaded function definitions after
+	// that, so onFunctionDefLoaded may hand them to another thread, e.g. to compile them.
+	struct StreamingLoader;
+	typedef std::function<void(Uptr functionDefIndex)> FunctionDefLoadedCallback;
+
+	WAVM_API StreamingLoader* createStreamingLoader(
+		IR::Module& outModule,
+		FunctionDefLoadedCallback&& onFunctionDefLoaded = nullptr);
+	WAVM_API void destroyStreamingLoader(StreamingLoader* loader);
+
+	// Feeds the next chunk of bytes to a streaming loader. If false is returned, the bytes fed so
+	// far are malformed or invalid, and if outError != nullptr, *outError will contain the error.
+	// Once a streaming loader has failed, it ignores any more bytes that are fed to it.
+	WAVM_API bool feedStreamingLoader(StreamingLoader* loader,
+									  const U8* bytes,
+									  Uptr numBytes,
+									  LoadError* outError = nullptr);
+
+	// Finishes loading the module after all its bytes have been fed. If true is returned, the load
+	// succeeded, and the outModule passed to createStreamingLoader contains the loaded module.
+	// If false is returned, the load failed, and if outError != nullptr, *outError will contain the
+	// error that caused the load to fail.
+	WAVM_API bool finishStreamingLoader(StreamingLoader* loader, LoadError* outError = nullptr);
 }}
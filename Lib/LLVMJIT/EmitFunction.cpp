@@ -173,6 +173,92 @@ ValueVector EmitFunctionContext::emitRuntimeIntrinsic(
 	return emitCallOrInvoke(intrinsicFunction, args, intrinsicType, getInnermostUnwindToBlock());
 }
 
+void EmitFunctionContext::emitTierUpCheck()
+{
+	WAVM_ASSERT(tierUpData);
+
+	auto tierUpBlock = llvm::BasicBlock::Create(llvmContext, "tierUp", function);
+	auto countCallBlock = llvm::BasicBlock::Create(llvmContext, "countCall", function);
+	auto decrementCallCountBlock
+		= llvm::BasicBlock::Create(llvmContext, "decrementCallCount", function);
+	auto requestTierUpBlock = llvm::BasicBlock::Create(llvmContext, "requestTierUp", function);
+	auto bodyBlock = llvm::BasicBlock::Create(llvmContext, "body", function);
+
+	// If optimized code has been loaded for the function, forward the call to it.
+	llvm::Value* tierUpCodeOffset
+		= emitLiteral(llvmContext, Uptr(offsetof(Runtime::FunctionTierUpData, code)));
+	llvm::LoadInst* tierUpCode
+		= loadFromUntypedPointer(irBuilder.CreateInBoundsGEP(tierUpData, {tierUpCodeOffset}),
+								 llvmContext.i8PtrType,
+								 sizeof(void*));
+	tierUpCode->setAtomic(llvm::AtomicOrdering::Acquire);
+	irBuilder.CreateCondBr(irBuilder.CreateIsNull(tierUpCode),
+						   countCallBlock,
+						   tierUpBlock,
+						   moduleContext.likelyTrueBranchWeights);
+
+	irBuilder.SetInsertPoint(tierUpBlock);
+	llvm::SmallVector<llvm::Value*, 8> tierUpArgs;
+	for(llvm::Argument& arg : function->args()) { tierUpArgs.push_back(&arg); }
+	auto tierUpCall = irBuilder.CreateCall(
+		irBuilder.CreatePointerCast(tierUpCode, function->getType()), tierUpArgs);
+	tierUpCall->setCallingConv(function->getCallingConv());
+	tierUpCall->setTailCall();
+	irBuilder.CreateRet(tierUpCall);
+
+	// Count down the calls until the function should be optimized, and ask the runtime to compile
+	// optimized code for the function when the count reaches zero. The count stops at zero, so a
+	// function that is waiting to be optimized, or that failed to be optimized, doesn't wrap the
+	// count around and request optimization again. The count is decremented with a compare and
+	// exchange that gives up if another thread changed the count: it's not necessary to count
+	// every call exactly.
+	irBuilder.SetInsertPoint(countCallBlock);
+	llvm::Value* numCallsUntilTierUpPointer = irBuilder.CreatePointerCast(
+		irBuilder.CreateInBoundsGEP(
+			tierUpData,
+			{emitLiteral(llvmContext,
+						 Uptr(offsetof(Runtime::FunctionTierUpData, numCallsUntilTierUp)))}),
+		llvmContext.i32Type->getPointerTo());
+	llvm::LoadInst* oldNumCallsUntilTierUp = irBuilder.CreateLoad(numCallsUntilTierUpPointer);
+	oldNumCallsUntilTierUp->setAlignment(LLVM_ALIGNMENT(sizeof(U32)));
+	oldNumCallsUntilTierUp->setAtomic(llvm::AtomicOrdering::Monotonic);
+	irBuilder.CreateCondBr(
+		irBuilder.CreateICmpEQ(oldNumCallsUntilTierUp, emitLiteral(llvmContext, U32(0))),
+		bodyBlock,
+		decrementCallCountBlock);
+
+	irBuilder.SetInsertPoint(decrementCallCountBlock);
+	llvm::Value* decrementResult = irBuilder.CreateAtomicCmpXchg(
+		numCallsUntilTierUpPointer,
+		oldNumCallsUntilTierUp,
+		irBuilder.CreateSub(oldNumCallsUntilTierUp, emitLiteral(llvmContext, U32(1))),
+		llvm::AtomicOrdering::Monotonic,
+		llvm::AtomicOrdering::Monotonic);
+	irBuilder.CreateCondBr(
+		irBuilder.CreateAnd(
+			irBuilder.CreateExtractValue(decrementResult, {1}),
+			irBuilder.CreateICmpEQ(oldNumCallsUntilTierUp, emitLiteral(llvmContext, U32(1)))),
+		requestTierUpBlock,
+		bodyBlock,
+		moduleContext.likelyFalseBranchWeights);
+
+	irBuilder.SetInsertPoint(requestTierUpBlock);
+	emitRuntimeIntrinsic(
+		"requestTierUp",
+		FunctionType({},
+					 {ValueType::funcref, inferValueType<Uptr>()},
+					 IR::CallingConvention::intrinsic),
+		{irBuilder.CreateIntToPtr(
+			 llvm::ConstantExpr::getSub(
+				 llvm::ConstantExpr::getPtrToInt(function, llvmContext.iptrType),
+				 emitLiteral(llvmContext, Uptr(offsetof(Runtime::Function, code)))),
+			 llvmContext.externrefType),
+		 emitLiteral(llvmContext, functionDefIndex)});
+	irBuilder.CreateBr(bodyBlock);
+
+	irBuilder.SetInsertPoint(bodyBlock);
+}
+
 // A helper function to emit a conditional call to a non-returning intrinsic function.
 void EmitFunctionContext::emitConditionalTrapIntrinsic(
 	llvm::Value* booleanCondition,
@@ -381,6 +467,10 @@ void EmitFunctionContext::emit()
 		}
 	}
 
+	// Baseline tier code checks whether it should call optimized code for the function before
+	// executing the function's body.
+	if(tierUpData) { emitTierUpCheck(); }
+
 	if(EMIT_ENTER_EXIT_HOOKS)
 	{
 		emitRuntimeIntrinsic(
@@ -22,6 +22,11 @@ namespace WAVM { namespace LLVMJIT {
 		IR::FunctionType functionType;
 		llvm::Function* function;
 
+		// If the function is emitted as baseline tier code, the address of its FunctionTierUpData
+		// and the index of its definition in the module.
+		llvm::Constant* tierUpData;
+		Uptr functionDefIndex;
+
 		std::vector<llvm::Value*> localPointers;
 
 		llvm::DISubprogram* diFunction;
@@ -62,17 +67,32 @@ namespace WAVM { namespace LLVMJIT {
 		std::vector<BranchTarget> branchTargetStack;
 		std::vector<llvm::Value*> stack;
 
+		// The memory accesses that have been bounds checked in boundsCheckedBlock, which are used
+		// to omit redundant bounds checks if the module is compiled with them.
+		struct BoundsCheckedAccess
+		{
+			llvm::Value* address;
+			Uptr memoryIndex;
+			U64 endOffset;
+		};
+		llvm::BasicBlock* boundsCheckedBlock = nullptr;
+		std::vector<BoundsCheckedAccess> boundsCheckedAccesses;
+
 		EmitFunctionContext(LLVMContext& inLLVMContext,
 							EmitModuleContext& inModuleContext,
 							const IR::Module& inIRModule,
 							const IR::FunctionDef& inFunctionDef,
-							llvm::Function* inLLVMFunction)
+							llvm::Function* inLLVMFunction,
+							llvm::Constant* inTierUpData = nullptr,
+							Uptr inFunctionDefIndex = UINTPTR_MAX)
 		: EmitContext(inLLVMContext, inModuleContext.memoryOffsets)
 		, moduleContext(inModuleContext)
 		, irModule(inIRModule)
 		, functionDef(inFunctionDef)
 		, functionType(inIRModule.types[inFunctionDef.type.index])
 		, function(inLLVMFunction)
+		, tierUpData(inTierUpData)
+		, functionDefIndex(inFunctionDefIndex)
 		{
 		}
 
@@ -159,6 +179,15 @@ namespace WAVM { namespace LLVMJIT {
 										 IR::FunctionType intrinsicType,
 										 const std::initializer_list<llvm::Value*>& args);
 
+		// Emits a reference to one of the module's functions. The loaded code may be shared by
+		// instances that each have their own Function objects, so it looks up the function in the
+		// instance.
+		llvm::Value* emitFunctionRef(Uptr functionIndex);
+
+		// Emits the baseline tier code that forwards calls to the function's optimized code once it
+		// is loaded, and counts calls to the function until it should be optimized.
+		void emitTierUpCheck();
+
 		// A helper function to emit a conditional call to a non-returning intrinsic function.
 		void emitConditionalTrapIntrinsic(llvm::Value* booleanCondition,
 										  const char* intrinsicName,
@@ -29,33 +29,93 @@ using namespace WAVM;
 using namespace WAVM::IR;
 using namespace WAVM::LLVMJIT;
 
+// Emits a check that traps if an access of numBytes at boundedAddress ends beyond the memory's
+// current size.
+static void emitMemoryBoundsCheck(EmitFunctionContext& functionContext,
+								  llvm::Value* address,
+								  llvm::Value* boundedAddress,
+								  U32 offset,
+								  Uptr memoryIndex,
+								  U64 numBytes)
+{
+	llvm::IRBuilder<>& irBuilder = functionContext.irBuilder;
+	LLVMContext& llvmContext = functionContext.llvmContext;
+	llvm::Constant* memoryOffset = functionContext.moduleContext.memoryOffsets[memoryIndex];
+
+	// Memories never shrink, so if an access to the same address and memory that ends at or after
+	// the end of this access has already been checked in this basic block, this access is in
+	// bounds. Later checks aren't hoisted above earlier ones, since that would trap before the
+	// side effects between them.
+	const U64 endOffset = U64(offset) + numBytes;
+	if(irBuilder.GetInsertBlock() != functionContext.boundsCheckedBlock)
+	{ functionContext.boundsCheckedAccesses.clear(); }
+	for(const EmitFunctionContext::BoundsCheckedAccess& checkedAccess :
+		functionContext.boundsCheckedAccesses)
+	{
+		if(checkedAccess.address == address && checkedAccess.memoryIndex == memoryIndex
+		   && checkedAccess.endOffset >= endOffset)
+		{ return; }
+	}
+
+	llvm::Value* memoryNumPages = functionContext.getMemoryNumPages(memoryOffset);
+	llvm::Value* memoryNumBytes
+		= irBuilder.CreateMul(memoryNumPages, emitLiteral(llvmContext, Uptr(IR::numBytesPerPage)));
+	functionContext.emitConditionalTrapIntrinsic(
+		irBuilder.CreateICmpUGT(
+			irBuilder.CreateAdd(boundedAddress, emitLiteral(llvmContext, numBytes)),
+			memoryNumBytes),
+		"memoryOutOfBoundsTrap",
+		FunctionType(TypeTuple{},
+					 TypeTuple{ValueType::i64, ValueType::i32, ValueType::i64, ValueType::i64},
+					 IR::CallingConvention::intrinsic),
+		{boundedAddress,
+		 emitLiteral(llvmContext, U32(numBytes)),
+		 memoryNumPages,
+		 getMemoryIdFromOffset(llvmContext, memoryOffset)});
+
+	// The check ends the basic block, so the accesses that follow it are in the block it branches
+	// to if the access is in bounds.
+	functionContext.boundsCheckedBlock = irBuilder.GetInsertBlock();
+	functionContext.boundsCheckedAccesses.push_back({address, memoryIndex, endOffset});
+}
+
 // Bounds checks a sandboxed memory address + offset, and returns an offset relative to the memory
 // base address that is guaranteed to be within the virtual address space allocated for the linear
-// memory object.
-static llvm::Value* getOffsetAndBoundedAddress(EmitContext& emitContext,
+// memory object. If numBytes is zero, the caller checks the bounds of the access itself.
+static llvm::Value* getOffsetAndBoundedAddress(EmitFunctionContext& functionContext,
 											   llvm::Value* address,
-											   U32 offset)
+											   U32 offset,
+											   Uptr memoryIndex,
+											   U64 numBytes)
 {
+	llvm::IRBuilder<>& irBuilder = functionContext.irBuilder;
+	LLVMContext& llvmContext = functionContext.llvmContext;
+
 	// zext the 32-bit address to 64-bits.
 	// This is crucial for security, as LLVM will otherwise implicitly sign extend it to 64-bits in
 	// the GEP below, interpreting it as a signed offset and allowing access to memory outside the
 	// sandboxed memory range. There are no 'far addresses' in a 32 bit runtime.
-	address = emitContext.irBuilder.CreateZExt(address, emitContext.llvmContext.i64Type);
+	llvm::Value* boundedAddress = irBuilder.CreateZExt(address, llvmContext.i64Type);
 
 	// Add the offset to the byte index.
 	if(offset)
 	{
-		address = emitContext.irBuilder.CreateAdd(
-			address,
-			emitContext.irBuilder.CreateZExt(emitLiteral(emitContext.llvmContext, offset),
-											 emitContext.llvmContext.i64Type));
+		boundedAddress = irBuilder.CreateAdd(
+			boundedAddress,
+			irBuilder.CreateZExt(emitLiteral(llvmContext, offset), llvmContext.i64Type));
 	}
 
 	// If HAS_64BIT_ADDRESS_SPACE, the memory has enough virtual address space allocated to ensure
 	// that any 32-bit byte index + 32-bit offset will fall within the virtual address sandbox, so
-	// no explicit bounds check is necessary.
+	// no explicit bounds check is necessary unless the module is compiled for memories with
+	// smaller reservations.
+	if(functionContext.moduleContext.boundsCheckMemoryAccesses && numBytes)
+	{
+		emitMemoryBoundsCheck(
+			functionContext, address, boundedAddress, offset, memoryIndex, numBytes);
+	}
 
-	return address;
+	return boundedAddress;
 }
 
 llvm::Value* EmitFunctionContext::coerceAddressToPointer(llvm::Value* boundedAddress,
@@ -137,8 +197,10 @@ void EmitFunctionContext::memory_copy(MemoryCopyImm imm)
 	llvm::Value* sourceAddress = pop();
 	llvm::Value* destAddress = pop();
 
-	llvm::Value* sourceBoundedAddress = getOffsetAndBoundedAddress(*this, sourceAddress, 0);
-	llvm::Value* destBoundedAddress = getOffsetAndBoundedAddress(*this, destAddress, 0);
+	llvm::Value* sourceBoundedAddress
+		= getOffsetAndBoundedAddress(*this, sourceAddress, 0, imm.sourceMemoryIndex, 0);
+	llvm::Value* destBoundedAddress
+		= getOffsetAndBoundedAddress(*this, destAddress, 0, imm.destMemoryIndex, 0);
 
 	llvm::Value* sourcePointer
 		= coerceAddressToPointer(sourceBoundedAddress, llvmContext.i8Type, imm.sourceMemoryIndex);
@@ -157,9 +219,9 @@ void EmitFunctionContext::memory_copy(MemoryCopyImm imm)
 								sourceMemoryNumBytes),
 		"memoryOutOfBoundsTrap",
 		FunctionType(TypeTuple{},
-					 TypeTuple{ValueType::i32, ValueType::i32, ValueType::i64, ValueType::i64},
+					 TypeTuple{ValueType::i64, ValueType::i32, ValueType::i64, ValueType::i64},
 					 IR::CallingConvention::intrinsic),
-		{sourceAddress,
+		{irBuilder.CreateZExt(sourceAddress, llvmContext.i64Type),
 		 numBytes,
 		 sourceMemoryNumPages,
 		 emitLiteral(llvmContext, U64(imm.sourceMemoryIndex))});
@@ -174,9 +236,9 @@ void EmitFunctionContext::memory_copy(MemoryCopyImm imm)
 								destMemoryNumBytes),
 		"memoryOutOfBoundsTrap",
 		FunctionType(TypeTuple{},
-					 TypeTuple{ValueType::i32, ValueType::i32, ValueType::i64, ValueType::i64},
+					 TypeTuple{ValueType::i64, ValueType::i32, ValueType::i64, ValueType::i64},
 					 IR::CallingConvention::intrinsic),
-		{destAddress,
+		{irBuilder.CreateZExt(destAddress, llvmContext.i64Type),
 		 numBytes,
 		 destMemoryNumPages,
 		 emitLiteral(llvmContext, U64(imm.destMemoryIndex))});
@@ -196,7 +258,8 @@ void EmitFunctionContext::memory_fill(MemoryImm imm)
 	llvm::Value* value = pop();
 	llvm::Value* destAddress = pop();
 
-	llvm::Value* destBoundedAddress = getOffsetAndBoundedAddress(*this, destAddress, 0);
+	llvm::Value* destBoundedAddress
+		= getOffsetAndBoundedAddress(*this, destAddress, 0, imm.memoryIndex, 0);
 	llvm::Value* destPointer
 		= coerceAddressToPointer(destBoundedAddress, llvmContext.i8Type, imm.memoryIndex);
 
@@ -211,9 +274,12 @@ void EmitFunctionContext::memory_fill(MemoryImm imm)
 								memoryNumBytes),
 		"memoryOutOfBoundsTrap",
 		FunctionType(TypeTuple{},
-					 TypeTuple{ValueType::i32, ValueType::i32, ValueType::i64, ValueType::i64},
+					 TypeTuple{ValueType::i64, ValueType::i32, ValueType::i64, ValueType::i64},
 					 IR::CallingConvention::intrinsic),
-		{destAddress, numBytes, memoryNumPages, emitLiteral(llvmContext, U64(imm.memoryIndex))});
+		{irBuilder.CreateZExt(destAddress, llvmContext.i64Type),
+		 numBytes,
+		 memoryNumPages,
+		 emitLiteral(llvmContext, U64(imm.memoryIndex))});
 
 	// Use the LLVM memset instruction to do the fill.
 	irBuilder.CreateMemSet(destPointer,
@@ -231,7 +297,8 @@ void EmitFunctionContext::memory_fill(MemoryImm imm)
 	void EmitFunctionContext::name(LoadOrStoreImm<naturalAlignmentLog2> imm)                       \
 	{                                                                                              \
 		auto address = pop();                                                                      \
-		auto boundedAddress = getOffsetAndBoundedAddress(*this, address, imm.offset);              \
+		auto boundedAddress = getOffsetAndBoundedAddress(                                          \
+			*this, address, imm.offset, imm.memoryIndex, U64(1) << naturalAlignmentLog2);          \
 		auto pointer = coerceAddressToPointer(boundedAddress, llvmMemoryType, imm.memoryIndex);    \
 		auto load = irBuilder.CreateLoad(pointer);                                                 \
 		/* Don't trust the alignment hint provided by the WebAssembly code, since the load can't   \
@@ -245,7 +312,8 @@ void EmitFunctionContext::memory_fill(MemoryImm imm)
 	{                                                                                              \
 		auto value = pop();                                                                        \
 		auto address = pop();                                                                      \
-		auto boundedAddress = getOffsetAndBoundedAddress(*this, address, imm.offset);              \
+		auto boundedAddress = getOffsetAndBoundedAddress(                                          \
+			*this, address, imm.offset, imm.memoryIndex, U64(1) << naturalAlignmentLog2);          \
 		auto pointer = coerceAddressToPointer(boundedAddress, llvmMemoryType, imm.memoryIndex);    \
 		auto memoryValue = conversionOp(value, llvmMemoryType);                                    \
 		auto store = irBuilder.CreateStore(memoryValue, pointer);                                  \
@@ -311,7 +379,8 @@ static void emitLoadInterleaved(EmitFunctionContext& functionContext,
 	WAVM_ASSERT(numLanes <= maxLanes);
 
 	auto address = functionContext.pop();
-	auto boundedAddress = getOffsetAndBoundedAddress(functionContext, address, offset);
+	auto boundedAddress = getOffsetAndBoundedAddress(
+		functionContext, address, offset, memoryIndex, U64(numVectors) * 16);
 	auto pointer
 		= functionContext.coerceAddressToPointer(boundedAddress, llvmValueType, memoryIndex);
 	if(functionContext.moduleContext.targetArch == llvm::Triple::aarch64)
@@ -375,7 +444,8 @@ static void emitStoreInterleaved(EmitFunctionContext& functionContext,
 			= functionContext.irBuilder.CreateBitCast(functionContext.pop(), llvmValueType);
 	}
 	auto address = functionContext.pop();
-	auto boundedAddress = getOffsetAndBoundedAddress(functionContext, address, offset);
+	auto boundedAddress = getOffsetAndBoundedAddress(
+		functionContext, address, offset, memoryIndex, U64(numVectors) * 16);
 	auto pointer
 		= functionContext.coerceAddressToPointer(boundedAddress, llvmValueType, memoryIndex);
 	if(functionContext.moduleContext.targetArch == llvm::Triple::aarch64)
@@ -487,7 +557,8 @@ void EmitFunctionContext::memory_atomic_notify(AtomicLoadOrStoreImm<2> imm)
 {
 	llvm::Value* numWaiters = pop();
 	llvm::Value* address = pop();
-	llvm::Value* boundedAddress = getOffsetAndBoundedAddress(*this, address, imm.offset);
+	llvm::Value* boundedAddress = getOffsetAndBoundedAddress(
+		*this, address, imm.offset, imm.memoryIndex, 4);
 	trapIfMisalignedAtomic(boundedAddress, imm.alignmentLog2);
 	push(emitRuntimeIntrinsic(
 		"memory.atomic.notify",
@@ -503,7 +574,8 @@ void EmitFunctionContext::memory_atomic_wait32(AtomicLoadOrStoreImm<2> imm)
 	llvm::Value* timeout = pop();
 	llvm::Value* expectedValue = pop();
 	llvm::Value* address = pop();
-	llvm::Value* boundedAddress = getOffsetAndBoundedAddress(*this, address, imm.offset);
+	llvm::Value* boundedAddress = getOffsetAndBoundedAddress(
+		*this, address, imm.offset, imm.memoryIndex, 4);
 	trapIfMisalignedAtomic(boundedAddress, imm.alignmentLog2);
 	push(emitRuntimeIntrinsic(
 		"memory.atomic.wait32",
@@ -521,7 +593,8 @@ void EmitFunctionContext::memory_atomic_wait64(AtomicLoadOrStoreImm<3> imm)
 	llvm::Value* timeout = pop();
 	llvm::Value* expectedValue = pop();
 	llvm::Value* address = pop();
-	llvm::Value* boundedAddress = getOffsetAndBoundedAddress(*this, address, imm.offset);
+	llvm::Value* boundedAddress = getOffsetAndBoundedAddress(
+		*this, address, imm.offset, imm.memoryIndex, 8);
 	trapIfMisalignedAtomic(boundedAddress, imm.alignmentLog2);
 	push(emitRuntimeIntrinsic(
 		"memory.atomic.wait64",
@@ -550,7 +623,8 @@ void EmitFunctionContext::atomic_fence(AtomicFenceImm imm)
 	void EmitFunctionContext::valueTypeId##_##name(AtomicLoadOrStoreImm<naturalAlignmentLog2> imm) \
 	{                                                                                              \
 		auto address = pop();                                                                      \
-		auto boundedAddress = getOffsetAndBoundedAddress(*this, address, imm.offset);              \
+		auto boundedAddress = getOffsetAndBoundedAddress(                                          \
+			*this, address, imm.offset, imm.memoryIndex, U64(1) << naturalAlignmentLog2);          \
 		trapIfMisalignedAtomic(boundedAddress, naturalAlignmentLog2);                              \
 		auto pointer = coerceAddressToPointer(boundedAddress, llvmMemoryType, imm.memoryIndex);    \
 		auto load = irBuilder.CreateLoad(pointer);                                                 \
@@ -564,7 +638,8 @@ void EmitFunctionContext::atomic_fence(AtomicFenceImm imm)
 	{                                                                                              \
 		auto value = pop();                                                                        \
 		auto address = pop();                                                                      \
-		auto boundedAddress = getOffsetAndBoundedAddress(*this, address, imm.offset);              \
+		auto boundedAddress = getOffsetAndBoundedAddress(                                          \
+			*this, address, imm.offset, imm.memoryIndex, U64(1) << naturalAlignmentLog2);          \
 		trapIfMisalignedAtomic(boundedAddress, naturalAlignmentLog2);                              \
 		auto pointer = coerceAddressToPointer(boundedAddress, llvmMemoryType, imm.memoryIndex);    \
 		auto memoryValue = valueToMem(value, llvmMemoryType);                                      \
@@ -598,7 +673,8 @@ EMIT_ATOMIC_STORE_OP(i64, atomic_store32, llvmContext.i32Type, 2, trunc)
 		auto replacementValue = valueToMem(pop(), llvmMemoryType);                                 \
 		auto expectedValue = valueToMem(pop(), llvmMemoryType);                                    \
 		auto address = pop();                                                                      \
-		auto boundedAddress = getOffsetAndBoundedAddress(*this, address, imm.offset);              \
+		auto boundedAddress = getOffsetAndBoundedAddress(                                          \
+			*this, address, imm.offset, imm.memoryIndex, U64(1) << alignmentLog2);                 \
 		trapIfMisalignedAtomic(boundedAddress, alignmentLog2);                                     \
 		auto pointer = coerceAddressToPointer(boundedAddress, llvmMemoryType, imm.memoryIndex);    \
 		auto atomicCmpXchg                                                                         \
@@ -627,7 +703,8 @@ EMIT_ATOMIC_CMPXCHG(i64, atomic_rmw_cmpxchg, llvmContext.i64Type, 3, identity, i
 	{                                                                                              \
 		auto value = valueToMem(pop(), llvmMemoryType);                                            \
 		auto address = pop();                                                                      \
-		auto boundedAddress = getOffsetAndBoundedAddress(*this, address, imm.offset);              \
+		auto boundedAddress = getOffsetAndBoundedAddress(                                          \
+			*this, address, imm.offset, imm.memoryIndex, U64(1) << alignmentLog2);                 \
 		trapIfMisalignedAtomic(boundedAddress, alignmentLog2);                                     \
 		auto pointer = coerceAddressToPointer(boundedAddress, llvmMemoryType, imm.memoryIndex);    \
 		auto atomicRMW = irBuilder.CreateAtomicRMW(llvm::AtomicRMWInst::BinOp::rmwOpId,            \
@@ -5,6 +5,7 @@
 #include "LLVMJITPrivate.h"
 #include "WAVM/IR/Module.h"
 #include "WAVM/IR/Types.h"
+#include "WAVM/Inline/Assert.h"
 #include "WAVM/Inline/BasicTypes.h"
 #include "WAVM/Inline/Timing.h"
 
@@ -110,10 +111,14 @@ static llvm::Constant* createImportedConstant(llvm::Module& llvmModule, llvm::Tw
 void LLVMJIT::emitModule(const IR::Module& irModule,
 						 LLVMContext& llvmContext,
 						 llvm::Module& outLLVMModule,
-						 llvm::TargetMachine* targetMachine)
+						 llvm::TargetMachine* targetMachine,
+						 bool boundsCheckMemoryAccesses,
+						 EmitTier tier,
+						 const std::vector<Uptr>* functionDefIndices)
 {
 	Timing::Timer emitTimer;
 	EmitModuleContext moduleContext(irModule, llvmContext, &outLLVMModule, targetMachine);
+	moduleContext.boundsCheckMemoryAccesses = boundsCheckMemoryAccesses;
 
 	// Set the module data layout for the target machine.
 	outLLVMModule.setDataLayout(targetMachine->createDataLayout());
@@ -239,10 +244,46 @@ void LLVMJIT::emitModule(const IR::Module& irModule,
 		moduleContext.functions[functionIndex] = function;
 	}
 
-	// Compile each function in the module.
+	// Determine which function definitions to emit. The other function definitions are left as
+	// declarations that will be bound to definitions in another shard's object file, or to their
+	// baseline code, when the object code is loaded.
+	std::vector<bool> isFunctionDefEmitted(irModule.functions.defs.size(), !functionDefIndices);
+	if(functionDefIndices)
+	{
+		for(Uptr functionDefIndex : *functionDefIndices)
+		{
+			WAVM_ASSERT(functionDefIndex < irModule.functions.defs.size());
+			isFunctionDefEmitted[functionDefIndex] = true;
+		}
+	}
+
+	// Tier-up code calls the function definitions it doesn't emit through their baseline code.
+	if(tier == EmitTier::tierUp)
+	{
+		for(Uptr functionDefIndex = 0; functionDefIndex < irModule.functions.defs.size();
+			++functionDefIndex)
+		{
+			const Uptr functionIndex = irModule.functions.imports.size() + functionDefIndex;
+			FunctionType functionType
+				= irModule.types[irModule.functions.defs[functionDefIndex].type.index];
+
+			llvm::Function* baselineFunction
+				= llvm::Function::Create(asLLVMType(llvmContext, functionType),
+										 llvm::Function::ExternalLinkage,
+										 getExternalName("baselineFunctionDef", functionDefIndex),
+										 &outLLVMModule);
+			baselineFunction->setCallingConv(asLLVMCallingConv(functionType.callingConvention()));
+			if(!isFunctionDefEmitted[functionDefIndex])
+			{ moduleContext.functions[functionIndex] = baselineFunction; }
+		}
+	}
+
+	// Compile each function definition that should be emitted.
 	for(Uptr functionDefIndex = 0; functionDefIndex < irModule.functions.defs.size();
 		++functionDefIndex)
 	{
+		if(!isFunctionDefEmitted[functionDefIndex]) { continue; }
+
 		const FunctionDef& functionDef = irModule.functions.defs[functionDefIndex];
 		llvm::Function* function
 			= moduleContext.functions[irModule.functions.imports.size() + functionDefIndex];
@@ -261,7 +302,23 @@ void LLVMJIT::emitModule(const IR::Module& irModule,
 								 moduleContext.typeIds[functionDef.type.index]);
 		setFunctionAttributes(targetMachine, function);
 
-		EmitFunctionContext(llvmContext, moduleContext, irModule, functionDef, function).emit();
+		// Baseline code uses the FunctionTierUpData in the function's FunctionMutableData, which
+		// is bound to a separate symbol.
+		llvm::Constant* tierUpData = nullptr;
+		if(tier == EmitTier::baseline)
+		{
+			tierUpData = createImportedConstant(
+				outLLVMModule, getExternalName("functionDefTierUpData", functionDefIndex));
+		}
+
+		EmitFunctionContext(llvmContext,
+							moduleContext,
+							irModule,
+							functionDef,
+							function,
+							tierUpData,
+							functionDefIndex)
+			.emit();
 	}
 
 	// Finalize the debug info.
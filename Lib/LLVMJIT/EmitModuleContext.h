@@ -18,9 +18,11 @@ namespace WAVM { namespace LLVMJIT {
 		llvm::TargetMachine* targetMachine;
 		llvm::Triple::ArchType targetArch;
 		bool useWindowsSEH;
+		bool boundsCheckMemoryAccesses = false;
 
 		std::vector<llvm::Constant*> typeIds;
 		std::vector<llvm::Function*> functions;
+
 		std::vector<llvm::Constant*> tableOffsets;
 		std::vector<llvm::Constant*> memoryOffsets;
 		std::vector<llvm::Constant*> globals;
@@ -35,16 +35,18 @@ void EmitFunctionContext::ref_is_null(NoImm)
 	push(coerceBoolToI32(isNull));
 }
 
-void EmitFunctionContext::ref_func(FunctionRefImm imm)
+llvm::Value* EmitFunctionContext::emitFunctionRef(Uptr functionIndex)
 {
-	llvm::Value* referencedFunction = moduleContext.functions[imm.functionIndex];
-	llvm::Value* codeAddress = irBuilder.CreatePtrToInt(referencedFunction, llvmContext.iptrType);
-	llvm::Value* functionAddress = irBuilder.CreateSub(
-		codeAddress, emitLiteral(llvmContext, Uptr(offsetof(Runtime::Function, code))));
-	llvm::Value* externref = irBuilder.CreateIntToPtr(functionAddress, llvmContext.externrefType);
-	push(externref);
+	return emitRuntimeIntrinsic(
+		"ref.func",
+		FunctionType({ValueType::externref},
+					 TypeTuple({inferValueType<Uptr>(), inferValueType<Uptr>()}),
+					 IR::CallingConvention::intrinsic),
+		{moduleContext.instanceId, emitLiteral(llvmContext, functionIndex)})[0];
 }
 
+void EmitFunctionContext::ref_func(FunctionRefImm imm) { push(emitFunctionRef(imm.functionIndex)); }
+
 void EmitFunctionContext::table_get(TableImm imm)
 {
 	llvm::Value* index = pop();
@@ -114,17 +114,9 @@ void EmitFunctionContext::global_get(GetOrSetVariableImm<true> imm)
 		case InitializerExpression::Type::ref_null:
 			value = llvm::Constant::getNullValue(llvmContext.externrefType);
 			break;
-		case InitializerExpression::Type::ref_func: {
-			llvm::Value* referencedFunction = moduleContext.functions[globalDef.initializer.ref];
-			llvm::Value* codeAddress
-				= irBuilder.CreatePtrToInt(referencedFunction, llvmContext.iptrType);
-			llvm::Value* functionAddress = irBuilder.CreateSub(
-				codeAddress, emitLiteral(llvmContext, Uptr(offsetof(Runtime::Function, code))));
-			llvm::Value* externref
-				= irBuilder.CreateIntToPtr(functionAddress, llvmContext.externrefType);
-			value = externref;
+		case InitializerExpression::Type::ref_func:
+			value = emitFunctionRef(globalDef.initializer.ref);
 			break;
-		}
 
 		case InitializerExpression::Type::invalid:
 		default: WAVM_UNREACHABLE();
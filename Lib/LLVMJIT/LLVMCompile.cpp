@@ -1,4 +1,6 @@
 #include <string.h>
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <system_error>
@@ -13,6 +15,7 @@
 #include "WAVM/LLVMJIT/LLVMJIT.h"
 #include "WAVM/Logging/Logging.h"
 #include "WAVM/Platform/Defines.h"
+#include "WAVM/Platform/Thread.h"
 
 PUSH_DISABLE_WARNINGS_FOR_LLVM_HEADERS
 #include <llvm-c/Disassembler.h>
@@ -20,6 +23,7 @@ PUSH_DISABLE_WARNINGS_FOR_LLVM_HEADERS
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/Triple.h>
 #include <llvm/ADT/ilist_iterator.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
 #include <llvm/CodeGen/TargetSubtargetInfo.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/IR/LegacyPassManager.h>
@@ -32,7 +36,10 @@ PUSH_DISABLE_WARNINGS_FOR_LLVM_HEADERS
 #include <llvm/Support/Host.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
+#include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Scalar/GVN.h>
+#include <llvm/Transforms/Vectorize.h>
 #if LLVM_VERSION_MAJOR >= 7
 #include <llvm/Transforms/Utils.h>
 #endif
@@ -52,6 +59,10 @@ using namespace WAVM;
 using namespace WAVM::IR;
 using namespace WAVM::LLVMJIT;
 
+// LLVM's code generator may recurse deeply, so give the threads that compile shards of a module
+// a larger stack than the default.
+static constexpr Uptr compileThreadNumStackBytes = 8 * 1024 * 1024;
+
 static std::string printModule(const llvm::Module& llvmModule)
 {
 	std::string result;
@@ -89,17 +100,55 @@ private:
 	std::vector<U8> output;
 };
 
-static void optimizeLLVMModule(llvm::Module& llvmModule, bool shouldLogMetrics)
+// The inlining threshold used at OptimizationLevel::aggressive. This is lower than LLVM's default
+// threshold, so only small functions are inlined.
+static constexpr int aggressiveInlineThreshold = 75;
+
+static void optimizeLLVMModule(llvm::Module& llvmModule,
+							   llvm::TargetMachine* targetMachine,
+							   OptimizationLevel optimizationLevel,
+							   bool shouldLogMetrics)
 {
+	if(optimizationLevel == OptimizationLevel::none) { return; }
+
 	// Run some optimization on the module's functions.
 	Timing::Timer optimizationTimer;
 
+	// Inline small functions before running the function passes, so the inlined code is optimized
+	// in the context of its caller.
+	if(optimizationLevel == OptimizationLevel::aggressive)
+	{
+		llvm::legacy::PassManager passManager;
+		passManager.add(llvm::createPromoteMemoryToRegisterPass());
+		passManager.add(llvm::createFunctionInliningPass(aggressiveInlineThreshold));
+		passManager.run(llvmModule);
+	}
+
 	llvm::legacy::FunctionPassManager fpm(&llvmModule);
+	fpm.add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
 	fpm.add(llvm::createPromoteMemoryToRegisterPass());
-	fpm.add(llvm::createInstructionCombiningPass());
-	fpm.add(llvm::createCFGSimplificationPass());
-	fpm.add(llvm::createJumpThreadingPass());
-	fpm.add(llvm::createConstantPropagationPass());
+	if(optimizationLevel == OptimizationLevel::fast)
+	{ fpm.add(llvm::createCFGSimplificationPass()); }
+	else
+	{
+		fpm.add(llvm::createInstructionCombiningPass());
+		fpm.add(llvm::createCFGSimplificationPass());
+		fpm.add(llvm::createJumpThreadingPass());
+		fpm.add(llvm::createConstantPropagationPass());
+	}
+
+	if(optimizationLevel == OptimizationLevel::aggressive)
+	{
+		fpm.add(llvm::createLICMPass());
+		fpm.add(llvm::createGVNPass());
+		fpm.add(llvm::createLoopUnrollPass());
+		fpm.add(llvm::createLoopVectorizePass());
+		fpm.add(llvm::createSLPVectorizerPass());
+
+		// Clean up after the vectorizers.
+		fpm.add(llvm::createInstructionCombiningPass());
+		fpm.add(llvm::createCFGSimplificationPass());
+	}
 
 	// This DCE pass is necessary to work around a bug in LLVM's CodeGenPrepare that's triggered
 	// if there's a dead div/rem with limited-range divisor:
@@ -120,7 +169,8 @@ static void optimizeLLVMModule(llvm::Module& llvmModule, bool shouldLogMetrics)
 std::vector<U8> LLVMJIT::compileLLVMModule(LLVMContext& llvmContext,
 										   llvm::Module&& llvmModule,
 										   bool shouldLogMetrics,
-										   llvm::TargetMachine* targetMachine)
+										   llvm::TargetMachine* targetMachine,
+										   OptimizationLevel optimizationLevel)
 {
 	// Verify the module.
 	if(WAVM_ENABLE_ASSERTS)
@@ -135,7 +185,7 @@ std::vector<U8> LLVMJIT::compileLLVMModule(LLVMContext& llvmContext,
 	}
 
 	// Optimize the module;
-	optimizeLLVMModule(llvmModule, shouldLogMetrics);
+	optimizeLLVMModule(llvmModule, targetMachine, optimizationLevel, shouldLogMetrics);
 
 	// Generate machine code for the module.
 	Timing::Timer machineCodeTimer;
@@ -197,18 +247,185 @@ static std::unique_ptr<llvm::TargetMachine> getAndValidateTargetMachine(
 	return targetMachine;
 }
 
-std::vector<U8> LLVMJIT::compileModule(const IR::Module& irModule, const TargetSpec& targetSpec)
+// Emits LLVM IR for a module, and compiles it to object code. Baseline tier code is compiled
+// without optimization, and with LLVM's fast instruction selector.
+static std::vector<U8> emitAndCompileModule(const IR::Module& irModule,
+											llvm::TargetMachine* targetMachine,
+											const TargetSpec& targetSpec,
+											EmitTier tier,
+											const std::vector<Uptr>* functionDefIndices,
+											bool shouldLogMetrics)
 {
-	std::unique_ptr<llvm::TargetMachine> targetMachine
-		= getAndValidateTargetMachine(irModule.featureSpec, targetSpec);
+	OptimizationLevel optimizationLevel = targetSpec.optimizationLevel;
+	if(tier == EmitTier::baseline)
+	{
+		optimizationLevel = OptimizationLevel::none;
+		targetMachine->setOptLevel(llvm::CodeGenOpt::None);
+	}
 
-	// Emit LLVM IR for the module.
 	LLVMContext llvmContext;
 	llvm::Module llvmModule("", llvmContext);
-	emitModule(irModule, llvmContext, llvmModule, targetMachine.get());
+	emitModule(irModule,
+			   llvmContext,
+			   llvmModule,
+			   targetMachine,
+			   targetSpec.boundsCheckMemoryAccesses,
+			   tier,
+			   functionDefIndices);
+
+	return compileLLVMModule(
+		llvmContext, std::move(llvmModule), shouldLogMetrics, targetMachine, optimizationLevel);
+}
+
+// The state shared by the threads that compile the shards of a module.
+struct ShardedCompileState
+{
+	const IR::Module& irModule;
+	const TargetSpec& targetSpec;
+	const EmitTier tier;
+
+	std::vector<std::vector<Uptr>> shardFunctionDefIndices;
+	std::vector<std::vector<U8>> shardObjectFiles;
+	std::atomic<Uptr> nextShardIndex{0};
+
+	ShardedCompileState(const IR::Module& inIRModule,
+						const TargetSpec& inTargetSpec,
+						EmitTier inTier)
+	: irModule(inIRModule), targetSpec(inTargetSpec), tier(inTier)
+	{
+	}
+};
+
+static I64 compileShardsThreadEntry(void* stateVoid)
+{
+	ShardedCompileState& state = *(ShardedCompileState*)stateVoid;
+	const Uptr numShards = state.shardObjectFiles.size();
+	while(true)
+	{
+		const Uptr shardIndex = state.nextShardIndex++;
+		if(shardIndex >= numShards) { break; }
+
+		// Each shard is compiled with its own LLVM context and target machine, since they may not
+		// be used by multiple threads at once.
+		std::unique_ptr<llvm::TargetMachine> targetMachine = getTargetMachine(state.targetSpec);
+		state.shardObjectFiles[shardIndex]
+			= emitAndCompileModule(state.irModule,
+								   targetMachine.get(),
+								   state.targetSpec,
+								   state.tier,
+								   &state.shardFunctionDefIndices[shardIndex],
+								   false);
+	}
+	return 0;
+}
+
+bool LLVMJIT::canShardModules(const TargetSpec& targetSpec)
+{
+	// The loader only supports fixing up the Windows SEH tables for a single object file.
+	return llvm::Triple(targetSpec.triple).getOS() != llvm::Triple::Win32;
+}
+
+std::vector<U8> LLVMJIT::compileModule(const IR::Module& irModule,
+									   const TargetSpec& targetSpec,
+									   Uptr numShards,
+									   CompileTier tier)
+{
+	const EmitTier emitTier
+		= tier == CompileTier::baseline ? EmitTier::baseline : EmitTier::optimized;
+
+	std::unique_ptr<llvm::TargetMachine> targetMachine
+		= getAndValidateTargetMachine(irModule.featureSpec, targetSpec);
+
+	// Don't create more shards than there are function definitions.
+	numShards = std::min(numShards, irModule.functions.defs.size());
+	if(!canShardModules(targetSpec)) { numShards = 1; }
+
+	if(numShards <= 1)
+	{
+		return emitAndCompileModule(irModule,
+									targetMachine.get(),
+									targetSpec,
+									emitTier,
+									nullptr,
+									true);
+	}
+
+	Timing::Timer compileTimer;
+
+	// Partition the function definitions into shards of contiguous function definitions with
+	// roughly the same number of bytes of code.
+	Uptr numCodeBytes = 0;
+	for(const FunctionDef& functionDef : irModule.functions.defs)
+	{ numCodeBytes += functionDef.code.size(); }
+
+	ShardedCompileState state(irModule, targetSpec, emitTier);
+	state.shardFunctionDefIndices.resize(1);
+	Uptr numPartitionedCodeBytes = 0;
+	for(Uptr functionDefIndex = 0; functionDefIndex < irModule.functions.defs.size();
+		++functionDefIndex)
+	{
+		const Uptr numPartitionedShards = state.shardFunctionDefIndices.size();
+		if(numPartitionedShards < numShards && state.shardFunctionDefIndices.back().size()
+		   && numPartitionedCodeBytes >= numCodeBytes * numPartitionedShards / numShards)
+		{ state.shardFunctionDefIndices.emplace_back(); }
+		state.shardFunctionDefIndices.back().push_back(functionDefIndex);
+		numPartitionedCodeBytes += irModule.functions.defs[functionDefIndex].code.size();
+	}
+	numShards = state.shardFunctionDefIndices.size();
+	state.shardObjectFiles.resize(numShards);
 
-	// Compile the LLVM IR to object code.
-	return compileLLVMModule(llvmContext, std::move(llvmModule), true, targetMachine.get());
+	// Compile the shards on as many threads as there are hardware threads.
+	const Uptr numThreads = std::min(numShards, Platform::getNumberOfHardwareThreads());
+	std::vector<Platform::Thread*> threads;
+	for(Uptr threadIndex = 0; threadIndex < numThreads; ++threadIndex)
+	{
+		threads.push_back(
+			Platform::createThread(compileThreadNumStackBytes, compileShardsThreadEntry, &state));
+	}
+	for(Platform::Thread* thread : threads) { Platform::joinThread(thread); }
+
+	Timing::logRatePerSecond("Compiled module shards",
+							 compileTimer,
+							 (F64)irModule.functions.defs.size(),
+							 "functions");
+	Log::printf(Log::metrics,
+				"Compiled %" WAVM_PRIuPTR " shards on %" WAVM_PRIuPTR " threads\n",
+				numShards,
+				numThreads);
+
+	return packObjectFiles(state.shardObjectFiles);
+}
+
+std::vector<U8> LLVMJIT::compileModuleShard(const IR::Module& irModule,
+											const TargetSpec& targetSpec,
+											const std::vector<Uptr>& functionDefIndices,
+											CompileTier tier)
+{
+	WAVM_ERROR_UNLESS(canShardModules(targetSpec));
+
+	std::unique_ptr<llvm::TargetMachine> targetMachine
+		= getAndValidateTargetMachine(irModule.featureSpec, targetSpec);
+	return emitAndCompileModule(
+		irModule,
+		targetMachine.get(),
+		targetSpec,
+		tier == CompileTier::baseline ? EmitTier::baseline : EmitTier::optimized,
+		&functionDefIndices,
+		false);
+}
+
+std::vector<U8> LLVMJIT::compileTierUpFunctions(const IR::Module& irModule,
+												const TargetSpec& targetSpec,
+												const std::vector<Uptr>& functionDefIndices)
+{
+	std::unique_ptr<llvm::TargetMachine> targetMachine
+		= getAndValidateTargetMachine(irModule.featureSpec, targetSpec);
+	return emitAndCompileModule(irModule,
+								targetMachine.get(),
+								targetSpec,
+								EmitTier::tierUp,
+								&functionDefIndices,
+								false);
 }
 
 std::string LLVMJIT::emitLLVMIR(const IR::Module& irModule,
@@ -221,10 +438,15 @@ std::string LLVMJIT::emitLLVMIR(const IR::Module& irModule,
 	// Emit LLVM IR for the module.
 	LLVMContext llvmContext;
 	llvm::Module llvmModule("", llvmContext);
-	emitModule(irModule, llvmContext, llvmModule, targetMachine.get());
+	emitModule(irModule,
+			   llvmContext,
+			   llvmModule,
+			   targetMachine.get(),
+			   targetSpec.boundsCheckMemoryAccesses);
 
 	// Optimize the LLVM IR.
-	if(optimize) { optimizeLLVMModule(llvmModule, true); }
+	if(optimize)
+	{ optimizeLLVMModule(llvmModule, targetMachine.get(), targetSpec.optimizationLevel, true); }
 
 	// Print the LLVM IR.
 	return printModule(llvmModule);
@@ -239,77 +461,82 @@ std::string LLVMJIT::disassembleObject(const TargetSpec& targetSpec,
 		= LLVMCreateDisasm(targetSpec.triple.c_str(), nullptr, 0, nullptr, nullptr);
 	WAVM_ERROR_UNLESS(LLVMSetDisasmOptions(disasmRef, LLVMDisassembler_Option_PrintLatency));
 
-	std::unique_ptr<llvm::object::ObjectFile> object
-		= cantFail(llvm::object::ObjectFile::createObjectFile(llvm::MemoryBufferRef(
-			llvm::StringRef((const char*)objectBytes.data(), objectBytes.size()), "memory")));
-
-	// Iterate over the functions in the loaded object.
-	for(std::pair<llvm::object::SymbolRef, U64> symbolSizePair :
-		llvm::object::computeSymbolSizes(*object))
+	// The object code may contain multiple object files if it was compiled in multiple shards.
+	for(llvm::StringRef objectFileBytes :
+		unpackObjectFiles(objectBytes.data(), objectBytes.size()))
 	{
-		llvm::object::SymbolRef symbol = symbolSizePair.first;
-
-		// Only process global symbols, which excludes SEH funclets.
-		if(!(symbol.getFlags() & llvm::object::SymbolRef::SF_Global)) { continue; }
-
-		// Get the type, name, and address of the symbol. Need to be careful not to get the
-		// Expected<T> for each value unless it will be checked for success before continuing.
-		llvm::Expected<llvm::object::SymbolRef::Type> type = symbol.getType();
-		if(!type || *type != llvm::object::SymbolRef::ST_Function) { continue; }
-		llvm::Expected<llvm::StringRef> name = symbol.getName();
-		if(!name) { continue; }
-		llvm::Expected<U64> addressInSection = symbol.getAddress();
-		if(!addressInSection) { continue; }
-
-		// Compute the address the function was loaded at.
-		llvm::StringRef sectionContents((const char*)objectBytes.data(), objectBytes.size());
-		if(llvm::Expected<llvm::object::section_iterator> symbolSection = symbol.getSection())
+		std::unique_ptr<llvm::object::ObjectFile> object
+			= cantFail(llvm::object::ObjectFile::createObjectFile(
+				llvm::MemoryBufferRef(objectFileBytes, "memory")));
+
+		// Iterate over the functions in the loaded object.
+		for(std::pair<llvm::object::SymbolRef, U64> symbolSizePair :
+			llvm::object::computeSymbolSizes(*object))
 		{
+			llvm::object::SymbolRef symbol = symbolSizePair.first;
+
+			// Only process global symbols, which excludes SEH funclets.
+			if(!(symbol.getFlags() & llvm::object::SymbolRef::SF_Global)) { continue; }
+
+			// Get the type, name, and address of the symbol. Need to be careful not to get the
+			// Expected<T> for each value unless it will be checked for success before continuing.
+			llvm::Expected<llvm::object::SymbolRef::Type> type = symbol.getType();
+			if(!type || *type != llvm::object::SymbolRef::ST_Function) { continue; }
+			llvm::Expected<llvm::StringRef> name = symbol.getName();
+			if(!name) { continue; }
+			llvm::Expected<U64> addressInSection = symbol.getAddress();
+			if(!addressInSection) { continue; }
+
+			// Compute the address the function was loaded at.
+			llvm::StringRef sectionContents = objectFileBytes;
+			if(llvm::Expected<llvm::object::section_iterator> symbolSection = symbol.getSection())
+			{
 #if LLVM_VERSION_MAJOR >= 9
-			if(llvm::Expected<llvm::StringRef> maybeSectionContents
-			   = (*symbolSection)->getContents())
-			{ sectionContents = maybeSectionContents.get(); }
+				if(llvm::Expected<llvm::StringRef> maybeSectionContents
+				   = (*symbolSection)->getContents())
+				{ sectionContents = maybeSectionContents.get(); }
 #else
-			(*symbolSection)->getContents(sectionContents);
+				(*symbolSection)->getContents(sectionContents);
 #endif
-		}
+			}
 
-		WAVM_ERROR_UNLESS(addressInSection.get() + symbolSizePair.second >= addressInSection.get()
-						  && addressInSection.get() + symbolSizePair.second
-								 <= sectionContents.size());
+			WAVM_ERROR_UNLESS(
+				addressInSection.get() + symbolSizePair.second >= addressInSection.get()
+				&& addressInSection.get() + symbolSizePair.second <= sectionContents.size());
 
-		result += name.get().str();
-		result += ": # ";
-		result += std::to_string(addressInSection.get());
-		result += '-';
-		result += std::to_string(addressInSection.get() + symbolSizePair.second);
-		result += '\n';
+			result += name.get().str();
+			result += ": # ";
+			result += std::to_string(addressInSection.get());
+			result += '-';
+			result += std::to_string(addressInSection.get() + symbolSizePair.second);
+			result += '\n';
 
-		const U8* nextByte = (const U8*)sectionContents.data() + addressInSection.get();
-		Uptr numBytesRemaining = Uptr(symbolSizePair.second);
-		while(numBytesRemaining)
-		{
-			char instructionBuffer[256];
-			Uptr numInstructionBytes = LLVMDisasmInstruction(disasmRef,
-															 const_cast<U8*>(nextByte),
-															 numBytesRemaining,
-															 reinterpret_cast<Uptr>(nextByte),
-															 instructionBuffer,
-															 sizeof(instructionBuffer));
-			if(numInstructionBytes == 0)
+			const U8* nextByte = (const U8*)sectionContents.data() + addressInSection.get();
+			Uptr numBytesRemaining = Uptr(symbolSizePair.second);
+			while(numBytesRemaining)
 			{
-				numInstructionBytes = 1;
-				result += "\t# skipped ";
-				result += std::to_string(numInstructionBytes);
-				result += " bytes.\n";
-			}
-			WAVM_ASSERT(numInstructionBytes <= numBytesRemaining);
-			numBytesRemaining -= numInstructionBytes;
-			nextByte += numInstructionBytes;
-
-			result += instructionBuffer;
-			result += '\n';
-		};
+				char instructionBuffer[256];
+				Uptr numInstructionBytes = LLVMDisasmInstruction(disasmRef,
+																 const_cast<U8*>(nextByte),
+																 numBytesRemaining,
+																 reinterpret_cast<Uptr>(nextByte),
+																 instructionBuffer,
+																 sizeof(instructionBuffer));
+				if(numInstructionBytes == 0)
+				{
+					numInstructionBytes = 1;
+					result += "\t# skipped ";
+					result += std::to_string(numInstructionBytes);
+					result += " bytes.\n";
+				}
+				WAVM_ASSERT(numInstructionBytes <= numBytesRemaining);
+				numBytesRemaining -= numInstructionBytes;
+				nextByte += numInstructionBytes;
+
+				result += instructionBuffer;
+				result += '\n';
+			};
+		}
 	}
 
 	LLVMDisasmDispose(disasmRef);
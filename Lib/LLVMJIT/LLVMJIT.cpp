@@ -1,4 +1,5 @@
 #include "WAVM/LLVMJIT/LLVMJIT.h"
+#include <string.h>
 #include <utility>
 #include "LLVMJITPrivate.h"
 #include "WAVM/IR/FeatureSpec.h"
@@ -187,8 +188,20 @@ std::unique_ptr<llvm::TargetMachine> LLVMJIT::getTargetMachine(const TargetSpec&
 	}
 #endif
 
+	llvm::CodeGenOpt::Level codeGenOptLevel;
+	switch(targetSpec.optimizationLevel)
+	{
+	case OptimizationLevel::none: codeGenOptLevel = llvm::CodeGenOpt::None; break;
+	case OptimizationLevel::fast: codeGenOptLevel = llvm::CodeGenOpt::Less; break;
+	case OptimizationLevel::standard: codeGenOptLevel = llvm::CodeGenOpt::Default; break;
+	case OptimizationLevel::aggressive: codeGenOptLevel = llvm::CodeGenOpt::Aggressive; break;
+	default: WAVM_UNREACHABLE();
+	};
+
 	return std::unique_ptr<llvm::TargetMachine>(
-		llvm::EngineBuilder().selectTarget(triple, "", targetSpec.cpu, targetAttributes));
+		llvm::EngineBuilder()
+			.setOptLevel(codeGenOptLevel)
+			.selectTarget(triple, "", targetSpec.cpu, targetAttributes));
 }
 
 TargetValidationResult LLVMJIT::validateTargetMachine(
@@ -230,3 +243,79 @@ Version LLVMJIT::getVersion()
 {
 	return Version{LLVM_VERSION_MAJOR, LLVM_VERSION_MINOR, LLVM_VERSION_PATCH, 3};
 }
+
+// Packed object files start with this magic number, followed by a U64 count of object files, and a
+// U64 size for each object file. Each object file follows, aligned to objectFileAlignment bytes.
+static constexpr char packedObjectFilesMagic[8] = {'W', 'A', 'V', 'M', 'O', 'B', 'J', 'S'};
+static constexpr Uptr objectFileAlignment = 16;
+
+static Uptr alignObjectFileOffset(Uptr offset)
+{
+	return (offset + objectFileAlignment - 1) & ~(objectFileAlignment - 1);
+}
+
+std::vector<U8> LLVMJIT::packObjectFiles(const std::vector<std::vector<U8>>& objectFiles)
+{
+	const Uptr numHeaderBytes
+		= sizeof(packedObjectFilesMagic) + sizeof(U64) * (1 + objectFiles.size());
+	Uptr numBytes = alignObjectFileOffset(numHeaderBytes);
+	for(const std::vector<U8>& objectFile : objectFiles)
+	{ numBytes = alignObjectFileOffset(numBytes + objectFile.size()); }
+
+	std::vector<U8> result(numBytes, 0);
+	memcpy(result.data(), packedObjectFilesMagic, sizeof(packedObjectFilesMagic));
+	const U64 numObjectFiles = U64(objectFiles.size());
+	memcpy(result.data() + sizeof(packedObjectFilesMagic), &numObjectFiles, sizeof(U64));
+
+	Uptr offset = alignObjectFileOffset(numHeaderBytes);
+	for(Uptr objectIndex = 0; objectIndex < objectFiles.size(); ++objectIndex)
+	{
+		const std::vector<U8>& objectFile = objectFiles[objectIndex];
+		const U64 numObjectBytes = U64(objectFile.size());
+		memcpy(result.data() + sizeof(packedObjectFilesMagic) + sizeof(U64) * (1 + objectIndex),
+			   &numObjectBytes,
+			   sizeof(U64));
+		memcpy(result.data() + offset, objectFile.data(), objectFile.size());
+		offset = alignObjectFileOffset(offset + objectFile.size());
+	}
+	WAVM_ASSERT(offset == numBytes);
+
+	return result;
+}
+
+std::vector<llvm::StringRef> LLVMJIT::unpackObjectFiles(const U8* objectCode,
+														Uptr numObjectCodeBytes)
+{
+	const char* objectCodeChars = (const char*)objectCode;
+	if(numObjectCodeBytes < sizeof(packedObjectFilesMagic) + sizeof(U64)
+	   || memcmp(objectCodeChars, packedObjectFilesMagic, sizeof(packedObjectFilesMagic)))
+	{ return {llvm::StringRef(objectCodeChars, numObjectCodeBytes)}; }
+
+	U64 numObjectFiles = 0;
+	memcpy(&numObjectFiles, objectCodeChars + sizeof(packedObjectFilesMagic), sizeof(U64));
+	WAVM_ERROR_UNLESS(numObjectFiles
+					  <= (numObjectCodeBytes - sizeof(packedObjectFilesMagic)) / sizeof(U64) - 1);
+
+	std::vector<llvm::StringRef> result;
+	Uptr offset = alignObjectFileOffset(sizeof(packedObjectFilesMagic)
+										+ sizeof(U64) * (1 + Uptr(numObjectFiles)));
+	for(Uptr objectIndex = 0; objectIndex < Uptr(numObjectFiles); ++objectIndex)
+	{
+		U64 numObjectBytes = 0;
+		memcpy(&numObjectBytes,
+			   objectCodeChars + sizeof(packedObjectFilesMagic) + sizeof(U64) * (1 + objectIndex),
+			   sizeof(U64));
+		WAVM_ERROR_UNLESS(offset <= numObjectCodeBytes
+						  && numObjectBytes <= U64(numObjectCodeBytes - offset));
+
+		result.push_back(llvm::StringRef(objectCodeChars + offset, Uptr(numObjectBytes)));
+		offset = alignObjectFileOffset(offset + Uptr(numObjectBytes));
+	}
+
+	return result;
+}
+
+Uptr LLVMJIT::getNumObjectFiles(const std::vector<U8>& objectCode)
+{
+	return unpackObjectFiles(objectCode.data(), objectCode.size()).size();
+}
@@ -362,11 +362,35 @@ namespace WAVM { namespace LLVMJIT {
 #endif
 	}
 
-	// Emits LLVM IR for a module.
+	// The kinds of code that emitModule can emit for a module's function definitions.
+	enum class EmitTier
+	{
+		// Code that calls other function definitions directly.
+		optimized,
+
+		// Code that counts its calls, and forwards them to optimized code once it is loaded.
+		baseline,
+
+		// Optimized code that replaces the baseline code for some of a module's function
+		// definitions. The emitted functions call each other directly, but reference the other
+		// function definitions through their baseline code.
+		tierUp,
+	};
+
+	// Emits LLVM IR for a module. If functionDefIndices is non-null, only the function definitions
+	// with the given indices are emitted; the others are declared, so they may be defined by the
+	// LLVM IR emitted for another shard of the module.
 	void emitModule(const IR::Module& irModule,
 					LLVMContext& llvmContext,
 					llvm::Module& outLLVMModule,
-					llvm::TargetMachine* targetMachine);
+					llvm::TargetMachine* targetMachine,
+					bool boundsCheckMemoryAccesses,
+					EmitTier tier = EmitTier::optimized,
+					const std::vector<Uptr>* functionDefIndices = nullptr);
+
+	// Unpacks the object files packed by packObjectFiles. Unpacking object code that isn't packed
+	// returns it as a single object file.
+	std::vector<llvm::StringRef> unpackObjectFiles(const U8* objectCode, Uptr numObjectCodeBytes);
 
 	// Used to override LLVM's default behavior of looking up unresolved symbols in DLL exports.
 	llvm::JITEvaluatedSymbol resolveJITImport(llvm::StringRef name);
@@ -380,18 +404,26 @@ namespace WAVM { namespace LLVMJIT {
 		HashMap<std::string, Runtime::Function*> nameToFunctionMap;
 		std::map<Uptr, Runtime::Function*> addressToFunctionMap;
 		std::string debugName;
+		const DebugInfoPolicy debugInfoPolicy;
 
 #if LAZY_PARSE_DWARF_LINE_INFO
+		// A DWARF context for each of the module's object files, keyed by the end address of the
+		// image the object file was loaded into. The contexts are created by the first call to
+		// decodeOffsetToOpIndexMap for a function in the image.
 		Platform::Mutex dwarfContextMutex;
-		std::unique_ptr<llvm::DWARFContext> dwarfContext;
+		std::map<Uptr, std::unique_ptr<llvm::DWARFContext>> imageEndToDWARFContextMap;
 #endif
 
-		Module(const std::vector<U8>& inObjectBytes,
+		Module(const U8* objectBytes,
+			   Uptr numObjectBytes,
 			   const HashMap<std::string, Uptr>& importedSymbolMap,
 			   bool shouldLogMetrics,
 			   std::string&& inDebugName);
 		~Module();
 
+		// Decodes the line table of one of the module's functions, if it hasn't been decoded yet.
+		void decodeOffsetToOpIndexMap(Runtime::FunctionMutableData* functionMutableData);
+
 	private:
 		ModuleMemoryManager* memoryManager;
 
@@ -403,7 +435,7 @@ namespace WAVM { namespace LLVMJIT {
 		// their pointers as keys for deregistration.
 #if LLVM_VERSION_MAJOR < 8
 		std::vector<U8> objectBytes;
-		std::unique_ptr<llvm::object::ObjectFile> object;
+		std::vector<std::unique_ptr<llvm::object::ObjectFile>> objects;
 #endif
 	};
 
@@ -415,7 +447,9 @@ namespace WAVM { namespace LLVMJIT {
 	extern std::vector<U8> compileLLVMModule(LLVMContext& llvmContext,
 											 llvm::Module&& llvmModule,
 											 bool shouldLogMetrics,
-											 llvm::TargetMachine* targetMachine);
+											 llvm::TargetMachine* targetMachine,
+											 OptimizationLevel optimizationLevel
+											 = OptimizationLevel::standard);
 
 	extern void processSEHTables(U8* imageBase,
 								 const llvm::LoadedObjectInfo& loadedObject,
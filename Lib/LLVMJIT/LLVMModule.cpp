@@ -1,6 +1,8 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
@@ -87,63 +89,103 @@ struct LLVMJIT::GlobalModuleState
 static llvm::JITEventListener* perfRegistrationListener = nullptr;
 #endif
 
+static std::atomic<DebugInfoPolicy> currentDebugInfoPolicy{DebugInfoPolicy::lazy};
+
+void LLVMJIT::setDebugInfoPolicy(DebugInfoPolicy policy)
+{
+	currentDebugInfoPolicy.store(policy, std::memory_order_relaxed);
+}
+
+DebugInfoPolicy LLVMJIT::getDebugInfoPolicy()
+{
+	return currentDebugInfoPolicy.load(std::memory_order_relaxed);
+}
+
+// Appends the entries of a DWARF line table for a function's code to the function's
+// offsetToOpIndexMap. The line table is sorted by address, so the map stays sorted by offset.
+static void appendLineTable(Runtime::FunctionMutableData* functionMutableData,
+							const llvm::DILineInfoTable& lineInfoTable,
+							Uptr codeAddress)
+{
+	functionMutableData->offsetToOpIndexMap.reserve(lineInfoTable.size());
+	for(auto lineInfo : lineInfoTable)
+	{
+		WAVM_ASSERT(lineInfo.first >= codeAddress);
+		functionMutableData->offsetToOpIndexMap.push_back(
+			{U32(lineInfo.first - codeAddress), U32(lineInfo.second.Line)});
+	}
+}
+
 // A map from address to loaded JIT symbols.
 static Platform::Mutex addressToModuleMapMutex;
 static std::map<Uptr, LLVMJIT::Module*> addressToModuleMap;
 
-// Allocates memory for the LLVM object loader.
+// Allocates memory for the LLVM object loader. Each object file loaded by the loader is allocated
+// a separate image that contains all of its sections.
 struct LLVMJIT::ModuleMemoryManager : llvm::RTDyldMemoryManager
 {
-	ModuleMemoryManager()
-	: imageBaseAddress(nullptr)
-	, isFinalized(false)
-	, codeSection({nullptr, 0, 0})
-	, readOnlySection({nullptr, 0, 0})
-	, readWriteSection({nullptr, 0, 0})
-	, hasRegisteredEHFrames(false)
+	struct Section
 	{
-	}
+		U8* baseAddress;
+		Uptr numPages;
+		Uptr numCommittedBytes;
+	};
+
+	struct Image
+	{
+		U8* baseAddress = nullptr;
+		Uptr numPages = 0;
+
+		Section codeSection{nullptr, 0, 0};
+		Section readOnlySection{nullptr, 0, 0};
+		Section readWriteSection{nullptr, 0, 0};
+
+		llvm::StringMap<std::unique_ptr<llvm::MemoryBuffer>> sectionNameToContentsMap;
+	};
+
+	ModuleMemoryManager() : isFinalized(false) {}
 	virtual ~ModuleMemoryManager() override
 	{
 		// Deregister the exception handling frame info.
 		deregisterEHFrames();
 
-		if(!KEEP_UNLOADED_MODULE_ADDRESSES_RESERVED)
-		{ Platform::freeVirtualPages(imageBaseAddress, numAllocatedImagePages); }
-		else
+		for(const std::unique_ptr<Image>& image : images)
 		{
-			// Decommit the image pages, but leave them reserved to catch any references to them
-			// that might erroneously remain.
-			Platform::decommitVirtualPages(imageBaseAddress, numAllocatedImagePages);
+			if(!image->numPages) { continue; }
+
+			if(!KEEP_UNLOADED_MODULE_ADDRESSES_RESERVED)
+			{ Platform::freeVirtualPages(image->baseAddress, image->numPages); }
+			else
+			{
+				// Decommit the image pages, but leave them reserved to catch any references to them
+				// that might erroneously remain.
+				Platform::decommitVirtualPages(image->baseAddress, image->numPages);
+			}
+			Platform::deregisterVirtualAllocation(image->numPages
+												  << Platform::getBytesPerPageLog2());
 		}
-		Platform::deregisterVirtualAllocation(numAllocatedImagePages
-											  << Platform::getBytesPerPageLog2());
 	}
 
 	void registerEHFrames(U8* addr, U64 loadAddr, uintptr_t numBytes) override
 	{
 		if(!USE_WINDOWS_SEH)
 		{
-			Platform::registerEHFrames(imageBaseAddress, addr, numBytes);
-			hasRegisteredEHFrames = true;
-			ehFramesAddr = addr;
-			ehFramesNumBytes = numBytes;
+			WAVM_ASSERT(images.size());
+			Platform::registerEHFrames(images.back()->baseAddress, addr, numBytes);
+			registeredEHFrames.push_back({images.back()->baseAddress, addr, Uptr(numBytes)});
 		}
 	}
 	void registerFixedSEHFrames(U8* addr, Uptr numBytes)
 	{
-		Platform::registerEHFrames(imageBaseAddress, addr, numBytes);
-		hasRegisteredEHFrames = true;
-		ehFramesAddr = addr;
-		ehFramesNumBytes = numBytes;
+		WAVM_ASSERT(images.size());
+		Platform::registerEHFrames(images.back()->baseAddress, addr, numBytes);
+		registeredEHFrames.push_back({images.back()->baseAddress, addr, numBytes});
 	}
 	void deregisterEHFrames() override
 	{
-		if(hasRegisteredEHFrames)
-		{
-			hasRegisteredEHFrames = false;
-			Platform::deregisterEHFrames(imageBaseAddress, ehFramesAddr, ehFramesNumBytes);
-		}
+		for(const RegisteredEHFrames& ehFrames : registeredEHFrames)
+		{ Platform::deregisterEHFrames(ehFrames.imageBase, ehFrames.addr, ehFrames.numBytes); }
+		registeredEHFrames.clear();
 	}
 
 	virtual bool needsToReserveAllocationSpace() override { return true; }
@@ -154,35 +196,42 @@ struct LLVMJIT::ModuleMemoryManager : llvm::RTDyldMemoryManager
 										uintptr_t numReadWriteBytes,
 										U32 readWriteAlignment) override
 	{
+		WAVM_ASSERT(!isFinalized);
+
 		if(USE_WINDOWS_SEH)
 		{
 			// Pad the code section to allow for the SEH trampoline.
 			numCodeBytes += 32;
 		}
 
+		// The loader calls reserveAllocationSpace before allocating the sections of each object, so
+		// start a new image for the object.
+		images.emplace_back(new Image);
+		Image& image = *images.back();
+
 		// Calculate the number of pages to be used by each section.
-		codeSection.numPages = shrAndRoundUp(numCodeBytes, Platform::getBytesPerPageLog2());
-		readOnlySection.numPages = shrAndRoundUp(numReadOnlyBytes, Platform::getBytesPerPageLog2());
-		readWriteSection.numPages
+		image.codeSection.numPages = shrAndRoundUp(numCodeBytes, Platform::getBytesPerPageLog2());
+		image.readOnlySection.numPages
+			= shrAndRoundUp(numReadOnlyBytes, Platform::getBytesPerPageLog2());
+		image.readWriteSection.numPages
 			= shrAndRoundUp(numReadWriteBytes, Platform::getBytesPerPageLog2());
-		numAllocatedImagePages
-			= codeSection.numPages + readOnlySection.numPages + readWriteSection.numPages;
-		if(numAllocatedImagePages)
+		image.numPages = image.codeSection.numPages + image.readOnlySection.numPages
+						 + image.readWriteSection.numPages;
+		if(image.numPages)
 		{
 			// Reserve enough contiguous pages for all sections.
-			imageBaseAddress = Platform::allocateVirtualPages(numAllocatedImagePages);
-			if(!imageBaseAddress
-			   || !Platform::commitVirtualPages(imageBaseAddress, numAllocatedImagePages))
+			image.baseAddress = Platform::allocateVirtualPages(image.numPages);
+			if(!image.baseAddress
+			   || !Platform::commitVirtualPages(image.baseAddress, image.numPages))
 			{ Errors::fatal("memory allocation for JIT code failed"); }
-			Platform::registerVirtualAllocation(numAllocatedImagePages
-												<< Platform::getBytesPerPageLog2());
-			codeSection.baseAddress = imageBaseAddress;
-			readOnlySection.baseAddress
-				= codeSection.baseAddress
-				  + (codeSection.numPages << Platform::getBytesPerPageLog2());
-			readWriteSection.baseAddress
-				= readOnlySection.baseAddress
-				  + (readOnlySection.numPages << Platform::getBytesPerPageLog2());
+			Platform::registerVirtualAllocation(image.numPages << Platform::getBytesPerPageLog2());
+			image.codeSection.baseAddress = image.baseAddress;
+			image.readOnlySection.baseAddress
+				= image.codeSection.baseAddress
+				  + (image.codeSection.numPages << Platform::getBytesPerPageLog2());
+			image.readWriteSection.baseAddress
+				= image.readOnlySection.baseAddress
+				  + (image.readOnlySection.numPages << Platform::getBytesPerPageLog2());
 		}
 	}
 	virtual U8* allocateCodeSection(uintptr_t numBytes,
@@ -190,7 +239,8 @@ struct LLVMJIT::ModuleMemoryManager : llvm::RTDyldMemoryManager
 									U32 sectionID,
 									llvm::StringRef sectionName) override
 	{
-		return allocateBytes(sectionName, (Uptr)numBytes, alignment, codeSection);
+		WAVM_ASSERT(images.size());
+		return allocateBytes(sectionName, (Uptr)numBytes, alignment, images.back()->codeSection);
 	}
 	virtual U8* allocateDataSection(uintptr_t numBytes,
 									U32 alignment,
@@ -198,10 +248,12 @@ struct LLVMJIT::ModuleMemoryManager : llvm::RTDyldMemoryManager
 									llvm::StringRef sectionName,
 									bool isReadOnly) override
 	{
+		WAVM_ASSERT(images.size());
 		return allocateBytes(sectionName,
 							 (Uptr)numBytes,
 							 alignment,
-							 isReadOnly ? readOnlySection : readWriteSection);
+							 isReadOnly ? images.back()->readOnlySection
+										: images.back()->readWriteSection);
 	}
 	virtual bool finalizeMemory(std::string* ErrMsg = nullptr) override
 	{
@@ -214,23 +266,29 @@ struct LLVMJIT::ModuleMemoryManager : llvm::RTDyldMemoryManager
 	{
 		WAVM_ASSERT(!isFinalized);
 		isFinalized = true;
-		if(codeSection.numPages)
-		{
-			WAVM_ERROR_UNLESS(Platform::setVirtualPageAccess(codeSection.baseAddress,
-															 codeSection.numPages,
-															 Platform::MemoryAccess::readExecute));
-		}
-		if(readOnlySection.numPages)
-		{
-			WAVM_ERROR_UNLESS(Platform::setVirtualPageAccess(readOnlySection.baseAddress,
-															 readOnlySection.numPages,
-															 Platform::MemoryAccess::readOnly));
-		}
-		if(readWriteSection.numPages)
+		for(const std::unique_ptr<Image>& image : images)
 		{
-			WAVM_ERROR_UNLESS(Platform::setVirtualPageAccess(readWriteSection.baseAddress,
-															 readWriteSection.numPages,
-															 Platform::MemoryAccess::readWrite));
+			if(image->codeSection.numPages)
+			{
+				WAVM_ERROR_UNLESS(
+					Platform::setVirtualPageAccess(image->codeSection.baseAddress,
+												   image->codeSection.numPages,
+												   Platform::MemoryAccess::readExecute));
+			}
+			if(image->readOnlySection.numPages)
+			{
+				WAVM_ERROR_UNLESS(
+					Platform::setVirtualPageAccess(image->readOnlySection.baseAddress,
+												   image->readOnlySection.numPages,
+												   Platform::MemoryAccess::readOnly));
+			}
+			if(image->readWriteSection.numPages)
+			{
+				WAVM_ERROR_UNLESS(
+					Platform::setVirtualPageAccess(image->readWriteSection.baseAddress,
+												   image->readWriteSection.numPages,
+												   Platform::MemoryAccess::readWrite));
+			}
 		}
 
 		// Invalidate the instruction cache.
@@ -238,47 +296,50 @@ struct LLVMJIT::ModuleMemoryManager : llvm::RTDyldMemoryManager
 	}
 	virtual void invalidateInstructionCache()
 	{
-		// Invalidate the instruction cache for the whole image.
-		llvm::sys::Memory::InvalidateInstructionCache(
-			imageBaseAddress, numAllocatedImagePages << Platform::getBytesPerPageLog2());
+		// Invalidate the instruction cache for the whole of each image.
+		for(const std::unique_ptr<Image>& image : images)
+		{
+			llvm::sys::Memory::InvalidateInstructionCache(
+				image->baseAddress, image->numPages << Platform::getBytesPerPageLog2());
+		}
 	}
 
-	U8* getImageBaseAddress() const { return imageBaseAddress; }
-	Uptr getNumImageBytes() const
+	const std::vector<std::unique_ptr<Image>>& getImages() const { return images; }
+
+	Uptr getNumCodeBytes() const
 	{
-		return numAllocatedImagePages << Platform::getBytesPerPageLog2();
+		Uptr numBytes = 0;
+		for(const std::unique_ptr<Image>& image : images)
+		{ numBytes += image->codeSection.numCommittedBytes; }
+		return numBytes;
 	}
-
-	Uptr getNumCodeBytes() const { return codeSection.numCommittedBytes; }
-	Uptr getNumReadOnlyBytes() const { return readOnlySection.numCommittedBytes; }
-	Uptr getNumReadWriteBytes() const { return readWriteSection.numCommittedBytes; }
-
-	const llvm::StringMap<std::unique_ptr<llvm::MemoryBuffer>>& getSectionNameToContentsMap() const
+	Uptr getNumReadOnlyBytes() const
 	{
-		return sectionNameToContentsMap;
+		Uptr numBytes = 0;
+		for(const std::unique_ptr<Image>& image : images)
+		{ numBytes += image->readOnlySection.numCommittedBytes; }
+		return numBytes;
+	}
+	Uptr getNumReadWriteBytes() const
+	{
+		Uptr numBytes = 0;
+		for(const std::unique_ptr<Image>& image : images)
+		{ numBytes += image->readWriteSection.numCommittedBytes; }
+		return numBytes;
 	}
 
 private:
-	struct Section
+	struct RegisteredEHFrames
 	{
-		U8* baseAddress;
-		Uptr numPages;
-		Uptr numCommittedBytes;
+		const U8* imageBase;
+		const U8* addr;
+		Uptr numBytes;
 	};
 
-	U8* imageBaseAddress;
-	Uptr numAllocatedImagePages;
+	std::vector<std::unique_ptr<Image>> images;
 	bool isFinalized;
 
-	Section codeSection;
-	Section readOnlySection;
-	Section readWriteSection;
-
-	bool hasRegisteredEHFrames;
-	const U8* ehFramesAddr;
-	Uptr ehFramesNumBytes;
-
-	llvm::StringMap<std::unique_ptr<llvm::MemoryBuffer>> sectionNameToContentsMap;
+	std::vector<RegisteredEHFrames> registeredEHFrames;
 
 	U8* allocateBytes(llvm::StringRef sectionName, Uptr numBytes, Uptr alignment, Section& section)
 	{
@@ -307,7 +368,7 @@ private:
 		}
 
 		// Record the address the section was allocated at.
-		sectionNameToContentsMap.insert(std::make_pair(
+		images.back()->sectionNameToContentsMap.insert(std::make_pair(
 			sectionName,
 			llvm::MemoryBuffer::getMemBuffer(
 				llvm::StringRef((const char*)allocationBaseAddress, numBytes), "", false)));
@@ -328,25 +389,41 @@ private:
 	void operator=(const ModuleMemoryManager&) = delete;
 };
 
-Module::Module(const std::vector<U8>& objectBytes,
+#if LLVM_VERSION_MAJOR >= 8
+// Returns the key that identifies an object loaded into an image to the JIT event listeners.
+static llvm::JITEventListener::ObjectKey getObjectKey(const ModuleMemoryManager::Image& image)
+{
+	return reinterpret_cast<Uptr>(&image);
+}
+#endif
+
+Module::Module(const U8* objectBytes,
+			   Uptr numObjectBytes,
 			   const HashMap<std::string, Uptr>& importedSymbolMap,
 			   bool shouldLogMetrics,
 			   std::string&& inDebugName)
 : debugName(std::move(inDebugName))
+, debugInfoPolicy(getDebugInfoPolicy())
 , memoryManager(new ModuleMemoryManager())
 , globalModuleState(GlobalModuleState::get())
 #if LLVM_VERSION_MAJOR < 8
-, objectBytes(objectBytes)
+, objectBytes(objectBytes, objectBytes + numObjectBytes)
 #endif
 {
 	Timing::Timer loadObjectTimer;
 
+	// The object code may contain multiple object files if it was compiled in multiple shards.
 #if LLVM_VERSION_MAJOR >= 8
-	std::unique_ptr<llvm::object::ObjectFile> object;
+	std::vector<std::unique_ptr<llvm::object::ObjectFile>> objects;
 #endif
+	for(llvm::StringRef objectFileBytes : unpackObjectFiles(objectBytes, numObjectBytes))
+	{
+		objects.push_back(cantFail(llvm::object::ObjectFile::createObjectFile(
+			llvm::MemoryBufferRef(objectFileBytes, "memory"))));
+	}
 
-	object = cantFail(llvm::object::ObjectFile::createObjectFile(llvm::MemoryBufferRef(
-		llvm::StringRef((const char*)objectBytes.data(), objectBytes.size()), "memory")));
+	// The Windows SEH tables are fixed up for a single object file below.
+	WAVM_ERROR_UNLESS(!USE_WINDOWS_SEH || objects.size() == 1);
 
 	// Create the LLVM object loader.
 	struct SymbolResolver : llvm::JITSymbolResolver
@@ -411,10 +488,11 @@ Module::Module(const std::vector<U8>& objectBytes,
 	};
 	SymbolResolver symbolResolver(importedSymbolMap);
 	llvm::RuntimeDyld loader(*memoryManager, symbolResolver);
-	// Process all sections on non-Windows platforms. On Windows, this triggers errors due to
-	// unimplemented relocation types in the debug sections.
+	// Process all sections on non-Windows platforms, so the debug sections are loaded for the
+	// DWARF context. On Windows, this triggers errors due to unimplemented relocation types in the
+	// debug sections. If there won't be any debug info, don't load the debug sections at all.
 #if !defined(_WIN32) || LAZY_PARSE_DWARF_LINE_INFO
-	loader.setProcessAllSections(true);
+	loader.setProcessAllSections(debugInfoPolicy != DebugInfoPolicy::off);
 #endif
 
 	// The LLVM dynamic loader doesn't correctly apply the IMAGE_REL_AMD64_ADDR32NB relocations in
@@ -429,7 +507,7 @@ Module::Module(const std::vector<U8>& objectBytes,
 	U8* xdataCopy = nullptr;
 	if(USE_WINDOWS_SEH)
 	{
-		for(auto section : object->sections())
+		for(auto section : objects[0]->sections())
 		{
 #if LLVM_VERSION_MAJOR >= 10
 			llvm::Expected<llvm::StringRef> sectionNameOrError = section.getName();
@@ -471,8 +549,11 @@ Module::Module(const std::vector<U8>& objectBytes,
 		}
 	}
 
-	// Use the LLVM object loader to load the object.
-	std::unique_ptr<llvm::RuntimeDyld::LoadedObjectInfo> loadedObject = loader.loadObject(*object);
+	// Use the LLVM object loader to load the objects. The objects' references to each other's
+	// symbols are resolved when the loader is finalized after loading all of them.
+	std::vector<std::unique_ptr<llvm::RuntimeDyld::LoadedObjectInfo>> loadedObjects;
+	for(const std::unique_ptr<llvm::object::ObjectFile>& object : objects)
+	{ loadedObjects.push_back(loader.loadObject(*object)); }
 	loader.finalizeWithMemoryManagerLocking();
 	if(loader.hasError())
 	{ Errors::fatalf("RuntimeDyld failed: %s", loader.getErrorString().data()); }
@@ -492,8 +573,8 @@ Module::Module(const std::vector<U8>& objectBytes,
 		memset(trampolineBytes + 2, 0, 4);
 		memcpy(trampolineBytes + 6, &sehHandlerAddress, sizeof(U64));
 
-		processSEHTables(memoryManager->getImageBaseAddress(),
-						 *loadedObject,
+		processSEHTables(memoryManager->getImages()[0]->baseAddress,
+						 *loadedObjects[0],
 						 pdataSection,
 						 pdataCopy,
 						 pdataNumBytes,
@@ -502,7 +583,7 @@ Module::Module(const std::vector<U8>& objectBytes,
 						 reinterpret_cast<Uptr>(trampolineBytes));
 
 		memoryManager->registerFixedSEHFrames(
-			reinterpret_cast<U8*>(Uptr(loadedObject->getSectionLoadAddress(pdataSection))),
+			reinterpret_cast<U8*>(Uptr(loadedObjects[0]->getSectionLoadAddress(pdataSection))),
 			pdataNumBytes);
 	}
 
@@ -522,104 +603,152 @@ Module::Module(const std::vector<U8>& objectBytes,
 	// final non-writable memory permissions.
 	memoryManager->reallyFinalizeMemory();
 
-	// Notify GDB of the new object.
+	const std::vector<std::unique_ptr<ModuleMemoryManager::Image>>& images
+		= memoryManager->getImages();
+	WAVM_ASSERT(images.size() == objects.size());
+
+	// Notify GDB of the new objects. This takes a global lock and copies the objects, so it is only
+	// done if debug info is decoded eagerly.
+	if(debugInfoPolicy == DebugInfoPolicy::eager)
 	{
 		Platform::Mutex::Lock lock(globalModuleState->gdbRegistrationListenerMutex);
+		for(Uptr objectIndex = 0; objectIndex < objects.size(); ++objectIndex)
+		{
 #if LLVM_VERSION_MAJOR >= 8
-		globalModuleState->gdbRegistrationListener->notifyObjectLoaded(
-			reinterpret_cast<Uptr>(this), *object, *loadedObject);
+			globalModuleState->gdbRegistrationListener->notifyObjectLoaded(
+				getObjectKey(*images[objectIndex]),
+				*objects[objectIndex],
+				*loadedObjects[objectIndex]);
 #else
-		globalModuleState->gdbRegistrationListener->NotifyObjectEmitted(*object, *loadedObject);
+			globalModuleState->gdbRegistrationListener->NotifyObjectEmitted(
+				*objects[objectIndex], *loadedObjects[objectIndex]);
 #endif
 
 #ifdef WAVM_PERF_EVENTS
-        if(!perfRegistrationListener) {
-            perfRegistrationListener = llvm::JITEventListener::createPerfJITEventListener();
-        }
+            if(!perfRegistrationListener) {
+                perfRegistrationListener = llvm::JITEventListener::createPerfJITEventListener();
+            }
 
-        perfRegistrationListener->notifyObjectLoaded(reinterpret_cast<Uptr>(this), *object, *loadedObject);
+            perfRegistrationListener->notifyObjectLoaded(getObjectKey(*images[objectIndex]),
+                                                         *objects[objectIndex],
+                                                         *loadedObjects[objectIndex]);
 #endif
+		}
 	}
 
-	// Create a DWARF context to interpret the debug information in this compilation unit.
+	for(Uptr objectIndex = 0; objectIndex < objects.size(); ++objectIndex)
+	{
+		const llvm::object::ObjectFile& object = *objects[objectIndex];
+		const llvm::RuntimeDyld::LoadedObjectInfo& loadedObject = *loadedObjects[objectIndex];
+
+		// If the line tables are decoded eagerly, create a DWARF context to interpret the debug
+		// information in this compilation unit. Otherwise, reserve an entry for the DWARF context
+		// that decodeOffsetToOpIndexMap creates on demand.
+		std::unique_ptr<llvm::DWARFContext> dwarfContext;
 #if LAZY_PARSE_DWARF_LINE_INFO
-	Platform::Mutex::Lock dwarfContextLock(dwarfContextMutex);
-	dwarfContext
-		= llvm::DWARFContext::create(memoryManager->getSectionNameToContentsMap(), sizeof(Uptr));
+		if(debugInfoPolicy == DebugInfoPolicy::eager)
+		{
+			dwarfContext = llvm::DWARFContext::create(
+				images[objectIndex]->sectionNameToContentsMap, sizeof(Uptr));
+		}
+		else if(debugInfoPolicy == DebugInfoPolicy::lazy && images[objectIndex]->numPages)
+		{
+			Platform::Mutex::Lock dwarfContextLock(dwarfContextMutex);
+			imageEndToDWARFContextMap.emplace(
+				reinterpret_cast<Uptr>(images[objectIndex]->baseAddress)
+					+ (images[objectIndex]->numPages << Platform::getBytesPerPageLog2()),
+				nullptr);
+		}
 #else
-	auto dwarfContext = llvm::DWARFContext::create(*object, &*loadedObject);
+		// Without lazy DWARF parsing, the line tables must be decoded while the object is still
+		// available, so the lazy policy decodes them eagerly.
+		if(debugInfoPolicy != DebugInfoPolicy::off)
+		{ dwarfContext = llvm::DWARFContext::create(object, &loadedObject); }
 #endif
 
-	// Iterate over the functions in the loaded object.
-	for(std::pair<llvm::object::SymbolRef, U64> symbolSizePair :
-		llvm::object::computeSymbolSizes(*object))
-	{
-		llvm::object::SymbolRef symbol = symbolSizePair.first;
-
-		// Only process global symbols, which excludes SEH funclets.
-		if(!(symbol.getFlags() & llvm::object::SymbolRef::SF_Global)) { continue; }
-
-		// Get the type, name, and address of the symbol. Need to be careful not to get the
-		// Expected<T> for each value unless it will be checked for success before continuing.
-		llvm::Expected<llvm::object::SymbolRef::Type> type = symbol.getType();
-		if(!type || *type != llvm::object::SymbolRef::ST_Function) { continue; }
-		llvm::Expected<llvm::StringRef> name = symbol.getName();
-		if(!name) { continue; }
-		llvm::Expected<U64> address = symbol.getAddress();
-		if(!address) { continue; }
-
-		// Compute the address the function was loaded at.
-		WAVM_ASSERT(*address <= UINTPTR_MAX);
-		Uptr loadedAddress = Uptr(*address);
-		if(llvm::Expected<llvm::object::section_iterator> symbolSection = symbol.getSection())
-		{ loadedAddress += (Uptr)loadedObject->getSectionLoadAddress(*symbolSection.get()); }
-
-		std::map<U32, U32> offsetToOpIndexMap;
-#if !LAZY_PARSE_DWARF_LINE_INFO
-		// Get the DWARF line info for this symbol, which maps machine code addresses to
-		// WebAssembly op indices.
-#if LLVM_VERSION_MAJOR >= 9
-		llvm::Expected<llvm::object::section_iterator> section = symbol.getSection();
-		if(!section) { continue; }
-		llvm::DILineInfoTable lineInfoTable = dwarfContext->getLineInfoForAddressRange(
-			llvm::object::SectionedAddress{loadedAddress, section.get()->getIndex()},
-			symbolSizePair.second);
+		// Iterate over the functions in the loaded object.
+		for(std::pair<llvm::object::SymbolRef, U64> symbolSizePair :
+			llvm::object::computeSymbolSizes(object))
+		{
+			llvm::object::SymbolRef symbol = symbolSizePair.first;
+
+			// Only process global symbols, which excludes SEH funclets.
+			if(!(symbol.getFlags() & llvm::object::SymbolRef::SF_Global)) { continue; }
+
+			// Get the type, name, and address of the symbol. Need to be careful not to get the
+			// Expected<T> for each value unless it will be checked for success before continuing.
+			llvm::Expected<llvm::object::SymbolRef::Type> type = symbol.getType();
+			if(!type || *type != llvm::object::SymbolRef::ST_Function) { continue; }
+			llvm::Expected<llvm::StringRef> name = symbol.getName();
+			if(!name) { continue; }
+			llvm::Expected<U64> address = symbol.getAddress();
+			if(!address) { continue; }
+
+			// Compute the address the function was loaded at.
+			WAVM_ASSERT(*address <= UINTPTR_MAX);
+			Uptr loadedAddress = Uptr(*address);
+			if(llvm::Expected<llvm::object::section_iterator> symbolSection = symbol.getSection())
+			{ loadedAddress += (Uptr)loadedObject.getSectionLoadAddress(*symbolSection.get()); }
+
+			// Add the function to the module's name and address to function maps.
+			WAVM_ASSERT(symbolSizePair.second <= UINTPTR_MAX);
+			Runtime::Function* function
+				= (Runtime::Function*)(loadedAddress - offsetof(Runtime::Function, code));
+			nameToFunctionMap.addOrFail(*name, function);
+			addressToFunctionMap.emplace(Uptr(loadedAddress + symbolSizePair.second), function);
+
+			// Initialize the function mutable data.
+			WAVM_ASSERT(function->mutableData);
+			function->mutableData->jitModule = this;
+			function->mutableData->function = function;
+			function->mutableData->numCodeBytes = Uptr(symbolSizePair.second);
+
+			if(dwarfContext)
+			{
+				// Get the DWARF line info for this symbol, which maps machine code addresses to
+				// WebAssembly op indices.
+#if LAZY_PARSE_DWARF_LINE_INFO
+				appendLineTable(function->mutableData,
+								dwarfContext->getLineInfoForAddressRange(
+									llvm::object::SectionedAddress{
+										loadedAddress, llvm::object::SectionedAddress::UndefSection},
+									symbolSizePair.second),
+								loadedAddress);
 #else
-		llvm::DILineInfoTable lineInfoTable
-			= dwarfContext->getLineInfoForAddressRange(loadedAddress, symbolSizePair.second);
-#endif
-		for(auto lineInfo : lineInfoTable)
-		{ offsetToOpIndexMap.emplace(U32(lineInfo.first - loadedAddress), lineInfo.second.Line); }
+				appendLineTable(
+					function->mutableData,
+					dwarfContext->getLineInfoForAddressRange(loadedAddress, symbolSizePair.second),
+					loadedAddress);
 #endif
+			}
 
-		// Add the function to the module's name and address to function maps.
-		WAVM_ASSERT(symbolSizePair.second <= UINTPTR_MAX);
-		Runtime::Function* function
-			= (Runtime::Function*)(loadedAddress - offsetof(Runtime::Function, code));
-		nameToFunctionMap.addOrFail(*name, function);
-		addressToFunctionMap.emplace(Uptr(loadedAddress + symbolSizePair.second), function);
-
-		// Initialize the function mutable data.
-		WAVM_ASSERT(function->mutableData);
-		function->mutableData->jitModule = this;
-		function->mutableData->function = function;
-		function->mutableData->numCodeBytes = Uptr(symbolSizePair.second);
-		function->mutableData->offsetToOpIndexMap = std::move(offsetToOpIndexMap);
+			// Unless the line table will be decoded on demand, it is complete.
+			if(dwarfContext || debugInfoPolicy == DebugInfoPolicy::off)
+			{
+				function->mutableData->isOffsetToOpIndexMapDecoded.store(
+					true, std::memory_order_release);
+			}
+		}
 	}
 
-	const Uptr moduleEndAddress = reinterpret_cast<Uptr>(memoryManager->getImageBaseAddress()
-														 + memoryManager->getNumImageBytes());
+	// Add each of the module's images to the global address to module map.
 	{
 		Platform::RWMutex::ExclusiveLock addressToModuleMapLock(
 			globalModuleState->addressToModuleMapMutex);
-		globalModuleState->addressToModuleMap.emplace(moduleEndAddress, this);
+		for(const std::unique_ptr<ModuleMemoryManager::Image>& image : images)
+		{
+			if(!image->numPages) { continue; }
+			const Uptr imageEndAddress = reinterpret_cast<Uptr>(image->baseAddress)
+										 + (image->numPages << Platform::getBytesPerPageLog2());
+			globalModuleState->addressToModuleMap.emplace(imageEndAddress, this);
+		}
 	}
 
 	if(shouldLogMetrics)
 	{
 		Timing::logRatePerSecond((std::string("Loaded ") + debugName).c_str(),
 								 loadObjectTimer,
-								 (F64)objectBytes.size() / 1024.0 / 1024.0,
+								 (F64)numObjectBytes / 1024.0 / 1024.0,
 								 "MiB");
 		Log::printf(Log::Category::metrics,
 					"Code: %.1f KiB, read-only data: %.1f KiB, read-write data: %.1f KiB\n",
@@ -631,28 +760,36 @@ Module::Module(const std::vector<U8>& objectBytes,
 
 Module::~Module()
 {
-	// Notify GDB that the object is being unloaded.
+	// Notify GDB that the objects are being unloaded.
+	if(debugInfoPolicy == DebugInfoPolicy::eager)
 	{
 		Platform::Mutex::Lock lock(globalModuleState->gdbRegistrationListenerMutex);
 #if LLVM_VERSION_MAJOR >= 8
-		globalModuleState->gdbRegistrationListener->notifyFreeingObject(
-			reinterpret_cast<Uptr>(this));
-#else
-		globalModuleState->gdbRegistrationListener->NotifyFreeingObject(*object);
-#endif
+		for(const std::unique_ptr<ModuleMemoryManager::Image>& image : memoryManager->getImages())
+		{
+			globalModuleState->gdbRegistrationListener->notifyFreeingObject(getObjectKey(*image));
 
 #ifdef WAVM_PERF_EVENTS
-    perfRegistrationListener->notifyFreeingObject(reinterpret_cast<Uptr>(this));
+            perfRegistrationListener->notifyFreeingObject(getObjectKey(*image));
+#endif
+		}
+#else
+		for(const std::unique_ptr<llvm::object::ObjectFile>& object : objects)
+		{ globalModuleState->gdbRegistrationListener->NotifyFreeingObject(*object); }
 #endif
 	}
 
-	// Remove the module from the global address to module map.
+	// Remove the module's images from the global address to module map.
 	{
 		Platform::RWMutex::ExclusiveLock addressToModuleMapLock(
 			globalModuleState->addressToModuleMapMutex);
-		globalModuleState->addressToModuleMap.erase(
-			globalModuleState->addressToModuleMap.find(reinterpret_cast<Uptr>(
-				memoryManager->getImageBaseAddress() + memoryManager->getNumImageBytes())));
+		for(const std::unique_ptr<ModuleMemoryManager::Image>& image : memoryManager->getImages())
+		{
+			if(!image->numPages) { continue; }
+			globalModuleState->addressToModuleMap.erase(globalModuleState->addressToModuleMap.find(
+				reinterpret_cast<Uptr>(image->baseAddress)
+				+ (image->numPages << Platform::getBytesPerPageLog2())));
+		}
 	}
 
 	// Free the FunctionMutableData objects.
@@ -663,7 +800,8 @@ Module::~Module()
 }
 
 std::shared_ptr<LLVMJIT::Module> LLVMJIT::loadModule(
-	const std::vector<U8>& objectFileBytes,
+	const U8* objectBytes,
+	Uptr numObjectBytes,
 	HashMap<std::string, FunctionBinding>&& wavmIntrinsicsExportMap,
 	std::vector<IR::FunctionType>&& types,
 	std::vector<FunctionBinding>&& functionImports,
@@ -674,7 +812,8 @@ std::shared_ptr<LLVMJIT::Module> LLVMJIT::loadModule(
 	InstanceBinding instance,
 	Uptr tableReferenceBias,
 	const std::vector<Runtime::FunctionMutableData*>& functionDefMutableDatas,
-	std::string&& debugName)
+	std::string&& debugName,
+	const std::vector<FunctionBinding>& baselineFunctionDefs)
 {
 	// Bind undefined symbols in the compiled object to values.
 	HashMap<std::string, Uptr> importedSymbolMap;
@@ -749,14 +888,29 @@ std::shared_ptr<LLVMJIT::Module> LLVMJIT::loadModule(
 	}
 
 	// Allocate FunctionMutableData objects for each function def, and bind them to the symbols
-	// imported by the compiled module.
+	// imported by the compiled module. Tier-up code only defines some of the module's function
+	// defs, so only has FunctionMutableData objects for those function defs.
 	for(Uptr functionDefIndex = 0; functionDefIndex < functionDefMutableDatas.size();
 		++functionDefIndex)
 	{
 		Runtime::FunctionMutableData* functionMutableData
 			= functionDefMutableDatas[functionDefIndex];
+		if(!functionMutableData) { continue; }
 		importedSymbolMap.addOrFail(getExternalName("functionDefMutableDatas", functionDefIndex),
 									reinterpret_cast<Uptr>(functionMutableData));
+
+		// Baseline tier code references the FunctionTierUpData in the FunctionMutableData.
+		importedSymbolMap.addOrFail(getExternalName("functionDefTierUpData", functionDefIndex),
+									reinterpret_cast<Uptr>(&functionMutableData->tierUp));
+	}
+
+	// Bind the symbols that tier-up code uses to reference the baseline code for function defs.
+	for(Uptr functionDefIndex = 0; functionDefIndex < baselineFunctionDefs.size();
+		++functionDefIndex)
+	{
+		importedSymbolMap.addOrFail(
+			getExternalName("baselineFunctionDef", functionDefIndex),
+			reinterpret_cast<Uptr>(baselineFunctionDefs[functionDefIndex].code));
 	}
 
 	// Bind the instance symbol to point to the Instance.
@@ -785,7 +939,8 @@ std::shared_ptr<LLVMJIT::Module> LLVMJIT::loadModule(
 #endif
 
 	// Load the module.
-	return std::make_shared<Module>(objectFileBytes, importedSymbolMap, true, std::move(debugName));
+	return std::make_shared<Module>(
+		objectBytes, numObjectBytes, importedSymbolMap, true, std::move(debugName));
 }
 
 bool LLVMJIT::getInstructionSourceByAddress(Uptr address, InstructionSource& outSource)
@@ -808,29 +963,67 @@ bool LLVMJIT::getInstructionSourceByAddress(Uptr address, InstructionSource& out
 	   || address >= codeAddress + outSource.function->mutableData->numCodeBytes)
 	{ return false; }
 
+	Runtime::FunctionMutableData* functionMutableData = outSource.function->mutableData;
+	if(!functionMutableData->isOffsetToOpIndexMapDecoded.load(std::memory_order_acquire))
+	{ jitModule->decodeOffsetToOpIndexMap(functionMutableData); }
+
+	// Find the last entry in the offsetToOpIndexMap whose offset is <= the function-relative IP.
+	const U32 ipOffset = U32(address - codeAddress);
+	const std::vector<Runtime::OffsetToOpIndex>& offsetToOpIndexMap
+		= functionMutableData->offsetToOpIndexMap;
+	auto offsetMapIt = std::upper_bound(
+		offsetToOpIndexMap.begin(),
+		offsetToOpIndexMap.end(),
+		ipOffset,
+		[](U32 offset, const Runtime::OffsetToOpIndex& entry) { return offset < entry.offset; });
+
+	outSource.instructionIndex
+		= offsetMapIt == offsetToOpIndexMap.begin() ? 0 : Uptr((offsetMapIt - 1)->opIndex);
+	return true;
+}
+
+void Module::decodeOffsetToOpIndexMap(Runtime::FunctionMutableData* functionMutableData)
+{
 #if LAZY_PARSE_DWARF_LINE_INFO
-	Platform::Mutex::Lock dwarfContextLock(jitModule->dwarfContextMutex);
-	llvm::DILineInfo lineInfo = jitModule->dwarfContext->getLineInfoForAddress(
-		llvm::object::SectionedAddress{address, llvm::object::SectionedAddress::UndefSection},
-		llvm::DILineInfoSpecifier(llvm::DILineInfoSpecifier::FileLineInfoKind::Default,
-								  llvm::DINameKind::None));
+	Platform::Mutex::Lock dwarfContextLock(dwarfContextMutex);
 
-	outSource.instructionIndex = Uptr(lineInfo.Line);
-	return true;
-#else
-	// Find the highest entry in the offsetToOpIndexMap whose offset is <= the symbol-relative IP.
-	U32 ipOffset = (U32)(address - codeAddress);
-	Iptr opIndex = -1;
-	for(auto offsetMapIt : outSource.function->mutableData->offsetToOpIndexMap)
+	// Another thread may have decoded the line table while this thread waited for the lock.
+	if(functionMutableData->isOffsetToOpIndexMapDecoded.load(std::memory_order_acquire))
+	{ return; }
+
+	const Uptr codeAddress = reinterpret_cast<Uptr>(functionMutableData->function->code);
+	auto dwarfContextIt = imageEndToDWARFContextMap.upper_bound(codeAddress);
+	if(dwarfContextIt != imageEndToDWARFContextMap.end())
 	{
-		if(offsetMapIt.first <= ipOffset) { opIndex = offsetMapIt.second; }
-		else
+		// Create the DWARF context for the function's image if this is the first function in the
+		// image to be decoded.
+		if(!dwarfContextIt->second)
+		{
+			for(const std::unique_ptr<ModuleMemoryManager::Image>& image :
+				memoryManager->getImages())
+			{
+				const Uptr imageEndAddress = reinterpret_cast<Uptr>(image->baseAddress)
+											 + (image->numPages << Platform::getBytesPerPageLog2());
+				if(image->numPages && imageEndAddress == dwarfContextIt->first)
+				{
+					dwarfContextIt->second = llvm::DWARFContext::create(
+						image->sectionNameToContentsMap, sizeof(Uptr));
+					break;
+				}
+			}
+		}
+
+		if(dwarfContextIt->second)
 		{
-			break;
+			appendLineTable(functionMutableData,
+							dwarfContextIt->second->getLineInfoForAddressRange(
+								llvm::object::SectionedAddress{
+									codeAddress, llvm::object::SectionedAddress::UndefSection},
+								functionMutableData->numCodeBytes),
+							codeAddress);
 		}
 	}
-
-	outSource.instructionIndex = opIndex > 0 ? Uptr(opIndex) : 0;
-	return true;
 #endif
+
+	functionMutableData->isOffsetToOpIndexMapDecoded.store(true, std::memory_order_release);
 }
@@ -165,9 +165,136 @@ InvokeThunkPointer LLVMJIT::getInvokeThunk(FunctionType functionType)
 
 	// Load the object code.
 	auto jitModule
-		= new LLVMJIT::Module(objectBytes, {}, false, std::string(functionMutableData->debugName));
+		= new LLVMJIT::Module(objectBytes.data(),
+							  objectBytes.size(),
+							  {},
+							  false,
+							  std::string(functionMutableData->debugName));
 	invokeThunkCache.modules.push_back(std::unique_ptr<LLVMJIT::Module>(jitModule));
 
 	invokeThunkFunction = jitModule->nameToFunctionMap[mangleSymbol("thunk")];
 	return reinterpret_cast<InvokeThunkPointer>(const_cast<U8*>(invokeThunkFunction->code));
 }
+
+// A global host thunk cache
+struct HostThunkCache
+{
+	Platform::RWMutex mutex;
+
+	HashMap<FunctionType, Runtime::Function*> typeToFunctionMap;
+	std::vector<std::unique_ptr<LLVMJIT::Module>> modules;
+
+	static HostThunkCache& get()
+	{
+		static HostThunkCache singleton;
+		return singleton;
+	}
+
+private:
+	HostThunkCache() {}
+};
+
+Runtime::Function* LLVMJIT::getHostThunk(FunctionType functionType)
+{
+	WAVM_ASSERT(functionType.callingConvention() == CallingConvention::wasm);
+	HostThunkCache& hostThunkCache = HostThunkCache::get();
+
+	// First, take a shareable lock on the cache mutex, and check if the thunk is cached.
+	{
+		Platform::RWMutex::ShareableLock shareableLock(hostThunkCache.mutex);
+		Runtime::Function** hostThunkFunction = hostThunkCache.typeToFunctionMap.get(functionType);
+		if(hostThunkFunction) { return *hostThunkFunction; }
+	}
+
+	// If the thunk is not cached, take an exclusive lock on the cache mutex, and check again if
+	// the thunk was cached while the cache was unlocked.
+	Platform::RWMutex::ExclusiveLock hostThunkLock(hostThunkCache.mutex);
+	Runtime::Function*& hostThunkFunction
+		= hostThunkCache.typeToFunctionMap.getOrAdd(functionType, nullptr);
+	if(hostThunkFunction) { return hostThunkFunction; }
+
+	// Create a FunctionMutableData object for the thunk.
+	FunctionMutableData* functionMutableData
+		= new FunctionMutableData("thnk!WASM to host thunk!" + asString(functionType));
+
+	// Create a LLVM module and a LLVM function for the thunk. The function has the wasm function
+	// type's parameters, preceded by a nest parameter for the HostThunkBinding.
+	LLVMContext llvmContext;
+	llvm::Module llvmModule("", llvmContext);
+	std::unique_ptr<llvm::TargetMachine> targetMachine = getTargetMachine(getHostTargetSpec());
+	llvmModule.setDataLayout(targetMachine->createDataLayout());
+	llvm::FunctionType* llvmWASMFunctionType = asLLVMType(llvmContext, functionType);
+	std::vector<llvm::Type*> llvmParamTypes{llvmContext.i8PtrType};
+	llvmParamTypes.insert(llvmParamTypes.end(),
+						  llvmWASMFunctionType->param_begin(),
+						  llvmWASMFunctionType->param_end());
+	auto llvmFunctionType = llvm::FunctionType::get(
+		llvmWASMFunctionType->getReturnType(), llvmParamTypes, false);
+	auto function = llvm::Function::Create(
+		llvmFunctionType, llvm::Function::ExternalLinkage, "thunk", &llvmModule);
+	function->setCallingConv(asLLVMCallingConv(CallingConvention::wasm));
+	function->addParamAttr(0, llvm::Attribute::Nest);
+	setRuntimeFunctionPrefix(llvmContext,
+							 function,
+							 emitLiteralPointer(functionMutableData, llvmContext.iptrType),
+							 emitLiteral(llvmContext, Uptr(UINTPTR_MAX)),
+							 emitLiteral(llvmContext, functionType.getEncoding().impl));
+	setFunctionAttributes(targetMachine.get(), function);
+
+	llvm::Value* binding = &*(function->args().begin() + 0);
+	llvm::Value* contextPointer = &*(function->args().begin() + 1);
+
+	EmitContext emitContext(llvmContext, {});
+	emitContext.irBuilder.SetInsertPoint(llvm::BasicBlock::Create(llvmContext, "entry", function));
+
+	emitContext.initContextVariables(contextPointer);
+
+	// Load the native function and the data bound to it from the binding.
+	llvm::Value* nativeFunction = emitContext.loadFromUntypedPointer(
+		emitContext.irBuilder.CreateInBoundsGEP(
+			binding,
+			{emitLiteral(llvmContext, Uptr(offsetof(HostThunkBinding, nativeFunction)))}),
+		llvmContext.i8PtrType,
+		alignof(HostThunkBinding));
+	llvm::Value* boundData = emitContext.loadFromUntypedPointer(
+		emitContext.irBuilder.CreateInBoundsGEP(
+			binding, {emitLiteral(llvmContext, Uptr(offsetof(HostThunkBinding, boundData)))}),
+		llvmContext.iptrType,
+		alignof(HostThunkBinding));
+
+	// Call the native function with the bound data followed by the thunk's arguments.
+	std::vector<ValueType> nativeParams{ValueType::i64};
+	std::vector<llvm::Value*> arguments{
+		emitContext.irBuilder.CreateZExt(boundData, llvmContext.i64Type)};
+	for(Uptr argIndex = 0; argIndex < functionType.params().size(); ++argIndex)
+	{
+		nativeParams.push_back(functionType.params()[argIndex]);
+		arguments.push_back(&*(function->args().begin() + 2 + argIndex));
+	}
+	const FunctionType nativeFunctionType(
+		functionType.results(), TypeTuple(nativeParams), CallingConvention::cAPICallback);
+	ValueVector results = emitContext.emitCallOrInvoke(
+		emitContext.irBuilder.CreatePointerCast(
+			nativeFunction, asLLVMType(llvmContext, nativeFunctionType)->getPointerTo()),
+		arguments,
+		nativeFunctionType);
+
+	// Return the native function's results.
+	emitContext.emitReturn(functionType.results(), results);
+
+	// Compile the LLVM IR to object code.
+	std::vector<U8> objectBytes
+		= compileLLVMModule(llvmContext, std::move(llvmModule), false, targetMachine.get());
+
+	// Load the object code.
+	auto jitModule
+		= new LLVMJIT::Module(objectBytes.data(),
+							  objectBytes.size(),
+							  {},
+							  false,
+							  std::string(functionMutableData->debugName));
+	hostThunkCache.modules.push_back(std::unique_ptr<LLVMJIT::Module>(jitModule));
+
+	hostThunkFunction = jitModule->nameToFunctionMap[mangleSymbol("thunk")];
+	return hostThunkFunction;
+}
@@ -378,15 +378,19 @@ NFA::Machine::Machine(Builder* builder)
 	}
 
 	// Build a [charClass][state] transition map.
-	stateAndOffsetToNextStateMap = new InternalStateIndex[numClasses * numStates];
+	InternalStateIndex* newStateAndOffsetToNextStateMap
+		= new InternalStateIndex[numClasses * numStates];
 	for(Uptr classIndex = 0; classIndex < numClasses; ++classIndex)
 	{
 		for(Uptr stateIndex = 0; stateIndex < numStates; ++stateIndex)
 		{
-			stateAndOffsetToNextStateMap[stateIndex + classIndex * numStates] = InternalStateIndex(
-				dfaStates[stateIndex].nextStateByChar[representativeCharsByClass[classIndex]]);
+			newStateAndOffsetToNextStateMap[stateIndex + classIndex * numStates]
+				= InternalStateIndex(
+					dfaStates[stateIndex].nextStateByChar[representativeCharsByClass[classIndex]]);
 		}
 	}
+	stateAndOffsetToNextStateMap = newStateAndOffsetToNextStateMap;
+	ownsStateAndOffsetToNextStateMap = true;
 
 	// Build a map from character index to offset into [charClass][initialState] transition map.
 	WAVM_ASSERT((numClasses - 1) * (numStates - 1) <= UINT32_MAX);
@@ -397,9 +401,18 @@ NFA::Machine::Machine(Builder* builder)
 	Log::printf(Log::metrics, "  reduced DFA character classes to %" WAVM_PRIuPTR "\n", numClasses);
 }
 
+NFA::Machine::Machine(const MachineTables& tables)
+: stateAndOffsetToNextStateMap(tables.stateAndOffsetToNextStateMap)
+, numClasses(tables.numClasses)
+, numStates(tables.numStates)
+, ownsStateAndOffsetToNextStateMap(false)
+{
+	memcpy(charToOffsetMap, tables.charToOffsetMap, sizeof(charToOffsetMap));
+}
+
 NFA::Machine::~Machine()
 {
-	if(stateAndOffsetToNextStateMap)
+	if(stateAndOffsetToNextStateMap && ownsStateAndOffsetToNextStateMap)
 	{
 		delete[] stateAndOffsetToNextStateMap;
 		stateAndOffsetToNextStateMap = nullptr;
@@ -410,7 +423,9 @@ void NFA::Machine::moveFrom(Machine&& inMachine) noexcept
 {
 	memcpy(charToOffsetMap, inMachine.charToOffsetMap, sizeof(charToOffsetMap));
 	stateAndOffsetToNextStateMap = inMachine.stateAndOffsetToNextStateMap;
+	ownsStateAndOffsetToNextStateMap = inMachine.ownsStateAndOffsetToNextStateMap;
 	inMachine.stateAndOffsetToNextStateMap = nullptr;
+	inMachine.ownsStateAndOffsetToNextStateMap = false;
 	numClasses = inMachine.numClasses;
 	numStates = inMachine.numStates;
 }
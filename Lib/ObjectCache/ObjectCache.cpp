@@ -26,6 +26,9 @@
 
 #define CURRENT_DB_VERSION 1
 
+// The maximum number of concurrent read transactions on the database.
+static constexpr unsigned int maxReaders = 4096;
+
 using namespace WAVM;
 using namespace WAVM::ObjectCache;
 
@@ -336,6 +339,15 @@ struct ScopedTxn
 		txn = nullptr;
 	}
 
+	// Releases ownership of the transaction without committing or aborting it.
+	MDB_txn* release()
+	{
+		WAVM_ASSERT(txn);
+		MDB_txn* result = txn;
+		txn = nullptr;
+		return result;
+	}
+
 	void commit()
 	{
 		WAVM_ASSERT(txn);
@@ -353,6 +365,28 @@ private:
 	MDB_txn* txn;
 };
 
+// A view of object code stored in the database. LMDB values are read directly from its read-only
+// mapping of the database, and remain valid until the read transaction they were read in ends. The
+// view holds its read transaction open, so LMDB won't reuse the pages the object code is stored in
+// until the view is destroyed.
+struct LMDBObjectCodeView : Runtime::ObjectCodeView
+{
+	LMDBObjectCodeView(const std::shared_ptr<Database>& inDatabase,
+					   MDB_txn* inTxn,
+					   const MDB_val& objectCodeVal)
+	: ObjectCodeView((const U8*)objectCodeVal.mv_data, objectCodeVal.mv_size)
+	, database(inDatabase)
+	, txn(inTxn)
+	{
+	}
+
+	~LMDBObjectCodeView() override { mdb_txn_abort(txn); }
+
+private:
+	std::shared_ptr<Database> database;
+	MDB_txn* txn;
+};
+
 // Encapsulates the global state of the object cache.
 struct LMDBObjectCache : Runtime::ObjectCacheInterface
 {
@@ -365,7 +399,12 @@ struct LMDBObjectCache : Runtime::ObjectCacheInterface
 		ERROR_UNLESS_MDB_SUCCESS(mdb_env_create(&env));
 		ERROR_UNLESS_MDB_SUCCESS(mdb_env_set_mapsize(env, maxBytes));
 		ERROR_UNLESS_MDB_SUCCESS(mdb_env_set_maxdbs(env, 5));
-		const int openError = mdb_env_open(env, path, MDB_NOMETASYNC, 0666);
+
+		// Each LMDBObjectCodeView holds a read transaction open, so allow more readers than LMDB's
+		// default of 126. MDB_NOTLS allows a thread to have multiple read transactions, and the
+		// views to be destroyed on a different thread than they were created on.
+		ERROR_UNLESS_MDB_SUCCESS(mdb_env_set_maxreaders(env, maxReaders));
+		const int openError = mdb_env_open(env, path, MDB_NOMETASYNC | MDB_NOTLS, 0666);
 		if(openError)
 		{
 			mdb_env_close(env);
@@ -459,14 +498,7 @@ struct LMDBObjectCache : Runtime::ObjectCacheInterface
 		ModuleKey moduleKey(codeKey, moduleHash);
 		if(Database::tryGetKeyValue(txn, objectTable, moduleKey, outObjectCode))
 		{
-			// Update the last-used time for the cached module.
-			Metadata metadata;
-			Database::getKeyValue(txn, metaTable, moduleKey, metadata);
-			Database::deleteKey(txn, lruTable, metadata.lastAccessTimeKey);
-			metadata.lastAccessTimeKey = Platform::getClockTime(Platform::Clock::realtime);
-			Database::putKeyValue(txn, metaTable, moduleKey, metadata);
-			Database::putKeyValue(txn, lruTable, metadata.lastAccessTimeKey, moduleKey);
-
+			updateLastAccessTime(txn, moduleKey);
 			hadCachedObject = true;
 		}
 
@@ -478,6 +510,33 @@ struct LMDBObjectCache : Runtime::ObjectCacheInterface
 		return hadCachedObject;
 	}
 
+	// Looks up a cached object, and if found, returns a view of it in the database's mapping.
+	std::shared_ptr<const Runtime::ObjectCodeView> tryGetCachedObjectView(U8 moduleHash[16])
+	{
+		Timing::Timer readTimer;
+
+		// Look up the object code in a read-only transaction that is owned by the view.
+		ModuleKey moduleKey(codeKey, moduleHash);
+		std::shared_ptr<const Runtime::ObjectCodeView> objectCodeView;
+		{
+			ScopedTxn readTxn(database->beginTxn(MDB_RDONLY));
+			MDB_val objectCodeVal;
+			if(!Database::tryGetKeyValue(readTxn, objectTable, moduleKey, objectCodeVal))
+			{ return nullptr; }
+			objectCodeView
+				= std::make_shared<LMDBObjectCodeView>(database, readTxn.release(), objectCodeVal);
+		}
+
+		// Update the last-used time for the cached module in a separate write transaction.
+		ScopedTxn txn(database->beginTxn());
+		updateLastAccessTime(txn, moduleKey);
+		txn.commit();
+
+		Timing::logTimer("Probed for cached object", readTimer);
+
+		return objectCodeView;
+	}
+
 	void addCachedObject(U8 moduleHash[16],
 						 const U8* wasmBytes,
 						 Uptr numWASMBytes,
@@ -614,15 +673,8 @@ struct LMDBObjectCache : Runtime::ObjectCacheInterface
 		Uptr numWASMBytes,
 		std::function<std::vector<U8>()>&& compileThunk) override
 	{
-		// Compute a hash of the serialized WASM module.
-		Timing::Timer hashTimer;
-
 		U8 moduleHashBytes[16];
-		if(blake2b(moduleHashBytes, sizeof(moduleHashBytes), wasmBytes, numWASMBytes, nullptr, 0))
-		{ Errors::fatal("blake2b error"); }
-
-		Timing::logRatePerSecond(
-			"Hashed module key", hashTimer, numWASMBytes / 1024.0 / 1024.0, "MiB");
+		hashModule(wasmBytes, numWASMBytes, moduleHashBytes);
 
 		// Try to find the module's object code in the cache.
 		std::vector<U8> objectCode;
@@ -656,14 +708,86 @@ struct LMDBObjectCache : Runtime::ObjectCacheInterface
 		return objectCode;
 	}
 
+	virtual std::shared_ptr<const Runtime::ObjectCodeView> getCachedObjectView(
+		const U8* wasmBytes,
+		Uptr numWASMBytes,
+		std::function<std::vector<U8>()>&& compileThunk) override
+	{
+		U8 moduleHashBytes[16];
+		hashModule(wasmBytes, numWASMBytes, moduleHashBytes);
+
+		// Try to find the module's object code in the cache, and return a view of it without
+		// copying it out of the database.
+		try
+		{
+			if(std::shared_ptr<const Runtime::ObjectCodeView> objectCodeView
+			   = tryGetCachedObjectView(moduleHashBytes))
+			{ return objectCodeView; }
+		}
+		catch(Database::Exception const& exception)
+		{
+			// If there are too many views holding read transactions open, fall back to copying the
+			// object code out of the database.
+			if(exception.type == Database::Exception::Type::tooManyReaders)
+			{
+				return Runtime::createObjectCodeView(
+					getCachedObject(wasmBytes, numWASMBytes, std::move(compileThunk)));
+			}
+
+			Log::printf(Log::error,
+						"Failed to lookup module in object cache: %s\n",
+						Database::Exception::getMessage(exception.type));
+		}
+
+		// If there wasn't a matching cached module+object code, compile the module.
+		std::vector<U8> objectCode = compileThunk();
+
+		// Add the cached module+object code to the database.
+		try
+		{
+			addCachedObject(moduleHashBytes, wasmBytes, numWASMBytes, objectCode);
+		}
+		catch(Database::Exception const& exception)
+		{
+			Log::printf(Log::error,
+						"Failed to add module to object cache: %s\n",
+						Database::Exception::getMessage(exception.type));
+		}
+
+		return Runtime::createObjectCodeView(std::move(objectCode));
+	}
+
 private:
-	std::unique_ptr<Database> database;
+	std::shared_ptr<Database> database;
 	MDB_dbi objectTable;
 	MDB_dbi metaTable;
 	MDB_dbi lruTable;
 	MDB_dbi versionTable;
 	U64 codeKey{0};
 
+	// Computes a hash of the serialized WASM module.
+	static void hashModule(const U8* wasmBytes, Uptr numWASMBytes, U8 outModuleHashBytes[16])
+	{
+		Timing::Timer hashTimer;
+
+		if(blake2b(outModuleHashBytes, 16, wasmBytes, numWASMBytes, nullptr, 0))
+		{ Errors::fatal("blake2b error"); }
+
+		Timing::logRatePerSecond(
+			"Hashed module key", hashTimer, numWASMBytes / 1024.0 / 1024.0, "MiB");
+	}
+
+	// Updates the last-used time for a cached module.
+	void updateLastAccessTime(MDB_txn* txn, const ModuleKey& moduleKey)
+	{
+		Metadata metadata;
+		Database::getKeyValue(txn, metaTable, moduleKey, metadata);
+		Database::deleteKey(txn, lruTable, metadata.lastAccessTimeKey);
+		metadata.lastAccessTimeKey = Platform::getClockTime(Platform::Clock::realtime);
+		Database::putKeyValue(txn, metaTable, moduleKey, metadata);
+		Database::putKeyValue(txn, lruTable, metadata.lastAccessTimeKey, moduleKey);
+	}
+
 	bool evictLRU()
 	{
 		ScopedTxn txn(database->beginTxn());
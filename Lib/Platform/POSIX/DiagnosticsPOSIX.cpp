@@ -5,6 +5,7 @@
 #include <string>
 #include "POSIXPrivate.h"
 #include "WAVM/Inline/Assert.h"
+#include "WAVM/Platform/Defines.h"
 #include "WAVM/Platform/Diagnostics.h"
 
 #if WAVM_ENABLE_UNWIND
@@ -29,10 +30,22 @@ extern "C" const char* __asan_default_options()
 		   ":replace_intrin=false";
 }
 
-CallStack Platform::captureCallStack(Uptr numOmittedFramesFromTop)
+static std::atomic<CallStackCapturePolicy> callStackCapturePolicy{
+	CallStackCapturePolicy::unwind};
+
+void Platform::setCallStackCapturePolicy(CallStackCapturePolicy policy)
 {
-	CallStack result;
+	callStackCapturePolicy.store(policy, std::memory_order_relaxed);
+}
 
+CallStackCapturePolicy Platform::getCallStackCapturePolicy()
+{
+	return callStackCapturePolicy.load(std::memory_order_relaxed);
+}
+
+// This is inlined into its callers so the unwind starts at the caller's frame.
+static WAVM_FORCEINLINE void unwindCallStack(CallStack& result, Uptr numOmittedFramesFromTop)
+{
 #if WAVM_ENABLE_UNWIND
 	unw_context_t context;
 	WAVM_ERROR_UNLESS(!unw_getcontext(&context));
@@ -50,10 +63,77 @@ CallStack Platform::captureCallStack(Uptr numOmittedFramesFromTop)
 		}
 	}
 #endif
+}
+
+CallStack Platform::captureCallStack(Uptr numOmittedFramesFromTop)
+{
+	CallStack result;
+	unwindCallStack(result, numOmittedFramesFromTop);
+	return result;
+}
 
+WAVM_FORCENOINLINE CallStack Platform::captureCallStackWithPolicy(Uptr numOmittedFramesFromTop)
+{
+	CallStack result;
+	const CallStackCapturePolicy policy = getCallStackCapturePolicy();
+	switch(policy)
+	{
+	case CallStackCapturePolicy::none: break;
+	case CallStackCapturePolicy::innermostFrame:
+	case CallStackCapturePolicy::framePointers: {
+		// Start at the caller's frame: this function's frame holds the caller's frame pointer and
+		// the return address into the caller.
+		const Uptr* frame = reinterpret_cast<const Uptr*>(__builtin_frame_address(0));
+		const Uptr maxFrames
+			= policy == CallStackCapturePolicy::innermostFrame ? 1 : CallStack::maxFrames;
+		walkFramePointers(result, frame[1], false, frame[0], numOmittedFramesFromTop, maxFrames);
+		break;
+	}
+	case CallStackCapturePolicy::unwind: unwindCallStack(result, numOmittedFramesFromTop); break;
+	default: WAVM_UNREACHABLE();
+	};
 	return result;
 }
 
+void Platform::walkFramePointers(CallStack& callStack,
+								 Uptr ip,
+								 bool isSignalIP,
+								 Uptr framePointer,
+								 Uptr numOmittedFramesFromTop,
+								 Uptr maxFrames)
+{
+	// Only follow frame pointers that are within the thread's stack, and that are above the frame
+	// pointer they were loaded from, to make sure the walk can't read unmapped memory or loop.
+	U8* stackMinGuardAddr;
+	U8* stackMinAddr;
+	U8* stackMaxAddr;
+	sigAltStack.getNonSignalStack(stackMinGuardAddr, stackMinAddr, stackMaxAddr);
+	Uptr minFramePointer = reinterpret_cast<Uptr>(stackMinAddr);
+	const Uptr maxFramePointer = reinterpret_cast<Uptr>(stackMaxAddr) - 2 * sizeof(Uptr);
+
+	for(Uptr frameIndex = 0; !callStack.frames.isFull() && callStack.frames.size() < maxFrames;
+		++frameIndex)
+	{
+		if(frameIndex >= numOmittedFramesFromTop)
+		{
+			callStack.frames.push_back(
+				CallStack::Frame{(frameIndex == 0 && isSignalIP) ? ip : (ip - 1)});
+		}
+
+		// Each frame pointer points to the caller's saved frame pointer, followed by the return
+		// address into the caller.
+		if(framePointer < minFramePointer || framePointer > maxFramePointer
+		   || framePointer % sizeof(Uptr))
+		{ break; }
+		const Uptr* frame = reinterpret_cast<const Uptr*>(framePointer);
+		ip = frame[1];
+		if(!ip) { break; }
+
+		minFramePointer = framePointer + 2 * sizeof(Uptr);
+		framePointer = frame[0];
+	}
+}
+
 bool Platform::getInstructionSourceByAddress(Uptr ip, InstructionSource& outSource)
 {
 #if defined(__linux__) || defined(__APPLE__)
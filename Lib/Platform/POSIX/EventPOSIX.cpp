@@ -9,9 +9,70 @@
 #include "WAVM/Platform/Defines.h"
 #include "WAVM/Platform/Event.h"
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 using namespace WAVM;
 using namespace WAVM::Platform;
 
+#ifdef __linux__
+
+// On Linux, events are a single futex word instead of a pthread mutex and condition variable: a
+// signal that doesn't find a waiting thread is a single atomic exchange, and waking a thread
+// doesn't need to acquire a mutex that the woken thread will immediately contend on.
+
+static long futex(std::atomic<U32>* word, int op, U32 value, const timespec* timeout)
+{
+	return syscall(SYS_futex, reinterpret_cast<U32*>(word), op, value, timeout, nullptr, 0);
+}
+
+Platform::Event::Event() : futexWord(0)
+{
+	static_assert(sizeof(futexWord) == sizeof(U32), "futex words must be 32 bits");
+}
+
+Platform::Event::~Event() {}
+
+bool Platform::Event::wait(Time waitDuration)
+{
+	const bool isInfiniteWait = isInfinity(waitDuration);
+	const I128 untilTimeNS
+		= isInfiniteWait ? 0 : getClockTime(Clock::monotonic).ns + waitDuration.ns;
+	while(true)
+	{
+		// If the event is signaled, reset it and return.
+		if(futexWord.exchange(0, std::memory_order_acquire)) { return true; }
+
+		// Park the thread until the futex word is changed by signal or the wait times out. Spurious
+		// wakeups (EINTR) and signals between the exchange and the futex call (EAGAIN) just retry.
+		timespec waitTimeSpec;
+		if(!isInfiniteWait)
+		{
+			const I128 currentTimeNS = getClockTime(Clock::monotonic).ns;
+			if(currentTimeNS >= untilTimeNS)
+			{ return futexWord.exchange(0, std::memory_order_acquire) != 0; }
+			const I128 remainingNS = untilTimeNS - currentTimeNS;
+			waitTimeSpec.tv_sec = time_t(remainingNS / 1000000000);
+			waitTimeSpec.tv_nsec = long(remainingNS % 1000000000);
+		}
+		if(futex(&futexWord, FUTEX_WAIT_PRIVATE, 0, isInfiniteWait ? nullptr : &waitTimeSpec))
+		{ WAVM_ERROR_UNLESS(errno == EAGAIN || errno == EINTR || errno == ETIMEDOUT); }
+	}
+}
+
+void Platform::Event::signal()
+{
+	// Only wake a thread if the event wasn't already signaled: if it was, any thread waiting on it
+	// has already been woken.
+	if(!futexWord.exchange(1, std::memory_order_release))
+	{ futex(&futexWord, FUTEX_WAKE_PRIVATE, 1, nullptr); }
+}
+
+#else
+
 Platform::Event::Event()
 {
 	static_assert(sizeof(pthreadMutex) == sizeof(pthread_mutex_t), "");
@@ -85,3 +146,5 @@ void Platform::Event::signal()
 {
 	WAVM_ERROR_UNLESS(!pthread_cond_signal((pthread_cond_t*)&pthreadCond));
 }
+
+#endif
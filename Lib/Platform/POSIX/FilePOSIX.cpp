@@ -6,12 +6,16 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
+#include <stdio.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
+#include <vector>
 #include "WAVM/Inline/Assert.h"
 #include "WAVM/Inline/BasicTypes.h"
 #include "WAVM/Inline/Errors.h"
@@ -21,6 +25,11 @@
 #include "WAVM/Platform/Mutex.h"
 #include "WAVM/VFS/VFS.h"
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
+
 #define FILE_OFFSET_IS_64BIT (sizeof(off_t) == 8)
 
 using namespace WAVM;
@@ -577,6 +586,12 @@ struct POSIXFD : VFD
 		outStream = new POSIXDirEntStream(dir);
 		return Result::success;
 	}
+
+	virtual bool getHostFD(I32& outHostFD) override
+	{
+		outHostFD = fd;
+		return true;
+	}
 };
 
 struct POSIXStdFD : POSIXFD
@@ -622,6 +637,7 @@ struct POSIXFS : HostFS
 	virtual Result openDir(const std::string& path, DirEntStream*& outStream) override;
 
 	virtual Result unlinkFile(const std::string& path) override;
+	virtual Result renameFile(const std::string& oldPath, const std::string& newPath) override;
 	virtual Result removeDir(const std::string& path) override;
 	virtual Result createDir(const std::string& path) override;
 
@@ -747,6 +763,11 @@ Result POSIXFS::unlinkFile(const std::string& path)
 	return !unlink(path.c_str()) ? VFS::Result::success : asVFSResult(errno);
 }
 
+Result POSIXFS::renameFile(const std::string& oldPath, const std::string& newPath)
+{
+	return !rename(oldPath.c_str(), newPath.c_str()) ? Result::success : asVFSResult(errno);
+}
+
 Result POSIXFS::removeDir(const std::string& path)
 {
 	return !unlinkat(AT_FDCWD, path.c_str(), AT_REMOVEDIR) ? Result::success : asVFSResult(errno);
@@ -764,3 +785,331 @@ std::string Platform::getCurrentWorkingDirectory()
 	WAVM_ERROR_UNLESS(getcwd(buffer, maxPathBytes) == buffer);
 	return std::string(buffer);
 }
+
+static void resetVFDPoll(VFDPoll& vfdPoll)
+{
+	vfdPoll.result = Result::success;
+	vfdPoll.isReadable = false;
+	vfdPoll.isWritable = false;
+	vfdPoll.isHungUp = false;
+	vfdPoll.numReadableBytes = 0;
+}
+
+static void setVFDPollEvents(VFDPoll& vfdPoll,
+							 I32 hostFD,
+							 bool canRead,
+							 bool canWrite,
+							 bool isHungUp,
+							 bool isError)
+{
+	vfdPoll.isReadable = vfdPoll.waitForRead && (canRead || isHungUp || isError);
+	vfdPoll.isWritable = vfdPoll.waitForWrite && (canWrite || isError);
+	vfdPoll.isHungUp = isHungUp;
+	if(vfdPoll.isReadable)
+	{
+		int numReadableBytes = 0;
+		if(!ioctl(hostFD, FIONREAD, &numReadableBytes) && numReadableBytes > 0)
+		{ vfdPoll.numReadableBytes = U64(numReadableBytes); }
+	}
+}
+
+#ifdef __linux__
+
+static timespec getTimeSpec(I128 ns)
+{
+	if(ns <= 0) { ns = 0; }
+	else if(ns > I128(INT64_MAX)) { ns = INT64_MAX; }
+
+	timespec result;
+	result.tv_sec = time_t(I64(ns / 1000000000));
+	result.tv_nsec = long(I64(ns % 1000000000));
+	return result;
+}
+
+// Each thread that calls pollVFDs keeps an epoll instance and a timerfd for each clock that
+// deadlines are waited for on, instead of creating them for every wait. The timerfds are always in
+// the epoll set, but are only armed during a wait with a finite deadline.
+struct ThreadPollState
+{
+	I32 epollFD = -1;
+	I32 realtimeTimerFD = -1;
+	I32 monotonicTimerFD = -1;
+
+	~ThreadPollState()
+	{
+		if(realtimeTimerFD >= 0) { ::close(realtimeTimerFD); }
+		if(monotonicTimerFD >= 0) { ::close(monotonicTimerFD); }
+		if(epollFD >= 0) { ::close(epollFD); }
+	}
+
+	Result init()
+	{
+		if(epollFD >= 0) { return Result::success; }
+
+		epollFD = epoll_create1(EPOLL_CLOEXEC);
+		realtimeTimerFD = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+		monotonicTimerFD = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+		Result result = Result::success;
+		if(epollFD < 0 || realtimeTimerFD < 0 || monotonicTimerFD < 0)
+		{ result = asVFSResult(errno); }
+		else
+		{
+			for(I32 timerFD : {realtimeTimerFD, monotonicTimerFD})
+			{
+				epoll_event event;
+				event.events = EPOLLIN;
+				event.data.fd = timerFD;
+				if(epoll_ctl(epollFD, EPOLL_CTL_ADD, timerFD, &event))
+				{
+					result = asVFSResult(errno);
+					break;
+				}
+			}
+		}
+
+		if(result != Result::success)
+		{
+			for(I32* fd : {&epollFD, &realtimeTimerFD, &monotonicTimerFD})
+			{
+				if(*fd >= 0) { ::close(*fd); }
+				*fd = -1;
+			}
+		}
+		return result;
+	}
+};
+
+static thread_local ThreadPollState threadPollState;
+
+Result Platform::pollVFDs(VFDPoll* vfdPolls,
+						  Uptr numVFDPolls,
+						  Clock deadlineClock,
+						  Time deadline,
+						  Uptr& outNumReadyVFDs)
+{
+	ThreadPollState& pollState = threadPollState;
+	Result result = pollState.init();
+	if(result != Result::success) { return result; }
+
+	// Add the host FDs to the epoll set. Several VFDPolls may wait on the same host FD, so the
+	// events registered for a host FD are the union of the events waited for by all of them.
+	std::vector<I32> hostFDs(numVFDPolls, -1);
+	std::vector<I32> registeredHostFDs;
+	Uptr numReadyVFDs = 0;
+	for(Uptr pollIndex = 0; pollIndex < numVFDPolls; ++pollIndex)
+	{
+		VFDPoll& vfdPoll = vfdPolls[pollIndex];
+		resetVFDPoll(vfdPoll);
+
+		I32 hostFD;
+		if(!vfdPoll.vfd->getHostFD(hostFD))
+		{
+			vfdPoll.result = Result::notSupported;
+			++numReadyVFDs;
+			continue;
+		}
+		hostFDs[pollIndex] = hostFD;
+
+		epoll_event event;
+		event.events = EPOLLRDHUP;
+		event.data.fd = hostFD;
+		for(Uptr otherIndex = 0; otherIndex <= pollIndex; ++otherIndex)
+		{
+			if(hostFDs[otherIndex] != hostFD) { continue; }
+			if(vfdPolls[otherIndex].waitForRead) { event.events |= EPOLLIN; }
+			if(vfdPolls[otherIndex].waitForWrite) { event.events |= EPOLLOUT; }
+		}
+
+		if(!epoll_ctl(pollState.epollFD, EPOLL_CTL_ADD, hostFD, &event))
+		{ registeredHostFDs.push_back(hostFD); }
+		else if(errno == EEXIST)
+		{
+			// The host FD was registered by an earlier VFDPoll: add this VFDPoll's events to it.
+			if(epoll_ctl(pollState.epollFD, EPOLL_CTL_MOD, hostFD, &event))
+			{
+				vfdPoll.result = asVFSResult(errno);
+				hostFDs[pollIndex] = -1;
+				++numReadyVFDs;
+			}
+		}
+		else
+		{
+			// epoll doesn't support regular files and directories, but they are always ready.
+			if(errno == EPERM)
+			{
+				setVFDPollEvents(vfdPoll, hostFD, true, true, false, false);
+				if(vfdPoll.isReadable)
+				{
+					struct stat fdStatus;
+					const off_t offset = lseek(hostFD, 0, SEEK_CUR);
+					if(!fstat(hostFD, &fdStatus) && offset >= 0 && fdStatus.st_size > offset)
+					{ vfdPoll.numReadableBytes = U64(fdStatus.st_size - offset); }
+				}
+			}
+			else
+			{
+				vfdPoll.result = asVFSResult(errno);
+			}
+			hostFDs[pollIndex] = -1;
+			++numReadyVFDs;
+		}
+	}
+
+	// If any VFDs are already ready, just check the registered host FDs without waiting. Otherwise,
+	// arm the timerfd for the deadline's clock. timerfds don't support CPU time clocks, so those
+	// deadlines are translated to the monotonic clock.
+	I32 timerFD = -1;
+	int timeoutMS = -1;
+	if(numReadyVFDs) { timeoutMS = 0; }
+	else if(!isInfinity(deadline))
+	{
+		if(deadlineClock == Clock::processCPUTime)
+		{
+			deadline.ns = getClockTime(Clock::monotonic).ns
+						  + (deadline.ns - getClockTime(Clock::processCPUTime).ns);
+			deadlineClock = Clock::monotonic;
+		}
+
+		timerFD = deadlineClock == Clock::realtime ? pollState.realtimeTimerFD
+												   : pollState.monotonicTimerFD;
+
+		// A zero it_value disarms the timer, so use a deadline of at least 1ns.
+		itimerspec timerSpec;
+		timerSpec.it_interval = getTimeSpec(0);
+		timerSpec.it_value = getTimeSpec(deadline.ns > 0 ? deadline.ns : I128(1));
+		if(timerfd_settime(timerFD, TFD_TIMER_ABSTIME, &timerSpec, nullptr))
+		{
+			result = asVFSResult(errno);
+			timerFD = -1;
+		}
+	}
+
+	if(result == Result::success)
+	{
+		std::vector<epoll_event> events(registeredHostFDs.size() + 1);
+		int numEvents;
+		do
+		{
+			numEvents = epoll_wait(pollState.epollFD, events.data(), int(events.size()), timeoutMS);
+		} while(numEvents < 0 && errno == EINTR);
+		if(numEvents < 0)
+		{
+			result = asVFSResult(errno);
+			numEvents = 0;
+		}
+
+		for(int eventIndex = 0; eventIndex < numEvents; ++eventIndex)
+		{
+			const epoll_event& event = events[eventIndex];
+			for(Uptr pollIndex = 0; pollIndex < numVFDPolls; ++pollIndex)
+			{
+				if(hostFDs[pollIndex] != event.data.fd) { continue; }
+
+				VFDPoll& vfdPoll = vfdPolls[pollIndex];
+				setVFDPollEvents(vfdPoll,
+								 event.data.fd,
+								 event.events & EPOLLIN,
+								 event.events & EPOLLOUT,
+								 event.events & (EPOLLHUP | EPOLLRDHUP),
+								 event.events & EPOLLERR);
+				if(vfdPoll.isReadable || vfdPoll.isWritable || vfdPoll.isHungUp)
+				{ ++numReadyVFDs; }
+			}
+		}
+	}
+
+	// Disarm the timer, and remove the host FDs from the epoll set.
+	if(timerFD >= 0)
+	{
+		itimerspec timerSpec;
+		timerSpec.it_interval = getTimeSpec(0);
+		timerSpec.it_value = getTimeSpec(0);
+		WAVM_ERROR_UNLESS(!timerfd_settime(timerFD, 0, &timerSpec, nullptr));
+	}
+	for(I32 hostFD : registeredHostFDs)
+	{ epoll_ctl(pollState.epollFD, EPOLL_CTL_DEL, hostFD, nullptr); }
+
+	outNumReadyVFDs = numReadyVFDs;
+	return result;
+}
+
+#else
+
+Result Platform::pollVFDs(VFDPoll* vfdPolls,
+						  Uptr numVFDPolls,
+						  Clock deadlineClock,
+						  Time deadline,
+						  Uptr& outNumReadyVFDs)
+{
+	// Translate the VFDPolls to pollfds. VFDs that aren't backed by a host FD are given a negative
+	// pollfd.fd, which poll ignores.
+	std::vector<pollfd> pollFDs(numVFDPolls);
+	Uptr numReadyVFDs = 0;
+	for(Uptr pollIndex = 0; pollIndex < numVFDPolls; ++pollIndex)
+	{
+		VFDPoll& vfdPoll = vfdPolls[pollIndex];
+		resetVFDPoll(vfdPoll);
+
+		pollFDs[pollIndex].fd = -1;
+		pollFDs[pollIndex].events = 0;
+		pollFDs[pollIndex].revents = 0;
+		if(!vfdPoll.vfd->getHostFD(pollFDs[pollIndex].fd))
+		{
+			pollFDs[pollIndex].fd = -1;
+			vfdPoll.result = Result::notSupported;
+			++numReadyVFDs;
+			continue;
+		}
+		if(vfdPoll.waitForRead) { pollFDs[pollIndex].events |= POLLIN; }
+		if(vfdPoll.waitForWrite) { pollFDs[pollIndex].events |= POLLOUT; }
+	}
+
+	// poll only has millisecond timeouts, so wait until the deadline is reached on its own clock.
+	while(true)
+	{
+		int timeoutMS = -1;
+		if(numReadyVFDs) { timeoutMS = 0; }
+		else if(!isInfinity(deadline))
+		{
+			const I128 remainingNS = deadline.ns - getClockTime(deadlineClock).ns;
+			if(remainingNS <= 0) { timeoutMS = 0; }
+			else if(remainingNS >= I128(INT32_MAX) * 1000000) { timeoutMS = INT32_MAX; }
+			else
+			{
+				timeoutMS = int(I32((remainingNS + 999999) / 1000000));
+			}
+		}
+
+		const int numEvents = poll(pollFDs.data(), nfds_t(pollFDs.size()), timeoutMS);
+		if(numEvents < 0)
+		{
+			if(errno == EINTR) { continue; }
+			return asVFSResult(errno);
+		}
+		if(numEvents > 0 || timeoutMS == 0) { break; }
+	}
+
+	for(Uptr pollIndex = 0; pollIndex < numVFDPolls; ++pollIndex)
+	{
+		const pollfd& pollFD = pollFDs[pollIndex];
+		if(pollFD.fd < 0 || !pollFD.revents) { continue; }
+
+		VFDPoll& vfdPoll = vfdPolls[pollIndex];
+		if(pollFD.revents & POLLNVAL) { vfdPoll.result = Result::ioDeviceError; }
+		else
+		{
+			setVFDPollEvents(vfdPoll,
+							 pollFD.fd,
+							 pollFD.revents & POLLIN,
+							 pollFD.revents & POLLOUT,
+							 pollFD.revents & POLLHUP,
+							 pollFD.revents & POLLERR);
+		}
+		++numReadyVFDs;
+	}
+
+	outNumReadyVFDs = numReadyVFDs;
+	return Result::success;
+}
+
+#endif
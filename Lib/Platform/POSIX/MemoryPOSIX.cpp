@@ -1,8 +1,11 @@
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/resource.h>
 #include <unistd.h>
+#include <algorithm>
+#include <vector>
 #include "POSIXPrivate.h"
 #include "WAVM/Inline/Assert.h"
 #include "WAVM/Inline/BasicTypes.h"
@@ -181,6 +184,141 @@ void Platform::freeAlignedVirtualPages(U8* unalignedBaseAddress, Uptr numPages,
 	}
 }
 
+struct Platform::MemoryFile
+{
+	int fd;
+};
+
+MemoryFile* Platform::createMemoryFile(const char* debugName, Uptr numBytes)
+{
+#ifdef HAS_MEMFD_CREATE
+	int fd = memfd_create(debugName, MFD_CLOEXEC);
+	if(fd == -1)
+	{
+		fprintf(stderr,
+				"memfd_create(\"%s\", MFD_CLOEXEC) failed: %s\n",
+				debugName,
+				strerror(errno));
+		return nullptr;
+	}
+
+	MemoryFile* file = new MemoryFile{fd};
+	if(!resizeMemoryFile(file, numBytes))
+	{
+		destroyMemoryFile(file);
+		return nullptr;
+	}
+	return file;
+#else
+	return nullptr;
+#endif
+}
+
+MemoryFile* Platform::openMemoryFile(const char* path)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(fd == -1)
+	{
+		fprintf(stderr, "open(\"%s\", O_RDONLY | O_CLOEXEC) failed: %s\n", path, strerror(errno));
+		return nullptr;
+	}
+	return new MemoryFile{fd};
+}
+
+void Platform::destroyMemoryFile(MemoryFile* file)
+{
+	WAVM_ERROR_UNLESS(!close(file->fd));
+	delete file;
+}
+
+bool Platform::resizeMemoryFile(MemoryFile* file, Uptr numBytes)
+{
+	if(ftruncate(file->fd, off_t(numBytes)))
+	{
+		fprintf(stderr,
+				"ftruncate(%i, %" WAVM_PRIuPTR ") failed: %s\n",
+				file->fd,
+				numBytes,
+				strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+bool Platform::mapMemoryFile(MemoryFile* file,
+							 Uptr fileOffset,
+							 U8* baseVirtualAddress,
+							 Uptr numPages,
+							 bool copyOnWrite)
+{
+	WAVM_ERROR_UNLESS(isPageAligned(baseVirtualAddress));
+	WAVM_ERROR_UNLESS(!(fileOffset & (getBytesPerPage() - 1)));
+
+	const Uptr numBytes = numPages << getBytesPerPageLog2();
+	const int flags = MAP_FIXED | (copyOnWrite ? MAP_PRIVATE : MAP_SHARED);
+	if(mmap(baseVirtualAddress, numBytes, PROT_READ | PROT_WRITE, flags, file->fd, off_t(fileOffset))
+	   == MAP_FAILED)
+	{
+		fprintf(stderr,
+				"mmap(0x%" WAVM_PRIxPTR ", %" WAVM_PRIuPTR
+				", PROT_READ | PROT_WRITE, %s, %i, %" WAVM_PRIuPTR ") failed: %s\n",
+				reinterpret_cast<Uptr>(baseVirtualAddress),
+				numBytes,
+				copyOnWrite ? "MAP_FIXED | MAP_PRIVATE" : "MAP_FIXED | MAP_SHARED",
+				file->fd,
+				fileOffset,
+				strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+bool Platform::getWrittenCopyOnWritePages(U8* baseVirtualAddress,
+										  Uptr numPages,
+										  std::vector<bool>& outIsWrittenPage)
+{
+#ifdef __linux__
+	// Each virtual page has an entry in /proc/self/pagemap that says whether it's present, swapped
+	// out, or mapped from a file. A page of a copy-on-write mapping that has been written is an
+	// anonymous page, which is either present or swapped out.
+	static constexpr U64 pagemapPresent = U64(1) << 63;
+	static constexpr U64 pagemapSwapped = U64(1) << 62;
+	static constexpr U64 pagemapFileOrShared = U64(1) << 61;
+
+	WAVM_ERROR_UNLESS(isPageAligned(baseVirtualAddress));
+	int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+	if(fd == -1) { return false; }
+
+	outIsWrittenPage.assign(numPages, false);
+	const Uptr firstPageIndex = reinterpret_cast<Uptr>(baseVirtualAddress) >> getBytesPerPageLog2();
+	U64 entries[512];
+	Uptr pageIndex = 0;
+	while(pageIndex < numPages)
+	{
+		const Uptr numEntries = std::min(Uptr(512), numPages - pageIndex);
+		const ssize_t numBytesRead = pread(fd,
+										   entries,
+										   numEntries * sizeof(U64),
+										   off_t((firstPageIndex + pageIndex) * sizeof(U64)));
+		if(numBytesRead <= 0 || numBytesRead % sizeof(U64)) { break; }
+
+		const Uptr numEntriesRead = Uptr(numBytesRead) / sizeof(U64);
+		for(Uptr entryIndex = 0; entryIndex < numEntriesRead; ++entryIndex)
+		{
+			const U64 entry = entries[entryIndex];
+			outIsWrittenPage[pageIndex + entryIndex]
+				= (entry & pagemapSwapped)
+				  || ((entry & pagemapPresent) && !(entry & pagemapFileOrShared));
+		}
+		pageIndex += numEntriesRead;
+	}
+	WAVM_ERROR_UNLESS(!close(fd));
+	return pageIndex == numPages;
+#else
+	return false;
+#endif
+}
+
 Uptr Platform::getPeakMemoryUsageBytes()
 {
 	struct rusage ru;
@@ -71,5 +71,17 @@ namespace WAVM { namespace Platform {
 	}
 
 	void dumpErrorCallStack(Uptr numOmittedFramesFromTop);
+
+	// Adds frames to a call stack by following the frame pointer chain, starting from a frame with
+	// the given instruction pointer and frame pointer. Stops when maxFrames frames have been added,
+	// or when the chain leaves the thread's stack. If isSignalIP is true, the initial instruction
+	// pointer is the faulting instruction from a signal context; otherwise it is a return address,
+	// and is adjusted to point into the call instruction like the rest of the frames.
+	void walkFramePointers(CallStack& callStack,
+						   Uptr ip,
+						   bool isSignalIP,
+						   Uptr framePointer,
+						   Uptr numOmittedFramesFromTop,
+						   Uptr maxFrames);
 	void getCurrentThreadStack(U8*& outMinGuardAddr, U8*& outMinAddr, U8*& outMaxAddr);
 }}
@@ -27,7 +27,32 @@ static void maskSignals(int how)
 	pthread_sigmask(how, &set, nullptr);
 }
 
-[[noreturn]] static void signalHandler(int signalNumber, siginfo_t* signalInfo, void*)
+// Reads the instruction pointer and frame pointer of the code that was interrupted by a signal.
+static bool getSignalFrame(void* contextVoid, Uptr& outIP, Uptr& outFramePointer)
+{
+	ucontext_t* context = static_cast<ucontext_t*>(contextVoid);
+#if defined(__linux__) && defined(__x86_64__)
+	outIP = Uptr(context->uc_mcontext.gregs[REG_RIP]);
+	outFramePointer = Uptr(context->uc_mcontext.gregs[REG_RBP]);
+	return true;
+#elif defined(__linux__) && defined(__aarch64__)
+	outIP = Uptr(context->uc_mcontext.pc);
+	outFramePointer = Uptr(context->uc_mcontext.regs[29]);
+	return true;
+#elif defined(__APPLE__) && defined(__x86_64__)
+	outIP = Uptr(context->uc_mcontext->__ss.__rip);
+	outFramePointer = Uptr(context->uc_mcontext->__ss.__rbp);
+	return true;
+#elif defined(__APPLE__) && defined(__aarch64__)
+	outIP = Uptr(__darwin_arm_thread_state64_get_pc(context->uc_mcontext->__ss));
+	outFramePointer = Uptr(__darwin_arm_thread_state64_get_fp(context->uc_mcontext->__ss));
+	return true;
+#else
+	return false;
+#endif
+}
+
+[[noreturn]] static void signalHandler(int signalNumber, siginfo_t* signalInfo, void* context)
 {
 	maskSignals(SIG_BLOCK);
 
@@ -57,13 +82,36 @@ static void maskSignals(int how)
 	default: Errors::fatalfWithCallStack("unknown signal number: %i", signalNumber); break;
 	};
 
-	// Capture the execution context, omitting this function and the function that called it, so the
-	// top of the callstack is the function that triggered the signal.
-	CallStack callStack = captureCallStack(2);
+	// Capture the call stack of the code that triggered the signal according to the call stack
+	// capture policy. Frame pointers are followed from the interrupted code's registers; if those
+	// aren't available, fall back to unwinding.
+	const CallStackCapturePolicy callStackCapturePolicy = getCallStackCapturePolicy();
+	CallStack callStack;
+	Uptr signalIP = 0;
+	Uptr signalFramePointer = 0;
+	if(callStackCapturePolicy == CallStackCapturePolicy::unwind
+	   || (callStackCapturePolicy != CallStackCapturePolicy::none
+		   && !getSignalFrame(context, signalIP, signalFramePointer)))
+	{
+		// Capture the execution context, omitting this function and the function that called it,
+		// so the top of the callstack is the function that triggered the signal.
+		callStack = captureCallStack(2);
 
-	// Undo the -1 offset that captureCallStack applied to the trapping IP on the assumption that
-	// the signal trampoline frame is returning from an ordinary call.
-	if(callStack.frames.size()) { callStack.frames[0].ip += 1; }
+		// Undo the -1 offset that captureCallStack applied to the trapping IP on the assumption
+		// that the signal trampoline frame is returning from an ordinary call.
+		if(callStack.frames.size()) { callStack.frames[0].ip += 1; }
+	}
+	else if(callStackCapturePolicy != CallStackCapturePolicy::none)
+	{
+		walkFramePointers(callStack,
+						  signalIP,
+						  true,
+						  signalFramePointer,
+						  0,
+						  callStackCapturePolicy == CallStackCapturePolicy::innermostFrame
+							  ? 1
+							  : CallStack::maxFrames);
+	}
 
 	// Call the signal handlers, from innermost to outermost, until one returns true.
 	for(SignalContext* signalContext = innermostSignalContext; signalContext;
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <atomic>
 #include "WAVM/Inline/Assert.h"
 #include "WAVM/Inline/BasicTypes.h"
 #include "WAVM/Inline/Errors.h"
@@ -111,7 +112,9 @@ bool Platform::getInstructionSourceByAddress(Uptr ip, InstructionSource& outSour
 	}
 }
 
-CallStack Platform::unwindStack(const CONTEXT& immutableContext, Uptr numOmittedFramesFromTop)
+CallStack Platform::unwindStack(const CONTEXT& immutableContext,
+								Uptr numOmittedFramesFromTop,
+								Uptr maxFrames)
 {
 	// Make a mutable copy of the context.
 	CONTEXT context;
@@ -121,7 +124,9 @@ CallStack Platform::unwindStack(const CONTEXT& immutableContext, Uptr numOmitted
 	// reached the base.
 	CallStack callStack;
 #if WAVM_ENABLE_UNWIND
-	for(Uptr frameIndex = 0; !callStack.frames.isFull() && context.Rip; ++frameIndex)
+	for(Uptr frameIndex = 0;
+		!callStack.frames.isFull() && callStack.frames.size() < maxFrames && context.Rip;
+		++frameIndex)
 	{
 		if(frameIndex >= numOmittedFramesFromTop)
 		{
@@ -168,6 +173,33 @@ CallStack Platform::captureCallStack(Uptr numOmittedFramesFromTop)
 	return unwindStack(context, numOmittedFramesFromTop + 1);
 }
 
+static std::atomic<CallStackCapturePolicy> callStackCapturePolicy{
+	CallStackCapturePolicy::unwind};
+
+void Platform::setCallStackCapturePolicy(CallStackCapturePolicy policy)
+{
+	callStackCapturePolicy.store(policy, std::memory_order_relaxed);
+}
+
+CallStackCapturePolicy Platform::getCallStackCapturePolicy()
+{
+	return callStackCapturePolicy.load(std::memory_order_relaxed);
+}
+
+CallStack Platform::captureCallStackWithPolicy(Uptr numOmittedFramesFromTop)
+{
+	// X64 Windows code doesn't reliably maintain a frame pointer chain, so the framePointers policy
+	// unwinds the stack using the SEH unwind information.
+	const CallStackCapturePolicy policy = getCallStackCapturePolicy();
+	if(policy == CallStackCapturePolicy::none) { return CallStack(); }
+
+	CONTEXT context;
+	RtlCaptureContext(&context);
+	const Uptr maxFrames
+		= policy == CallStackCapturePolicy::innermostFrame ? 1 : CallStack::maxFrames;
+	return unwindStack(context, numOmittedFramesFromTop + 1, maxFrames);
+}
+
 static std::atomic<Uptr> numCommittedPageBytes{0};
 
 void Platform::printMemoryProfile()
@@ -690,6 +690,7 @@ struct WindowsFS : HostFS
 	virtual Result openDir(const std::string& path, DirEntStream*& outStream) override;
 
 	virtual Result unlinkFile(const std::string& path) override;
+	virtual Result renameFile(const std::string& oldPath, const std::string& newPath) override;
 	virtual Result removeDir(const std::string& path) override;
 	virtual Result createDir(const std::string& path) override;
 
@@ -838,6 +839,19 @@ Result WindowsFS::unlinkFile(const std::string& path)
 	return DeleteFileW(windowsPath.c_str()) ? Result::success : asVFSResult(GetLastError());
 }
 
+Result WindowsFS::renameFile(const std::string& oldPath, const std::string& newPath)
+{
+	// Convert the paths from UTF-8 VFS paths (with /) to UTF-16 Windows paths (with \).
+	std::wstring oldWindowsPath;
+	std::wstring newWindowsPath;
+	if(!getWindowsPath(oldPath, oldWindowsPath) || !getWindowsPath(newPath, newWindowsPath))
+	{ return Result::invalidNameCharacter; }
+
+	return MoveFileExW(oldWindowsPath.c_str(), newWindowsPath.c_str(), MOVEFILE_REPLACE_EXISTING)
+			   ? Result::success
+			   : asVFSResult(GetLastError());
+}
+
 Result WindowsFS::removeDir(const std::string& path)
 {
 	// Convert the path from a UTF-8 VFS path (with /) to a UTF-16 Windows path (with \).
@@ -906,3 +920,38 @@ std::string Platform::getCurrentWorkingDirectory()
 
 	return result;
 }
+
+Result Platform::pollVFDs(VFDPoll* vfdPolls,
+						  Uptr numVFDPolls,
+						  Clock deadlineClock,
+						  Time deadline,
+						  Uptr& outNumReadyVFDs)
+{
+	// Waiting on Windows file handles isn't supported, but a wait with no VFDs may be used to
+	// sleep until a deadline.
+	for(Uptr pollIndex = 0; pollIndex < numVFDPolls; ++pollIndex)
+	{
+		VFDPoll& vfdPoll = vfdPolls[pollIndex];
+		vfdPoll.result = Result::notSupported;
+		vfdPoll.isReadable = false;
+		vfdPoll.isWritable = false;
+		vfdPoll.isHungUp = false;
+		vfdPoll.numReadableBytes = 0;
+	}
+	outNumReadyVFDs = numVFDPolls;
+
+	if(!numVFDPolls)
+	{
+		Event event;
+		while(true)
+		{
+			const Time remainingTime
+				= isInfinity(deadline) ? deadline
+									   : Time{deadline.ns - getClockTime(deadlineClock).ns};
+			if(!isInfinity(remainingTime) && remainingTime.ns <= 0) { break; }
+			event.wait(remainingTime);
+		}
+	}
+
+	return Result::success;
+}
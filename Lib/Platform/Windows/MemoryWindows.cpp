@@ -147,6 +147,30 @@ void Platform::freeAlignedVirtualPages(U8* unalignedBaseAddress, Uptr numPages,
 	if(unalignedBaseAddress && !result) { Errors::fatal("VirtualFree(MEM_RELEASE) failed"); }
 }
 
+MemoryFile* Platform::createMemoryFile(const char* debugName, Uptr numBytes) { return nullptr; }
+
+MemoryFile* Platform::openMemoryFile(const char* path) { return nullptr; }
+
+void Platform::destroyMemoryFile(MemoryFile* file) { WAVM_UNREACHABLE(); }
+
+bool Platform::resizeMemoryFile(MemoryFile* file, Uptr numBytes) { WAVM_UNREACHABLE(); }
+
+bool Platform::mapMemoryFile(MemoryFile* file,
+							 Uptr fileOffset,
+							 U8* baseVirtualAddress,
+							 Uptr numPages,
+							 bool copyOnWrite)
+{
+	WAVM_UNREACHABLE();
+}
+
+bool Platform::getWrittenCopyOnWritePages(U8* baseVirtualAddress,
+										  Uptr numPages,
+										  std::vector<bool>& outIsWrittenPage)
+{
+	return false;
+}
+
 Uptr Platform::getPeakMemoryUsageBytes()
 {
 	PROCESS_MEMORY_COUNTERS processMemoryCounters;
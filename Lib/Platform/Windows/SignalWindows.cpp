@@ -67,8 +67,19 @@ static LONG CALLBACK sehSignalFilterFunctionNonReentrant(EXCEPTION_POINTERS* exc
 	if(!translateSEHToSignal(exceptionPointers, signal)) { return EXCEPTION_CONTINUE_SEARCH; }
 	else
 	{
-		// Unwind the stack frames from the context of the exception.
-		CallStack callStack = unwindStack(*exceptionPointers->ContextRecord, 0);
+		// Unwind the stack frames from the context of the exception, according to the call stack
+		// capture policy.
+		const CallStackCapturePolicy callStackCapturePolicy = getCallStackCapturePolicy();
+		CallStack callStack;
+		if(callStackCapturePolicy != CallStackCapturePolicy::none)
+		{
+			callStack = unwindStack(
+				*exceptionPointers->ContextRecord,
+				0,
+				callStackCapturePolicy == CallStackCapturePolicy::innermostFrame
+					? 1
+					: CallStack::maxFrames);
+		}
 
 		if((*filter)(context, signal, std::move(callStack))) { return EXCEPTION_EXECUTE_HANDLER; }
 		else
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include "WAVM/Inline/Assert.h"
+#include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Platform/Mutex.h"
+
+namespace WAVM { namespace Runtime {
+
+	// An index of non-overlapping address ranges that may be queried without blocking, so it can be
+	// used from signal handlers. Lookups binary search an immutable sorted array of the ranges.
+	// Adding or removing a range copies the array, and publishes the copy for subsequent lookups.
+	// Arrays that have been replaced are freed once no lookups are in progress.
+	template<typename Value> struct AddressRangeIndex
+	{
+		AddressRangeIndex() : ranges(new RangeArray) {}
+
+		~AddressRangeIndex()
+		{
+			delete ranges.load(std::memory_order_acquire);
+			for(const RangeArray* retiredRanges : retiredRangeArrays) { delete retiredRanges; }
+		}
+
+		// Adds the range [begin, end), which must not overlap any range already in the index.
+		void add(Uptr begin, Uptr end, Value value)
+		{
+			WAVM_ASSERT(begin < end);
+
+			Platform::Mutex::Lock writeLock(writeMutex);
+			const RangeArray* oldRanges = ranges.load(std::memory_order_acquire);
+
+			RangeArray* newRanges = new RangeArray;
+			newRanges->reserve(oldRanges->size() + 1);
+			auto insertIt = std::upper_bound(oldRanges->begin(), oldRanges->end(), begin, lessThan);
+			WAVM_ASSERT(insertIt == oldRanges->end() || end <= insertIt->begin);
+			WAVM_ASSERT(insertIt == oldRanges->begin() || (insertIt - 1)->end <= begin);
+			newRanges->insert(newRanges->end(), oldRanges->begin(), insertIt);
+			newRanges->push_back(Range{begin, end, value});
+			newRanges->insert(newRanges->end(), insertIt, oldRanges->end());
+
+			publish(oldRanges, newRanges);
+		}
+
+		// Removes the range that starts at the given address, if there is one.
+		void remove(Uptr begin)
+		{
+			Platform::Mutex::Lock writeLock(writeMutex);
+			const RangeArray* oldRanges = ranges.load(std::memory_order_acquire);
+
+			auto removeIt = std::upper_bound(oldRanges->begin(), oldRanges->end(), begin, lessThan);
+			if(removeIt == oldRanges->begin() || (removeIt - 1)->begin != begin) { return; }
+			--removeIt;
+
+			RangeArray* newRanges = new RangeArray;
+			newRanges->reserve(oldRanges->size() - 1);
+			newRanges->insert(newRanges->end(), oldRanges->begin(), removeIt);
+			newRanges->insert(newRanges->end(), removeIt + 1, oldRanges->end());
+
+			publish(oldRanges, newRanges);
+		}
+
+		// Finds the range that contains an address. Doesn't block or allocate memory.
+		bool lookup(Uptr address, Value& outValue, Uptr& outBegin) const
+		{
+			++numActiveLookups;
+			const RangeArray* currentRanges = ranges.load(std::memory_order_seq_cst);
+
+			bool result = false;
+			auto rangeIt
+				= std::upper_bound(currentRanges->begin(), currentRanges->end(), address, lessThan);
+			if(rangeIt != currentRanges->begin() && address < (rangeIt - 1)->end)
+			{
+				outValue = (rangeIt - 1)->value;
+				outBegin = (rangeIt - 1)->begin;
+				result = true;
+			}
+
+			--numActiveLookups;
+			return result;
+		}
+
+	private:
+		struct Range
+		{
+			Uptr begin;
+			Uptr end;
+			Value value;
+		};
+		typedef std::vector<Range> RangeArray;
+
+		Platform::Mutex writeMutex;
+		std::atomic<const RangeArray*> ranges;
+		mutable std::atomic<Uptr> numActiveLookups{0};
+		std::vector<const RangeArray*> retiredRangeArrays;
+
+		static bool lessThan(Uptr address, const Range& range) { return address < range.begin; }
+
+		void publish(const RangeArray* oldRanges, const RangeArray* newRanges)
+		{
+			ranges.store(newRanges, std::memory_order_seq_cst);
+			retiredRangeArrays.push_back(oldRanges);
+
+			// A lookup that starts after this point will see the new array, so if no lookups are in
+			// progress, none can be using a retired array.
+			if(numActiveLookups.load(std::memory_order_seq_cst) == 0)
+			{
+				for(const RangeArray* retiredRanges : retiredRangeArrays) { delete retiredRanges; }
+				retiredRangeArrays.clear();
+			}
+		}
+	};
+}}
@@ -9,8 +9,6 @@
 #include "WAVM/Inline/Assert.h"
 #include "WAVM/Inline/BasicTypes.h"
 #include "WAVM/Inline/Hash.h"
-#include "WAVM/Inline/HashMap.h"
-#include "WAVM/Platform/Clock.h"
 #include "WAVM/Platform/Event.h"
 #include "WAVM/Platform/Mutex.h"
 #include "WAVM/Runtime/Intrinsics.h"
@@ -24,60 +22,76 @@ namespace WAVM { namespace Runtime {
 	WAVM_DEFINE_INTRINSIC_MODULE(wavmIntrinsicsAtomics)
 }}
 
-// Holds a list of threads (in the form of events that will wake them) that
-// are waiting on a specific address.
-struct WaitList
+// A thread waiting on an address. Waiters live on the waiting thread's stack, and are linked into
+// the wait list of the shard that the address hashes to.
+struct Waiter
 {
-	Platform::Mutex mutex;
-	std::vector<Platform::Event*> wakeEvents;
-	std::atomic<Uptr> numReferences;
-
-	WaitList() : numReferences(1) {}
+	Uptr address;
+	Platform::Event* wakeEvent;
+	Waiter* next;
+	Waiter* prev;
+	bool isInWaitList;
 };
 
-// An event that is reused within a thread when it waits on a WaitList.
-thread_local std::unique_ptr<Platform::Event> threadWakeEvent = nullptr;
-
-// A map from address to a list of threads waiting on that address.
-static Platform::Mutex addressToWaitListMapMutex;
-static HashMap<Uptr, WaitList*> addressToWaitListMap;
+// The threads waiting on addresses are partitioned into shards by a hash of the address, so threads
+// waiting on unrelated addresses don't contend on the same mutex. Each shard has its own cache line
+// to avoid false sharing between them.
+static constexpr Uptr numWaitShardsLog2 = 8;
+static constexpr Uptr numWaitShards = Uptr(1) << numWaitShardsLog2;
 
-// Opens the wait list for a given address.
-// Increases the wait list's reference count, and returns a pointer to it.
-// Note that it does not lock the wait list mutex.
-// A call to openWaitList should be followed by a call to closeWaitList to avoid leaks.
-static WaitList* openWaitList(Uptr address)
+struct alignas(64) WaitShard
 {
-	Platform::Mutex::Lock mapLock(addressToWaitListMapMutex);
-	auto waitListPtr = addressToWaitListMap.get(address);
-	if(waitListPtr)
-	{
-		++(*waitListPtr)->numReferences;
-		return *waitListPtr;
-	}
-	else
+	Platform::Mutex mutex;
+
+	// A list of the threads waiting on addresses in this shard, ordered from oldest to newest.
+	Waiter* firstWaiter = nullptr;
+	Waiter* lastWaiter = nullptr;
+
+	// The number of threads that are waiting (or about to wait) on addresses in this shard. Notify
+	// reads it without locking the mutex to skip shards that don't have any waiters.
+	std::atomic<Uptr> numWaiters{0};
+
+	void addWaiter(Waiter* waiter)
 	{
-		WaitList* waitList = new WaitList();
-		addressToWaitListMap.set(address, waitList);
-		return waitList;
+		waiter->next = nullptr;
+		waiter->prev = lastWaiter;
+		if(lastWaiter) { lastWaiter->next = waiter; }
+		else
+		{
+			firstWaiter = waiter;
+		}
+		lastWaiter = waiter;
+		waiter->isInWaitList = true;
 	}
-}
 
-// Closes a wait list, deleting it and removing it from the global map if it was the last reference.
-static void closeWaitList(Uptr address, WaitList* waitList)
-{
-	if(--waitList->numReferences == 0)
+	void removeWaiter(Waiter* waiter)
 	{
-		Platform::Mutex::Lock mapLock(addressToWaitListMapMutex);
-		if(!waitList->numReferences)
+		WAVM_ASSERT(waiter->isInWaitList);
+		if(waiter->prev) { waiter->prev->next = waiter->next; }
+		else
 		{
-			WAVM_ASSERT(!waitList->wakeEvents.size());
-			delete waitList;
-			addressToWaitListMap.remove(address);
+			firstWaiter = waiter->next;
 		}
+		if(waiter->next) { waiter->next->prev = waiter->prev; }
+		else
+		{
+			lastWaiter = waiter->prev;
+		}
+		waiter->isInWaitList = false;
+		--numWaiters;
 	}
+};
+
+static WaitShard waitShards[numWaitShards];
+
+static WaitShard& getWaitShard(Uptr address)
+{
+	return waitShards[Hash<Uptr>()(address, 0) & (numWaitShards - 1)];
 }
 
+// An event that is reused within a thread when it waits on an address.
+thread_local std::unique_ptr<Platform::Event> threadWakeEvent = nullptr;
+
 // Loads a value from memory with seq_cst memory order.
 // The caller must ensure that the pointer is naturally aligned.
 template<typename Value> static Value atomicLoad(const Value* valuePointer)
@@ -99,98 +113,111 @@ template<typename Value> static void atomicStore(Value* valuePointer, Value newV
 template<typename Value>
 static U32 waitOnAddress(Value* valuePointer, Value expectedValue, I64 timeout)
 {
-	// Open the wait list for this address.
 	const Uptr address = reinterpret_cast<Uptr>(valuePointer);
-	WaitList* waitList = openWaitList(address);
+	WaitShard& shard = getWaitShard(address);
+
+	// If the thread hasn't yet created a wake event, do so.
+	if(!threadWakeEvent)
+	{ threadWakeEvent = std::unique_ptr<Platform::Event>(new Platform::Event()); }
 
-	// Lock the wait list, and check that *valuePointer is still what the caller expected it to be.
+	Waiter waiter;
+	waiter.address = address;
+	waiter.wakeEvent = threadWakeEvent.get();
+	waiter.isInWaitList = false;
+
+	// Lock the shard, and check that *valuePointer is still what the caller expected it to be.
 	{
-		Platform::Mutex::Lock waitListLock(waitList->mutex);
+		Platform::Mutex::Lock shardLock(shard.mutex);
+
+		// Count the waiter before loading the value: a thread that changes the value and then
+		// notifies either sees the waiter in numWaiters, or changed the value before it is loaded.
+		++shard.numWaiters;
 
 		// Use unwindSignalsAsExceptions to ensure that an access violation signal produced by the
 		// load will be thrown as a Runtime::Exception and unwind the stack (e.g. the locks).
 		Value value;
-		Runtime::unwindSignalsAsExceptions(
-			[valuePointer, &value] { value = atomicLoad(valuePointer); });
+		try
+		{
+			Runtime::unwindSignalsAsExceptions(
+				[valuePointer, &value] { value = atomicLoad(valuePointer); });
+		}
+		catch(Exception*)
+		{
+			--shard.numWaiters;
+			throw;
+		}
 
 		if(value != expectedValue)
 		{
-			// If *valuePointer wasn't the expected value, unlock the wait list and return.
-			waitListLock.unlock();
-			closeWaitList(address, waitList);
+			// If *valuePointer wasn't the expected value, return without waiting.
+			--shard.numWaiters;
 			return 1;
 		}
-		else
-		{
-			// If the thread hasn't yet created a wake event, do so.
-			if(!threadWakeEvent)
-			{ threadWakeEvent = std::unique_ptr<Platform::Event>(new Platform::Event()); }
 
-			// Add the wake event to the wait list, and unlock the wait list.
-			waitList->wakeEvents.push_back(threadWakeEvent.get());
-			waitListLock.unlock();
-		}
+		// Add the waiter to the shard's wait list, and unlock the shard.
+		shard.addWaiter(&waiter);
 	}
 
 	// Wait for the thread's wake event to be signaled.
-	bool timedOut = false;
 	if(!threadWakeEvent->wait(timeout < 0 ? Time::infinity() : Time{I128(timeout)}))
 	{
-		// If the wait timed out, lock the wait list and check if the thread's wake event is still
-		// in the wait list.
-		Platform::Mutex::Lock waitListLock(waitList->mutex);
-		auto wakeEventIt = std::find(
-			waitList->wakeEvents.begin(), waitList->wakeEvents.end(), threadWakeEvent.get());
-		if(wakeEventIt != waitList->wakeEvents.end())
+		// If the wait timed out, lock the shard and check if the waiter is still in the wait list.
+		Platform::Mutex::Lock shardLock(shard.mutex);
+		if(waiter.isInWaitList)
 		{
-			// If the event was still on the wait list, remove it, and return the "timed out"
+			// If the waiter was still in the wait list, remove it, and return the "timed out"
 			// result.
-			waitList->wakeEvents.erase(wakeEventIt);
-			timedOut = true;
+			shard.removeWaiter(&waiter);
+			return 2;
 		}
 		else
 		{
-			// In between the wait timing out and locking the wait list, some other thread tried to
-			// wake this thread. The event will now be signaled, so use an immediately expiring wait
-			// on it to reset it.
-			WAVM_ERROR_UNLESS(
-				threadWakeEvent->wait(Platform::getClockTime(Platform::Clock::monotonic)));
+			// In between the wait timing out and locking the shard, some other thread tried to
+			// wake this thread. Use an immediately expiring wait on the event to reset it if the
+			// wake left it signaled. Events that don't latch a signal delivered before the wait
+			// (the pthread condition variable implementation) will return false here, which just
+			// means there's no pending wake to consume.
+			threadWakeEvent->wait(Time{0});
 		}
 	}
 
-	closeWaitList(address, waitList);
-	return timedOut ? 2 : 0;
+	WAVM_ASSERT(!waiter.isInWaitList);
+	return 0;
 }
 
 static U32 wakeAddress(void* pointer, U32 numToWake)
 {
 	if(numToWake == 0) { return 0; }
 
-	// Open the wait list for this address.
+	// If there aren't any threads waiting on addresses in the shard, there's nothing to wake.
 	const Uptr address = reinterpret_cast<Uptr>(pointer);
-	WaitList* waitList = openWaitList(address);
-	Uptr actualNumToWake = numToWake;
-	{
-		Platform::Mutex::Lock waitListLock(waitList->mutex);
+	WaitShard& shard = getWaitShard(address);
+	if(!shard.numWaiters.load(std::memory_order_seq_cst)) { return 0; }
 
-		// Determine how many threads to wake.
-		// numToWake==UINT32_MAX means wake all waiting threads.
-		if(actualNumToWake == UINT32_MAX || actualNumToWake > waitList->wakeEvents.size())
-		{ actualNumToWake = waitList->wakeEvents.size(); }
-
-		// Signal the events corresponding to the oldest waiting threads.
-		for(Uptr wakeIndex = 0; wakeIndex < actualNumToWake; ++wakeIndex)
-		{ waitList->wakeEvents[wakeIndex]->signal(); }
-
-		// Remove the events from the wait list.
-		waitList->wakeEvents.erase(waitList->wakeEvents.begin(),
-								   waitList->wakeEvents.begin() + actualNumToWake);
+	// Wake the oldest threads waiting on the address. numToWake==UINT32_MAX means wake all waiting
+	// threads.
+	Uptr numWoken = 0;
+	{
+		Platform::Mutex::Lock shardLock(shard.mutex);
+		Waiter* waiter = shard.firstWaiter;
+		while(waiter && (numToWake == UINT32_MAX || numWoken < numToWake))
+		{
+			Waiter* nextWaiter = waiter->next;
+			if(waiter->address == address)
+			{
+				// Remove the waiter from the wait list before signaling its event: once it's
+				// signaled, the waiting thread may return and free the waiter.
+				Platform::Event* wakeEvent = waiter->wakeEvent;
+				shard.removeWaiter(waiter);
+				wakeEvent->signal();
+				++numWoken;
+			}
+			waiter = nextWaiter;
+		}
 	}
-	closeWaitList(address, waitList);
 
-	if(actualNumToWake > UINT32_MAX)
-	{ throwException(ExceptionTypes::integerDivideByZeroOrOverflow); }
-	return U32(actualNumToWake);
+	if(numWoken > UINT32_MAX) { throwException(ExceptionTypes::integerDivideByZeroOrOverflow); }
+	return U32(numWoken);
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(wavmIntrinsicsAtomics,
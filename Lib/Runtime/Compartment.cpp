@@ -65,7 +65,9 @@ Compartment* Runtime::createCompartment(std::string&& debugName)
 	return new Compartment(std::move(debugName));
 }
 
-Compartment* Runtime::cloneCompartment(const Compartment* compartment, std::string&& debugName, bool copyMemoryContents)
+Compartment* Runtime::cloneCompartment(const Compartment* compartment,
+									   std::string&& debugName,
+									   MemoryCloneMode memoryCloneMode)
 {
 	Timing::Timer timer;
 
@@ -82,7 +84,7 @@ Compartment* Runtime::cloneCompartment(const Compartment* compartment, std::stri
 	// Clone memories.
 	for(Memory* memory : compartment->memories)
 	{
-		Memory* newMemory = cloneMemory(memory, newCompartment, copyMemoryContents);
+		Memory* newMemory = cloneMemory(memory, newCompartment, memoryCloneMode);
 		WAVM_ASSERT(newMemory->id == memory->id);
 	}
 
@@ -190,8 +192,8 @@ bool Runtime::isInCompartment(const Object* object, const Compartment* compartme
 	if(object->kind == ObjectKind::function)
 	{
 		// The function may be in multiple compartments, but if this compartment maps the function's
-		// instanceId to a Instance with the LLVMJIT LoadedModule that contains this
-		// function, then the function is in this compartment.
+		// instanceId to a Instance that defines the function with its ForwardingFunctions, or with
+		// the LLVMJIT LoadedModule that contains it, then the function is in this compartment.
 		Function* function = (Function*)object;
 
 		// Treat functions with instanceId=UINTPTR_MAX as if they are in all compartments.
@@ -200,7 +202,10 @@ bool Runtime::isInCompartment(const Object* object, const Compartment* compartme
 		Platform::RWMutex::ShareableLock compartmentLock(compartment->mutex);
 		if(!compartment->instances.contains(function->instanceId)) { return false; }
 		Instance* instance = compartment->instances[function->instanceId];
-		return instance->jitModule.get() == function->mutableData->jitModule;
+		if(instance->forwardingFunctions)
+		{ return instance->forwardingFunctions->contains(function); }
+		return instance->jitModule.get() == function->mutableData->jitModule
+			   && function->mutableData->function == function;
 	}
 	else
 	{
@@ -4,7 +4,9 @@
 #include "RuntimePrivate.h"
 #include "WAVM/Inline/Assert.h"
 #include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Inline/DenseStaticIntSet.h"
 #include "WAVM/Platform/Memory.h"
+#include "WAVM/Platform/Mutex.h"
 #include "WAVM/Platform/RWMutex.h"
 #include "WAVM/Runtime/Runtime.h"
 #include "WAVM/RuntimeABI/RuntimeABI.h"
@@ -12,10 +14,52 @@
 using namespace WAVM;
 using namespace WAVM::Runtime;
 
+// The maximum number of collected contexts that a compartment keeps for reuse by createContext.
+static constexpr Uptr maxPooledContexts = 64;
+
+// Initializes a context's mutable globals with the compartment's initial values. Only the mutable
+// globals that have been allocated are copied: the others are zeroed when they are allocated.
+// Must be called with the compartment's mutex locked.
+static void initContextMutableGlobals(Compartment* compartment, Context* context)
+{
+	DenseStaticIntSet<U32, maxMutableGlobals> remainingMutableGlobals
+		= compartment->globalDataAllocationMask;
+	for(U32 mutableGlobalIndex = remainingMutableGlobals.getSmallestMember();
+		mutableGlobalIndex != maxMutableGlobals;
+		mutableGlobalIndex = remainingMutableGlobals.getSmallestMember())
+	{
+		context->runtimeData->mutableGlobals[mutableGlobalIndex]
+			= compartment->initialContextMutableGlobals[mutableGlobalIndex];
+		remainingMutableGlobals.remove(mutableGlobalIndex);
+	}
+}
+
 Context* Runtime::createContext(Compartment* compartment, std::string&& debugName)
 {
 	WAVM_ASSERT(compartment);
-	Context* context = new Context(compartment, std::move(debugName));
+
+	// Reuse a pooled context if possible. Its ID and runtime data are still allocated, so it only
+	// needs its mutable globals reset, which doesn't need the compartment to be exclusively locked.
+	Context* context = nullptr;
+	{
+		Platform::Mutex::Lock contextPoolLock(compartment->contextPoolMutex);
+		if(compartment->contextPool.size())
+		{
+			context = compartment->contextPool.back();
+			compartment->contextPool.pop_back();
+			context->isPooled = false;
+		}
+	}
+	if(context)
+	{
+		context->debugName = std::move(debugName);
+
+		Platform::RWMutex::ShareableLock compartmentLock(compartment->mutex);
+		initContextMutableGlobals(compartment, context);
+		return context;
+	}
+
+	context = new Context(compartment, std::move(debugName));
 	{
 		Platform::RWMutex::ExclusiveLock lock(compartment->mutex);
 
@@ -35,9 +79,7 @@ Context* Runtime::createContext(Compartment* compartment, std::string&& debugNam
 		Platform::registerVirtualAllocation(sizeof(ContextRuntimeData));
 
 		// Initialize the context's global data.
-		memcpy(context->runtimeData->mutableGlobals,
-			   compartment->initialContextMutableGlobals,
-			   maxMutableGlobals * sizeof(IR::UntaggedValue));
+		initContextMutableGlobals(compartment, context);
 
 		context->runtimeData->context = context;
 	}
@@ -45,6 +87,23 @@ Context* Runtime::createContext(Compartment* compartment, std::string&& debugNam
 	return context;
 }
 
+bool Runtime::tryPoolContext(Context* context)
+{
+	Compartment* compartment = context->compartment;
+	WAVM_ASSERT_RWMUTEX_IS_EXCLUSIVELY_LOCKED_BY_CURRENT_THREAD(compartment->mutex);
+	WAVM_ASSERT(!context->isPooled);
+	if(compartment->contextPool.size() >= maxPooledContexts) { return false; }
+
+	// Finalize the context's user data as if it was deleted.
+	if(context->finalizeUserData) { (*context->finalizeUserData)(context->userData); }
+	context->userData = nullptr;
+	context->finalizeUserData = nullptr;
+
+	context->isPooled = true;
+	compartment->contextPool.push_back(context);
+	return true;
+}
+
 Runtime::Context::~Context()
 {
 	WAVM_ASSERT_RWMUTEX_IS_EXCLUSIVELY_LOCKED_BY_CURRENT_THREAD(compartment->mutex);
@@ -168,6 +168,28 @@ IR::TypeTuple Runtime::getExceptionTypeParameters(const ExceptionType* type)
 	return type->sig.params;
 }
 
+// Exceptions with few enough arguments are allocated as fixed-size blocks that are recycled
+// through a per-thread freelist, so code that traps or throws frequently doesn't pay for a malloc
+// and free per exception.
+static constexpr Uptr maxFreelistExceptionArguments = 4;
+static constexpr Uptr maxFreelistExceptions = 16;
+
+struct ExceptionFreelist
+{
+	void* blocks[maxFreelistExceptions];
+	Uptr numBlocks = 0;
+	bool isDestroyed = false;
+
+	~ExceptionFreelist()
+	{
+		for(Uptr blockIndex = 0; blockIndex < numBlocks; ++blockIndex) { free(blocks[blockIndex]); }
+		numBlocks = 0;
+		isDestroyed = true;
+	}
+};
+
+static thread_local ExceptionFreelist exceptionFreelist;
+
 Exception* Runtime::createException(ExceptionType* type,
 									const IR::UntaggedValue* arguments,
 									Uptr numArguments,
@@ -176,9 +198,20 @@ Exception* Runtime::createException(ExceptionType* type,
 	const IR::TypeTuple& params = type->sig.params;
 	WAVM_ASSERT(numArguments == params.size());
 
+	const bool isFromFreelist = params.size() <= maxFreelistExceptionArguments;
+	void* memory;
+	if(isFromFreelist && exceptionFreelist.numBlocks)
+	{ memory = exceptionFreelist.blocks[--exceptionFreelist.numBlocks]; }
+	else
+	{
+		memory = malloc(Exception::calcNumBytes(isFromFreelist ? maxFreelistExceptionArguments
+															   : params.size()));
+	}
+
 	const bool isUserException = type->compartment != nullptr;
-	Exception* exception = new(malloc(Exception::calcNumBytes(params.size())))
-		Exception(type->id, type, isUserException, std::move(callStack));
+	Exception* exception
+		= new(memory) Exception(type->id, type, isUserException, std::move(callStack));
+	exception->isFromFreelist = isFromFreelist ? 1 : 0;
 	if(params.size())
 	{ memcpy(exception->arguments, arguments, sizeof(IR::UntaggedValue) * params.size()); }
 	return exception;
@@ -186,8 +219,18 @@ Exception* Runtime::createException(ExceptionType* type,
 
 void Runtime::destroyException(Exception* exception)
 {
+	const bool isFromFreelist = exception->isFromFreelist != 0;
 	exception->~Exception();
-	free(exception);
+
+	// The exception may be destroyed on a different thread than it was created on, or after the
+	// thread's freelist was destroyed, so only recycle it if this thread's freelist has room.
+	if(isFromFreelist && !exceptionFreelist.isDestroyed
+	   && exceptionFreelist.numBlocks < maxFreelistExceptions)
+	{ exceptionFreelist.blocks[exceptionFreelist.numBlocks++] = exception; }
+	else
+	{
+		free(exception);
+	}
 }
 
 ExceptionType* Runtime::getExceptionType(const Exception* exception) { return exception->type; }
@@ -271,8 +314,8 @@ std::string Runtime::describeException(const Exception* exception)
 										  const std::vector<IR::UntaggedValue>& arguments)
 {
 	WAVM_ASSERT(type->sig.params.size() == arguments.size());
-	throwException(
-		createException(type, arguments.data(), arguments.size(), Platform::captureCallStack(1)));
+	throwException(createException(
+		type, arguments.data(), arguments.size(), Platform::captureCallStackWithPolicy(1)));
 }
 
 WAVM_DEFINE_INTRINSIC_FUNCTION(wavmIntrinsicsException,
@@ -291,8 +334,10 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wavmIntrinsicsException,
 	}
 	auto args = reinterpret_cast<const IR::UntaggedValue*>(Uptr(argsBits));
 
-	Exception* exception = createException(
-		exceptionType, args, exceptionType->sig.params.size(), Platform::captureCallStack(1));
+	Exception* exception = createException(exceptionType,
+										   args,
+										   exceptionType->sig.params.size(),
+										   Platform::captureCallStackWithPolicy(1));
 
 	return reinterpret_cast<Uptr>(exception);
 }
@@ -1,4 +1,9 @@
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
 #include <memory>
+#include <new>
 #include <utility>
 #include "RuntimePrivate.h"
 #include "WAVM/IR/IR.h"
@@ -11,8 +16,12 @@
 #include "WAVM/Inline/HashMap.h"
 #include "WAVM/Inline/Timing.h"
 #include "WAVM/LLVMJIT/LLVMJIT.h"
+#include "WAVM/Logging/Logging.h"
 #include "WAVM/Platform/Intrinsic.h"
+#include "WAVM/Platform/Memory.h"
+#include "WAVM/Platform/Mutex.h"
 #include "WAVM/Platform/RWMutex.h"
+#include "WAVM/Platform/Thread.h"
 #include "WAVM/Runtime/Runtime.h"
 #include "WAVM/WASM/WASM.h"
 
@@ -50,6 +59,22 @@ static Value evaluateInitializer(const std::vector<Global*>& moduleGlobals,
 	};
 }
 
+HashMap<std::string, LLVMJIT::FunctionBinding> Runtime::getWAVMIntrinsicsExportMap()
+{
+	HashMap<std::string, LLVMJIT::FunctionBinding> wavmIntrinsicsExportMap;
+	for(const HashMapPair<std::string, Intrinsics::Function*>& intrinsicFunctionPair :
+		Intrinsics::getUninstantiatedFunctions({WAVM_INTRINSIC_MODULE_REF(wavmIntrinsics),
+												WAVM_INTRINSIC_MODULE_REF(wavmIntrinsicsAtomics),
+												WAVM_INTRINSIC_MODULE_REF(wavmIntrinsicsException),
+												WAVM_INTRINSIC_MODULE_REF(wavmIntrinsicsMemory),
+												WAVM_INTRINSIC_MODULE_REF(wavmIntrinsicsTable)}))
+	{
+		LLVMJIT::FunctionBinding functionBinding{intrinsicFunctionPair.value->getNativeFunction()};
+		wavmIntrinsicsExportMap.add(intrinsicFunctionPair.key, functionBinding);
+	}
+	return wavmIntrinsicsExportMap;
+}
+
 Instance::~Instance()
 {
 	if(id != UINTPTR_MAX)
@@ -59,18 +84,120 @@ Instance::~Instance()
 	}
 }
 
-Instance* Runtime::instantiateModule(Compartment* compartment,
-									 ModuleConstRefParam module,
-									 ImportBindings&& imports,
-									 std::string&& moduleDebugName,
-									 ResourceQuotaRefParam resourceQuota)
+// The machine code of a function that forwards calls to another function: it jumps to the absolute
+// address that follows it. Loaded code can only be shared between instances on architectures that
+// have it, since each instance needs its own Function objects.
+#if defined(__x86_64__) || defined(_M_X64)
+#define CAN_SHARE_LOADED_CODE 1
+static const U8 forwardingCode[] = {0xff, 0x25, 0x00, 0x00, 0x00, 0x00}; // jmp [rip + 0]
+#elif defined(__aarch64__)
+#define CAN_SHARE_LOADED_CODE 1
+static const U8 forwardingCode[] = {
+	0x50, 0x00, 0x00, 0x58, // ldr x16, #8
+	0x00, 0x02, 0x1f, 0xd6, // br x16
+};
+#else
+#define CAN_SHARE_LOADED_CODE 0
+#endif
+
+ForwardingFunctions::~ForwardingFunctions()
+{
+	for(Function* function : functions) { delete function->mutableData; }
+	if(finalizeBoundData) { (*finalizeBoundData)(boundData); }
+	if(pages) { Platform::freeVirtualPages(pages, numPages); }
+}
+
+#if CAN_SHARE_LOADED_CODE
+// Creates Function objects for an instance's function definitions that forward calls to the
+// functions in the loaded code. Returns null if there isn't enough memory.
+static std::shared_ptr<ForwardingFunctions> createForwardingFunctions(
+	const LoadedJITModule& loadedJITModule,
+	std::vector<std::string>&& functionDefDebugNames)
+{
+	static constexpr Uptr numCodeBytes = sizeof(forwardingCode) + sizeof(Uptr);
+	static constexpr Uptr numFunctionBytes = (offsetof(Function, code) + numCodeBytes + 15) & ~15;
+
+	const Uptr numFunctions = loadedJITModule.functionDefs.size();
+	const Uptr numPages = (numFunctions * numFunctionBytes + Platform::getBytesPerPage() - 1)
+						  >> Platform::getBytesPerPageLog2();
+	U8* pages = nullptr;
+	if(numPages)
+	{
+		pages = Platform::allocateVirtualPages(numPages);
+		if(!pages) { return nullptr; }
+		if(!Platform::commitVirtualPages(pages, numPages))
+		{
+			Platform::freeVirtualPages(pages, numPages);
+			return nullptr;
+		}
+	}
+
+	auto forwardingFunctions = std::make_shared<ForwardingFunctions>(pages, numPages);
+	for(Uptr functionDefIndex = 0; functionDefIndex < numFunctions; ++functionDefIndex)
+	{
+		Function* sharedFunction = loadedJITModule.functionDefs[functionDefIndex];
+
+		FunctionMutableData* functionMutableData
+			= new FunctionMutableData(std::move(functionDefDebugNames[functionDefIndex]));
+		functionMutableData->jitModule = sharedFunction->mutableData->jitModule;
+		functionMutableData->function = sharedFunction;
+		functionMutableData->numCodeBytes = numCodeBytes;
+
+		U8* functionBytes = pages + functionDefIndex * numFunctionBytes;
+		Function* function = new(functionBytes) Function(
+			functionMutableData, sharedFunction->instanceId, sharedFunction->encodedType);
+		forwardingFunctions->functions.push_back(function);
+
+		U8* code = functionBytes + offsetof(Function, code);
+		const Uptr sharedCodeAddress = reinterpret_cast<Uptr>(sharedFunction->code);
+		memcpy(code, forwardingCode, sizeof(forwardingCode));
+		memcpy(code + sizeof(forwardingCode), &sharedCodeAddress, sizeof(Uptr));
+	}
+
+	if(numPages)
+	{
+#if defined(__aarch64__)
+		__builtin___clear_cache(reinterpret_cast<char*>(pages),
+								reinterpret_cast<char*>(pages + numFunctions * numFunctionBytes));
+#endif
+		WAVM_ERROR_UNLESS(
+			Platform::setVirtualPageAccess(pages, numPages, Platform::MemoryAccess::readExecute));
+	}
+
+	return forwardingFunctions;
+}
+#endif
+
+// Returns the code that calls to a function run. For a function that forwards calls to a function
+// in loaded code, that's the loaded function's code.
+static const void* getForwardedCode(const Function* function)
+{
+	const Function* codeFunction = function->mutableData->function;
+	return codeFunction ? codeFunction->code : function->code;
+}
+
+// The objects bound to a module's imports, split up by kind.
+struct ResolvedImports
 {
-	// Check the types of the Instance's imports, and build per-kind import arrays.
 	std::vector<FunctionImportBinding> functionImports;
 	std::vector<Table*> tableImports;
 	std::vector<Memory*> memoryImports;
 	std::vector<Global*> globalImports;
-	std::vector<ExceptionType*> exceptionTypeImports;
+	std::vector<Runtime::ExceptionType*> exceptionTypeImports;
+};
+
+// Checks the types of the Instance's imports, and builds per-kind import arrays.
+static ResolvedImports resolveImports(Compartment* compartment,
+									  ModuleConstRefParam module,
+									  const ImportBindings& imports)
+{
+	ResolvedImports resolvedImports;
+	std::vector<FunctionImportBinding>& functionImports = resolvedImports.functionImports;
+	std::vector<Table*>& tableImports = resolvedImports.tableImports;
+	std::vector<Memory*>& memoryImports = resolvedImports.memoryImports;
+	std::vector<Global*>& globalImports = resolvedImports.globalImports;
+	std::vector<Runtime::ExceptionType*>& exceptionTypeImports
+		= resolvedImports.exceptionTypeImports;
 	WAVM_ERROR_UNLESS(imports.size() == module->ir.imports.size());
 	for(Uptr importIndex = 0; importIndex < imports.size(); ++importIndex)
 	{
@@ -112,7 +239,7 @@ Instance* Runtime::instantiateModule(Compartment* compartment,
 			break;
 		}
 		case ExternKind::exceptionType: {
-			ExceptionType* exceptionType = asExceptionType(importObject);
+			Runtime::ExceptionType* exceptionType = asExceptionType(importObject);
 			WAVM_ERROR_UNLESS(isSubtype(exceptionType->sig.params,
 										module->ir.exceptionTypes.getType(kindIndex.index).params));
 			exceptionTypeImports.push_back(exceptionType);
@@ -124,26 +251,42 @@ Instance* Runtime::instantiateModule(Compartment* compartment,
 		};
 	}
 
+	return resolvedImports;
+}
+
+Instance* Runtime::instantiateModule(Compartment* compartment,
+									 ModuleConstRefParam module,
+									 ImportBindings&& imports,
+									 std::string&& moduleDebugName,
+									 ResourceQuotaRefParam resourceQuota)
+{
+	ResolvedImports resolvedImports = resolveImports(compartment, module, imports);
 	return instantiateModuleInternal(compartment,
 									 module,
-									 std::move(functionImports),
-									 std::move(tableImports),
-									 std::move(memoryImports),
-									 std::move(globalImports),
-									 std::move(exceptionTypeImports),
+									 std::move(resolvedImports.functionImports),
+									 std::move(resolvedImports.tableImports),
+									 std::move(resolvedImports.memoryImports),
+									 std::move(resolvedImports.globalImports),
+									 std::move(resolvedImports.exceptionTypeImports),
 									 std::move(moduleDebugName),
 									 resourceQuota);
 }
 
-Instance* Runtime::instantiateModuleInternal(Compartment* compartment,
-											 ModuleConstRefParam module,
-											 std::vector<FunctionImportBinding>&& functionImports,
-											 std::vector<Table*>&& tables,
-											 std::vector<Memory*>&& memories,
-											 std::vector<Global*>&& globals,
-											 std::vector<ExceptionType*>&& exceptionTypes,
-											 std::string&& moduleDebugName,
-											 ResourceQuotaRefParam resourceQuota)
+// Creates an instance of a module with a reserved instance ID, but doesn't initialize its active
+// data and elem segments.
+static Instance* createInstance(
+	Compartment* compartment,
+	ModuleConstRefParam module,
+	Uptr id,
+	std::vector<FunctionImportBinding>&& functionImports,
+	std::vector<Table*>&& tables,
+	std::vector<Memory*>&& memories,
+	std::vector<Global*>&& globals,
+	std::vector<Runtime::ExceptionType*>&& exceptionTypes,
+	std::string&& moduleDebugName,
+	ResourceQuotaRefParam resourceQuota,
+	const DisassemblyNames& disassemblyNames,
+	const HashMap<std::string, LLVMJIT::FunctionBinding>& wavmIntrinsicsExportMap)
 {
 	WAVM_ASSERT(functionImports.size() == module->ir.functions.imports.size());
 	WAVM_ASSERT(tables.size() == module->ir.tables.imports.size());
@@ -151,17 +294,6 @@ Instance* Runtime::instantiateModuleInternal(Compartment* compartment,
 	WAVM_ASSERT(globals.size() == module->ir.globals.imports.size());
 	WAVM_ASSERT(exceptionTypes.size() == module->ir.exceptionTypes.imports.size());
 
-	Uptr id = UINTPTR_MAX;
-	{
-		Platform::RWMutex::ExclusiveLock compartmentLock(compartment->mutex);
-		id = compartment->instances.add(UINTPTR_MAX, nullptr);
-	}
-	if(id == UINTPTR_MAX) { return nullptr; }
-
-	// Deserialize the disassembly names.
-	DisassemblyNames disassemblyNames;
-	getDisassemblyNames(module->ir, disassemblyNames);
-
 	// Instantiate the module's memory and table definitions.
 	for(Uptr tableDefIndex = 0; tableDefIndex < module->ir.tables.defs.size(); ++tableDefIndex)
 	{
@@ -184,10 +316,11 @@ Instance* Runtime::instantiateModuleInternal(Compartment* compartment,
 	{
 		std::string debugName
 			= disassemblyNames.memories[module->ir.memories.imports.size() + memoryDefIndex];
-		auto memory = createMemory(compartment,
-								   module->ir.memories.defs[memoryDefIndex].type,
-								   std::move(debugName),
-								   resourceQuota);
+		auto memory = createMemoryInternal(compartment,
+										   module->ir.memories.defs[memoryDefIndex].type,
+										   std::move(debugName),
+										   resourceQuota,
+										   module->boundsCheckMemoryAccesses);
 		if(!memory)
 		{
 			Platform::RWMutex::ExclusiveLock compartmentLock(compartment->mutex);
@@ -231,97 +364,204 @@ Instance* Runtime::instantiateModuleInternal(Compartment* compartment,
 			createExceptionType(compartment, exceptionTypeDef.type, std::move(debugName)));
 	}
 
-	// Set up the values to bind to the symbols in the LLVMJIT object code.
-	HashMap<std::string, LLVMJIT::FunctionBinding> wavmIntrinsicsExportMap;
-	for(const HashMapPair<std::string, Intrinsics::Function*>& intrinsicFunctionPair :
-		Intrinsics::getUninstantiatedFunctions({WAVM_INTRINSIC_MODULE_REF(wavmIntrinsics),
-												WAVM_INTRINSIC_MODULE_REF(wavmIntrinsicsAtomics),
-												WAVM_INTRINSIC_MODULE_REF(wavmIntrinsicsException),
-												WAVM_INTRINSIC_MODULE_REF(wavmIntrinsicsMemory),
-												WAVM_INTRINSIC_MODULE_REF(wavmIntrinsicsTable)}))
+	// Build a key from the values that will be bound to the symbols in the LLVMJIT object code.
+	// The bindings only depend on compartment-relative IDs, the code of imported functions, and the
+	// values of immutable globals, so the same module instantiated the same way in different
+	// compartments has the same key, and can share the loaded object code.
+	std::vector<Uptr> bindingKey;
+	bindingKey.push_back(id);
+	for(Uptr importIndex = 0; importIndex < module->ir.functions.imports.size(); ++importIndex)
 	{
-		LLVMJIT::FunctionBinding functionBinding{intrinsicFunctionPair.value->getNativeFunction()};
-		wavmIntrinsicsExportMap.add(intrinsicFunctionPair.key, functionBinding);
+		const FunctionType functionType
+			= module->ir.types[module->ir.functions.imports[importIndex].type.index];
+		const FunctionImportBinding& functionImport = functionImports[importIndex];
+		bindingKey.push_back(functionType.callingConvention() == CallingConvention::wasm
+								 ? reinterpret_cast<Uptr>(getForwardedCode(functionImport.wasmFunction))
+								 : reinterpret_cast<Uptr>(functionImport.nativeFunction));
+	}
+	for(Table* table : tables) { bindingKey.push_back(table->id); }
+	for(Memory* memory : memories) { bindingKey.push_back(memory->id); }
+	for(Uptr globalIndex = 0; globalIndex < globals.size(); ++globalIndex)
+	{
+		const Global* global = globals[globalIndex];
+		if(global->type.isMutable) { bindingKey.push_back(global->mutableGlobalIndex); }
+		else if(globalIndex >= module->ir.globals.imports.size()
+				&& module->ir.globals.defs[globalIndex - module->ir.globals.imports.size()]
+						   .initializer.type
+					   == InitializerExpression::Type::ref_func)
+		{
+			// The value of a (ref.func ...) initializer is one of the instance's functions, which
+			// the loaded code looks up through the instance.
+			bindingKey.push_back(UINTPTR_MAX);
+		}
+		else
+		{
+			Uptr valueWords[sizeof(UntaggedValue) / sizeof(Uptr)] = {0};
+			memcpy(valueWords, global->initialValue.bytes, getTypeByteWidth(global->type.valueType));
+			bindingKey.insert(bindingKey.end(), std::begin(valueWords), std::end(valueWords));
+		}
 	}
+	for(Runtime::ExceptionType* exceptionType : exceptionTypes)
+	{ bindingKey.push_back(exceptionType->id); }
+
+	// Name the module's function definitions.
+	std::vector<std::string> functionDefDebugNames;
+	for(Uptr functionDefIndex = 0; functionDefIndex < module->ir.functions.defs.size();
+		++functionDefIndex)
+	{
+		std::string debugName
+			= disassemblyNames.functions[module->ir.functions.imports.size() + functionDefIndex].name;
+		if(!debugName.size()) { debugName = "<function #" + std::to_string(functionDefIndex) + ">"; }
+		functionDefDebugNames.push_back("wasm!" + moduleDebugName + '!' + debugName);
+	}
+
+	// Look for object code that was already loaded with the same bindings.
+	std::shared_ptr<LoadedJITModule> loadedJITModule;
+#if CAN_SHARE_LOADED_CODE
+	{
+		Platform::Mutex::Lock loadedJITModulesLock(module->loadedJITModulesMutex);
+		if(const std::weak_ptr<LoadedJITModule>* weakLoadedJITModule
+		   = module->loadedJITModules.get(bindingKey))
+		{ loadedJITModule = weakLoadedJITModule->lock(); }
+	}
+#endif
 
 	std::vector<Function*> functions;
-	std::vector<LLVMJIT::FunctionBinding> jitFunctionImports;
 	for(Uptr importIndex = 0; importIndex < module->ir.functions.imports.size(); ++importIndex)
 	{
 		const FunctionType functionType
 			= module->ir.types[module->ir.functions.imports[importIndex].type.index];
-		if(functionType.callingConvention() == CallingConvention::wasm)
+		functions.push_back(functionType.callingConvention() == CallingConvention::wasm
+								? functionImports[importIndex].wasmFunction
+								: nullptr);
+	}
+
+	if(!loadedJITModule)
+	{
+		loadedJITModule = std::make_shared<LoadedJITModule>();
+		loadedJITModule->module = module;
+		loadedJITModule->debugName = moduleDebugName;
+		loadedJITModule->instanceId = id;
+
+		// Set up the values to bind to the symbols in the LLVMJIT object code.
+		std::vector<LLVMJIT::FunctionBinding> jitFunctionImports;
+		for(Uptr importIndex = 0; importIndex < module->ir.functions.imports.size(); ++importIndex)
 		{
-			functions.push_back(functionImports[importIndex].wasmFunction);
-			jitFunctionImports.push_back({functionImports[importIndex].wasmFunction->code});
+			if(functions[importIndex])
+			{ jitFunctionImports.push_back({getForwardedCode(functions[importIndex])}); }
+			else
+			{
+				jitFunctionImports.push_back({functionImports[importIndex].nativeFunction});
+			}
 		}
-		else
+
+		std::vector<LLVMJIT::TableBinding> jitTables;
+		for(Table* table : tables) { jitTables.push_back({table->id}); }
+
+		std::vector<LLVMJIT::MemoryBinding> jitMemories;
+		for(Memory* memory : memories) { jitMemories.push_back({memory->id}); }
+
+		// Bind immutable globals to a copy of their value owned by the LoadedJITModule, so the
+		// loaded code doesn't reference this instance's Global objects.
+		loadedJITModule->immutableGlobalValues.resize(globals.size());
+		std::vector<LLVMJIT::GlobalBinding> jitGlobals;
+		for(Uptr globalIndex = 0; globalIndex < globals.size(); ++globalIndex)
 		{
-			functions.push_back(nullptr);
-			jitFunctionImports.push_back({functionImports[importIndex].nativeFunction});
+			const Global* global = globals[globalIndex];
+			LLVMJIT::GlobalBinding globalSpec;
+			globalSpec.type = global->type;
+			if(global->type.isMutable)
+			{ globalSpec.mutableGlobalIndex = global->mutableGlobalIndex; }
+			else
+			{
+				loadedJITModule->immutableGlobalValues[globalIndex] = global->initialValue;
+				globalSpec.immutableValuePointer
+					= &loadedJITModule->immutableGlobalValues[globalIndex];
+			}
+			jitGlobals.push_back(globalSpec);
 		}
-	}
 
-	std::vector<LLVMJIT::TableBinding> jitTables;
-	for(Table* table : tables) { jitTables.push_back({table->id}); }
+		std::vector<LLVMJIT::ExceptionTypeBinding> jitExceptionTypes;
+		for(Runtime::ExceptionType* exceptionType : exceptionTypes)
+		{ jitExceptionTypes.push_back({exceptionType->id}); }
 
-	std::vector<LLVMJIT::MemoryBinding> jitMemories;
-	for(Memory* memory : memories) { jitMemories.push_back({memory->id}); }
+		// Keep a copy of the bindings, so optimized code for baseline tier functions can be loaded
+		// with the same bindings.
+		loadedJITModule->functionImportBindings = jitFunctionImports;
+		loadedJITModule->tableBindings = jitTables;
+		loadedJITModule->memoryBindings = jitMemories;
+		loadedJITModule->globalBindings = jitGlobals;
+		loadedJITModule->exceptionTypeBindings = jitExceptionTypes;
 
-	std::vector<LLVMJIT::GlobalBinding> jitGlobals;
-	for(Global* global : globals)
-	{
-		LLVMJIT::GlobalBinding globalSpec;
-		globalSpec.type = global->type;
-		if(global->type.isMutable) { globalSpec.mutableGlobalIndex = global->mutableGlobalIndex; }
-		else
+		// Create a FunctionMutableData for each function definition.
+		const U32 numCallsToTierUp = getNumCallsToTierUp();
+		std::vector<FunctionMutableData*> functionDefMutableDatas;
+		for(Uptr functionDefIndex = 0; functionDefIndex < module->ir.functions.defs.size();
+			++functionDefIndex)
 		{
-			globalSpec.immutableValuePointer = &global->initialValue;
+			FunctionMutableData* functionMutableData
+				= new FunctionMutableData(std::string(functionDefDebugNames[functionDefIndex]));
+			functionMutableData->tierUp.numCallsUntilTierUp.store(numCallsToTierUp,
+																  std::memory_order_relaxed);
+			functionDefMutableDatas.push_back(functionMutableData);
 		}
-		jitGlobals.push_back(globalSpec);
-	}
 
-	std::vector<LLVMJIT::ExceptionTypeBinding> jitExceptionTypes;
-	for(ExceptionType* exceptionType : exceptionTypes)
-	{ jitExceptionTypes.push_back({exceptionType->id}); }
+		// Load the compiled module's object code with this instance's imports.
+		std::vector<FunctionType> jitTypes = module->ir.types;
+		loadedJITModule->jitModule
+			= LLVMJIT::loadModule(module->objectCode->bytes,
+								  module->objectCode->numBytes,
+								  HashMap<std::string, LLVMJIT::FunctionBinding>(
+									  wavmIntrinsicsExportMap),
+								  std::move(jitTypes),
+								  std::move(jitFunctionImports),
+								  std::move(jitTables),
+								  std::move(jitMemories),
+								  std::move(jitGlobals),
+								  std::move(jitExceptionTypes),
+								  {id},
+								  reinterpret_cast<Uptr>(getOutOfBoundsElement()),
+								  functionDefMutableDatas,
+								  std::string(moduleDebugName));
 
-	// Create a FunctionMutableData for each function definition.
-	std::vector<FunctionMutableData*> functionDefMutableDatas;
-	for(Uptr functionDefIndex = 0; functionDefIndex < module->ir.functions.defs.size();
-		++functionDefIndex)
+		// LLVMJIT::loadModule filled in the functionDefMutableDatas' function pointers with the
+		// compiled functions.
+		for(FunctionMutableData* functionMutableData : functionDefMutableDatas)
+		{ loadedJITModule->functionDefs.push_back(functionMutableData->function); }
+
+#if CAN_SHARE_LOADED_CODE
+		// Publish the loaded code for other instances with the same bindings, and forget any
+		// loaded code that is no longer used by an instance.
+		Platform::Mutex::Lock loadedJITModulesLock(module->loadedJITModulesMutex);
+		std::vector<std::vector<Uptr>> expiredKeys;
+		for(const auto& pair : module->loadedJITModules)
+		{
+			if(pair.value.expired()) { expiredKeys.push_back(pair.key); }
+		}
+		for(const std::vector<Uptr>& expiredKey : expiredKeys)
+		{ module->loadedJITModules.removeOrFail(expiredKey); }
+		module->loadedJITModules.set(bindingKey, loadedJITModule);
+#endif
+	}
+
+	// Create this instance's Function objects for the module's function definitions, which forward
+	// calls to the loaded code, and add them after its imports. If calls can't be forwarded, the
+	// loaded code isn't shared, and the instance uses the loaded code's Function objects.
+#if CAN_SHARE_LOADED_CODE
+	std::shared_ptr<ForwardingFunctions> forwardingFunctions
+		= createForwardingFunctions(*loadedJITModule, std::move(functionDefDebugNames));
+	if(!forwardingFunctions)
 	{
-		std::string debugName
-			= disassemblyNames.functions[module->ir.functions.imports.size() + functionDefIndex]
-				  .name;
-		if(!debugName.size())
-		{ debugName = "<function #" + std::to_string(functionDefIndex) + ">"; }
-		debugName = "wasm!" + moduleDebugName + '!' + debugName;
-
-		functionDefMutableDatas.push_back(new FunctionMutableData(std::move(debugName)));
-	}
-
-	// Load the compiled module's object code with this instance's imports.
-	std::vector<FunctionType> jitTypes = module->ir.types;
-	std::vector<Runtime::Function*> jitFunctionDefs;
-	jitFunctionDefs.resize(module->ir.functions.defs.size(), nullptr);
-	std::shared_ptr<LLVMJIT::Module> jitModule
-		= LLVMJIT::loadModule(module->objectCode,
-							  std::move(wavmIntrinsicsExportMap),
-							  std::move(jitTypes),
-							  std::move(jitFunctionImports),
-							  std::move(jitTables),
-							  std::move(jitMemories),
-							  std::move(jitGlobals),
-							  std::move(jitExceptionTypes),
-							  {id},
-							  reinterpret_cast<Uptr>(getOutOfBoundsElement()),
-							  functionDefMutableDatas,
-							  std::string(moduleDebugName));
-
-	// LLVMJIT::loadModule filled in the functionDefMutableDatas' function pointers with the
-	// compiled functions. Add those functions to the module.
-	for(FunctionMutableData* functionMutableData : functionDefMutableDatas)
-	{ functions.push_back(functionMutableData->function); }
+		Platform::RWMutex::ExclusiveLock compartmentLock(compartment->mutex);
+		compartment->instances.removeOrFail(id);
+		throwException(ExceptionTypes::outOfMemory);
+	}
+	const std::vector<Function*>& functionDefs = forwardingFunctions->functions;
+#else
+	std::shared_ptr<ForwardingFunctions> forwardingFunctions;
+	const std::vector<Function*>& functionDefs = loadedJITModule->functionDefs;
+#endif
+	functions.insert(functions.end(), functionDefs.begin(), functionDefs.end());
 
 	// Set up the instance's exports.
 	HashMap<std::string, Object*> exportMap;
@@ -381,7 +621,8 @@ Instance* Runtime::instantiateModuleInternal(Compartment* compartment,
 									  startFunction,
 									  std::move(dataSegments),
 									  std::move(elemSegments),
-									  std::move(jitModule),
+									  std::move(loadedJITModule),
+									  std::move(forwardingFunctions),
 									  std::move(moduleDebugName),
 									  resourceQuota);
 	{
@@ -401,11 +642,29 @@ Instance* Runtime::instantiateModuleInternal(Compartment* compartment,
 		}
 	}
 
-	// Copy the module's data segments into their designated memory instances.
+	return instance;
+}
+
+// Copies the module's active data and elem segments into the instance's memories and tables. May
+// throw a runtime exception for bad segment offsets.
+static void initActiveSegments(ModuleConstRefParam module, Instance* instance)
+{
+	// Initialize the memories defined by the module from images of their data segments, if
+	// enabled.
+	const Uptr numImportedMemories = module->ir.memories.imports.size();
+	std::vector<bool> isMemoryInitialized(module->ir.memories.size(), false);
+	for(Uptr memoryDefIndex = 0; memoryDefIndex < module->ir.memories.defs.size(); ++memoryDefIndex)
+	{
+		const Uptr memoryIndex = numImportedMemories + memoryDefIndex;
+		isMemoryInitialized[memoryIndex] = initMemoryFromDataSegmentImage(
+			module, instance->memories[memoryIndex], memoryDefIndex);
+	}
+
+	// Copy the module's other data segments into their designated memory instances.
 	for(Uptr segmentIndex = 0; segmentIndex < module->ir.dataSegments.size(); ++segmentIndex)
 	{
 		const DataSegment& dataSegment = module->ir.dataSegments[segmentIndex];
-		if(dataSegment.isActive)
+		if(dataSegment.isActive && !isMemoryInitialized[dataSegment.memoryIndex])
 		{
 			WAVM_ASSERT(instance->dataSegments[segmentIndex] == nullptr);
 
@@ -459,10 +718,254 @@ Instance* Runtime::instantiateModuleInternal(Compartment* compartment,
 							numElements);
 		}
 	}
+}
+
+static Instance* instantiateModuleImpl(Compartment* compartment,
+									   ModuleConstRefParam module,
+									   std::vector<FunctionImportBinding>&& functionImports,
+									   std::vector<Table*>&& tables,
+									   std::vector<Memory*>&& memories,
+									   std::vector<Global*>&& globals,
+									   std::vector<Runtime::ExceptionType*>&& exceptionTypes,
+									   std::string&& moduleDebugName,
+									   ResourceQuotaRefParam resourceQuota,
+									   bool shouldInitActiveSegments)
+{
+	// A memory whose reserved address space is too small for unchecked accesses may only be
+	// imported by a module compiled with memory bounds checks. The linker only sees the IR module,
+	// so it can't reject such an import: fail the instantiation before it has any side effects.
+	if(!module->boundsCheckMemoryAccesses)
+	{
+		for(Memory* memory : memories)
+		{
+			if(memory->requiresBoundsChecks)
+			{
+				Log::printf(Log::debug,
+							"Can't instantiate %s: it imports memory %s, which requires bounds"
+							" checks, but wasn't compiled with them.\n",
+							moduleDebugName.c_str(),
+							memory->debugName.c_str());
+				throwException(ExceptionTypes::invalidArgument);
+			}
+		}
+	}
+
+	Uptr id = UINTPTR_MAX;
+	{
+		Platform::RWMutex::ExclusiveLock compartmentLock(compartment->mutex);
+		id = compartment->instances.add(UINTPTR_MAX, nullptr);
+	}
+	if(id == UINTPTR_MAX) { return nullptr; }
 
+	// Deserialize the disassembly names.
+	DisassemblyNames disassemblyNames;
+	getDisassemblyNames(module->ir, disassemblyNames);
+
+	Instance* instance = createInstance(compartment,
+										module,
+										id,
+										std::move(functionImports),
+										std::move(tables),
+										std::move(memories),
+										std::move(globals),
+										std::move(exceptionTypes),
+										std::move(moduleDebugName),
+										resourceQuota,
+										disassemblyNames,
+										getWAVMIntrinsicsExportMap());
+	if(shouldInitActiveSegments) { initActiveSegments(module, instance); }
 	return instance;
 }
 
+Instance* Runtime::instantiateModuleInternal(Compartment* compartment,
+											 ModuleConstRefParam module,
+											 std::vector<FunctionImportBinding>&& functionImports,
+											 std::vector<Table*>&& tables,
+											 std::vector<Memory*>&& memories,
+											 std::vector<Global*>&& globals,
+											 std::vector<ExceptionType*>&& exceptionTypes,
+											 std::string&& moduleDebugName,
+											 ResourceQuotaRefParam resourceQuota)
+{
+	return instantiateModuleImpl(compartment,
+								 module,
+								 std::move(functionImports),
+								 std::move(tables),
+								 std::move(memories),
+								 std::move(globals),
+								 std::move(exceptionTypes),
+								 std::move(moduleDebugName),
+								 resourceQuota,
+								 true);
+}
+
+Instance* Runtime::instantiateModuleWithoutActiveSegments(Compartment* compartment,
+														  ModuleConstRefParam module,
+														  ImportBindings&& imports,
+														  std::string&& moduleDebugName,
+														  ResourceQuotaRefParam resourceQuota)
+{
+	ResolvedImports resolvedImports = resolveImports(compartment, module, imports);
+	return instantiateModuleImpl(compartment,
+								 module,
+								 std::move(resolvedImports.functionImports),
+								 std::move(resolvedImports.tableImports),
+								 std::move(resolvedImports.memoryImports),
+								 std::move(resolvedImports.globalImports),
+								 std::move(resolvedImports.exceptionTypeImports),
+								 std::move(moduleDebugName),
+								 resourceQuota,
+								 false);
+}
+
+// instantiateModules initializes the segments of at least this many instances per thread, to
+// amortize the cost of creating the threads.
+static constexpr Uptr minInstancesPerSegmentInitThread = 4;
+static constexpr Uptr segmentInitThreadNumStackBytes = 1024 * 1024;
+
+struct SegmentInitThreadContext
+{
+	ModuleConstRef module;
+	const std::vector<Instance*>* instances;
+	std::atomic<Uptr>* nextInstanceIndex;
+	Platform::Mutex* exceptionMutex;
+	Exception** exception;
+};
+
+static I64 segmentInitThreadEntry(void* argument)
+{
+	SegmentInitThreadContext& context = *(SegmentInitThreadContext*)argument;
+	while(true)
+	{
+		const Uptr instanceIndex = (*context.nextInstanceIndex)++;
+		if(instanceIndex >= context.instances->size()) { break; }
+
+		// Catch exceptions thrown by the initialization, and pass the first one back to the thread
+		// that called instantiateModules.
+		catchRuntimeExceptions(
+			[&] { initActiveSegments(context.module, (*context.instances)[instanceIndex]); },
+			[&](Exception* exception) {
+				Platform::Mutex::Lock exceptionLock(*context.exceptionMutex);
+				if(!*context.exception) { *context.exception = exception; }
+				else
+				{
+					destroyException(exception);
+				}
+			});
+	}
+	return 0;
+}
+
+std::vector<Instance*> Runtime::instantiateModules(Compartment* compartment,
+												   ModuleConstRefParam module,
+												   Uptr numInstances,
+												   const ImportBindings& imports,
+												   const std::string& debugName,
+												   ResourceQuotaRefParam resourceQuota)
+{
+	Timing::Timer timer;
+
+	// Resolve the imports, decode the module's names, and look up the WAVM intrinsics once for
+	// all the instances.
+	const ResolvedImports resolvedImports = resolveImports(compartment, module, imports);
+	DisassemblyNames disassemblyNames;
+	getDisassemblyNames(module->ir, disassemblyNames);
+	const HashMap<std::string, LLVMJIT::FunctionBinding> wavmIntrinsicsExportMap
+		= getWAVMIntrinsicsExportMap();
+
+	// Reserve IDs for all the instances with a single lock of the compartment.
+	std::vector<Uptr> ids;
+	{
+		Platform::RWMutex::ExclusiveLock compartmentLock(compartment->mutex);
+		while(ids.size() < numInstances)
+		{
+			const Uptr id = compartment->instances.add(UINTPTR_MAX, nullptr);
+			if(id == UINTPTR_MAX) { break; }
+			ids.push_back(id);
+		}
+		if(ids.size() < numInstances)
+		{
+			for(Uptr id : ids) { compartment->instances.removeOrFail(id); }
+			return {};
+		}
+	}
+
+	// Create the instances. If creating one of them fails, release the IDs reserved for the
+	// instances that weren't created yet. The instances that were created are freed by the
+	// compartment's garbage collector.
+	std::vector<Instance*> instances;
+	instances.reserve(numInstances);
+	try
+	{
+		for(Uptr instanceIndex = 0; instanceIndex < numInstances; ++instanceIndex)
+		{
+			std::vector<FunctionImportBinding> functionImports = resolvedImports.functionImports;
+			std::vector<Table*> tableImports = resolvedImports.tableImports;
+			std::vector<Memory*> memoryImports = resolvedImports.memoryImports;
+			std::vector<Global*> globalImports = resolvedImports.globalImports;
+			std::vector<ExceptionType*> exceptionTypeImports
+				= resolvedImports.exceptionTypeImports;
+			instances.push_back(createInstance(compartment,
+											   module,
+											   ids[instanceIndex],
+											   std::move(functionImports),
+											   std::move(tableImports),
+											   std::move(memoryImports),
+											   std::move(globalImports),
+											   std::move(exceptionTypeImports),
+											   std::string(debugName),
+											   resourceQuota,
+											   disassemblyNames,
+											   wavmIntrinsicsExportMap));
+		}
+	}
+	catch(Exception*)
+	{
+		// createInstance releases the ID of the instance that failed.
+		Platform::RWMutex::ExclusiveLock compartmentLock(compartment->mutex);
+		for(Uptr instanceIndex = instances.size() + 1; instanceIndex < numInstances;
+			++instanceIndex)
+		{ compartment->instances.removeOrFail(ids[instanceIndex]); }
+		throw;
+	}
+
+	// Initialize the instances' active segments. If the instances share imported memories or
+	// tables, they must be initialized in order, since segments of later instances may overwrite
+	// those of earlier instances. Otherwise, each instance writes only to its own memories and
+	// tables, and they may be initialized in parallel.
+	const Uptr numThreads
+		= resolvedImports.tableImports.size() || resolvedImports.memoryImports.size()
+			  ? 1
+			  : std::min(Platform::getNumberOfHardwareThreads(),
+						 numInstances / minInstancesPerSegmentInitThread);
+	if(numThreads <= 1)
+	{
+		for(Instance* instance : instances) { initActiveSegments(module, instance); }
+	}
+	else
+	{
+		std::atomic<Uptr> nextInstanceIndex{0};
+		Platform::Mutex exceptionMutex;
+		Exception* exception = nullptr;
+		SegmentInitThreadContext context{
+			module, &instances, &nextInstanceIndex, &exceptionMutex, &exception};
+
+		std::vector<Platform::Thread*> threads;
+		for(Uptr threadIndex = 0; threadIndex < numThreads; ++threadIndex)
+		{
+			threads.push_back(Platform::createThread(
+				segmentInitThreadNumStackBytes, segmentInitThreadEntry, &context));
+		}
+		for(Platform::Thread* thread : threads) { Platform::joinThread(thread); }
+
+		if(exception) { throwException(exception); }
+	}
+
+	Timing::logRatePerSecond("Instantiated modules", timer, F64(numInstances), "instances");
+
+	return instances;
+}
+
 Instance* Runtime::cloneInstance(Instance* instance, Compartment* newCompartment)
 {
 	// Remap the module's references to the cloned compartment.
@@ -506,7 +1009,8 @@ Instance* Runtime::cloneInstance(Instance* instance, Compartment* newCompartment
 	}
 
 	// Create the new Instance in the cloned compartment, but with the same ID as the old one.
-	std::shared_ptr<LLVMJIT::Module> jitModuleCopy = instance->jitModule;
+	std::shared_ptr<LoadedJITModule> loadedJITModuleCopy = instance->loadedJITModule;
+	std::shared_ptr<ForwardingFunctions> forwardingFunctionsCopy = instance->forwardingFunctions;
 	Instance* newInstance = new Instance(newCompartment,
 										 instance->id,
 										 std::move(newExportMap),
@@ -519,7 +1023,8 @@ Instance* Runtime::cloneInstance(Instance* instance, Compartment* newCompartment
 										 std::move(newStartFunction),
 										 std::move(newDataSegments),
 										 std::move(newElemSegments),
-										 std::move(jitModuleCopy),
+										 std::move(loadedJITModuleCopy),
+										 std::move(forwardingFunctionsCopy),
 										 std::string(instance->debugName),
 										 instance->resourceQuota);
 	{
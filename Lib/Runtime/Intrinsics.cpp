@@ -1,5 +1,8 @@
 #include "WAVM/Runtime/Intrinsics.h"
+#include <stddef.h>
+#include <string.h>
 #include <initializer_list>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -14,8 +17,12 @@
 #include "WAVM/Inline/HashMap.h"
 #include "WAVM/Inline/Serialization.h"
 #include "WAVM/Inline/Timing.h"
+#include "WAVM/LLVMJIT/LLVMJIT.h"
+#include "WAVM/Platform/Memory.h"
+#include "WAVM/Platform/Mutex.h"
 #include "WAVM/Platform/RWMutex.h"
 #include "WAVM/Runtime/Runtime.h"
+#include "WAVM/RuntimeABI/RuntimeABI.h"
 
 namespace WAVM { namespace Intrinsics {
 	struct ModuleImpl
@@ -24,6 +31,11 @@ namespace WAVM { namespace Intrinsics {
 		HashMap<std::string, Intrinsics::Table*> tableMap;
 		HashMap<std::string, Intrinsics::Memory*> memoryMap;
 		HashMap<std::string, Intrinsics::Global*> globalMap;
+
+		// The compiled modules for instantiations whose first intrinsic module is this module,
+		// keyed by the requested intrinsic modules.
+		Platform::Mutex compiledModulesMutex;
+		HashMap<std::vector<Uptr>, Runtime::ModuleRef> compiledModules;
 	};
 }}
 
@@ -89,25 +101,39 @@ Intrinsics::Memory::Memory(Intrinsics::Module* moduleRef,
 	moduleRef->impl->memoryMap.set(name, this);
 }
 
-Instance* Intrinsics::instantiateModule(
-	Compartment* compartment,
-	const std::initializer_list<const Intrinsics::Module*>& moduleRefs,
-	std::string&& debugName)
+static void validateIntrinsicModule(const IR::Module& irModule)
 {
-	Timing::Timer timer;
+	if(WAVM_ENABLE_ASSERTS)
+	{
+		try
+		{
+			std::shared_ptr<IR::ModuleValidationState> moduleValidationState
+				= IR::createModuleValidationState(irModule);
+			validatePreCodeSections(*moduleValidationState);
+			validateCodeSection(*moduleValidationState);
+			validatePostCodeSections(*moduleValidationState);
+		}
+		catch(ValidationException const& exception)
+		{
+			Errors::fatalf("Validation exception in intrinsic module: %s",
+						   exception.message.c_str());
+		}
+	}
+}
 
+static ModuleRef compileIntrinsicModule(
+	const std::initializer_list<const Intrinsics::Module*>& moduleRefs)
+{
 	IR::Module irModule(FeatureLevel::wavm);
 	irModule.featureSpec.nonWASMFunctionTypes = true;
 	DisassemblyNames names;
 
-	std::vector<FunctionImportBinding> functionImportBindings;
 	for(const Intrinsics::Module* moduleRef : moduleRefs)
 	{
 		if(moduleRef->impl)
 		{
 			for(const auto& pair : moduleRef->impl->functionMap)
 			{
-				functionImportBindings.push_back({pair.value->getNativeFunction()});
 				const Uptr typeIndex = irModule.types.size();
 				const Uptr functionIndex = irModule.functions.size();
 				irModule.types.push_back(pair.value->getType());
@@ -206,25 +232,63 @@ Instance* Intrinsics::instantiateModule(
 	}
 
 	setDisassemblyNames(irModule, names);
+	validateIntrinsicModule(irModule);
 
-	if(WAVM_ENABLE_ASSERTS)
+	return compileModule(irModule);
+}
+
+Instance* Intrinsics::instantiateModule(
+	Compartment* compartment,
+	const std::initializer_list<const Intrinsics::Module*>& moduleRefs,
+	std::string&& debugName)
+{
+	Timing::Timer timer;
+
+	// Bind the compiled module's function imports to the intrinsic functions, in the same order
+	// that compileIntrinsicModule adds them to the IR module. Also compute a key that identifies
+	// the requested intrinsic modules, and find the first of them that has any intrinsics.
+	std::vector<FunctionImportBinding> functionImportBindings;
+	std::vector<Uptr> compiledModuleKey;
+	Intrinsics::ModuleImpl* firstModuleImpl = nullptr;
+	for(const Intrinsics::Module* moduleRef : moduleRefs)
 	{
-		try
+		if(moduleRef->impl)
 		{
-			std::shared_ptr<IR::ModuleValidationState> moduleValidationState
-				= IR::createModuleValidationState(irModule);
-			validatePreCodeSections(*moduleValidationState);
-			validateCodeSection(*moduleValidationState);
-			validatePostCodeSections(*moduleValidationState);
+			if(!firstModuleImpl) { firstModuleImpl = moduleRef->impl; }
+
+			for(const auto& pair : moduleRef->impl->functionMap)
+			{ functionImportBindings.push_back({pair.value->getNativeFunction()}); }
+
+			compiledModuleKey.push_back(reinterpret_cast<Uptr>(moduleRef));
+			compiledModuleKey.push_back(moduleRef->impl->functionMap.size());
+			compiledModuleKey.push_back(moduleRef->impl->tableMap.size());
+			compiledModuleKey.push_back(moduleRef->impl->memoryMap.size());
+			compiledModuleKey.push_back(moduleRef->impl->globalMap.size());
 		}
-		catch(ValidationException const& exception)
+	}
+
+	// The compiled module only depends on the requested intrinsic modules, so reuse the module
+	// compiled for a previous instantiation of the same intrinsic modules.
+	ModuleRef module;
+	if(!firstModuleImpl) { module = compileIntrinsicModule(moduleRefs); }
+	else
+	{
 		{
-			Errors::fatalf("Validation exception in intrinsic module: %s",
-						   exception.message.c_str());
+			Platform::Mutex::Lock compiledModulesLock(firstModuleImpl->compiledModulesMutex);
+			if(const ModuleRef* compiledModule
+			   = firstModuleImpl->compiledModules.get(compiledModuleKey))
+			{ module = *compiledModule; }
+		}
+
+		if(!module)
+		{
+			module = compileIntrinsicModule(moduleRefs);
+
+			Platform::Mutex::Lock compiledModulesLock(firstModuleImpl->compiledModulesMutex);
+			firstModuleImpl->compiledModules.set(compiledModuleKey, module);
 		}
 	}
 
-	ModuleRef module = compileModule(irModule);
 	Instance* instance = instantiateModuleInternal(compartment,
 												   module,
 												   std::move(functionImportBindings),
@@ -238,6 +302,216 @@ Instance* Intrinsics::instantiateModule(
 	return instance;
 }
 
+// The machine code of a host function: it loads the address of the LLVMJIT::HostThunkBinding
+// that follows the code into the register LLVM uses for nest parameters, and jumps to the absolute
+// address of the host thunk that precedes the binding. On other architectures, and on Apple and
+// Windows AArch64 platforms that reserve x18, each host function instantiates a module that calls
+// the native function instead.
+#if defined(__x86_64__) || defined(_M_X64)
+#define CAN_SHARE_HOST_THUNKS 1
+static const U8 hostFunctionCode[] = {
+	0x4c, 0x8d, 0x15, 0x11, 0x00, 0x00, 0x00, // lea r10, [rip + 17]
+	0xff, 0x25, 0x03, 0x00, 0x00, 0x00,       // jmp [rip + 3]
+	0xcc, 0xcc, 0xcc,                         // int3
+};
+#elif defined(__aarch64__) && !defined(__APPLE__) && !defined(_WIN32)
+#define CAN_SHARE_HOST_THUNKS 1
+static const U8 hostFunctionCode[] = {
+	0xd2, 0x00, 0x00, 0x10, // adr x18, #24
+	0x70, 0x00, 0x00, 0x58, // ldr x16, #12
+	0x00, 0x02, 0x1f, 0xd6, // br x16
+	0x1f, 0x20, 0x03, 0xd5, // nop
+};
+#else
+#define CAN_SHARE_HOST_THUNKS 0
+#endif
+
+#if CAN_SHARE_HOST_THUNKS
+static_assert(sizeof(hostFunctionCode) == 16, "The host thunk address must follow the code");
+
+Runtime::Function* Intrinsics::createHostFunction(Compartment* compartment,
+												  FunctionType type,
+												  void* nativeFunction,
+												  void* boundData,
+												  void (*finalizeBoundData)(void*),
+												  std::string&& debugName)
+{
+	static constexpr Uptr numCodeBytes
+		= sizeof(hostFunctionCode) + sizeof(Uptr) + sizeof(LLVMJIT::HostThunkBinding);
+
+	const FunctionType wasmFunctionType(type.results(), type.params(), CallingConvention::wasm);
+	const Runtime::Function* hostThunk = LLVMJIT::getHostThunk(wasmFunctionType);
+
+	// Reserve an ID for the instance that owns the function.
+	Uptr id = UINTPTR_MAX;
+	{
+		Platform::RWMutex::ExclusiveLock compartmentLock(compartment->mutex);
+		id = compartment->instances.add(UINTPTR_MAX, nullptr);
+	}
+	if(id == UINTPTR_MAX) { return nullptr; }
+
+	U8* page = Platform::allocateVirtualPages(1);
+	if(!page || !Platform::commitVirtualPages(page, 1))
+	{
+		if(page) { Platform::freeVirtualPages(page, 1); }
+		Platform::RWMutex::ExclusiveLock compartmentLock(compartment->mutex);
+		compartment->instances.removeOrFail(id);
+		return nullptr;
+	}
+
+	// Create the function, and write its code, the address of the host thunk, and the binding.
+	FunctionMutableData* functionMutableData = new FunctionMutableData(std::string(debugName));
+	functionMutableData->numCodeBytes = numCodeBytes;
+	Runtime::Function* function
+		= new(page) Runtime::Function(functionMutableData, id, wasmFunctionType.getEncoding());
+	functionMutableData->function = function;
+
+	U8* code = page + offsetof(Runtime::Function, code);
+	const Uptr hostThunkAddress = reinterpret_cast<Uptr>(hostThunk->code);
+	const LLVMJIT::HostThunkBinding binding{nativeFunction, boundData};
+	memcpy(code, hostFunctionCode, sizeof(hostFunctionCode));
+	memcpy(code + sizeof(hostFunctionCode), &hostThunkAddress, sizeof(Uptr));
+	memcpy(code + sizeof(hostFunctionCode) + sizeof(Uptr), &binding, sizeof(binding));
+#if defined(__aarch64__)
+	__builtin___clear_cache(reinterpret_cast<char*>(code),
+							reinterpret_cast<char*>(code + numCodeBytes));
+#endif
+	WAVM_ERROR_UNLESS(
+		Platform::setVirtualPageAccess(page, 1, Platform::MemoryAccess::readExecute));
+
+	auto forwardingFunctions = std::make_shared<ForwardingFunctions>(page, 1);
+	forwardingFunctions->functions.push_back(function);
+	forwardingFunctions->boundData = boundData;
+	forwardingFunctions->finalizeBoundData = finalizeBoundData;
+
+	// Create an instance that owns the function, and add it to the compartment.
+	Instance* instance = new Instance(compartment,
+									  id,
+									  HashMap<std::string, Object*>(),
+									  std::vector<Object*>(),
+									  std::vector<Runtime::Function*>{function},
+									  std::vector<Runtime::Table*>(),
+									  std::vector<Runtime::Memory*>(),
+									  std::vector<Runtime::Global*>(),
+									  std::vector<Runtime::ExceptionType*>(),
+									  nullptr,
+									  DataSegmentVector(),
+									  ElemSegmentVector(),
+									  nullptr,
+									  std::move(forwardingFunctions),
+									  std::move(debugName),
+									  ResourceQuotaRef());
+	{
+		Platform::RWMutex::ExclusiveLock compartmentLock(compartment->mutex);
+		compartment->instances[id] = instance;
+	}
+
+	return function;
+}
+#else
+// A global cache of the modules compiled for host functions, keyed by the host function type.
+struct HostFunctionModuleCache
+{
+	Platform::RWMutex mutex;
+	HashMap<FunctionType, ModuleRef> typeToModuleMap;
+
+	static HostFunctionModuleCache& get()
+	{
+		static HostFunctionModuleCache singleton;
+		return singleton;
+	}
+
+private:
+	HostFunctionModuleCache() {}
+};
+
+// Compiles a module that imports a native function and the data bound to it, and exports a thunk
+// that calls the native function with the bound data followed by the thunk's parameters.
+static ModuleRef compileHostFunctionModule(FunctionType wasmFunctionType)
+{
+	IR::Module irModule(FeatureLevel::wavm);
+	irModule.featureSpec.nonWASMFunctionTypes = true;
+	DisassemblyNames names;
+
+	std::vector<ValueType> nativeParams{ValueType::i64};
+	for(ValueType param : wasmFunctionType.params()) { nativeParams.push_back(param); }
+	irModule.types.push_back(FunctionType(wasmFunctionType.results(),
+										  TypeTuple(nativeParams),
+										  CallingConvention::cAPICallback));
+	irModule.types.push_back(wasmFunctionType);
+
+	irModule.functions.imports.push_back({{0}, "", "nativeFunction"});
+	irModule.imports.push_back({ExternKind::function, 0});
+	names.functions.push_back({"nativeFunction", {}, {}});
+
+	irModule.globals.imports.push_back({GlobalType(ValueType::i64, false), "", "boundData"});
+	irModule.imports.push_back({ExternKind::global, 0});
+	names.globals.push_back("boundData");
+
+	Serialization::ArrayOutputStream codeStream;
+	OperatorEncoderStream opEncoder(codeStream);
+	opEncoder.global_get({0});
+	for(Uptr paramIndex = 0; paramIndex < wasmFunctionType.params().size(); ++paramIndex)
+	{ opEncoder.local_get({paramIndex}); }
+	opEncoder.call({0});
+	opEncoder.end();
+
+	irModule.functions.defs.push_back({{1}, {}, codeStream.getBytes(), {}});
+	names.functions.push_back({"thunk", {}, {}});
+	irModule.exports.push_back({"thunk", ExternKind::function, 1});
+
+	setDisassemblyNames(irModule, names);
+	validateIntrinsicModule(irModule);
+
+	return compileModule(irModule);
+}
+
+Runtime::Function* Intrinsics::createHostFunction(Compartment* compartment,
+												  FunctionType type,
+												  void* nativeFunction,
+												  void* boundData,
+												  void (*finalizeBoundData)(void*),
+												  std::string&& debugName)
+{
+	const FunctionType wasmFunctionType(type.results(), type.params(), CallingConvention::wasm);
+
+	// Look up the module compiled for the function type, or compile it if this is the first host
+	// function with the type. Each host function instantiates the module with its own bound data.
+	HostFunctionModuleCache& moduleCache = HostFunctionModuleCache::get();
+	ModuleRef module;
+	{
+		Platform::RWMutex::ShareableLock shareableLock(moduleCache.mutex);
+		if(const ModuleRef* cachedModule = moduleCache.typeToModuleMap.get(wasmFunctionType))
+		{ module = *cachedModule; }
+	}
+	if(!module)
+	{
+		Platform::RWMutex::ExclusiveLock exclusiveLock(moduleCache.mutex);
+		ModuleRef& cachedModule = moduleCache.typeToModuleMap.getOrAdd(wasmFunctionType, nullptr);
+		if(!cachedModule) { cachedModule = compileHostFunctionModule(wasmFunctionType); }
+		module = cachedModule;
+	}
+
+	Runtime::Global* boundDataGlobal
+		= createGlobal(compartment, GlobalType(ValueType::i64, false), "");
+	if(!boundDataGlobal) { return nullptr; }
+	initializeGlobal(boundDataGlobal, I64(reinterpret_cast<Uptr>(boundData)));
+
+	Instance* instance = instantiateModuleInternal(compartment,
+												   module,
+												   {FunctionImportBinding(nativeFunction)},
+												   {},
+												   {},
+												   {boundDataGlobal},
+												   {},
+												   std::move(debugName));
+	if(!instance) { return nullptr; }
+	if(finalizeBoundData) { setUserData(instance, boundData, finalizeBoundData); }
+
+	return getTypedInstanceExport(instance, "thunk", wasmFunctionType);
+}
+#endif
+
 HashMap<std::string, Intrinsics::Function*> Intrinsics::getUninstantiatedFunctions(
 	const std::initializer_list<const Intrinsics::Module*>& moduleRefs)
 {
@@ -15,11 +15,7 @@ using namespace WAVM;
 using namespace WAVM::IR;
 using namespace WAVM::Runtime;
 
-void Runtime::invokeFunction(Context* context,
-							 const Function* function,
-							 FunctionType invokeSig,
-							 const UntaggedValue arguments[],
-							 UntaggedValue outResults[])
+PreparedInvoke Runtime::prepareInvoke(const Function* function, FunctionType invokeSig)
 {
 	FunctionType functionType{function->encodedType};
 
@@ -37,20 +33,6 @@ void Runtime::invokeFunction(Context* context,
 		throwException(ExceptionTypes::invokeSignatureMismatch);
 	}
 
-	// Assert that the function, the context, and any reference arguments are all in the same
-	// compartment.
-	if(WAVM_ENABLE_ASSERTS)
-	{
-		WAVM_ASSERT(isInCompartment(asObject(function), context->compartment));
-		for(Uptr argumentIndex = 0; argumentIndex < invokeSig.params().size(); ++argumentIndex)
-		{
-			const ValueType argType = invokeSig.params()[argumentIndex];
-			const UntaggedValue& arg = arguments[argumentIndex];
-			WAVM_ASSERT(!isReferenceType(argType) || !arg.object
-						|| isInCompartment(arg.object, context->compartment));
-		}
-	}
-
 	// Get the invoke thunk for this function type. Cache it in the function's FunctionMutableData
 	// to avoid the global lock implied by LLVMJIT::getInvokeThunk.
 	InvokeThunkPointer invokeThunk
@@ -66,33 +48,57 @@ void Runtime::invokeFunction(Context* context,
 	}
 	WAVM_ASSERT(invokeThunk);
 
+	PreparedInvoke prepared;
+	prepared.function = function;
+	prepared.invokeThunk = invokeThunk;
+	return prepared;
+}
+
+void Runtime::invokeFunction(Context* context,
+							 const Function* function,
+							 FunctionType invokeSig,
+							 const UntaggedValue arguments[],
+							 UntaggedValue outResults[])
+{
+	const PreparedInvoke prepared = prepareInvoke(function, invokeSig);
+
+	// Assert that the function, the context, and any reference arguments are all in the same
+	// compartment.
+	if(WAVM_ENABLE_ASSERTS)
+	{
+		WAVM_ASSERT(isInCompartment(asObject(function), context->compartment));
+		for(Uptr argumentIndex = 0; argumentIndex < invokeSig.params().size(); ++argumentIndex)
+		{
+			const ValueType argType = invokeSig.params()[argumentIndex];
+			const UntaggedValue& arg = arguments[argumentIndex];
+			WAVM_ASSERT(!isReferenceType(argType) || !arg.object
+						|| isInCompartment(arg.object, context->compartment));
+		}
+	}
+
 	// MacOS std::function is a little more pessimistic about heap allocating captures, and without
 	// wrapping these captured variables into a single reference, does a heap allocation for the
 	// thunk passed to unwindSignalsAsExceptions below.
 	struct InvokeContext
 	{
 		Context* context;
-		const Function* function;
+		const PreparedInvoke* prepared;
 		const UntaggedValue* arguments;
 		UntaggedValue* outResults;
-		InvokeThunkPointer invokeThunk;
 	};
 	InvokeContext invokeContext;
 	invokeContext.context = context;
-	invokeContext.function = function;
+	invokeContext.prepared = &prepared;
 	invokeContext.arguments = arguments;
 	invokeContext.outResults = outResults;
-	invokeContext.invokeThunk = invokeThunk;
 
 	// Use unwindSignalsAsExceptions to ensure that any signal that occurs in WebAssembly code calls
 	// C++ destructors on the stack between here and where it is caught.
 	unwindSignalsAsExceptions([&invokeContext] {
-		ContextRuntimeData* contextRuntimeData = getContextRuntimeData(invokeContext.context);
-
 		// Call the invoke thunk.
-		(*invokeContext.invokeThunk)(invokeContext.function,
-									 contextRuntimeData,
-									 invokeContext.arguments,
-									 invokeContext.outResults);
+		invokePrepared(getContextRuntimeData(invokeContext.context),
+					   *invokeContext.prepared,
+					   invokeContext.arguments,
+					   invokeContext.outResults);
 	});
 }
@@ -1,16 +1,22 @@
 #include "WAVM/Platform/Memory.h"
 #include <stdint.h>
 #include <string.h>
+#include <algorithm>
 #include <atomic>
 #include <memory>
 #include <vector>
+#include "AddressRangeIndex.h"
 #include "RuntimePrivate.h"
 #include "WAVM/IR/IR.h"
 #include "WAVM/IR/Types.h"
 #include "WAVM/IR/Value.h"
 #include "WAVM/Inline/Assert.h"
 #include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Inline/Errors.h"
+#include "WAVM/Inline/Timing.h"
+#include "WAVM/Logging/Logging.h"
 #include "WAVM/Platform/Intrinsic.h"
+#include "WAVM/Platform/Mutex.h"
 #include "WAVM/Platform/RWMutex.h"
 #include "WAVM/Runtime/Runtime.h"
 #include "WAVM/RuntimeABI/RuntimeABI.h"
@@ -22,40 +28,159 @@ namespace WAVM { namespace Runtime {
 	WAVM_DEFINE_INTRINSIC_MODULE(wavmIntrinsicsMemory)
 }}
 
-// Global lists of memories; used to query whether an address is reserved by one of them.
-static Platform::RWMutex memoriesMutex;
-static std::vector<Memory*> memories;
+// Global index of the address ranges reserved by memories; used to query whether an address is
+// reserved by one of them.
+static AddressRangeIndex<Memory*> memoryAddressIndex;
 
 static constexpr Uptr numGuardPages = 1;
 
+// On a 64-bit runtime, allocate 8GB of address space for each memory.
+// This allows eliding bounds checks on memory accesses, since a 32-bit index + 32-bit offset will
+// always be within the reserved address-space.
+static constexpr Uptr memoryMaxBytes = Uptr(8ull * 1024 * 1024 * 1024);
+
+// If memory bounds checks are enabled, memories instead reserve only enough address space for their
+// declared maximum size, up to maxBoundsCheckedReservedBytes, and must be accessed by code that
+// checks the bounds of each access.
+static std::atomic<bool> memoryBoundsChecks{false};
+static std::atomic<Uptr> maxBoundsCheckedReservedBytes{Uptr(1) << 30};
+
+// A pool of address-space reservations freed by memories, which are reused by new memories instead
+// of unmapping them and mapping new reservations.
+static Platform::Mutex memoryReservationPoolMutex;
+static std::vector<U8*> memoryReservationPool;
+static Uptr maxPooledMemoryReservations = 16;
+static std::atomic<Uptr> numMemoryReservationPoolHits{0};
+static std::atomic<Uptr> numMemoryReservationPoolMisses{0};
+
 static Uptr getPlatformPagesPerWebAssemblyPageLog2()
 {
 	WAVM_ERROR_UNLESS(Platform::getBytesPerPageLog2() <= IR::numBytesPerPageLog2);
 	return IR::numBytesPerPageLog2 - Platform::getBytesPerPageLog2();
 }
 
+static Uptr getNumMemoryReservationPlatformPages()
+{
+	return (memoryMaxBytes >> Platform::getBytesPerPageLog2()) + numGuardPages;
+}
+
+static U8* acquireMemoryReservation()
+{
+	U8* baseAddress = nullptr;
+	{
+		Platform::Mutex::Lock poolLock(memoryReservationPoolMutex);
+		if(memoryReservationPool.size())
+		{
+			baseAddress = memoryReservationPool.back();
+			memoryReservationPool.pop_back();
+		}
+	}
+
+	if(baseAddress) { ++numMemoryReservationPoolHits; }
+	else
+	{
+		++numMemoryReservationPoolMisses;
+		baseAddress = Platform::allocateVirtualPages(getNumMemoryReservationPlatformPages());
+	}
+
+	Log::printf(Log::metrics,
+				"Memory reservation pool: %" WAVM_PRIuPTR " hits, %" WAVM_PRIuPTR " misses\n",
+				numMemoryReservationPoolHits.load(std::memory_order_relaxed),
+				numMemoryReservationPoolMisses.load(std::memory_order_relaxed));
+
+	return baseAddress;
+}
+
+static void releaseMemoryReservation(U8* baseAddress, Uptr numCommittedPlatformPages)
+{
+	bool isPoolFull;
+	{
+		Platform::Mutex::Lock poolLock(memoryReservationPoolMutex);
+		isPoolFull = memoryReservationPool.size() >= maxPooledMemoryReservations;
+	}
+
+	if(!isPoolFull)
+	{
+		// Decommit the pages that were committed, so the reservation is indistinguishable from a
+		// fresh one when it's reused.
+		if(numCommittedPlatformPages)
+		{ Platform::decommitVirtualPages(baseAddress, numCommittedPlatformPages); }
+
+		Platform::Mutex::Lock poolLock(memoryReservationPoolMutex);
+		if(memoryReservationPool.size() < maxPooledMemoryReservations)
+		{
+			memoryReservationPool.push_back(baseAddress);
+			return;
+		}
+	}
+
+	Platform::freeVirtualPages(baseAddress, getNumMemoryReservationPlatformPages());
+}
+
+void Runtime::setMaxPooledMemoryReservations(Uptr newMaxPooledMemoryReservations)
+{
+	std::vector<U8*> freedReservations;
+	{
+		Platform::Mutex::Lock poolLock(memoryReservationPoolMutex);
+		maxPooledMemoryReservations = newMaxPooledMemoryReservations;
+		while(memoryReservationPool.size() > maxPooledMemoryReservations)
+		{
+			freedReservations.push_back(memoryReservationPool.back());
+			memoryReservationPool.pop_back();
+		}
+	}
+
+	for(U8* baseAddress : freedReservations)
+	{ Platform::freeVirtualPages(baseAddress, getNumMemoryReservationPlatformPages()); }
+}
+
+void Runtime::setMemoryBoundsChecks(bool enable, Uptr maxReservedBytes)
+{
+	maxBoundsCheckedReservedBytes.store(maxReservedBytes, std::memory_order_relaxed);
+	memoryBoundsChecks.store(enable, std::memory_order_relaxed);
+}
+
+bool Runtime::getMemoryBoundsChecks() { return memoryBoundsChecks.load(std::memory_order_relaxed); }
+
+// Returns the number of bytes of address space to reserve for a memory whose accesses are bounds
+// checked: enough for the memory's declared maximum size, up to maxBoundsCheckedReservedBytes, but
+// at least enough for its minimum size.
+static Uptr getNumBoundsCheckedReservedBytes(const IR::MemoryType& type)
+{
+	const U64 maxPages = std::min(type.size.max, U64(IR::maxMemoryPages));
+	U64 numReservedBytes = maxBoundsCheckedReservedBytes.load(std::memory_order_relaxed);
+	numReservedBytes = std::min(numReservedBytes, maxPages * IR::numBytesPerPage);
+	numReservedBytes = std::max(numReservedBytes, type.size.min * IR::numBytesPerPage);
+
+	// Round up to a whole number of WebAssembly pages.
+	numReservedBytes = (numReservedBytes + IR::numBytesPerPage - 1) & ~U64(IR::numBytesPerPage - 1);
+	return Uptr(std::min(numReservedBytes, U64(memoryMaxBytes)));
+}
+
 static Memory* createMemoryImpl(Compartment* compartment,
 								IR::MemoryType type,
 								Uptr numPages,
 								std::string&& debugName,
-								ResourceQuotaRefParam resourceQuota)
+								ResourceQuotaRefParam resourceQuota,
+								Uptr numReservedBytes)
 {
 	Memory* memory = new Memory(compartment, type, std::move(debugName), resourceQuota);
 
-	// On a 64-bit runtime, allocate 8GB of address space for the memory.
-	// This allows eliding bounds checks on memory accesses, since a 32-bit index + 32-bit offset
-	// will always be within the reserved address-space.
-	const Uptr pageBytesLog2 = Platform::getBytesPerPageLog2();
-	const Uptr memoryMaxBytes = Uptr(8ull * 1024 * 1024 * 1024);
-	const Uptr memoryMaxPages = memoryMaxBytes >> pageBytesLog2;
-
-	memory->baseAddress = Platform::allocateVirtualPages(memoryMaxPages + numGuardPages);
-	memory->numReservedBytes = memoryMaxBytes;
+	// Reserve the memory's address-space. Full size reservations reuse a pooled reservation if
+	// possible, but smaller reservations for bounds checked memories aren't pooled.
+	if(numReservedBytes == memoryMaxBytes) { memory->baseAddress = acquireMemoryReservation(); }
+	else
+	{
+		memory->baseAddress = Platform::allocateVirtualPages(
+			(numReservedBytes >> Platform::getBytesPerPageLog2()) + numGuardPages);
+		memory->requiresBoundsChecks = true;
+	}
 	if(!memory->baseAddress)
 	{
 		delete memory;
 		return nullptr;
 	}
+	memory->numReservedBytes = numReservedBytes;
 
 	// Grow the memory to the type's minimum size.
 	if(growMemory(memory, numPages) != GrowResult::success)
@@ -64,23 +189,28 @@ static Memory* createMemoryImpl(Compartment* compartment,
 		return nullptr;
 	}
 
-	// Add the memory to the global array.
-	{
-		Platform::RWMutex::ExclusiveLock memoriesLock(memoriesMutex);
-		memories.push_back(memory);
-	}
+	// Add the memory to the global address index.
+	memoryAddressIndex.add(reinterpret_cast<Uptr>(memory->baseAddress),
+						   reinterpret_cast<Uptr>(memory->baseAddress) + memory->numReservedBytes,
+						   memory);
 
 	return memory;
 }
 
-Memory* Runtime::createMemory(Compartment* compartment,
-							  IR::MemoryType type,
-							  std::string&& debugName,
-							  ResourceQuotaRefParam resourceQuota)
+Memory* Runtime::createMemoryInternal(Compartment* compartment,
+									  IR::MemoryType type,
+									  std::string&& debugName,
+									  ResourceQuotaRefParam resourceQuota,
+									  bool isBoundsChecked)
 {
 	WAVM_ASSERT(type.size.min <= UINTPTR_MAX);
 	Memory* memory = createMemoryImpl(
-		compartment, type, Uptr(type.size.min), std::move(debugName), resourceQuota);
+		compartment,
+		type,
+		Uptr(type.size.min),
+		std::move(debugName),
+		resourceQuota,
+		isBoundsChecked ? getNumBoundsCheckedReservedBytes(type) : memoryMaxBytes);
 	if(!memory) { return nullptr; }
 
 	// Add the memory to the compartment's memories IndexMap.
@@ -101,18 +231,183 @@ Memory* Runtime::createMemory(Compartment* compartment,
 	return memory;
 }
 
-Memory* Runtime::cloneMemory(Memory* memory, Compartment* newCompartment, bool copyContents) {
+Memory* Runtime::createMemory(Compartment* compartment,
+							  IR::MemoryType type,
+							  std::string&& debugName,
+							  ResourceQuotaRefParam resourceQuota)
+{
+	return createMemoryInternal(
+		compartment, type, std::move(debugName), resourceQuota, getMemoryBoundsChecks());
+}
+
+bool Runtime::isZeroPage(const U8* page)
+{
+	const U64* words = (const U64*)page;
+	for(Uptr wordIndex = 0; wordIndex < IR::numBytesPerPage / sizeof(U64); ++wordIndex)
+	{
+		if(words[wordIndex]) { return false; }
+	}
+	return true;
+}
+
+// The number of pages that are copied to a memory snapshot at a time. This bounds the number of
+// pages that are resident in both the memory and the snapshot while the snapshot is taken.
+static constexpr Uptr numSnapshotChunkPages = 16;
+
+Runtime::MemorySnapshot::~MemorySnapshot()
+{
+	if(file) { Platform::destroyMemoryFile(file); }
+}
+
+// Finds the pages of a memory that have been written since it was mapped from its snapshot. Returns
+// false if they can't be determined. Must be called with the memory's resizingMutex locked.
+static bool getPagesWrittenSinceSnapshot(Memory* memory, std::vector<bool>& outIsWrittenPage)
+{
+	const Uptr platformPagesPerPageLog2 = getPlatformPagesPerWebAssemblyPageLog2();
+	std::vector<bool> isWrittenPlatformPage;
+	if(!Platform::getWrittenCopyOnWritePages(memory->baseAddress,
+											  memory->snapshot->numPages << platformPagesPerPageLog2,
+											  isWrittenPlatformPage))
+	{ return false; }
+
+	outIsWrittenPage.assign(memory->snapshot->numPages, false);
+	for(Uptr platformPageIndex = 0; platformPageIndex < isWrittenPlatformPage.size();
+		++platformPageIndex)
+	{
+		if(isWrittenPlatformPage[platformPageIndex])
+		{ outIsWrittenPage[platformPageIndex >> platformPagesPerPageLog2] = true; }
+	}
+	return true;
+}
+
+// Returns whether a memory's snapshot has the memory's current contents: the memory hasn't been
+// grown or written since it was mapped from the snapshot. Must be called with the memory's
+// resizingMutex locked.
+static bool isMemorySnapshotCurrent(Memory* memory, Uptr numPages)
+{
+	if(!memory->snapshot || memory->snapshot->numPages != numPages) { return false; }
+
+	std::vector<bool> isWrittenPage;
+	if(!getPagesWrittenSinceSnapshot(memory, isWrittenPage)) { return false; }
+	for(bool isWritten : isWrittenPage)
+	{
+		if(isWritten) { return false; }
+	}
+	return true;
+}
+
+// Copies the contents of a memory to a new snapshot, and replaces the memory's pages with a
+// copy-on-write mapping of the snapshot, so later writes to the memory don't change the snapshot.
+// The memory is copied and remapped a chunk at a time, so its contents are never resident twice.
+// Must be called with the memory's resizingMutex locked.
+static bool takeMemorySnapshot(Memory* memory, Uptr numPages)
+{
+	std::shared_ptr<MemorySnapshot> snapshot = std::make_shared<MemorySnapshot>();
+	snapshot->file
+		= Platform::createMemoryFile(memory->debugName.c_str(), numPages * IR::numBytesPerPage);
+	if(!snapshot->file) { return false; }
+	snapshot->numPages = numPages;
+	snapshot->isNonZeroPage.assign(numPages, false);
+
+	// Pages that were zero in the memory's previous snapshot, and haven't been written since, are
+	// still zero. Skipping them avoids reading the holes in the previous snapshot's file, which
+	// would materialize them.
+	std::shared_ptr<MemorySnapshot> previousSnapshot = memory->snapshot;
+	std::vector<bool> isWrittenPage;
+	if(previousSnapshot && !getPagesWrittenSinceSnapshot(memory, isWrittenPage))
+	{ previousSnapshot = nullptr; }
+
+	const Uptr platformPagesPerPageLog2 = getPlatformPagesPerWebAssemblyPageLog2();
+	const Uptr numStagingPlatformPages = numSnapshotChunkPages << platformPagesPerPageLog2;
+	U8* stagingAddress = Platform::allocateVirtualPages(numStagingPlatformPages);
+	if(!stagingAddress) { return false; }
+
+	bool succeeded = true;
+	for(Uptr chunkPageIndex = 0; succeeded && chunkPageIndex < numPages;
+		chunkPageIndex += numSnapshotChunkPages)
+	{
+		const Uptr numChunkPages = std::min(numSnapshotChunkPages, numPages - chunkPageIndex);
+		const Uptr chunkOffset = chunkPageIndex * IR::numBytesPerPage;
+
+		// Map the chunk of the file at the staging address, and copy the memory's pages that
+		// aren't all zero to it.
+		if(!Platform::mapMemoryFile(snapshot->file,
+									chunkOffset,
+									stagingAddress,
+									numChunkPages << platformPagesPerPageLog2,
+									false))
+		{
+			succeeded = false;
+			break;
+		}
+		for(Uptr pageIndex = chunkPageIndex; pageIndex < chunkPageIndex + numChunkPages;
+			++pageIndex)
+		{
+			if(previousSnapshot && pageIndex < previousSnapshot->numPages
+			   && !previousSnapshot->isNonZeroPage[pageIndex] && !isWrittenPage[pageIndex])
+			{ continue; }
+
+			const U8* page = memory->baseAddress + pageIndex * IR::numBytesPerPage;
+			if(!isZeroPage(page))
+			{
+				memcpy(stagingAddress + (pageIndex - chunkPageIndex) * IR::numBytesPerPage,
+					   page,
+					   IR::numBytesPerPage);
+				snapshot->isNonZeroPage[pageIndex] = true;
+			}
+		}
+
+		// Replace the chunk of the memory with a copy-on-write mapping of the file, which frees the
+		// memory's copy of the pages.
+		if(!Platform::mapMemoryFile(snapshot->file,
+									chunkOffset,
+									memory->baseAddress + chunkOffset,
+									numChunkPages << platformPagesPerPageLog2,
+									true))
+		{
+			Errors::fatalf("Failed to map memory snapshot over the pages of memory %s",
+						   memory->debugName.c_str());
+		}
+	}
+	Platform::freeVirtualPages(stagingAddress, numStagingPlatformPages);
+
+	// If the snapshot couldn't be completed, the memory's pages that were already remapped still
+	// have the same contents, but the memory no longer matches any snapshot.
+	memory->snapshot = succeeded ? snapshot : nullptr;
+	return succeeded;
+}
+
+Memory* Runtime::cloneMemory(Memory* memory,
+							 Compartment* newCompartment,
+							 MemoryCloneMode cloneMode)
+{
 	Platform::RWMutex::ExclusiveLock resizingLock(memory->resizingMutex);
 	const Uptr numPages = memory->numPages.load(std::memory_order_acquire);
 	std::string debugName = memory->debugName;
-	Memory* newMemory = createMemoryImpl(
-		newCompartment, memory->type, numPages, std::move(debugName), memory->resourceQuota);
+	Memory* newMemory = createMemoryImpl(newCompartment,
+										 memory->type,
+										 numPages,
+										 std::move(debugName),
+										 memory->resourceQuota,
+										 memory->numReservedBytes);
 	if(!newMemory) { return nullptr; }
 
-	// Copy the memory contents to the new memory.
-	if(copyContents) {
-	    memcpy(newMemory->baseAddress, memory->baseAddress, numPages * IR::numBytesPerPage);
+	// Map a snapshot of the memory copy-on-write into the new memory, or fall back to copying it.
+	// The snapshot is reused for later clones until the memory is written.
+	bool isMappedCopyOnWrite = false;
+	if(cloneMode == MemoryCloneMode::copyOnWrite && numPages > 0
+	   && (isMemorySnapshotCurrent(memory, numPages) || takeMemorySnapshot(memory, numPages)))
+	{
+		isMappedCopyOnWrite
+			= Platform::mapMemoryFile(memory->snapshot->file,
+									  0,
+									  newMemory->baseAddress,
+									  numPages << getPlatformPagesPerWebAssemblyPageLog2(),
+									  true);
+		if(isMappedCopyOnWrite) { newMemory->snapshot = memory->snapshot; }
 	}
+	if(!isMappedCopyOnWrite && cloneMode != MemoryCloneMode::none)
+	{ memcpy(newMemory->baseAddress, memory->baseAddress, numPages * IR::numBytesPerPage); }
 
 	resizingLock.unlock();
 
@@ -145,25 +440,24 @@ Runtime::Memory::~Memory()
 		compartment->runtimeData->memories[id].numPages.store(0, std::memory_order_release);
 	}
 
-	// Remove the memory from the global array.
-	{
-		Platform::RWMutex::ExclusiveLock memoriesLock(memoriesMutex);
-		for(Uptr memoryIndex = 0; memoryIndex < memories.size(); ++memoryIndex)
-		{
-			if(memories[memoryIndex] == this)
-			{
-				memories.erase(memories.begin() + memoryIndex);
-				break;
-			}
-		}
-	}
+	// Remove the memory from the global address index.
+	if(baseAddress) { memoryAddressIndex.remove(reinterpret_cast<Uptr>(baseAddress)); }
 
-	// Free the virtual address space.
+	// Free the virtual address space, or return it to the reservation pool.
 	const Uptr pageBytesLog2 = Platform::getBytesPerPageLog2();
 	if(numReservedBytes > 0)
 	{
-		Platform::freeVirtualPages(baseAddress,
-								   (numReservedBytes >> pageBytesLog2) + numGuardPages);
+		if(requiresBoundsChecks)
+		{
+			Platform::freeVirtualPages(baseAddress,
+									   (numReservedBytes >> pageBytesLog2) + numGuardPages);
+		}
+		else
+		{
+			releaseMemoryReservation(baseAddress,
+									 numPages.load(std::memory_order_acquire)
+										 << getPlatformPagesPerWebAssemblyPageLog2());
+		}
 
 		Platform::deregisterVirtualAllocation(numPages >> pageBytesLog2);
 	}
@@ -174,21 +468,13 @@ Runtime::Memory::~Memory()
 
 bool Runtime::isAddressOwnedByMemory(U8* address, Memory*& outMemory, Uptr& outMemoryAddress)
 {
-	// Iterate over all memories and check if the address is within the reserved address space for
-	// each.
-	Platform::RWMutex::ShareableLock memoriesLock(memoriesMutex);
-	for(auto memory : memories)
-	{
-		U8* startAddress = memory->baseAddress;
-		U8* endAddress = memory->baseAddress + memory->numReservedBytes;
-		if(address >= startAddress && address < endAddress)
-		{
-			outMemory = memory;
-			outMemoryAddress = address - startAddress;
-			return true;
-		}
-	}
-	return false;
+	// Look up the memory whose reserved address space contains the address.
+	Uptr baseAddress = 0;
+	if(!memoryAddressIndex.lookup(reinterpret_cast<Uptr>(address), outMemory, baseAddress))
+	{ return false; }
+
+	outMemoryAddress = reinterpret_cast<Uptr>(address) - baseAddress;
+	return true;
 }
 
 Uptr Runtime::getMemoryNumPages(const Memory* memory)
@@ -221,16 +507,24 @@ GrowResult Runtime::growMemory(Memory* memory, Uptr numPagesToGrow, Uptr* outOld
 			return GrowResult::outOfMaxSize;
 		}
 
-		// Try to commit the new pages, and return GrowResult::outOfMemory if the commit fails.
-		if(!Platform::commitVirtualPages(
-			   memory->baseAddress + oldNumPages * IR::numBytesPerPage,
-			   numPagesToGrow << getPlatformPagesPerWebAssemblyPageLog2()))
+		// Memories that require bounds checks can't grow beyond their reserved address space.
+		if((oldNumPages + numPagesToGrow) * IR::numBytesPerPage > memory->numReservedBytes)
 		{
 			if(memory->resourceQuota) { memory->resourceQuota->memoryPages.free(numPagesToGrow); }
 			return GrowResult::outOfMemory;
 		}
-		Platform::registerVirtualAllocation(numPagesToGrow
-											<< getPlatformPagesPerWebAssemblyPageLog2());
+
+		// Try to commit the new pages, and return GrowResult::outOfMemory if the commit fails. The
+		// new pages aren't part of the memory's snapshot, if it has one.
+		const Uptr numPlatformPagesToGrow = numPagesToGrow
+											<< getPlatformPagesPerWebAssemblyPageLog2();
+		if(!Platform::commitVirtualPages(memory->baseAddress + oldNumPages * IR::numBytesPerPage,
+										 numPlatformPagesToGrow))
+		{
+			if(memory->resourceQuota) { memory->resourceQuota->memoryPages.free(numPagesToGrow); }
+			return GrowResult::outOfMemory;
+		}
+		Platform::registerVirtualAllocation(numPlatformPagesToGrow);
 
 		const Uptr newNumPages = oldNumPages + numPagesToGrow;
 		memory->numPages.store(newNumPages, std::memory_order_release);
@@ -250,9 +544,12 @@ void Runtime::unmapMemoryPages(Memory* memory, Uptr pageIndex, Uptr numPages)
 	WAVM_ASSERT(pageIndex + numPages > pageIndex);
 	WAVM_ASSERT((pageIndex + numPages) * IR::numBytesPerPage <= memory->numReservedBytes);
 
-	// Decommit the pages.
+	// Decommit the pages. They're replaced by anonymous pages that can't be distinguished from
+	// pages mapped from the memory's snapshot, so the snapshot can't be reused for clones.
+	Platform::RWMutex::ExclusiveLock resizingLock(memory->resizingMutex);
 	Platform::decommitVirtualPages(memory->baseAddress + pageIndex * IR::numBytesPerPage,
 								   numPages << getPlatformPagesPerWebAssemblyPageLog2());
+	memory->snapshot = nullptr;
 
 	Platform::deregisterVirtualAllocation(numPages << getPlatformPagesPerWebAssemblyPageLog2());
 }
@@ -325,6 +622,181 @@ void Runtime::initDataSegment(Instance* instance,
 	}
 }
 
+static std::atomic<bool> useDataSegmentImages{false};
+
+void Runtime::setDataSegmentImages(bool enable)
+{
+	useDataSegmentImages.store(enable, std::memory_order_relaxed);
+}
+
+Runtime::DataSegmentImage::~DataSegmentImage()
+{
+	if(file) { Platform::destroyMemoryFile(file); }
+}
+
+// Builds the image of a module's active data segments for one of its memory definitions. Returns
+// null if the segments can't be mapped, or if no page is entirely written by a segment.
+static std::unique_ptr<DataSegmentImage> createDataSegmentImage(const Runtime::Module* module,
+																Uptr memoryDefIndex)
+{
+	const IR::Module& irModule = module->ir;
+	const Uptr memoryIndex = irModule.memories.imports.size() + memoryDefIndex;
+	const U64 numMemoryBytes
+		= irModule.memories.defs[memoryDefIndex].type.size.min * IR::numBytesPerPage;
+
+	// The segments must have constant offsets that are within the memory's initial size, so they
+	// don't depend on the instance's imports, and can't trap.
+	std::vector<Uptr> segmentIndices;
+	Uptr numPages = 0;
+	for(Uptr segmentIndex = 0; segmentIndex < irModule.dataSegments.size(); ++segmentIndex)
+	{
+		const IR::DataSegment& dataSegment = irModule.dataSegments[segmentIndex];
+		if(!dataSegment.isActive || dataSegment.memoryIndex != memoryIndex) { continue; }
+		if(dataSegment.baseOffset.type != IR::InitializerExpression::Type::i32_const)
+		{ return nullptr; }
+
+		const U64 endAddress = U64(U32(dataSegment.baseOffset.i32)) + dataSegment.data->size();
+		if(endAddress > numMemoryBytes) { return nullptr; }
+
+		segmentIndices.push_back(segmentIndex);
+		numPages = std::max(numPages,
+							Uptr((endAddress + IR::numBytesPerPage - 1) / IR::numBytesPerPage));
+	}
+
+	// Find the pages that are entirely written by a segment.
+	std::vector<bool> isWholePage(numPages, false);
+	bool hasWholePages = false;
+	for(Uptr segmentIndex : segmentIndices)
+	{
+		const IR::DataSegment& dataSegment = irModule.dataSegments[segmentIndex];
+		const Uptr beginAddress = U32(dataSegment.baseOffset.i32);
+		const Uptr endAddress = beginAddress + dataSegment.data->size();
+		for(Uptr pageIndex = (beginAddress + IR::numBytesPerPage - 1) / IR::numBytesPerPage;
+			pageIndex < endAddress / IR::numBytesPerPage;
+			++pageIndex)
+		{
+			isWholePage[pageIndex] = true;
+			hasWholePages = true;
+		}
+	}
+	if(!hasWholePages) { return nullptr; }
+
+	std::unique_ptr<DataSegmentImage> image(new DataSegmentImage);
+	image->numPages = numPages;
+	image->file = Platform::createMemoryFile("data segment image", numPages * IR::numBytesPerPage);
+	if(!image->file) { return nullptr; }
+
+	// Map the file at a temporary address, and apply the segments in order: the parts of segments
+	// that write to whole pages are copied to the file, and the other parts are recorded to be
+	// copied when the image is used.
+	const Uptr numPlatformPages = numPages << getPlatformPagesPerWebAssemblyPageLog2();
+	U8* stagingAddress = Platform::allocateVirtualPages(numPlatformPages);
+	if(!stagingAddress) { return nullptr; }
+	if(!Platform::mapMemoryFile(image->file, 0, stagingAddress, numPlatformPages, false))
+	{
+		Platform::freeVirtualPages(stagingAddress, numPlatformPages);
+		return nullptr;
+	}
+	for(Uptr segmentIndex : segmentIndices)
+	{
+		const IR::DataSegment& dataSegment = irModule.dataSegments[segmentIndex];
+		const Uptr beginAddress = U32(dataSegment.baseOffset.i32);
+		const Uptr endAddress = beginAddress + dataSegment.data->size();
+		for(Uptr pageIndex = beginAddress / IR::numBytesPerPage;
+			pageIndex * IR::numBytesPerPage < endAddress;
+			++pageIndex)
+		{
+			const Uptr copyBeginAddress = std::max(beginAddress, pageIndex * IR::numBytesPerPage);
+			const Uptr copyEndAddress = std::min(endAddress, (pageIndex + 1) * IR::numBytesPerPage);
+			const Uptr sourceOffset = copyBeginAddress - beginAddress;
+			const Uptr numBytes = copyEndAddress - copyBeginAddress;
+			if(isWholePage[pageIndex])
+			{
+				memcpy(stagingAddress + copyBeginAddress,
+					   dataSegment.data->data() + sourceOffset,
+					   numBytes);
+			}
+			else if(image->partialPageCopies.size()
+					&& image->partialPageCopies.back().dataSegmentIndex == segmentIndex
+					&& image->partialPageCopies.back().destAddress
+								   + image->partialPageCopies.back().numBytes
+							   == copyBeginAddress)
+			{
+				image->partialPageCopies.back().numBytes += numBytes;
+			}
+			else
+			{
+				image->partialPageCopies.push_back(
+					{segmentIndex, copyBeginAddress, sourceOffset, numBytes});
+			}
+		}
+	}
+	Platform::freeVirtualPages(stagingAddress, numPlatformPages);
+
+	for(Uptr pageIndex = 0; pageIndex < numPages; ++pageIndex)
+	{
+		if(!isWholePage[pageIndex]) { continue; }
+		if(image->wholePageRuns.size()
+		   && image->wholePageRuns.back().firstPageIndex + image->wholePageRuns.back().numPages
+				  == pageIndex)
+		{ ++image->wholePageRuns.back().numPages; }
+		else
+		{
+			image->wholePageRuns.push_back({pageIndex, 1});
+		}
+	}
+
+	return image;
+}
+
+static const DataSegmentImage* getDataSegmentImage(const Runtime::Module* module,
+												   Uptr memoryDefIndex)
+{
+	Platform::Mutex::Lock dataSegmentImagesLock(module->dataSegmentImagesMutex);
+	if(!module->hasBuiltDataSegmentImages)
+	{
+		Timing::Timer timer;
+		for(Uptr defIndex = 0; defIndex < module->ir.memories.defs.size(); ++defIndex)
+		{ module->dataSegmentImages.push_back(createDataSegmentImage(module, defIndex)); }
+		module->hasBuiltDataSegmentImages = true;
+		Timing::logTimer("Built data segment images", timer);
+	}
+	return module->dataSegmentImages[memoryDefIndex].get();
+}
+
+bool Runtime::initMemoryFromDataSegmentImage(ModuleConstRefParam module,
+											 Memory* memory,
+											 Uptr memoryDefIndex)
+{
+	if(!useDataSegmentImages.load(std::memory_order_relaxed)) { return false; }
+
+	const DataSegmentImage* image = getDataSegmentImage(module.get(), memoryDefIndex);
+	if(!image || getMemoryNumPages(memory) < image->numPages) { return false; }
+
+	// Map the whole pages of the image copy-on-write. If that fails, the caller copies all the
+	// segments, which overwrites any pages that were already mapped with the same contents.
+	for(const DataSegmentImage::PageRun& run : image->wholePageRuns)
+	{
+		if(!Platform::mapMemoryFile(image->file,
+									run.firstPageIndex * IR::numBytesPerPage,
+									memory->baseAddress + run.firstPageIndex * IR::numBytesPerPage,
+									run.numPages << getPlatformPagesPerWebAssemblyPageLog2(),
+									true))
+		{ return false; }
+	}
+
+	// Copy the parts of the segments that write to partial pages. The memory was just created by
+	// the instance, so it can't be accessed concurrently.
+	for(const DataSegmentImage::PartialPageCopy& copy : image->partialPageCopies)
+	{
+		const std::vector<U8>& data = *module->ir.dataSegments[copy.dataSegmentIndex].data;
+		memcpy(
+			memory->baseAddress + copy.destAddress, data.data() + copy.sourceOffset, copy.numBytes);
+	}
+
+	return true;
+}
+
 WAVM_DEFINE_INTRINSIC_FUNCTION(wavmIntrinsicsMemory,
 							   "memory.grow",
 							   I32,
@@ -397,7 +869,7 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wavmIntrinsics,
 							   "memoryOutOfBoundsTrap",
 							   void,
 							   outOfBoundsMemoryFillTrap,
-							   U32 address,
+							   U64 address,
 							   U32 numBytes,
 							   U64 memoryNumPages,
 							   U64 memoryId)
@@ -408,7 +880,7 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wavmIntrinsics,
 	compartmentLock.unlock();
 
 	const U64 memoryNumBytes = memoryNumPages * IR::numBytesPerPage;
-	const U64 outOfBoundsAddress = U64(address) > memoryNumBytes ? U64(address) : memoryNumBytes;
+	const U64 outOfBoundsAddress = address > memoryNumBytes ? address : memoryNumBytes;
 
 	throwException(ExceptionTypes::outOfBoundsMemoryAccess, {memory, outOfBoundsAddress});
 }
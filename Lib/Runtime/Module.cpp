@@ -1,16 +1,37 @@
 #include "WAVM/IR/Module.h"
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <list>
 #include <memory>
 #include <utility>
 #include "RuntimePrivate.h"
+#include "WAVM/IR/FeatureSpec.h"
 #include "WAVM/IR/IR.h"
 #include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Inline/Errors.h"
+#include "WAVM/Inline/Hash.h"
+#include "WAVM/Inline/HashMap.h"
 #include "WAVM/Inline/Timing.h"
 #include "WAVM/LLVMJIT/LLVMJIT.h"
 #include "WAVM/Platform/Intrinsic.h"
+#include "WAVM/Platform/Mutex.h"
 #include "WAVM/Platform/RWMutex.h"
+#include "WAVM/Platform/Thread.h"
 #include "WAVM/Runtime/Runtime.h"
 #include "WAVM/WASM/WASM.h"
 
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4804)
+#endif
+
+#include "blake2.h"
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
 using namespace WAVM;
 using namespace WAVM::IR;
 using namespace WAVM::Runtime;
@@ -30,16 +51,65 @@ static std::shared_ptr<ObjectCacheInterface> getGlobalObjectCache()
 	return globalObjectCache;
 }
 
+static std::atomic<Uptr> numCompileShards{1};
+
+void Runtime::setNumCompileShards(Uptr numShards)
+{
+	WAVM_ERROR_UNLESS(numShards > 0);
+	numCompileShards.store(numShards, std::memory_order_relaxed);
+}
+
+static std::atomic<bool> tieredCompilation{false};
+static std::atomic<U32> numCallsToTierUp{1000};
+
+void Runtime::setTieredCompilation(bool enable, U32 inNumCallsToTierUp)
+{
+	WAVM_ERROR_UNLESS(inNumCallsToTierUp > 0);
+	numCallsToTierUp.store(inNumCallsToTierUp, std::memory_order_relaxed);
+	tieredCompilation.store(enable, std::memory_order_relaxed);
+}
+
+U32 Runtime::getNumCallsToTierUp() { return numCallsToTierUp.load(std::memory_order_relaxed); }
+
+static std::atomic<LLVMJIT::OptimizationLevel> optimizationLevel{
+	LLVMJIT::OptimizationLevel::standard};
+
+void Runtime::setOptimizationLevel(LLVMJIT::OptimizationLevel inOptimizationLevel)
+{
+	optimizationLevel.store(inOptimizationLevel, std::memory_order_relaxed);
+}
+
+LLVMJIT::TargetSpec Runtime::getCompileTargetSpec(bool boundsCheckMemoryAccesses)
+{
+	LLVMJIT::TargetSpec targetSpec = LLVMJIT::getHostTargetSpec();
+	targetSpec.optimizationLevel = optimizationLevel.load(std::memory_order_relaxed);
+	targetSpec.boundsCheckMemoryAccesses = boundsCheckMemoryAccesses;
+	return targetSpec;
+}
+
+static std::vector<U8> compileObjectCode(const IR::Module& irModule, bool boundsCheckMemoryAccesses)
+{
+	return LLVMJIT::compileModule(irModule,
+								  getCompileTargetSpec(boundsCheckMemoryAccesses),
+								  numCompileShards.load(std::memory_order_relaxed),
+								  tieredCompilation.load(std::memory_order_relaxed)
+									  ? LLVMJIT::CompileTier::baseline
+									  : LLVMJIT::CompileTier::optimized);
+}
+
 ModuleRef Runtime::compileModule(const IR::Module& irModule)
 {
-	// Get a pointer to the global object cache, if there is one.
-	std::shared_ptr<ObjectCacheInterface> objectCache = getGlobalObjectCache();
+	// Get a pointer to the global object cache, if there is one. It isn't used for modules
+	// compiled with memory bounds checks.
+	const bool boundsCheckMemoryAccesses = getMemoryBoundsChecks();
+	std::shared_ptr<ObjectCacheInterface> objectCache
+		= boundsCheckMemoryAccesses ? nullptr : getGlobalObjectCache();
 
-	std::vector<U8> objectCode;
+	std::shared_ptr<const ObjectCodeView> objectCode;
 	if(!objectCache)
 	{
 		// If there's no global object cache, just compile the module.
-		objectCode = LLVMJIT::compileModule(irModule, LLVMJIT::getHostTargetSpec());
+		objectCode = createObjectCodeView(compileObjectCode(irModule, boundsCheckMemoryAccesses));
 	}
 	else
 	{
@@ -50,50 +120,448 @@ ModuleRef Runtime::compileModule(const IR::Module& irModule)
 
 		// Check for cached object code for the module before compiling it.
 		objectCode
-			= objectCache->getCachedObject(wasmBytes.data(), wasmBytes.size(), [&irModule]() {
-				  return LLVMJIT::compileModule(irModule, LLVMJIT::getHostTargetSpec());
+			= objectCache->getCachedObjectView(wasmBytes.data(), wasmBytes.size(), [&irModule]() {
+				  return compileObjectCode(irModule, false);
 			  });
 	}
 
-	return std::make_shared<Runtime::Module>(IR::Module(irModule), std::move(objectCode));
+	return std::make_shared<Runtime::Module>(
+		IR::Module(irModule), std::move(objectCode), boundsCheckMemoryAccesses);
 }
 
-bool Runtime::loadBinaryModule(const U8* wasmBytes,
-							   Uptr numWASMBytes,
-							   ModuleRef& outModule,
-							   const IR::FeatureSpec& featureSpec,
-							   WASM::LoadError* outError)
+// The key for a module in the module cache: a hash of the binary module, the feature spec it was
+// loaded with, and the compilation settings.
+struct ModuleCacheKey
+{
+	U8 hashBytes[16];
+
+	friend bool operator==(const ModuleCacheKey& left, const ModuleCacheKey& right)
+	{
+		return !memcmp(left.hashBytes, right.hashBytes, sizeof(hashBytes));
+	}
+};
+
+namespace WAVM {
+	template<> struct Hash<ModuleCacheKey>
+	{
+		Uptr operator()(const ModuleCacheKey& key, Uptr seed = 0) const
+		{
+			return Uptr(XXH<U64>(key.hashBytes, sizeof(key.hashBytes), U64(seed)));
+		}
+	};
+}
+
+// A process-wide LRU cache of modules loaded by loadBinaryModule.
+struct ModuleCache
+{
+	Platform::Mutex mutex;
+	std::atomic<Uptr> maxModules{0};
+
+	// The cached modules, ordered from most to least recently used.
+	typedef std::list<std::pair<ModuleCacheKey, ModuleRef>> ModuleList;
+	ModuleList modules;
+	HashMap<ModuleCacheKey, ModuleList::iterator> keyToModuleMap;
+
+	Uptr numHits = 0;
+	Uptr numMisses = 0;
+	Uptr numEvictions = 0;
+
+	static ModuleCache& get()
+	{
+		static ModuleCache moduleCache;
+		return moduleCache;
+	}
+
+	void evictToCapacity()
+	{
+		while(modules.size() > maxModules.load(std::memory_order_relaxed))
+		{
+			keyToModuleMap.removeOrFail(modules.back().first);
+			modules.pop_back();
+			++numEvictions;
+		}
+	}
+};
+
+template<typename Value> static void updateModuleCacheKey(blake2b_state& state, const Value& value)
+{
+	if(blake2b_update(&state, &value, sizeof(Value))) { Errors::fatal("blake2b error"); }
+}
+
+static ModuleCacheKey getModuleCacheKey(const U8* wasmBytes,
+										Uptr numWASMBytes,
+										const IR::FeatureSpec& featureSpec)
+{
+	blake2b_state state;
+	if(blake2b_init(&state, sizeof(ModuleCacheKey::hashBytes))
+	   || blake2b_update(&state, wasmBytes, numWASMBytes))
+	{ Errors::fatal("blake2b error"); }
+
+#define VISIT_FEATURE(name, ...) updateModuleCacheKey(state, featureSpec.name);
+	WAVM_ENUM_MATURE_FEATURES(VISIT_FEATURE)
+	WAVM_ENUM_PROPOSED_FEATURES(VISIT_FEATURE)
+	WAVM_ENUM_NONSTANDARD_FEATURES(VISIT_FEATURE)
+	WAVM_ENUM_INTERNAL_FEATURES(VISIT_FEATURE)
+#undef VISIT_FEATURE
+	updateModuleCacheKey(state, featureSpec.maxLocals);
+	updateModuleCacheKey(state, featureSpec.maxLabelsPerFunction);
+	updateModuleCacheKey(state, featureSpec.maxDataSegments);
+	updateModuleCacheKey(state, featureSpec.maxSyntaxRecursion);
+
+	updateModuleCacheKey(state, tieredCompilation.load(std::memory_order_relaxed));
+	updateModuleCacheKey(state, optimizationLevel.load(std::memory_order_relaxed));
+	updateModuleCacheKey(state, getMemoryBoundsChecks());
+
+	ModuleCacheKey key;
+	if(blake2b_final(&state, key.hashBytes, sizeof(key.hashBytes)))
+	{ Errors::fatal("blake2b error"); }
+	return key;
+}
+
+void Runtime::setModuleCacheCapacity(Uptr maxModules)
+{
+	ModuleCache& moduleCache = ModuleCache::get();
+	Platform::Mutex::Lock moduleCacheLock(moduleCache.mutex);
+	moduleCache.maxModules.store(maxModules, std::memory_order_relaxed);
+	moduleCache.evictToCapacity();
+}
+
+ModuleCacheStats Runtime::getModuleCacheStats()
+{
+	ModuleCache& moduleCache = ModuleCache::get();
+	Platform::Mutex::Lock moduleCacheLock(moduleCache.mutex);
+	return ModuleCacheStats{moduleCache.modules.size(),
+							moduleCache.numHits,
+							moduleCache.numMisses,
+							moduleCache.numEvictions};
+}
+
+static bool loadAndCompileBinaryModule(const U8* wasmBytes,
+									   Uptr numWASMBytes,
+									   ModuleRef& outModule,
+									   const IR::FeatureSpec& featureSpec,
+									   WASM::LoadError* outError)
 {
 	// Load the module IR.
 	IR::Module irModule(std::move(featureSpec));
 	if(!WASM::loadBinaryModule(wasmBytes, numWASMBytes, irModule, outError)) { return false; }
 
-	// Get a pointer to the global object cache, if there is one.
-	std::shared_ptr<ObjectCacheInterface> objectCache = getGlobalObjectCache();
+	// Get a pointer to the global object cache, if there is one. It isn't used for modules
+	// compiled with memory bounds checks.
+	const bool boundsCheckMemoryAccesses = getMemoryBoundsChecks();
+	std::shared_ptr<ObjectCacheInterface> objectCache
+		= boundsCheckMemoryAccesses ? nullptr : getGlobalObjectCache();
 
-	std::vector<U8> objectCode;
+	std::shared_ptr<const ObjectCodeView> objectCode;
 	if(!objectCache)
 	{
 		// If there's no global object cache, just compile the module.
-		objectCode = LLVMJIT::compileModule(irModule, LLVMJIT::getHostTargetSpec());
+		objectCode = createObjectCodeView(compileObjectCode(irModule, boundsCheckMemoryAccesses));
 	}
 	else
 	{
 		// Check for cached object code for the module before compiling it.
-		objectCode = objectCache->getCachedObject(wasmBytes, numWASMBytes, [&irModule]() {
-			return LLVMJIT::compileModule(irModule, LLVMJIT::getHostTargetSpec());
+		objectCode = objectCache->getCachedObjectView(wasmBytes, numWASMBytes, [&irModule]() {
+			return compileObjectCode(irModule, false);
 		});
 	}
 
-	outModule = std::make_shared<Runtime::Module>(std::move(irModule), std::move(objectCode));
+	outModule = std::make_shared<Runtime::Module>(
+		std::move(irModule), std::move(objectCode), boundsCheckMemoryAccesses);
 	return true;
 }
 
+bool Runtime::loadBinaryModule(const U8* wasmBytes,
+							   Uptr numWASMBytes,
+							   ModuleRef& outModule,
+							   const IR::FeatureSpec& featureSpec,
+							   WASM::LoadError* outError)
+{
+	// If the module cache is disabled, just load the module.
+	ModuleCache& moduleCache = ModuleCache::get();
+	if(!moduleCache.maxModules.load(std::memory_order_relaxed))
+	{ return loadAndCompileBinaryModule(wasmBytes, numWASMBytes, outModule, featureSpec, outError); }
+
+	// Look for the module in the cache.
+	Timing::Timer lookupTimer;
+	const ModuleCacheKey key = getModuleCacheKey(wasmBytes, numWASMBytes, featureSpec);
+	{
+		Platform::Mutex::Lock moduleCacheLock(moduleCache.mutex);
+		if(auto moduleIt = moduleCache.keyToModuleMap.get(key))
+		{
+			// Move the module to the front of the LRU list.
+			moduleCache.modules.splice(moduleCache.modules.begin(), moduleCache.modules, *moduleIt);
+			outModule = (*moduleIt)->second;
+			++moduleCache.numHits;
+			Timing::logTimer("Loaded module from the module cache", lookupTimer);
+			return true;
+		}
+		++moduleCache.numMisses;
+	}
+
+	// If the module wasn't in the cache, load it, and add it to the cache.
+	if(!loadAndCompileBinaryModule(wasmBytes, numWASMBytes, outModule, featureSpec, outError))
+	{ return false; }
+
+	Platform::Mutex::Lock moduleCacheLock(moduleCache.mutex);
+	if(!moduleCache.keyToModuleMap.contains(key))
+	{
+		moduleCache.modules.emplace_front(key, outModule);
+		moduleCache.keyToModuleMap.addOrFail(key, moduleCache.modules.begin());
+		moduleCache.evictToCapacity();
+	}
+	return true;
+}
+
+// A streaming module loader compiles the function definitions it has loaded in batches of at
+// least this many bytes of IR code, and at least 1/maxStreamingCompileBatches of the module's
+// function definitions. Each batch is compiled to an object file that declares all the module's
+// functions, so the number of batches is limited to bound that overhead.
+static constexpr Uptr minStreamingCompileBatchNumCodeBytes = 256 * 1024;
+static constexpr Uptr maxStreamingCompileBatches = 64;
+
+// LLVM's code generator may recurse deeply, so give the threads that compile streamed modules a
+// larger stack than the default.
+static constexpr Uptr streamingCompileThreadNumStackBytes = 8 * 1024 * 1024;
+
+namespace WAVM { namespace Runtime {
+	struct StreamingModuleLoader
+	{
+		IR::Module irModule;
+
+		// If the module is compiled while it is being loaded, the streaming WASM loader.
+		// Otherwise, the bytes that have been fed so far.
+		WASM::StreamingLoader* wasmLoader = nullptr;
+		std::vector<U8> wasmBytes;
+
+		const bool boundsCheckMemoryAccesses;
+		const LLVMJIT::TargetSpec targetSpec;
+		const LLVMJIT::CompileTier tier;
+		const Uptr maxCompileThreads;
+		const bool compileInBatches;
+
+		// The loaded function definitions that haven't been added to a batch yet.
+		std::vector<Uptr> pendingFunctionDefIndices;
+		Uptr pendingNumCodeBytes = 0;
+
+		// The batches of function definitions, and the object file compiled for each batch. The
+		// compile threads exit when there are no more batches waiting to be compiled.
+		Platform::Mutex mutex;
+		std::vector<std::vector<Uptr>> batchFunctionDefIndices;
+		std::vector<std::vector<U8>> batchObjectFiles;
+		Uptr nextBatchIndex = 0;
+		Uptr numRunningThreads = 0;
+		bool isCancelled = false;
+		std::vector<Platform::Thread*> threads;
+
+		StreamingModuleLoader(const IR::FeatureSpec& featureSpec, bool inBoundsCheckMemoryAccesses)
+		: irModule(featureSpec)
+		, boundsCheckMemoryAccesses(inBoundsCheckMemoryAccesses)
+		, targetSpec(getCompileTargetSpec(inBoundsCheckMemoryAccesses))
+		, tier(tieredCompilation.load(std::memory_order_relaxed)
+				   ? LLVMJIT::CompileTier::baseline
+				   : LLVMJIT::CompileTier::optimized)
+		, maxCompileThreads(std::min(numCompileShards.load(std::memory_order_relaxed),
+									 Platform::getNumberOfHardwareThreads()))
+		, compileInBatches(LLVMJIT::canShardModules(targetSpec))
+		{
+		}
+
+		~StreamingModuleLoader()
+		{
+			// Stop compiling, and wait for the compile threads to exit.
+			{
+				Platform::Mutex::Lock lock(mutex);
+				isCancelled = true;
+			}
+			joinCompileThreads();
+
+			if(wasmLoader) { WASM::destroyStreamingLoader(wasmLoader); }
+		}
+
+		void onFunctionDefLoaded(Uptr functionDefIndex);
+		void addPendingBatch();
+		void joinCompileThreads();
+	};
+}}
+
+static I64 streamingCompileThreadEntry(void* loaderVoid)
+{
+	StreamingModuleLoader& loader = *(StreamingModuleLoader*)loaderVoid;
+	while(true)
+	{
+		Uptr batchIndex;
+		std::vector<Uptr> functionDefIndices;
+		{
+			Platform::Mutex::Lock lock(loader.mutex);
+			if(loader.isCancelled || loader.nextBatchIndex == loader.batchFunctionDefIndices.size())
+			{
+				--loader.numRunningThreads;
+				break;
+			}
+			batchIndex = loader.nextBatchIndex++;
+			functionDefIndices = loader.batchFunctionDefIndices[batchIndex];
+		}
+
+		// The WASM loader doesn't modify the function definitions in a batch, or the sections
+		// that precede the code section, after passing them to onFunctionDefLoaded.
+		std::vector<U8> objectFile = LLVMJIT::compileModuleShard(
+			loader.irModule, loader.targetSpec, functionDefIndices, loader.tier);
+
+		Platform::Mutex::Lock lock(loader.mutex);
+		loader.batchObjectFiles[batchIndex] = std::move(objectFile);
+	}
+	return 0;
+}
+
+void StreamingModuleLoader::onFunctionDefLoaded(Uptr functionDefIndex)
+{
+	if(!compileInBatches) { return; }
+
+	pendingFunctionDefIndices.push_back(functionDefIndex);
+	pendingNumCodeBytes += irModule.functions.defs[functionDefIndex].code.size();
+
+	const Uptr minBatchNumFunctionDefs = irModule.functions.defs.size() / maxStreamingCompileBatches;
+	if(pendingNumCodeBytes >= minStreamingCompileBatchNumCodeBytes
+	   && pendingFunctionDefIndices.size() >= minBatchNumFunctionDefs)
+	{ addPendingBatch(); }
+}
+
+void StreamingModuleLoader::addPendingBatch()
+{
+	if(!pendingFunctionDefIndices.size()) { return; }
+
+	Platform::Mutex::Lock lock(mutex);
+	batchFunctionDefIndices.push_back(std::move(pendingFunctionDefIndices));
+	batchObjectFiles.emplace_back();
+	pendingFunctionDefIndices.clear();
+	pendingNumCodeBytes = 0;
+
+	// Start another compile thread if there are fewer than the maximum running.
+	if(numRunningThreads < maxCompileThreads)
+	{
+		++numRunningThreads;
+		threads.push_back(Platform::createThread(
+			streamingCompileThreadNumStackBytes, streamingCompileThreadEntry, this));
+	}
+}
+
+void StreamingModuleLoader::joinCompileThreads()
+{
+	for(Platform::Thread* thread : threads) { Platform::joinThread(thread); }
+	threads.clear();
+}
+
+StreamingModuleLoader* Runtime::createStreamingModuleLoader(const IR::FeatureSpec& featureSpec)
+{
+	const bool boundsCheckMemoryAccesses = getMemoryBoundsChecks();
+	StreamingModuleLoader* loader
+		= new StreamingModuleLoader(featureSpec, boundsCheckMemoryAccesses);
+
+	// The module cache and the object cache are keyed by the whole binary module, so if either is
+	// enabled, just save the bytes until they have all been fed, and then use loadBinaryModule.
+	const bool useCache = ModuleCache::get().maxModules.load(std::memory_order_relaxed)
+						  || (!boundsCheckMemoryAccesses && getGlobalObjectCache());
+	if(!useCache)
+	{
+		loader->wasmLoader = WASM::createStreamingLoader(
+			loader->irModule,
+			[loader](Uptr functionDefIndex) { loader->onFunctionDefLoaded(functionDefIndex); });
+	}
+
+	return loader;
+}
+
+void Runtime::destroyStreamingModuleLoader(StreamingModuleLoader* loader) { delete loader; }
+
+bool Runtime::feedStreamingModuleLoader(StreamingModuleLoader* loader,
+										const U8* bytes,
+										Uptr numBytes,
+										WASM::LoadError* outError)
+{
+	if(!loader->wasmLoader)
+	{
+		loader->wasmBytes.insert(loader->wasmBytes.end(), bytes, bytes + numBytes);
+		return true;
+	}
+
+	return WASM::feedStreamingLoader(loader->wasmLoader, bytes, numBytes, outError);
+}
+
+bool Runtime::finishStreamingModuleLoader(StreamingModuleLoader* loader,
+										  ModuleRef& outModule,
+										  WASM::LoadError* outError)
+{
+	if(!loader->wasmLoader)
+	{
+		return loadBinaryModule(loader->wasmBytes.data(),
+								loader->wasmBytes.size(),
+								outModule,
+								loader->irModule.featureSpec,
+								outError);
+	}
+
+	if(!WASM::finishStreamingLoader(loader->wasmLoader, outError)) { return false; }
+
+	// Compile the last batch, and wait for all the batches to be compiled.
+	Timing::Timer compileTimer;
+	loader->addPendingBatch();
+	loader->joinCompileThreads();
+	Timing::logTimer("Finished compiling streamed module", compileTimer);
+
+	std::vector<U8> objectCode;
+	if(!loader->batchObjectFiles.size())
+	{
+		// If the module wasn't compiled in batches, compile it now.
+		objectCode = compileObjectCode(loader->irModule, loader->boundsCheckMemoryAccesses);
+	}
+	else if(loader->batchObjectFiles.size() == 1)
+	{
+		objectCode = std::move(loader->batchObjectFiles[0]);
+	}
+	else
+	{
+		objectCode = LLVMJIT::packObjectFiles(loader->batchObjectFiles);
+	}
+
+	outModule = std::make_shared<Runtime::Module>(std::move(loader->irModule),
+												  createObjectCodeView(std::move(objectCode)),
+												  loader->boundsCheckMemoryAccesses);
+	return true;
+}
+
+// A view of object code that owns the object code.
+struct OwnedObjectCodeView : ObjectCodeView
+{
+	std::vector<U8> ownedBytes;
+
+	OwnedObjectCodeView(std::vector<U8>&& inOwnedBytes)
+	: ObjectCodeView(inOwnedBytes.data(), inOwnedBytes.size()), ownedBytes(std::move(inOwnedBytes))
+	{
+	}
+};
+
+std::shared_ptr<const ObjectCodeView> Runtime::createObjectCodeView(std::vector<U8>&& objectCode)
+{
+	return std::make_shared<OwnedObjectCodeView>(std::move(objectCode));
+}
+
 ModuleRef Runtime::loadPrecompiledModule(const IR::Module& irModule,
 										 const std::vector<U8>& objectCode)
 {
-	return std::make_shared<Module>(IR::Module(irModule), std::vector<U8>(objectCode));
+	return std::make_shared<Module>(IR::Module(irModule),
+									createObjectCodeView(std::vector<U8>(objectCode)));
+}
+
+ModuleRef Runtime::loadPrecompiledModule(IR::Module&& irModule,
+										 std::shared_ptr<const ObjectCodeView>&& objectCode)
+{
+	return std::make_shared<Module>(std::move(irModule), std::move(objectCode));
 }
 
 const IR::Module& Runtime::getModuleIR(ModuleConstRefParam module) { return module->ir; }
-std::vector<U8> Runtime::getObjectCode(ModuleConstRefParam module) { return module->objectCode; }
+std::vector<U8> Runtime::getObjectCode(ModuleConstRefParam module)
+{
+	return std::vector<U8>(module->objectCode->bytes,
+						   module->objectCode->bytes + module->objectCode->numBytes);
+}
@@ -6,9 +6,11 @@
 #include "WAVM/Inline/BasicTypes.h"
 #include "WAVM/Inline/Errors.h"
 #include "WAVM/Inline/Hash.h"
+#include "WAVM/Inline/HashMap.h"
 #include "WAVM/Inline/HashSet.h"
 #include "WAVM/Inline/Timing.h"
 #include "WAVM/Logging/Logging.h"
+#include "WAVM/Platform/Mutex.h"
 #include "WAVM/Platform/RWMutex.h"
 #include "WAVM/Runtime/Runtime.h"
 
@@ -71,12 +73,84 @@ void Runtime::removeGCRoot(const Object* object) noexcept
 	}
 }
 
+// Removes a garbage memory, table, or instance from its compartment, so it may be deleted after
+// the compartment is unlocked. Must be called with the compartment's mutex exclusively locked.
+static void detachFromCompartment(GCObject* object)
+{
+	Compartment* compartment = object->compartment;
+	WAVM_ASSERT_RWMUTEX_IS_EXCLUSIVELY_LOCKED_BY_CURRENT_THREAD(compartment->mutex);
+	switch(object->kind)
+	{
+	case ObjectKind::memory: {
+		Memory* memory = asMemory(object);
+		WAVM_ASSERT(compartment->memories[memory->id] == memory);
+		compartment->memories.removeOrFail(memory->id);
+		compartment->runtimeData->memories[memory->id].base = nullptr;
+		compartment->runtimeData->memories[memory->id].numPages.store(0, std::memory_order_release);
+		memory->id = UINTPTR_MAX;
+		break;
+	}
+	case ObjectKind::table: {
+		Table* table = asTable(object);
+		WAVM_ASSERT(compartment->tables[table->id] == table);
+		compartment->tables.removeOrFail(table->id);
+		compartment->runtimeData->tableBases[table->id] = nullptr;
+		table->id = UINTPTR_MAX;
+		break;
+	}
+	case ObjectKind::instance: {
+		Instance* instance = asInstance(object);
+		WAVM_ASSERT(compartment->instances[instance->id] == instance);
+		compartment->instances.removeOrFail(instance->id);
+		instance->id = UINTPTR_MAX;
+		break;
+	}
+
+	case ObjectKind::global:
+	case ObjectKind::exceptionType:
+	case ObjectKind::context:
+	case ObjectKind::compartment:
+	case ObjectKind::function:
+	case ObjectKind::foreign:
+	case ObjectKind::invalid:
+	default: WAVM_UNREACHABLE();
+	};
+}
+
+static Uptr getNumCompartmentObjects(Compartment* compartment)
+{
+	return compartment->instances.size() + compartment->memories.size()
+		   + compartment->tables.size() + compartment->exceptionTypes.size()
+		   + compartment->globals.size() + compartment->contexts.size();
+}
+
+static bool hasRootReferences(GCObject* object)
+{
+	if(object->numRootReferences > 0) { return true; }
+
+	// Transfer root markings from functions to their instance.
+	if(object->kind == ObjectKind::instance)
+	{
+		for(Function* function : asInstance(object)->functions)
+		{
+			if(function && function->mutableData->numRootReferences) { return true; }
+		}
+	}
+	return false;
+}
+
 struct GCState
 {
 	Compartment* compartment;
 	HashSet<GCObject*> unreferencedObjects;
 	std::vector<GCObject*> pendingScanObjects;
 
+	// The instances and contexts in the compartment when its roots were snapshotted. The
+	// compartment's IndexMaps may change while marking without the compartment locked, so
+	// references are resolved through these instead.
+	HashMap<Uptr, Instance*> instances;
+	std::vector<ContextRuntimeData*> contextRuntimeDatas;
+
 	GCState(Compartment* inCompartment) : compartment(inCompartment) {}
 
 	void visitReference(Object* object)
@@ -85,13 +159,11 @@ struct GCState
 		{
 			if(object->kind == ObjectKind::function)
 			{
+				// Functions of instances that were created after the snapshot aren't looked up:
+				// those instances are scanned by the remark.
 				Function* function = asFunction(object);
-				if(function->instanceId != UINTPTR_MAX)
-				{
-					WAVM_ASSERT(compartment->instances.contains(function->instanceId));
-					Instance* instance = compartment->instances[function->instanceId];
-					visitReference(instance);
-				}
+				Instance* const* instance = instances.get(function->instanceId);
+				if(instance) { visitReference(*instance); }
 			}
 			else if(unreferencedObjects.remove((GCObject*)object))
 			{
@@ -105,9 +177,9 @@ struct GCState
 		for(auto reference : array) { visitReference(asObject(reference)); }
 	}
 
-	void initGCObject(GCObject* object, bool forceRoot = false)
+	void initGCObject(GCObject* object)
 	{
-		if(forceRoot || object->numRootReferences > 0) { pendingScanObjects.push_back(object); }
+		if(hasRootReferences(object)) { pendingScanObjects.push_back(object); }
 		else
 		{
 			unreferencedObjects.add(object);
@@ -140,11 +212,10 @@ struct GCState
 					visitReference(
 						compartment->initialContextMutableGlobals[global->mutableGlobalIndex]
 							.object);
-					for(Context* context : compartment->contexts)
+					for(ContextRuntimeData* contextRuntimeData : contextRuntimeDatas)
 					{
 						visitReference(
-							context->runtimeData->mutableGlobals[global->mutableGlobalIndex]
-								.object);
+							contextRuntimeData->mutableGlobals[global->mutableGlobalIndex].object);
 					}
 				}
 				visitReference(global->initialValue.object);
@@ -175,76 +246,180 @@ struct GCState
 		default: WAVM_UNREACHABLE();
 		};
 	}
+
+	// Scan the objects added to the referenced set so far: gather their child references and
+	// recurse.
+	void scanPendingObjects()
+	{
+		while(pendingScanObjects.size())
+		{
+			GCObject* object = pendingScanObjects.back();
+			pendingScanObjects.pop_back();
+			scanObject(object);
+		};
+	}
 };
 
+// Collects a compartment's garbage in three phases:
+// 1. The compartment's objects and which of them are roots are snapshotted with the compartment's
+//    mutex shareably locked.
+// 2. The objects referenced by the roots are marked without locking the compartment.
+// 3. With the compartment's mutex exclusively locked, the references that may have changed since
+//    they were marked are rescanned, and the remaining unreferenced objects are freed. Memories,
+//    tables, and instances are detached from the compartment, and deleted after it is unlocked.
+//    They are deleted before the collection returns, so their resource quota and address space are
+//    released by then.
 static bool collectGarbageImpl(Compartment* compartment)
 {
-	Platform::RWMutex::ExclusiveLock compartmentLock(compartment->mutex);
+	Platform::Mutex::Lock gcLock(compartment->gcMutex);
 	Timing::Timer timer;
 
 	GCState state(compartment);
 
 	// Initialize the GC state from the compartment's various sets of objects.
-	state.initGCObject(compartment);
-	for(Instance* instance : compartment->instances)
+	Timing::Timer snapshotTimer;
+	Uptr numSnapshotObjects = 0;
 	{
-		if(instance)
+		Platform::RWMutex::ShareableLock compartmentLock(compartment->mutex);
+		Platform::Mutex::Lock contextPoolLock(compartment->contextPoolMutex);
+
+		state.initGCObject(compartment);
+		for(Instance* instance : compartment->instances)
 		{
-			// Transfer root markings from functions to their instance.
-			bool hasRootFunction = false;
-			for(Function* function : instance->functions)
+			if(instance)
 			{
-				if(function && function->mutableData->numRootReferences)
-				{
-					hasRootFunction = true;
-					break;
-				}
+				state.instances.add(instance->id, instance);
+				state.initGCObject(instance);
 			}
-
-			state.initGCObject(instance, hasRootFunction);
 		}
+		for(Memory* memory : compartment->memories) { state.initGCObject(memory); }
+		for(Table* table : compartment->tables) { state.initGCObject(table); }
+		for(ExceptionType* exceptionType : compartment->exceptionTypes)
+		{ state.initGCObject(exceptionType); }
+		for(Global* global : compartment->globals) { state.initGCObject(global); }
+		for(Context* context : compartment->contexts)
+		{
+			// Pooled contexts aren't referenced, but aren't garbage until the compartment is.
+			if(!context->isPooled)
+			{
+				state.initGCObject(context);
+				state.contextRuntimeDatas.push_back(context->runtimeData);
+			}
+		}
+
+		numSnapshotObjects = getNumCompartmentObjects(compartment);
 	}
-	for(Memory* memory : compartment->memories) { state.initGCObject(memory); }
-	for(Table* table : compartment->tables) { state.initGCObject(table); }
-	for(ExceptionType* exceptionType : compartment->exceptionTypes)
-	{ state.initGCObject(exceptionType); }
-	for(Global* global : compartment->globals) { state.initGCObject(global); }
-	for(Context* context : compartment->contexts) { state.initGCObject(context); }
+	snapshotTimer.stop();
 
-	// Scan the objects added to the referenced set so far: gather their child references and
-	// recurse.
+	// Mark the objects that are reachable from the roots without locking the compartment.
+	Timing::Timer markTimer;
 	const Uptr numInitialObjects
 		= state.pendingScanObjects.size() + state.unreferencedObjects.size();
 	const Uptr numRoots = state.pendingScanObjects.size();
-	while(state.pendingScanObjects.size())
+	state.scanPendingObjects();
+	markTimer.stop();
+
+	Timing::Timer remarkTimer;
+	Platform::RWMutex::ExclusiveLock compartmentLock(compartment->mutex);
+	Platform::Mutex::Lock contextPoolLock(compartment->contextPoolMutex);
+
+	// While marking, unreferenced objects may have been rooted, or stored in tables and mutable
+	// globals. Mark the unreferenced objects that are now rooted, and rescan the referenced tables
+	// and globals. An instance's references can't change, so only the instances that were created
+	// since the snapshot need to be scanned.
+	state.contextRuntimeDatas.clear();
+	for(Context* context : compartment->contexts)
 	{
-		GCObject* object = state.pendingScanObjects.back();
-		state.pendingScanObjects.pop_back();
-		state.scanObject(object);
-	};
+		if(!context->isPooled) { state.contextRuntimeDatas.push_back(context->runtimeData); }
+	}
+	std::vector<GCObject*> rootedObjects;
+	for(GCObject* object : state.unreferencedObjects)
+	{
+		if(hasRootReferences(object)) { rootedObjects.push_back(object); }
+	}
+	for(GCObject* object : rootedObjects) { state.visitReference(object); }
+	for(Instance* instance : compartment->instances)
+	{
+		if(instance && !state.instances.contains(instance->id)) { state.scanObject(instance); }
+	}
+	for(Table* table : compartment->tables)
+	{
+		if(!state.unreferencedObjects.contains(table)) { state.scanObject(table); }
+	}
+	for(Global* global : compartment->globals)
+	{
+		if(!state.unreferencedObjects.contains(global)) { state.scanObject(global); }
+	}
+	state.scanPendingObjects();
 
-	// Delete each unreferenced object that isn't the compartment.
-	bool wasCompartmentUnreferenced = false;
+	// If objects were created in the compartment since the snapshot, the compartment is still in
+	// use, even if none of the objects are referenced.
+	bool wasCompartmentUnreferenced = state.unreferencedObjects.contains(compartment);
+	if(wasCompartmentUnreferenced && getNumCompartmentObjects(compartment) != numSnapshotObjects)
+	{
+		state.unreferencedObjects.remove(compartment);
+		wasCompartmentUnreferenced = false;
+	}
+
+	// Free each unreferenced object that isn't the compartment. Unreferenced contexts are added to
+	// the compartment's context pool instead, unless the compartment is also unreferenced.
+	Uptr numPooledContexts = 0;
+	std::vector<GCObject*> detachedGarbage;
 	for(GCObject* object : state.unreferencedObjects)
 	{
-		if(object == compartment) { wasCompartmentUnreferenced = true; }
+		if(object == compartment) { continue; }
+		else if(wasCompartmentUnreferenced)
+		{
+			delete object;
+		}
+		else if(object->kind == ObjectKind::context && tryPoolContext((Context*)object))
+		{
+			++numPooledContexts;
+		}
+		else if(object->kind == ObjectKind::memory || object->kind == ObjectKind::table
+				|| object->kind == ObjectKind::instance)
+		{
+			detachFromCompartment(object);
+			detachedGarbage.push_back(object);
+		}
 		else
 		{
 			delete object;
 		}
 	}
+	if(wasCompartmentUnreferenced)
+	{
+		for(Context* context : compartment->contextPool) { delete context; }
+		compartment->contextPool.clear();
+	}
 
-	// Delete the compartment last, if it wasn't referenced.
+	contextPoolLock.unlock();
 	compartmentLock.unlock();
+	remarkTimer.stop();
+
+	// Delete the detached objects without pausing the compartment's other users, and then delete
+	// the compartment last, if it wasn't referenced.
+	Timing::Timer deleteTimer;
+	for(GCObject* object : detachedGarbage) { delete object; }
+	gcLock.unlock();
 	if(wasCompartmentUnreferenced) { delete compartment; }
+	deleteTimer.stop();
 
 	Log::printf(Log::metrics,
-				"Collected garbage in %.2fms: %" WAVM_PRIuPTR " roots, %" WAVM_PRIuPTR
-				" objects, %" WAVM_PRIuPTR " garbage\n",
+				"Collected garbage in %.2fms: %.2fms snapshot pause, %.2fms concurrent mark, "
+				"%.2fms remark pause, %.2fms concurrent delete; %" WAVM_PRIuPTR
+				" roots, %" WAVM_PRIuPTR " objects, %" WAVM_PRIuPTR " garbage (%" WAVM_PRIuPTR
+				" deleted after the pause), %" WAVM_PRIuPTR " contexts pooled\n",
 				timer.getMilliseconds(),
+				snapshotTimer.getMilliseconds(),
+				markTimer.getMilliseconds(),
+				remarkTimer.getMilliseconds(),
+				deleteTimer.getMilliseconds(),
 				numRoots,
 				numInitialObjects,
-				Uptr(state.unreferencedObjects.size()));
+				Uptr(state.unreferencedObjects.size()),
+				Uptr(detachedGarbage.size()),
+				numPooledContexts);
 
 	return wasCompartmentUnreferenced;
 }
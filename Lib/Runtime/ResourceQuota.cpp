@@ -1,12 +1,19 @@
 #include <memory>
 #include "RuntimePrivate.h"
-#include "WAVM/Platform/Mutex.h"
 #include "WAVM/Runtime/Runtime.h"
 
 using namespace WAVM;
 using namespace WAVM::Runtime;
 
-ResourceQuotaRef Runtime::createResourceQuota() { return std::make_shared<ResourceQuota>(); }
+ResourceQuotaRef Runtime::createResourceQuota(ResourceQuotaRefParam parent)
+{
+	return std::make_shared<ResourceQuota>(parent);
+}
+
+ResourceQuotaRef Runtime::getResourceQuotaParent(ResourceQuotaConstRefParam resourceQuota)
+{
+	return resourceQuota->parent;
+}
 
 Uptr Runtime::getResourceQuotaMaxTableElems(ResourceQuotaConstRefParam resourceQuota)
 {
@@ -11,6 +11,8 @@
 #include "WAVM/Inline/IndexMap.h"
 #include "WAVM/LLVMJIT/LLVMJIT.h"
 #include "WAVM/Platform/Defines.h"
+#include "WAVM/Platform/Memory.h"
+#include "WAVM/Platform/Mutex.h"
 #include "WAVM/Platform/RWMutex.h"
 #include "WAVM/Runtime/Intrinsics.h"
 #include "WAVM/Runtime/Runtime.h"
@@ -72,6 +74,21 @@ namespace WAVM { namespace Runtime {
 	// at the end of the array will, when re-adding this Function's address, point to this Object.
 	extern Object* getOutOfBoundsElement();
 
+	// A memory file with a copy of a memory's contents, which isn't changed after it's created. The
+	// memory and its copy-on-write clones map the file copy-on-write, so they share the pages of it
+	// that they haven't written.
+	struct MemorySnapshot
+	{
+		Platform::MemoryFile* file = nullptr;
+		Uptr numPages = 0;
+
+		// Whether each page of the file was written when the snapshot was taken. The other pages are
+		// zero, and are holes in the file.
+		std::vector<bool> isNonZeroPage;
+
+		~MemorySnapshot();
+	};
+
 	// An instance of a WebAssembly Memory.
 	struct Memory : GCObject
 	{
@@ -84,6 +101,15 @@ namespace WAVM { namespace Runtime {
 		mutable Platform::RWMutex resizingMutex;
 		std::atomic<Uptr> numPages{0};
 
+		// If non-null, the memory's first snapshot->numPages pages are a copy-on-write mapping of the
+		// snapshot's file, which may be shared with other memories. Protected by resizingMutex.
+		std::shared_ptr<MemorySnapshot> snapshot;
+
+		// True if the memory's reserved address space is smaller than the range a 32-bit address
+		// and 32-bit offset may access, so it may only be accessed by code compiled with memory
+		// bounds checks.
+		bool requiresBoundsChecks = false;
+
 		ResourceQuotaRef resourceQuota;
 
 		Memory(Compartment* inCompartment,
@@ -143,14 +169,119 @@ namespace WAVM { namespace Runtime {
 	typedef std::vector<std::shared_ptr<std::vector<U8>>> DataSegmentVector;
 	typedef std::vector<std::shared_ptr<IR::ElemSegment::Contents>> ElemSegmentVector;
 
+	// Object code that has been loaded for an instance of a module. The loaded code references the
+	// values of immutable globals through immutableGlobalValues rather than through an instance's
+	// Global objects, and references the instance's functions through the instance, so it may be
+	// shared by any instance of the module with the same bindings. Each instance has its own
+	// ForwardingFunctions that forward calls to functionDefs.
+	struct LoadedJITModule
+	{
+		std::shared_ptr<LLVMJIT::Module> jitModule;
+		std::vector<IR::UntaggedValue> immutableGlobalValues;
+		std::vector<Function*> functionDefs;
+
+		// The module and the values bound to the symbols in its object code, which are needed to
+		// load optimized code for the functions in baseline tier object code.
+		ModuleConstRef module;
+		std::string debugName;
+		Uptr instanceId;
+		std::vector<LLVMJIT::FunctionBinding> functionImportBindings;
+		std::vector<LLVMJIT::TableBinding> tableBindings;
+		std::vector<LLVMJIT::MemoryBinding> memoryBindings;
+		std::vector<LLVMJIT::GlobalBinding> globalBindings;
+		std::vector<LLVMJIT::ExceptionTypeBinding> exceptionTypeBindings;
+
+		// The optimized code that has been loaded for some of the baseline tier functions, and the
+		// functions that are waiting to be optimized.
+		Platform::Mutex tierUpMutex;
+		std::vector<std::shared_ptr<LLVMJIT::Module>> tierUpJITModules;
+		std::vector<Uptr> pendingTierUpFunctionDefIndices;
+	};
+
+	// Function objects for an instance's function definitions that forward calls to the functions
+	// of a LoadedJITModule. They give each instance that shares the loaded code its own Function
+	// objects, so rooting one instance's functions, or setting their user data, doesn't affect the
+	// other instances. A host function is also a forwarding function, which binds the host thunk
+	// for its type to a native function and data.
+	struct ForwardingFunctions
+	{
+		std::vector<Function*> functions;
+
+		// The data bound to a host function, which is finalized when the function is deleted.
+		void* boundData = nullptr;
+		void (*finalizeBoundData)(void*) = nullptr;
+
+		ForwardingFunctions(U8* inPages, Uptr inNumPages) : pages(inPages), numPages(inNumPages) {}
+		~ForwardingFunctions();
+
+		bool contains(const Function* function) const
+		{
+			return reinterpret_cast<const U8*>(function) >= pages
+				   && reinterpret_cast<const U8*>(function)
+						  < pages + (numPages << Platform::getBytesPerPageLog2());
+		}
+
+	private:
+		U8* pages;
+		Uptr numPages;
+	};
+
+	// The initial contents of a memory defined by a module, built from the module's active data
+	// segments. The pages that are entirely written by a segment are stored in a memory file that
+	// instances map copy-on-write, and the rest of the segments' bytes are copied.
+	struct DataSegmentImage
+	{
+		struct PageRun
+		{
+			Uptr firstPageIndex;
+			Uptr numPages;
+		};
+
+		struct PartialPageCopy
+		{
+			Uptr dataSegmentIndex;
+			Uptr destAddress;
+			Uptr sourceOffset;
+			Uptr numBytes;
+		};
+
+		Platform::MemoryFile* file = nullptr;
+		Uptr numPages = 0;
+		std::vector<PageRun> wholePageRuns;
+		std::vector<PartialPageCopy> partialPageCopies;
+
+		~DataSegmentImage();
+	};
+
 	// A compiled WebAssembly module.
 	struct Module
 	{
 		IR::Module ir;
-		std::vector<U8> objectCode;
-
-		Module(IR::Module&& inIR, std::vector<U8>&& inObjectCode)
-		: ir(inIR), objectCode(std::move(inObjectCode))
+		std::shared_ptr<const ObjectCodeView> objectCode;
+
+		// The object code that has been loaded for instances of this module, keyed by the values
+		// bound to the object code's imported symbols. Instances with the same bindings (e.g. the
+		// same module instantiated in many compartments) share the loaded code.
+		mutable Platform::Mutex loadedJITModulesMutex;
+		mutable HashMap<std::vector<Uptr>, std::weak_ptr<LoadedJITModule>> loadedJITModules;
+
+		// The data segment images of the module's memory definitions, which are built the first
+		// time the module is instantiated with data segment images enabled. The image of a memory
+		// is null if its data segments can't be mapped.
+		mutable Platform::Mutex dataSegmentImagesMutex;
+		mutable bool hasBuiltDataSegmentImages = false;
+		mutable std::vector<std::unique_ptr<DataSegmentImage>> dataSegmentImages;
+
+		// True if the object code checks the bounds of memory accesses, so it may access memories
+		// that require bounds checks.
+		const bool boundsCheckMemoryAccesses;
+
+		Module(IR::Module&& inIR,
+			   std::shared_ptr<const ObjectCodeView>&& inObjectCode,
+			   bool inBoundsCheckMemoryAccesses = false)
+		: ir(std::move(inIR))
+		, objectCode(std::move(inObjectCode))
+		, boundsCheckMemoryAccesses(inBoundsCheckMemoryAccesses)
 		{
 		}
 	};
@@ -158,7 +289,7 @@ namespace WAVM { namespace Runtime {
 	// An instance of a WebAssembly module.
 	struct Instance : GCObject
 	{
-		const Uptr id;
+		Uptr id;
 
 		const HashMap<std::string, Object*> exportMap;
 		const std::vector<Object*> exports;
@@ -177,8 +308,17 @@ namespace WAVM { namespace Runtime {
 		mutable Platform::RWMutex elemSegmentsMutex;
 		ElemSegmentVector elemSegments;
 
+		// The instance references the LLVMJIT::Module through a pointer that also keeps the
+		// LoadedJITModule's immutable global values alive. They are null for a host function's
+		// instance, which doesn't load any code.
+		const std::shared_ptr<LoadedJITModule> loadedJITModule;
 		const std::shared_ptr<LLVMJIT::Module> jitModule;
 
+		// The Function objects for the instance's function definitions, which cloned instances share
+		// with the instance they were cloned from. If calls can't be forwarded on this CPU, this is
+		// null, and the instance uses the LoadedJITModule's functions instead of sharing it.
+		const std::shared_ptr<ForwardingFunctions> forwardingFunctions;
+
 		ResourceQuotaRef resourceQuota;
 
 		Instance(Compartment* inCompartment,
@@ -193,7 +333,8 @@ namespace WAVM { namespace Runtime {
 				 Function* inStartFunction,
 				 DataSegmentVector&& inPassiveDataSegments,
 				 ElemSegmentVector&& inPassiveElemSegments,
-				 std::shared_ptr<LLVMJIT::Module>&& inJITModule,
+				 std::shared_ptr<LoadedJITModule>&& inLoadedJITModule,
+				 std::shared_ptr<ForwardingFunctions>&& inForwardingFunctions,
 				 std::string&& inDebugName,
 				 ResourceQuotaRefParam inResourceQuota)
 		: GCObject(ObjectKind::instance, inCompartment, std::move(inDebugName))
@@ -208,7 +349,9 @@ namespace WAVM { namespace Runtime {
 		, startFunction(inStartFunction)
 		, dataSegments(std::move(inPassiveDataSegments))
 		, elemSegments(std::move(inPassiveElemSegments))
-		, jitModule(std::move(inJITModule))
+		, loadedJITModule(std::move(inLoadedJITModule))
+		, jitModule(loadedJITModule, loadedJITModule ? loadedJITModule->jitModule.get() : nullptr)
+		, forwardingFunctions(std::move(inForwardingFunctions))
 		, resourceQuota(inResourceQuota)
 		{
 		}
@@ -221,6 +364,10 @@ namespace WAVM { namespace Runtime {
 		Uptr id = UINTPTR_MAX;
 		struct ContextRuntimeData* runtimeData = nullptr;
 
+		// True if the context was collected, and is in its compartment's context pool. Protected
+		// by the compartment's contextPoolMutex.
+		bool isPooled = false;
+
 		Context(Compartment* inCompartment, std::string&& inDebugName)
 		: GCObject(ObjectKind::context, inCompartment, std::move(inDebugName))
 		{
@@ -246,6 +393,14 @@ namespace WAVM { namespace Runtime {
 		DenseStaticIntSet<U32, maxMutableGlobals> globalDataAllocationMask;
 		IR::UntaggedValue initialContextMutableGlobals[maxMutableGlobals];
 
+		// Serializes garbage collections of the compartment.
+		Platform::Mutex gcMutex;
+
+		// Contexts that were collected, but kept with their ID and committed runtime data to be
+		// reused by createContext. They remain in the contexts IndexMap while they are pooled.
+		Platform::Mutex contextPoolMutex;
+		std::vector<Context*> contextPool;
+
 		Compartment(std::string&& inDebugName);
 		~Compartment();
 	};
@@ -262,54 +417,67 @@ namespace WAVM { namespace Runtime {
 
 	struct ResourceQuota
 	{
+		// A lock-free counter with a maximum. If the quota has a parent, allocations are also
+		// charged to the parent's counter, and fail if either counter would exceed its maximum.
 		template<typename Value> struct CurrentAndMax
 		{
-			CurrentAndMax(Value inMax) : current{0}, max(inMax) {}
+			CurrentAndMax(Value inMax, CurrentAndMax* inParent)
+			: current{0}, max{inMax}, parent(inParent)
+			{
+			}
 
 			bool allocate(Value delta)
 			{
-				Platform::RWMutex::ExclusiveLock lock(mutex);
-
-				// Make sure the delta doesn't make current overflow.
-				if(current + delta < current) { return false; }
-
-				if(current + delta > max) { return false; }
-
-				current += delta;
+				// Reserve the delta with a compare-and-swap loop, so concurrent allocations can't
+				// exceed the maximum.
+				Value oldCurrent = current.load(std::memory_order_relaxed);
+				do
+				{
+					// Make sure the delta doesn't make current overflow.
+					if(oldCurrent + delta < oldCurrent) { return false; }
+
+					if(oldCurrent + delta > max.load(std::memory_order_relaxed)) { return false; }
+				} while(!current.compare_exchange_weak(
+					oldCurrent, oldCurrent + delta, std::memory_order_relaxed));
+
+				// Charge the parent quota, and give back the reservation if it fails.
+				if(parent && !parent->allocate(delta))
+				{
+					current.fetch_sub(delta, std::memory_order_relaxed);
+					return false;
+				}
 				return true;
 			}
 
 			void free(Value delta)
 			{
-				Platform::RWMutex::ExclusiveLock lock(mutex);
-				WAVM_ASSERT(current - delta <= current);
-				current -= delta;
+				const Value oldCurrent = current.fetch_sub(delta, std::memory_order_relaxed);
+				WAVM_ASSERT(oldCurrent - delta <= oldCurrent);
+				if(parent) { parent->free(delta); }
 			}
 
-			Value getCurrent() const
-			{
-				Platform::RWMutex::ShareableLock lock(mutex);
-				return current;
-			}
-			Value getMax() const
-			{
-				Platform::RWMutex::ShareableLock lock(mutex);
-				return max;
-			}
-			void setMax(Value newMax)
-			{
-				Platform::RWMutex::ExclusiveLock lock(mutex);
-				max = newMax;
-			}
+			Value getCurrent() const { return current.load(std::memory_order_relaxed); }
+			Value getMax() const { return max.load(std::memory_order_relaxed); }
+			void setMax(Value newMax) { max.store(newMax, std::memory_order_relaxed); }
 
 		private:
-			mutable Platform::RWMutex mutex;
-			Value current;
-			Value max;
+			std::atomic<Value> current;
+			std::atomic<Value> max;
+			CurrentAndMax* parent;
 		};
 
-		CurrentAndMax<Uptr> memoryPages{UINTPTR_MAX};
-		CurrentAndMax<Uptr> tableElems{UINTPTR_MAX};
+		// The quota that this quota's allocations are also charged to, or null.
+		const ResourceQuotaRef parent;
+
+		CurrentAndMax<Uptr> memoryPages;
+		CurrentAndMax<Uptr> tableElems;
+
+		ResourceQuota(ResourceQuotaRefParam inParent)
+		: parent(inParent)
+		, memoryPages(UINTPTR_MAX, parent ? &parent->memoryPages : nullptr)
+		, tableElems(UINTPTR_MAX, parent ? &parent->tableElems : nullptr)
+		{
+		}
 	};
 
 	WAVM_DECLARE_INTRINSIC_MODULE(wavmIntrinsics);
@@ -322,15 +490,34 @@ namespace WAVM { namespace Runtime {
 	bool isAddressOwnedByTable(U8* address, Table*& outTable, Uptr& outTableIndex);
 	bool isAddressOwnedByMemory(U8* address, Memory*& outMemory, Uptr& outMemoryAddress);
 
+	// Creates a memory with a reserved address space that is only smaller than the range a 32-bit
+	// address and 32-bit offset may access if isBoundsChecked is true.
+	Memory* createMemoryInternal(Compartment* compartment,
+								 IR::MemoryType type,
+								 std::string&& debugName,
+								 ResourceQuotaRefParam resourceQuota,
+								 bool isBoundsChecked);
+
+	// Whether memories created by createMemory require bounds checks, and modules are compiled
+	// with them.
+	bool getMemoryBoundsChecks();
+
 	// Clones objects into a new compartment with the same ID.
 	Table* cloneTable(Table* memory, Compartment* newCompartment);
-	Memory* cloneMemory(Memory* memory, Compartment* newCompartment, bool copyContents = true);
+	Memory* cloneMemory(Memory* memory,
+						Compartment* newCompartment,
+						MemoryCloneMode cloneMode = MemoryCloneMode::copy);
 	ExceptionType* cloneExceptionType(ExceptionType* exceptionType, Compartment* newCompartment);
 	Instance* cloneInstance(Instance* instance, Compartment* newCompartment);
 
 	// Clone a global with same ID and mutable data offset (if mutable) in a new compartment.
 	Global* cloneGlobal(Global* global, Compartment* newCompartment);
 
+	// Adds a context that was collected to its compartment's context pool instead of deleting it.
+	// Returns false if the pool is full. Must be called with the compartment's mutex exclusively
+	// locked, and its contextPoolMutex locked.
+	bool tryPoolContext(Context* context);
+
 	Instance* getInstanceFromRuntimeData(ContextRuntimeData* contextRuntimeData, Uptr instanceId);
 	Table* getTableFromRuntimeData(ContextRuntimeData* contextRuntimeData, Uptr tableId);
 	Memory* getMemoryFromRuntimeData(ContextRuntimeData* contextRuntimeData, Uptr memoryId);
@@ -344,6 +531,13 @@ namespace WAVM { namespace Runtime {
 						 Uptr sourceOffset,
 						 Uptr numBytes);
 
+	// If data segment images are enabled, initializes a memory defined by a module from the
+	// image of the module's active data segments for the memory. Returns false if the memory
+	// must be initialized by copying the segments instead.
+	bool initMemoryFromDataSegmentImage(ModuleConstRefParam module,
+										Memory* memory,
+										Uptr memoryDefIndex);
+
 	// Initialize a table segment (equivalent to executing a table.init instruction).
 	void initElemSegment(Instance* instance,
 						 Uptr elemSegmentIndex,
@@ -378,6 +572,31 @@ namespace WAVM { namespace Runtime {
 										std::vector<ExceptionType*>&& exceptionTypeImports,
 										std::string&& debugName,
 										ResourceQuotaRefParam resourceQuota = ResourceQuotaRef());
+
+	// Like Runtime::instantiateModule, but doesn't copy the module's active data and elem segments
+	// into its memories and tables. Used to restore instances whose memories and tables are
+	// restored from a snapshot.
+	Instance* instantiateModuleWithoutActiveSegments(Compartment* compartment,
+													 ModuleConstRefParam module,
+													 ImportBindings&& imports,
+													 std::string&& debugName,
+													 ResourceQuotaRefParam resourceQuota);
+
+	// Returns true if all the bytes in a WebAssembly page are zero.
+	bool isZeroPage(const U8* page);
+
+	// Returns the values to bind to the WAVM intrinsic function symbols in LLVMJIT object code.
+	HashMap<std::string, LLVMJIT::FunctionBinding> getWAVMIntrinsicsExportMap();
+
+	// The number of calls to a baseline tier function after which it is optimized.
+	U32 getNumCallsToTierUp();
+
+	// The host target spec, with the optimization level set by setOptimizationLevel.
+	LLVMJIT::TargetSpec getCompileTargetSpec(bool boundsCheckMemoryAccesses);
+
+	// Queues a baseline tier function definition to be optimized on a background thread.
+	void requestTierUp(const std::shared_ptr<LoadedJITModule>& loadedJITModule,
+					   Uptr functionDefIndex);
 }}
 
 namespace WAVM { namespace Intrinsics {
@@ -0,0 +1,964 @@
+#include <string.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "RuntimePrivate.h"
+#include "WAVM/IR/IR.h"
+#include "WAVM/IR/Module.h"
+#include "WAVM/IR/Types.h"
+#include "WAVM/IR/Value.h"
+#include "WAVM/Inline/Assert.h"
+#include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Inline/Hash.h"
+#include "WAVM/Inline/HashMap.h"
+#include "WAVM/Inline/HashSet.h"
+#include "WAVM/Inline/LEB128.h"
+#include "WAVM/Inline/Serialization.h"
+#include "WAVM/Inline/Timing.h"
+#include "WAVM/Logging/Logging.h"
+#include "WAVM/Platform/File.h"
+#include "WAVM/Platform/Memory.h"
+#include "WAVM/Platform/RWMutex.h"
+#include "WAVM/Runtime/Runtime.h"
+#include "WAVM/RuntimeABI/RuntimeABI.h"
+#include "WAVM/VFS/VFS.h"
+
+using namespace WAVM;
+using namespace WAVM::IR;
+using namespace WAVM::Runtime;
+using namespace WAVM::Serialization;
+
+// A snapshot file starts with a header in the first WebAssembly page, followed by the contents of
+// each memory at a page-aligned offset, followed by a description of the compartment's objects.
+// Pages of memories that are all zero aren't written, so they are holes in the file on file
+// systems that support sparse files, and read as zero.
+static constexpr U64 snapshotMagic = 0x50414e534d564157; // "WAVMSNAP"
+static constexpr U32 snapshotVersion = 1;
+
+struct SnapshotHeader
+{
+	U64 magic;
+	U32 version;
+	U32 numBytesPerPage;
+	U64 objectsOffset;
+	U64 numObjectsBytes;
+};
+
+// Objects are referenced by their ID in the snapshotted compartment. Functions are referenced by
+// the ID of the instance that defines them, and their index in the instance's functions.
+enum class SnapshotObjectKind : U8
+{
+	null,
+	function,
+	table,
+	memory,
+	global,
+	exceptionType,
+	instance,
+};
+
+struct SnapshotRef
+{
+	U8 kind = U8(SnapshotObjectKind::null);
+	U64 id = 0;
+	U64 functionIndex = 0;
+};
+
+struct MemoryRecord
+{
+	U64 id;
+	U8 isShared;
+	U64 minPages;
+	U64 maxPages;
+	U64 numPages;
+	U64 dataOffset;
+	std::string debugName;
+};
+
+struct TableRecord
+{
+	U64 id;
+	U8 elementType;
+	U8 isShared;
+	U64 minElements;
+	U64 maxElements;
+	std::vector<SnapshotRef> elements;
+	std::string debugName;
+};
+
+struct GlobalRecord
+{
+	U64 id;
+	U8 valueType;
+	U8 isMutable;
+	U8 hasBeenInitialized;
+	UntaggedValue value;
+	SnapshotRef referenceValue;
+	std::string debugName;
+};
+
+struct ExceptionTypeRecord
+{
+	U64 id;
+	std::vector<U8> params;
+	std::string debugName;
+};
+
+struct InstanceRecord
+{
+	U64 id;
+	std::string debugName;
+
+	// Instances of modules that import native functions (e.g. intrinsic modules) can't be
+	// restored from the module's object code, and are recreated by the host.
+	U8 isHostInstance;
+	U64 moduleHash;
+	std::vector<SnapshotRef> imports;
+
+	// The IDs of all the instance's tables, memories, globals, and exception types, including
+	// imports.
+	std::vector<U64> tableIds;
+	std::vector<U64> memoryIds;
+	std::vector<U64> globalIds;
+	std::vector<U64> exceptionTypeIds;
+
+	std::vector<U8> isDataSegmentDropped;
+	std::vector<U8> isElemSegmentDropped;
+};
+
+struct CompartmentSnapshot
+{
+	std::vector<MemoryRecord> memories;
+	std::vector<TableRecord> tables;
+	std::vector<GlobalRecord> globals;
+	std::vector<ExceptionTypeRecord> exceptionTypes;
+	std::vector<InstanceRecord> instances;
+};
+
+template<typename Stream> void serialize(Stream& stream, SnapshotRef& ref)
+{
+	serialize(stream, ref.kind);
+	serialize(stream, ref.id);
+	serialize(stream, ref.functionIndex);
+}
+
+template<typename Stream> void serialize(Stream& stream, MemoryRecord& record)
+{
+	serialize(stream, record.id);
+	serialize(stream, record.isShared);
+	serialize(stream, record.minPages);
+	serialize(stream, record.maxPages);
+	serialize(stream, record.numPages);
+	serialize(stream, record.dataOffset);
+	serialize(stream, record.debugName);
+}
+
+template<typename Stream> void serialize(Stream& stream, TableRecord& record)
+{
+	serialize(stream, record.id);
+	serialize(stream, record.elementType);
+	serialize(stream, record.isShared);
+	serialize(stream, record.minElements);
+	serialize(stream, record.maxElements);
+	serialize(stream, record.elements);
+	serialize(stream, record.debugName);
+}
+
+template<typename Stream> void serialize(Stream& stream, GlobalRecord& record)
+{
+	serialize(stream, record.id);
+	serialize(stream, record.valueType);
+	serialize(stream, record.isMutable);
+	serialize(stream, record.hasBeenInitialized);
+	serializeBytes(stream, record.value.bytes, sizeof(record.value.bytes));
+	serialize(stream, record.referenceValue);
+	serialize(stream, record.debugName);
+}
+
+template<typename Stream> void serialize(Stream& stream, ExceptionTypeRecord& record)
+{
+	serialize(stream, record.id);
+	serialize(stream, record.params);
+	serialize(stream, record.debugName);
+}
+
+template<typename Stream> void serialize(Stream& stream, InstanceRecord& record)
+{
+	serialize(stream, record.id);
+	serialize(stream, record.debugName);
+	serialize(stream, record.isHostInstance);
+	serialize(stream, record.moduleHash);
+	serialize(stream, record.imports);
+	serialize(stream, record.tableIds);
+	serialize(stream, record.memoryIds);
+	serialize(stream, record.globalIds);
+	serialize(stream, record.exceptionTypeIds);
+	serialize(stream, record.isDataSegmentDropped);
+	serialize(stream, record.isElemSegmentDropped);
+}
+
+template<typename Stream> void serialize(Stream& stream, CompartmentSnapshot& snapshot)
+{
+	serialize(stream, snapshot.memories);
+	serialize(stream, snapshot.tables);
+	serialize(stream, snapshot.globals);
+	serialize(stream, snapshot.exceptionTypes);
+	serialize(stream, snapshot.instances);
+}
+
+static U64 hashModule(const Runtime::Module* module)
+{
+	return XXH<U64>(module->objectCode->bytes, module->objectCode->numBytes, 0);
+}
+
+static bool isHostModule(const Runtime::Module* module)
+{
+	for(const auto& functionImport : module->ir.functions.imports)
+	{
+		if(module->ir.types[functionImport.type.index].callingConvention()
+		   != CallingConvention::wasm)
+		{ return true; }
+	}
+	return false;
+}
+
+static Uptr getPlatformPagesPerWebAssemblyPageLog2()
+{
+	return IR::numBytesPerPageLog2 - Platform::getBytesPerPageLog2();
+}
+
+static bool checkFileResult(VFS::Result result, const char* operation, const char* path)
+{
+	if(result == VFS::Result::success) { return true; }
+	Log::printf(
+		Log::error, "Error %s snapshot '%s': %s\n", operation, path, VFS::describeResult(result));
+	return false;
+}
+
+//
+// Saving snapshots
+//
+
+struct SnapshotWriter
+{
+	// Maps the address of each function defined by an instance to a reference to it.
+	HashMap<Uptr, SnapshotRef> functionRefs;
+
+	bool encodeRef(const Object* object, SnapshotRef& outRef)
+	{
+		outRef = SnapshotRef();
+		if(!object) { return true; }
+		switch(object->kind)
+		{
+		case ObjectKind::function: {
+			const SnapshotRef* functionRef = functionRefs.get(reinterpret_cast<Uptr>(object));
+			if(!functionRef)
+			{
+				Log::printf(Log::error,
+							"Can't snapshot a reference to function %s that isn't defined by an "
+							"instance in the compartment.\n",
+							getFunctionDebugName((const Function*)object).c_str());
+				return false;
+			}
+			outRef = *functionRef;
+			return true;
+		}
+		case ObjectKind::table:
+			outRef.kind = U8(SnapshotObjectKind::table);
+			outRef.id = asTable(object)->id;
+			return true;
+		case ObjectKind::memory:
+			outRef.kind = U8(SnapshotObjectKind::memory);
+			outRef.id = asMemory(object)->id;
+			return true;
+		case ObjectKind::global:
+			outRef.kind = U8(SnapshotObjectKind::global);
+			outRef.id = asGlobal(object)->id;
+			return true;
+		case ObjectKind::exceptionType:
+			outRef.kind = U8(SnapshotObjectKind::exceptionType);
+			outRef.id = asExceptionType(object)->id;
+			return true;
+		case ObjectKind::instance:
+			outRef.kind = U8(SnapshotObjectKind::instance);
+			outRef.id = asInstance(object)->id;
+			return true;
+
+		case ObjectKind::context:
+		case ObjectKind::compartment:
+		case ObjectKind::foreign:
+			Log::printf(Log::error,
+						"Can't snapshot a reference to %s.\n",
+						((const GCObject*)object)->debugName.c_str());
+			return false;
+
+		case ObjectKind::invalid:
+		default: WAVM_UNREACHABLE();
+		};
+	}
+};
+
+bool Runtime::saveCompartmentSnapshot(const Compartment* compartment,
+									  const char* path,
+									  const Context* context)
+{
+	WAVM_ASSERT(!context || context->compartment == compartment);
+	Timing::Timer timer;
+
+	Platform::RWMutex::ShareableLock compartmentLock(compartment->mutex);
+	CompartmentSnapshot snapshot;
+	SnapshotWriter writer;
+
+	// Index the functions defined by each instance.
+	for(const Instance* instance : compartment->instances)
+	{
+		for(Uptr functionIndex = 0; functionIndex < instance->functions.size(); ++functionIndex)
+		{
+			const Function* function = instance->functions[functionIndex];
+			if(function && function->instanceId == instance->id)
+			{
+				SnapshotRef functionRef;
+				functionRef.kind = U8(SnapshotObjectKind::function);
+				functionRef.id = instance->id;
+				functionRef.functionIndex = functionIndex;
+				writer.functionRefs.set(reinterpret_cast<Uptr>(function), functionRef);
+			}
+		}
+	}
+
+	// Describe the memories, and lay out their contents in the file.
+	U64 nextDataOffset = IR::numBytesPerPage;
+	for(const Memory* memory : compartment->memories)
+	{
+		MemoryRecord record;
+		record.id = memory->id;
+		record.isShared = memory->type.isShared;
+		record.minPages = memory->type.size.min;
+		record.maxPages = memory->type.size.max;
+		record.numPages = memory->numPages.load(std::memory_order_acquire);
+		record.dataOffset = nextDataOffset;
+		record.debugName = memory->debugName;
+		nextDataOffset += record.numPages * IR::numBytesPerPage;
+		snapshot.memories.push_back(std::move(record));
+	}
+
+	for(const Table* table : compartment->tables)
+	{
+		TableRecord record;
+		record.id = table->id;
+		record.elementType = U8(table->type.elementType);
+		record.isShared = table->type.isShared;
+		record.minElements = table->type.size.min;
+		record.maxElements = table->type.size.max;
+		record.debugName = table->debugName;
+		const Uptr numElements = getTableNumElements(table);
+		record.elements.resize(numElements);
+		for(Uptr elementIndex = 0; elementIndex < numElements; ++elementIndex)
+		{
+			if(!writer.encodeRef(getTableElement(table, elementIndex),
+								 record.elements[elementIndex]))
+			{ return false; }
+		}
+		snapshot.tables.push_back(std::move(record));
+	}
+
+	for(const Global* global : compartment->globals)
+	{
+		GlobalRecord record;
+		record.id = global->id;
+		record.valueType = U8(global->type.valueType);
+		record.isMutable = global->type.isMutable;
+		record.hasBeenInitialized = global->hasBeenInitialized;
+		record.debugName = global->debugName;
+
+		// Use the context's value of mutable globals if a context was given, or else the value
+		// that new contexts will be initialized with.
+		record.value = global->initialValue;
+		if(global->type.isMutable)
+		{
+			record.value
+				= context ? context->runtimeData->mutableGlobals[global->mutableGlobalIndex]
+						  : compartment->initialContextMutableGlobals[global->mutableGlobalIndex];
+		}
+		if(isReferenceType(global->type.valueType))
+		{
+			if(!writer.encodeRef(record.value.object, record.referenceValue)) { return false; }
+			record.value = UntaggedValue();
+		}
+		snapshot.globals.push_back(std::move(record));
+	}
+
+	for(const Runtime::ExceptionType* exceptionType : compartment->exceptionTypes)
+	{
+		ExceptionTypeRecord record;
+		record.id = exceptionType->id;
+		for(ValueType param : exceptionType->sig.params) { record.params.push_back(U8(param)); }
+		record.debugName = exceptionType->debugName;
+		snapshot.exceptionTypes.push_back(std::move(record));
+	}
+
+	HashMap<Uptr, U64> moduleHashes;
+	for(const Instance* instance : compartment->instances)
+	{
+		const Runtime::Module* module
+			= instance->loadedJITModule ? instance->loadedJITModule->module.get() : nullptr;
+
+		InstanceRecord record;
+		record.id = instance->id;
+		record.debugName = instance->debugName;
+		record.isHostInstance = !module || isHostModule(module);
+		record.moduleHash = 0;
+		if(!record.isHostInstance)
+		{
+			const Uptr moduleKey = reinterpret_cast<Uptr>(module);
+			if(const U64* moduleHash = moduleHashes.get(moduleKey))
+			{ record.moduleHash = *moduleHash; }
+			else
+			{
+				record.moduleHash = hashModule(module);
+				moduleHashes.add(moduleKey, record.moduleHash);
+			}
+
+			// Reference the objects bound to the instance's imports, in the order of the module's
+			// imports.
+			for(const KindAndIndex& kindIndex : module->ir.imports)
+			{
+				const Object* importObject = nullptr;
+				switch(kindIndex.kind)
+				{
+				case ExternKind::function:
+					importObject = asObject(instance->functions[kindIndex.index]);
+					break;
+				case ExternKind::table: importObject = instance->tables[kindIndex.index]; break;
+				case ExternKind::memory: importObject = instance->memories[kindIndex.index]; break;
+				case ExternKind::global: importObject = instance->globals[kindIndex.index]; break;
+				case ExternKind::exceptionType:
+					importObject = instance->exceptionTypes[kindIndex.index];
+					break;
+
+				case ExternKind::invalid:
+				default: WAVM_UNREACHABLE();
+				};
+
+				SnapshotRef importRef;
+				if(!writer.encodeRef(importObject, importRef)) { return false; }
+				record.imports.push_back(importRef);
+			}
+		}
+
+		for(const Table* table : instance->tables) { record.tableIds.push_back(table->id); }
+		for(const Memory* memory : instance->memories) { record.memoryIds.push_back(memory->id); }
+		for(const Global* global : instance->globals) { record.globalIds.push_back(global->id); }
+		for(const Runtime::ExceptionType* exceptionType : instance->exceptionTypes)
+		{ record.exceptionTypeIds.push_back(exceptionType->id); }
+
+		{
+			Platform::RWMutex::ShareableLock dataSegmentsLock(instance->dataSegmentsMutex);
+			for(Uptr segmentIndex = 0; segmentIndex < instance->dataSegments.size(); ++segmentIndex)
+			{
+				record.isDataSegmentDropped.push_back(
+					!module->ir.dataSegments[segmentIndex].isActive
+					&& !instance->dataSegments[segmentIndex]);
+			}
+		}
+		{
+			Platform::RWMutex::ShareableLock elemSegmentsLock(instance->elemSegmentsMutex);
+			for(Uptr segmentIndex = 0; segmentIndex < instance->elemSegments.size(); ++segmentIndex)
+			{
+				record.isElemSegmentDropped.push_back(
+					module->ir.elemSegments[segmentIndex].type == ElemSegment::Type::passive
+					&& !instance->elemSegments[segmentIndex]);
+			}
+		}
+
+		snapshot.instances.push_back(std::move(record));
+	}
+
+	// Serialize the description of the compartment's objects.
+	ArrayOutputStream stream;
+	serialize(stream, snapshot);
+	std::vector<U8> objectsBytes = stream.getBytes();
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = snapshotMagic;
+	header.version = snapshotVersion;
+	header.numBytesPerPage = U32(IR::numBytesPerPage);
+	header.objectsOffset = nextDataOffset;
+	header.numObjectsBytes = objectsBytes.size();
+
+	// Write the snapshot to a temporary file that is renamed to the path once it's complete, so a
+	// snapshot that was already at the path isn't lost if writing the new snapshot fails.
+	VFS::FileSystem& hostFS = Platform::getHostFS();
+	const std::string tempPath = std::string(path) + ".tmp";
+	VFS::VFD* vfd = nullptr;
+	if(!checkFileResult(
+		   hostFS.open(
+			   tempPath, VFS::FileAccessMode::writeOnly, VFS::FileCreateMode::createAlways, vfd),
+		   "creating",
+		   tempPath.c_str()))
+	{ return false; }
+
+	// Write the header, the memory pages that aren't all zero, and the object descriptions.
+	bool succeeded = true;
+	U64 offset = 0;
+	succeeded = succeeded
+				&& checkFileResult(vfd->write(&header, sizeof(header), nullptr, &offset),
+								   "writing",
+								   tempPath.c_str());
+	Uptr numWrittenPages = 0;
+	for(const MemoryRecord& record : snapshot.memories)
+	{
+		const Memory* memory = compartment->memories[record.id];
+		for(Uptr pageIndex = 0; succeeded && pageIndex < record.numPages; ++pageIndex)
+		{
+			const U8* page = memory->baseAddress + pageIndex * IR::numBytesPerPage;
+			if(!isZeroPage(page))
+			{
+				offset = record.dataOffset + pageIndex * IR::numBytesPerPage;
+				succeeded = checkFileResult(vfd->write(page, IR::numBytesPerPage, nullptr, &offset),
+											"writing",
+											tempPath.c_str());
+				++numWrittenPages;
+			}
+		}
+	}
+	offset = header.objectsOffset;
+	succeeded = succeeded
+				&& checkFileResult(
+					vfd->write(objectsBytes.data(), objectsBytes.size(), nullptr, &offset),
+					"writing",
+					tempPath.c_str());
+	succeeded = succeeded
+				&& checkFileResult(
+					vfd->sync(VFS::SyncType::contents), "writing", tempPath.c_str());
+	succeeded = checkFileResult(vfd->close(), "closing", tempPath.c_str()) && succeeded;
+
+	// Replace the file at the path with the complete snapshot, or delete the incomplete snapshot.
+	succeeded = succeeded
+				&& checkFileResult(hostFS.renameFile(tempPath, path), "renaming", tempPath.c_str());
+	if(!succeeded) { hostFS.unlinkFile(tempPath); }
+
+	Log::printf(Log::metrics,
+				"Snapshot of compartment %s: %" WAVM_PRIuPTR " non-zero memory pages, %" WAVM_PRIuPTR
+				" bytes of objects\n",
+				compartment->debugName.c_str(),
+				numWrittenPages,
+				objectsBytes.size());
+	Timing::logTimer("Saved compartment snapshot", timer);
+	return succeeded;
+}
+
+//
+// Restoring snapshots
+//
+
+struct SnapshotReader
+{
+	Compartment* compartment;
+	HashMap<Uptr, Table*> tables;
+	HashMap<Uptr, Memory*> memories;
+	HashMap<Uptr, Global*> globals;
+	HashMap<Uptr, Runtime::ExceptionType*> exceptionTypes;
+	HashMap<Uptr, Instance*> instances;
+
+	bool decodeRef(const SnapshotRef& ref, Object*& outObject)
+	{
+		outObject = nullptr;
+		switch(SnapshotObjectKind(ref.kind))
+		{
+		case SnapshotObjectKind::null: return true;
+		case SnapshotObjectKind::function: {
+			Instance* const* instance = instances.get(ref.id);
+			if(!instance || ref.functionIndex >= (*instance)->functions.size()) { return false; }
+			outObject = asObject((*instance)->functions[ref.functionIndex]);
+			return outObject != nullptr;
+		}
+		case SnapshotObjectKind::table: return decodeRef(tables, ref.id, outObject);
+		case SnapshotObjectKind::memory: return decodeRef(memories, ref.id, outObject);
+		case SnapshotObjectKind::global: return decodeRef(globals, ref.id, outObject);
+		case SnapshotObjectKind::exceptionType:
+			return decodeRef(exceptionTypes, ref.id, outObject);
+		case SnapshotObjectKind::instance: return decodeRef(instances, ref.id, outObject);
+
+		default: return false;
+		};
+	}
+
+	// Initializes a global that isn't defined by an instance, or sets the value of a mutable
+	// global that is.
+	bool restoreGlobalValue(const GlobalRecord& record, bool isDefinedByInstance)
+	{
+		Global* const* globalPointer = globals.get(record.id);
+		if(!globalPointer) { return false; }
+		Global* global = *globalPointer;
+		UntaggedValue value = record.value;
+		if(isReferenceType(global->type.valueType)
+		   && !decodeRef(record.referenceValue, value.object))
+		{ return false; }
+
+		if(!isDefinedByInstance && record.hasBeenInitialized)
+		{ initializeGlobal(global, Value(global->type.valueType, value)); }
+		else if(global->type.isMutable)
+		{
+			compartment->initialContextMutableGlobals[global->mutableGlobalIndex] = value;
+		}
+		return true;
+	}
+
+private:
+	template<typename ObjectType>
+	static bool decodeRef(const HashMap<Uptr, ObjectType*>& map, Uptr id, Object*& outObject)
+	{
+		ObjectType* const* object = map.get(id);
+		if(!object) { return false; }
+		outObject = asObject(*object);
+		return true;
+	}
+};
+
+template<typename ObjectType>
+static bool mapInstanceObjects(HashMap<Uptr, ObjectType*>& map,
+							   const std::vector<U64>& ids,
+							   const std::vector<ObjectType*>& objects)
+{
+	if(ids.size() != objects.size()) { return false; }
+	for(Uptr index = 0; index < ids.size(); ++index)
+	{
+		if(!map.contains(ids[index])) { map.add(ids[index], objects[index]); }
+	}
+	return true;
+}
+
+static bool restoreSnapshotObjects(SnapshotReader& reader,
+								   const CompartmentSnapshot& snapshot,
+								   const std::vector<ModuleConstRef>& modules,
+								   const RestoreHostInstanceFunction& restoreHostInstance,
+								   ResourceQuotaRefParam resourceQuota)
+{
+	Compartment* compartment = reader.compartment;
+
+	HashMap<U64, ModuleConstRef> hashToModuleMap;
+	for(const ModuleConstRef& module : modules)
+	{ hashToModuleMap.set(hashModule(module.get()), module); }
+
+	// Find the objects that are defined by instances, which are created by instantiating the
+	// instances' modules. Instances of host modules define all their objects.
+	HashSet<Uptr> instanceTableIds;
+	HashSet<Uptr> instanceMemoryIds;
+	HashSet<Uptr> instanceGlobalIds;
+	HashSet<Uptr> instanceExceptionTypeIds;
+	for(const InstanceRecord& record : snapshot.instances)
+	{
+		const ModuleConstRef* module = hashToModuleMap.get(record.moduleHash);
+		if(!record.isHostInstance && !module)
+		{
+			Log::printf(Log::error,
+						"The module instantiated as %s in the snapshot wasn't provided.\n",
+						record.debugName.c_str());
+			return false;
+		}
+
+		const IR::Module* irModule = record.isHostInstance ? nullptr : &(*module)->ir;
+		for(Uptr index = irModule ? irModule->tables.imports.size() : 0;
+			index < record.tableIds.size();
+			++index)
+		{ instanceTableIds.add(record.tableIds[index]); }
+		for(Uptr index = irModule ? irModule->memories.imports.size() : 0;
+			index < record.memoryIds.size();
+			++index)
+		{ instanceMemoryIds.add(record.memoryIds[index]); }
+		for(Uptr index = irModule ? irModule->globals.imports.size() : 0;
+			index < record.globalIds.size();
+			++index)
+		{ instanceGlobalIds.add(record.globalIds[index]); }
+		for(Uptr index = irModule ? irModule->exceptionTypes.imports.size() : 0;
+			index < record.exceptionTypeIds.size();
+			++index)
+		{ instanceExceptionTypeIds.add(record.exceptionTypeIds[index]); }
+	}
+
+	// Create the objects that aren't defined by an instance.
+	for(const MemoryRecord& record : snapshot.memories)
+	{
+		if(instanceMemoryIds.contains(record.id)) { continue; }
+		const MemoryType type(record.isShared != 0, {record.minPages, record.maxPages});
+		Memory* memory
+			= createMemory(compartment, type, std::string(record.debugName), resourceQuota);
+		if(!memory || !reader.memories.add(record.id, memory)) { return false; }
+	}
+	for(const TableRecord& record : snapshot.tables)
+	{
+		if(instanceTableIds.contains(record.id)) { continue; }
+		const TableType type(ReferenceType(record.elementType),
+							 record.isShared != 0,
+							 {record.minElements, record.maxElements});
+		Table* table = createTable(
+			compartment, type, nullptr, std::string(record.debugName), resourceQuota);
+		if(!table || !reader.tables.add(record.id, table)) { return false; }
+	}
+	for(const ExceptionTypeRecord& record : snapshot.exceptionTypes)
+	{
+		if(instanceExceptionTypeIds.contains(record.id)) { continue; }
+		std::vector<ValueType> params;
+		for(U8 param : record.params) { params.push_back(ValueType(param)); }
+		if(!reader.exceptionTypes.add(record.id,
+									  createExceptionType(compartment,
+														  IR::ExceptionType{TypeTuple(params)},
+														  std::string(record.debugName))))
+		{ return false; }
+	}
+	for(const GlobalRecord& record : snapshot.globals)
+	{
+		if(instanceGlobalIds.contains(record.id)) { continue; }
+		const GlobalType type(ValueType(record.valueType), record.isMutable != 0);
+		Global* global
+			= createGlobal(compartment, type, std::string(record.debugName), resourceQuota);
+		if(!global || !reader.globals.add(record.id, global)) { return false; }
+
+		// Initialize the globals that don't reference a function before the instances, since their
+		// values may be used by the instances' initializers.
+		if(record.referenceValue.kind != U8(SnapshotObjectKind::function)
+		   && !reader.restoreGlobalValue(record, false))
+		{ return false; }
+	}
+
+	// Instantiate the modules. The instances are in the order of their IDs, so an instance's
+	// imports are restored before it, unless the compartment reused the ID of a freed instance.
+	for(const InstanceRecord& record : snapshot.instances)
+	{
+		Instance* instance = nullptr;
+		if(record.isHostInstance)
+		{
+			if(restoreHostInstance)
+			{ instance = restoreHostInstance(compartment, record.debugName); }
+		}
+		else
+		{
+			ImportBindings imports;
+			for(const SnapshotRef& importRef : record.imports)
+			{
+				Object* importObject = nullptr;
+				if(!reader.decodeRef(importRef, importObject) || !importObject) { return false; }
+				imports.push_back(importObject);
+			}
+
+			instance = instantiateModuleWithoutActiveSegments(compartment,
+															   hashToModuleMap[record.moduleHash],
+															   std::move(imports),
+															   std::string(record.debugName),
+															   resourceQuota);
+		}
+		if(!instance)
+		{
+			Log::printf(
+				Log::error, "Couldn't restore instance %s.\n", record.debugName.c_str());
+			return false;
+		}
+
+		if(!reader.instances.add(record.id, instance)
+		   || !mapInstanceObjects(reader.tables, record.tableIds, instance->tables)
+		   || !mapInstanceObjects(reader.memories, record.memoryIds, instance->memories)
+		   || !mapInstanceObjects(reader.globals, record.globalIds, instance->globals)
+		   || !mapInstanceObjects(
+			   reader.exceptionTypes, record.exceptionTypeIds, instance->exceptionTypes))
+		{ return false; }
+
+		// Drop the passive segments that were dropped in the snapshotted instance.
+		if(record.isDataSegmentDropped.size() != instance->dataSegments.size()
+		   || record.isElemSegmentDropped.size() != instance->elemSegments.size())
+		{ return false; }
+		for(Uptr segmentIndex = 0; segmentIndex < record.isDataSegmentDropped.size(); ++segmentIndex)
+		{
+			if(record.isDataSegmentDropped[segmentIndex])
+			{ instance->dataSegments[segmentIndex].reset(); }
+		}
+		for(Uptr segmentIndex = 0; segmentIndex < record.isElemSegmentDropped.size(); ++segmentIndex)
+		{
+			if(record.isElemSegmentDropped[segmentIndex])
+			{ instance->elemSegments[segmentIndex].reset(); }
+		}
+	}
+
+	// Restore the values of the remaining globals.
+	for(const GlobalRecord& record : snapshot.globals)
+	{
+		const bool isDefinedByInstance = instanceGlobalIds.contains(record.id);
+		if((isDefinedByInstance || record.referenceValue.kind == U8(SnapshotObjectKind::function))
+		   && !reader.restoreGlobalValue(record, isDefinedByInstance))
+		{ return false; }
+	}
+
+	// Restore the tables' elements.
+	for(const TableRecord& record : snapshot.tables)
+	{
+		Table* const* tablePointer = reader.tables.get(record.id);
+		if(!tablePointer) { return false; }
+		Table* table = *tablePointer;
+		const Uptr numElements = getTableNumElements(table);
+		if(numElements > record.elements.size()
+		   || (numElements < record.elements.size()
+			   && growTable(table, record.elements.size() - numElements) != GrowResult::success))
+		{ return false; }
+
+		for(Uptr elementIndex = 0; elementIndex < record.elements.size(); ++elementIndex)
+		{
+			Object* element = nullptr;
+			if(!reader.decodeRef(record.elements[elementIndex], element)) { return false; }
+			setTableElement(table, elementIndex, element);
+		}
+	}
+
+	return true;
+}
+
+// Restores the contents of a memory from the snapshot, by mapping the pages of the snapshot
+// copy-on-write if possible, or by reading them from the file otherwise.
+static bool restoreMemoryContents(Memory* memory,
+								  const MemoryRecord& record,
+								  Platform::MemoryFile* snapshotMemoryFile,
+								  VFS::VFD* vfd,
+								  const char* path)
+{
+	const Uptr numPages = getMemoryNumPages(memory);
+	if(numPages > record.numPages
+	   || (numPages < record.numPages
+		   && growMemory(memory, record.numPages - numPages) != GrowResult::success))
+	{ return false; }
+	if(!record.numPages) { return true; }
+
+	if(snapshotMemoryFile
+	   && Platform::mapMemoryFile(snapshotMemoryFile,
+								  record.dataOffset,
+								  memory->baseAddress,
+								  record.numPages << getPlatformPagesPerWebAssemblyPageLog2(),
+								  true))
+	{ return true; }
+
+	U64 offset = record.dataOffset;
+	return checkFileResult(
+		vfd->read(memory->baseAddress, record.numPages * IR::numBytesPerPage, nullptr, &offset),
+		"reading",
+		path);
+}
+
+Compartment* Runtime::restoreCompartmentSnapshot(
+	const char* path,
+	const std::vector<ModuleConstRef>& modules,
+	const RestoreHostInstanceFunction& restoreHostInstance,
+	std::string&& debugName,
+	ResourceQuotaRefParam resourceQuota,
+	std::vector<Instance*>* outInstances)
+{
+	Timing::Timer timer;
+
+	VFS::VFD* vfd = nullptr;
+	if(!checkFileResult(
+		   Platform::getHostFS().open(
+			   path, VFS::FileAccessMode::readOnly, VFS::FileCreateMode::openExisting, vfd),
+		   "opening",
+		   path))
+	{ return nullptr; }
+
+	// Read the header and the description of the compartment's objects.
+	CompartmentSnapshot snapshot;
+	SnapshotHeader header;
+	U64 offset = 0;
+	Uptr numBytesRead = 0;
+	if(!checkFileResult(vfd->read(&header, sizeof(header), &numBytesRead, &offset), "reading", path)
+	   || numBytesRead != sizeof(header) || header.magic != snapshotMagic
+	   || header.version != snapshotVersion || header.numBytesPerPage != IR::numBytesPerPage)
+	{
+		Log::printf(Log::error, "'%s' isn't a compatible compartment snapshot.\n", path);
+		WAVM_ERROR_UNLESS(vfd->close() == VFS::Result::success);
+		return nullptr;
+	}
+
+	// Check that the object descriptions are within the file before allocating memory for them.
+	VFS::FileInfo fileInfo;
+	if(!checkFileResult(vfd->getFileInfo(fileInfo), "reading", path)
+	   || header.objectsOffset < IR::numBytesPerPage || header.objectsOffset > fileInfo.numBytes
+	   || header.numObjectsBytes > fileInfo.numBytes - header.objectsOffset)
+	{
+		Log::printf(Log::error, "Compartment snapshot '%s' is truncated or corrupt.\n", path);
+		WAVM_ERROR_UNLESS(vfd->close() == VFS::Result::success);
+		return nullptr;
+	}
+
+	std::vector<U8> objectsBytes(Uptr(header.numObjectsBytes));
+	offset = header.objectsOffset;
+	if(!checkFileResult(
+		   vfd->read(objectsBytes.data(), objectsBytes.size(), &numBytesRead, &offset),
+		   "reading",
+		   path)
+	   || numBytesRead != objectsBytes.size())
+	{
+		WAVM_ERROR_UNLESS(vfd->close() == VFS::Result::success);
+		return nullptr;
+	}
+	try
+	{
+		MemoryInputStream stream(objectsBytes.data(), objectsBytes.size());
+		serialize(stream, snapshot);
+	}
+	catch(FatalSerializationException const& exception)
+	{
+		Log::printf(Log::error,
+					"Error reading snapshot '%s': %s\n",
+					path,
+					exception.message.c_str());
+		WAVM_ERROR_UNLESS(vfd->close() == VFS::Result::success);
+		return nullptr;
+	}
+
+	// Check that the memories' contents are between the header and the object descriptions.
+	for(const MemoryRecord& record : snapshot.memories)
+	{
+		if(record.dataOffset % IR::numBytesPerPage || record.dataOffset < IR::numBytesPerPage
+		   || record.dataOffset > header.objectsOffset
+		   || record.numPages > (header.objectsOffset - record.dataOffset) / IR::numBytesPerPage)
+		{
+			Log::printf(Log::error, "Compartment snapshot '%s' is truncated or corrupt.\n", path);
+			WAVM_ERROR_UNLESS(vfd->close() == VFS::Result::success);
+			return nullptr;
+		}
+	}
+
+	// Recreate the compartment's objects, and restore the contents of its memories.
+	SnapshotReader reader;
+	reader.compartment = createCompartment(std::move(debugName));
+	bool succeeded = restoreSnapshotObjects(
+		reader, snapshot, modules, restoreHostInstance, resourceQuota);
+	if(succeeded)
+	{
+		Platform::MemoryFile* snapshotMemoryFile = Platform::openMemoryFile(path);
+		for(const MemoryRecord& record : snapshot.memories)
+		{
+			Memory* const* memory = reader.memories.get(record.id);
+			succeeded = memory
+						&& restoreMemoryContents(*memory, record, snapshotMemoryFile, vfd, path);
+			if(!succeeded) { break; }
+		}
+		if(snapshotMemoryFile) { Platform::destroyMemoryFile(snapshotMemoryFile); }
+	}
+	WAVM_ERROR_UNLESS(vfd->close() == VFS::Result::success);
+
+	if(!succeeded)
+	{
+		Log::printf(Log::error, "Couldn't restore compartment snapshot '%s'.\n", path);
+		GCPointer<Compartment> compartment = reader.compartment;
+		WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
+		return nullptr;
+	}
+
+	if(outInstances)
+	{
+		for(const InstanceRecord& record : snapshot.instances)
+		{ outInstances->push_back(reader.instances[record.id]); }
+	}
+
+	Timing::logTimer("Restored compartment snapshot", timer);
+	return reader.compartment;
+}
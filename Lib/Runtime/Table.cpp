@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <vector>
+#include "AddressRangeIndex.h"
 #include "RuntimePrivate.h"
 #include "WAVM/IR/Types.h"
 #include "WAVM/Inline/Assert.h"
@@ -20,9 +21,9 @@ namespace WAVM { namespace Runtime {
 	WAVM_DEFINE_INTRINSIC_MODULE(wavmIntrinsicsTable)
 }}
 
-// Global lists of tables; used to query whether an address is reserved by one of them.
-static Platform::RWMutex tablesMutex;
-static std::vector<Table*> tables;
+// Global index of the address ranges reserved by tables; used to query whether an address is
+// reserved by one of them.
+static AddressRangeIndex<Table*> tableAddressIndex;
 
 static constexpr Uptr numGuardPages = 1;
 
@@ -86,11 +87,10 @@ static Table* createTableImpl(Compartment* compartment,
 		return nullptr;
 	}
 
-	// Add the table to the global array.
-	{
-		Platform::RWMutex::ExclusiveLock tablesLock(tablesMutex);
-		tables.push_back(table);
-	}
+	// Add the table to the global address index.
+	tableAddressIndex.add(reinterpret_cast<Uptr>(table->elements),
+						  reinterpret_cast<Uptr>(table->elements) + table->numReservedBytes,
+						  table);
 	return table;
 }
 
@@ -255,18 +255,8 @@ Table::~Table()
 		compartment->runtimeData->tableBases[id] = nullptr;
 	}
 
-	// Remove the table from the global array.
-	{
-		Platform::RWMutex::ExclusiveLock tablesLock(tablesMutex);
-		for(Uptr tableIndex = 0; tableIndex < tables.size(); ++tableIndex)
-		{
-			if(tables[tableIndex] == this)
-			{
-				tables.erase(tables.begin() + tableIndex);
-				break;
-			}
-		}
-	}
+	// Remove the table from the global address index.
+	if(elements) { tableAddressIndex.remove(reinterpret_cast<Uptr>(elements)); }
 
 	// Free the virtual address space.
 	const Uptr pageBytesLog2 = Platform::getBytesPerPageLog2();
@@ -286,21 +276,13 @@ Table::~Table()
 
 bool Runtime::isAddressOwnedByTable(U8* address, Table*& outTable, Uptr& outTableIndex)
 {
-	// Iterate over all tables and check if the address is within the reserved address space for
-	// each.
-	Platform::RWMutex::ShareableLock tablesLock(tablesMutex);
-	for(auto table : tables)
-	{
-		U8* startAddress = (U8*)table->elements;
-		U8* endAddress = ((U8*)table->elements) + table->numReservedBytes;
-		if(address >= startAddress && address < endAddress)
-		{
-			outTable = table;
-			outTableIndex = (address - startAddress) / sizeof(Table::Element);
-			return true;
-		}
-	}
-	return false;
+	// Look up the table whose reserved address space contains the address.
+	Uptr baseAddress = 0;
+	if(!tableAddressIndex.lookup(reinterpret_cast<Uptr>(address), outTable, baseAddress))
+	{ return false; }
+
+	outTableIndex = (reinterpret_cast<Uptr>(address) - baseAddress) / sizeof(Table::Element);
+	return true;
 }
 
 static Object* setTableElementNonNull(Table* table, Uptr index, Object* object)
@@ -561,6 +543,18 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wavmIntrinsicsTable,
 	setTableElement(table, index, value);
 }
 
+WAVM_DEFINE_INTRINSIC_FUNCTION(wavmIntrinsicsTable,
+							   "ref.func",
+							   Object*,
+							   ref_func,
+							   Uptr instanceId,
+							   Uptr functionIndex)
+{
+	Instance* instance = getInstanceFromRuntimeData(contextRuntimeData, instanceId);
+	WAVM_ASSERT(functionIndex < instance->functions.size());
+	return asObject(instance->functions[functionIndex]);
+}
+
 WAVM_DEFINE_INTRINSIC_FUNCTION(wavmIntrinsicsTable,
 							   "table.init",
 							   void,
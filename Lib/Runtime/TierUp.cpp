@@ -0,0 +1,211 @@
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "RuntimePrivate.h"
+#include "WAVM/IR/Module.h"
+#include "WAVM/IR/Types.h"
+#include "WAVM/Inline/Assert.h"
+#include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Inline/Timing.h"
+#include "WAVM/LLVMJIT/LLVMJIT.h"
+#include "WAVM/Logging/Logging.h"
+#include "WAVM/Platform/Mutex.h"
+#include "WAVM/Platform/Thread.h"
+#include "WAVM/Runtime/Intrinsics.h"
+#include "WAVM/Runtime/Runtime.h"
+#include "WAVM/RuntimeABI/RuntimeABI.h"
+
+using namespace WAVM;
+using namespace WAVM::IR;
+using namespace WAVM::Runtime;
+
+// LLVM's code generator may recurse deeply, so give the thread that compiles optimized code a
+// larger stack than the default.
+static constexpr Uptr tierUpThreadNumStackBytes = 8 * 1024 * 1024;
+
+// The LoadedJITModules with functions that are waiting to be optimized, and the thread optimizing
+// them. The thread exits when there are no more functions waiting, or when the process is exiting.
+struct TierUpQueue
+{
+	Platform::Mutex mutex;
+	std::vector<std::shared_ptr<LoadedJITModule>> loadedJITModules;
+	Platform::Thread* thread = nullptr;
+	bool isThreadRunning = false;
+	bool isShuttingDown = false;
+
+	static TierUpQueue& get()
+	{
+		// The queue is never destroyed, so the LoadedJITModules that are still waiting when the
+		// process exits aren't freed during static destruction.
+		static TierUpQueue* queue = new TierUpQueue;
+		return *queue;
+	}
+};
+
+// Waits for the tier-up thread to exit when the process exits, so it can't still be compiling code
+// while static objects are being destroyed. It is created before the first tier-up thread is
+// started, so it is destroyed before any static objects that were created before that.
+struct TierUpThreadJoiner
+{
+	~TierUpThreadJoiner()
+	{
+		TierUpQueue& queue = TierUpQueue::get();
+		Platform::Thread* thread;
+		{
+			Platform::Mutex::Lock queueLock(queue.mutex);
+			queue.isShuttingDown = true;
+			thread = queue.thread;
+			queue.thread = nullptr;
+		}
+		if(thread) { Platform::joinThread(thread); }
+	}
+};
+
+static void tierUp(const std::shared_ptr<LoadedJITModule>& loadedJITModule)
+{
+	std::vector<Uptr> functionDefIndices;
+	{
+		Platform::Mutex::Lock tierUpLock(loadedJITModule->tierUpMutex);
+		functionDefIndices = std::move(loadedJITModule->pendingTierUpFunctionDefIndices);
+		loadedJITModule->pendingTierUpFunctionDefIndices.clear();
+	}
+	if(!functionDefIndices.size()) { return; }
+
+	Timing::Timer tierUpTimer;
+
+	// Compile optimized code for the functions.
+	const IR::Module& irModule = loadedJITModule->module->ir;
+	const LLVMJIT::TargetSpec targetSpec
+		= getCompileTargetSpec(loadedJITModule->module->boundsCheckMemoryAccesses);
+	std::vector<U8> objectCode
+		= LLVMJIT::compileTierUpFunctions(irModule, targetSpec, functionDefIndices);
+
+	// Create a FunctionMutableData for each optimized function. They are owned by the
+	// LLVMJIT::Module that the optimized code is loaded into.
+	std::vector<FunctionMutableData*> functionDefMutableDatas(irModule.functions.defs.size(),
+															  nullptr);
+	for(Uptr functionDefIndex : functionDefIndices)
+	{
+		const FunctionMutableData* baselineMutableData
+			= loadedJITModule->functionDefs[functionDefIndex]->mutableData;
+		functionDefMutableDatas[functionDefIndex]
+			= new FunctionMutableData(std::string(baselineMutableData->debugName));
+	}
+
+	// The optimized code references the other functions through their baseline code.
+	std::vector<LLVMJIT::FunctionBinding> baselineFunctionDefs;
+	for(const Function* function : loadedJITModule->functionDefs)
+	{ baselineFunctionDefs.push_back({function->code}); }
+
+	// Load the optimized code with the same bindings as the baseline code.
+	std::vector<FunctionType> jitTypes = irModule.types;
+	std::vector<LLVMJIT::FunctionBinding> jitFunctionImports
+		= loadedJITModule->functionImportBindings;
+	std::vector<LLVMJIT::TableBinding> jitTables = loadedJITModule->tableBindings;
+	std::vector<LLVMJIT::MemoryBinding> jitMemories = loadedJITModule->memoryBindings;
+	std::vector<LLVMJIT::GlobalBinding> jitGlobals = loadedJITModule->globalBindings;
+	std::vector<LLVMJIT::ExceptionTypeBinding> jitExceptionTypes
+		= loadedJITModule->exceptionTypeBindings;
+	std::shared_ptr<LLVMJIT::Module> tierUpJITModule
+		= LLVMJIT::loadModule(objectCode.data(),
+							  objectCode.size(),
+							  getWAVMIntrinsicsExportMap(),
+							  std::move(jitTypes),
+							  std::move(jitFunctionImports),
+							  std::move(jitTables),
+							  std::move(jitMemories),
+							  std::move(jitGlobals),
+							  std::move(jitExceptionTypes),
+							  {loadedJITModule->instanceId},
+							  reinterpret_cast<Uptr>(getOutOfBoundsElement()),
+							  functionDefMutableDatas,
+							  loadedJITModule->debugName + " (optimized)",
+							  baselineFunctionDefs);
+
+	// Keep the optimized code alive as long as the baseline code, and make the baseline code
+	// forward calls to it.
+	{
+		Platform::Mutex::Lock tierUpLock(loadedJITModule->tierUpMutex);
+		loadedJITModule->tierUpJITModules.push_back(tierUpJITModule);
+	}
+	for(Uptr functionDefIndex : functionDefIndices)
+	{
+		const Function* optimizedFunction = functionDefMutableDatas[functionDefIndex]->function;
+		WAVM_ASSERT(optimizedFunction);
+		loadedJITModule->functionDefs[functionDefIndex]->mutableData->tierUp.code.store(
+			optimizedFunction->code, std::memory_order_release);
+	}
+
+	Timing::logRatePerSecond("Optimized baseline tier functions",
+							 tierUpTimer,
+							 F64(functionDefIndices.size()),
+							 "functions");
+}
+
+static I64 tierUpThreadEntry(void*)
+{
+	TierUpQueue& queue = TierUpQueue::get();
+	while(true)
+	{
+		std::shared_ptr<LoadedJITModule> loadedJITModule;
+		{
+			Platform::Mutex::Lock queueLock(queue.mutex);
+			if(!queue.loadedJITModules.size() || queue.isShuttingDown)
+			{
+				queue.isThreadRunning = false;
+				break;
+			}
+			loadedJITModule = std::move(queue.loadedJITModules.front());
+			queue.loadedJITModules.erase(queue.loadedJITModules.begin());
+		}
+
+		tierUp(loadedJITModule);
+	}
+	return 0;
+}
+
+void Runtime::requestTierUp(const std::shared_ptr<LoadedJITModule>& loadedJITModule,
+							Uptr functionDefIndex)
+{
+	WAVM_ASSERT(functionDefIndex < loadedJITModule->functionDefs.size());
+
+	// Add the function to the functions waiting to be optimized. If other functions in the same
+	// LoadedJITModule were already waiting, it's already in the queue.
+	{
+		Platform::Mutex::Lock tierUpLock(loadedJITModule->tierUpMutex);
+		loadedJITModule->pendingTierUpFunctionDefIndices.push_back(functionDefIndex);
+		if(loadedJITModule->pendingTierUpFunctionDefIndices.size() > 1) { return; }
+	}
+
+	// Add the LoadedJITModule to the queue, and start a thread to process the queue if there isn't
+	// already one running.
+	static TierUpThreadJoiner tierUpThreadJoiner;
+	TierUpQueue& queue = TierUpQueue::get();
+	Platform::Mutex::Lock queueLock(queue.mutex);
+	if(queue.isShuttingDown) { return; }
+	queue.loadedJITModules.push_back(loadedJITModule);
+	if(!queue.isThreadRunning)
+	{
+		// If a previous thread exited because the queue was empty, join it before starting a new
+		// one. It has already released the queue's mutex, so this doesn't block for long.
+		if(queue.thread) { Platform::joinThread(queue.thread); }
+
+		queue.isThreadRunning = true;
+		queue.thread
+			= Platform::createThread(tierUpThreadNumStackBytes, tierUpThreadEntry, nullptr);
+	}
+}
+
+WAVM_DEFINE_INTRINSIC_FUNCTION(wavmIntrinsics,
+							   "requestTierUp",
+							   void,
+							   requestTierUpIntrinsic,
+							   Function* function,
+							   Uptr functionDefIndex)
+{
+	Instance* instance = getInstanceFromRuntimeData(contextRuntimeData, function->instanceId);
+	WAVM_ASSERT(functionDefIndex < instance->loadedJITModule->functionDefs.size());
+	WAVM_ASSERT(instance->loadedJITModule->functionDefs[functionDefIndex] == function);
+	requestTierUp(instance->loadedJITModule, functionDefIndex);
+}
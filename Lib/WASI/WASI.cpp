@@ -55,24 +55,6 @@ bool ProcessResolver::resolve(const std::string& moduleName,
 	return false;
 }
 
-WAVM_DEFINE_INTRINSIC_FUNCTION(wasi,
-							   "poll_oneoff",
-							   __wasi_errno_return_t,
-							   wasi_poll_oneoff,
-							   WASIAddress inAddress,
-							   WASIAddress outAddress,
-							   WASIAddress numSubscriptions,
-							   WASIAddress outNumEventsAddress)
-{
-	UNIMPLEMENTED_SYSCALL("poll_oneoff",
-						  "(" WASIADDRESS_FORMAT ", " WASIADDRESS_FORMAT ", %u, " WASIADDRESS_FORMAT
-						  ")",
-						  inAddress,
-						  outAddress,
-						  numSubscriptions,
-						  outNumEventsAddress);
-}
-
 WAVM_DEFINE_INTRINSIC_FUNCTION(wasi, "proc_exit", void, wasi_proc_exit, __wasi_exitcode_t exitCode)
 {
 	TRACE_SYSCALL("proc_exit", "(%u)", exitCode);
@@ -15,7 +15,7 @@ namespace WAVM { namespace WASI {
 	WAVM_DEFINE_INTRINSIC_MODULE(wasiClocks)
 }}
 
-static bool getPlatformClock(__wasi_clockid_t clock, Platform::Clock& outPlatformClock)
+bool WASI::getPlatformClock(__wasi_clockid_t clock, Platform::Clock& outPlatformClock)
 {
 	switch(clock)
 	{
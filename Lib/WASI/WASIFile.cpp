@@ -3,6 +3,7 @@
 #include "WAVM/Inline/Time.h"
 #include "WAVM/Logging/Logging.h"
 #include "WAVM/Platform/Clock.h"
+#include "WAVM/Platform/File.h"
 #include "WAVM/Platform/RWMutex.h"
 #include "WAVM/Runtime/Runtime.h"
 #include "WAVM/VFS/VFS.h"
@@ -1454,3 +1455,195 @@ WAVM_DEFINE_INTRINSIC_FUNCTION(wasiFile,
 	const VFS::Result result = process->fileSystem->createDir(canonicalPath);
 	return TRACE_SYSCALL_RETURN(asWASIErrNo(result));
 }
+
+WAVM_DEFINE_INTRINSIC_FUNCTION(wasiFile,
+							   "poll_oneoff",
+							   __wasi_errno_return_t,
+							   wasi_poll_oneoff,
+							   WASIAddress inAddress,
+							   WASIAddress outAddress,
+							   WASIAddress numSubscriptions,
+							   WASIAddress outNumEventsAddress)
+{
+	TRACE_SYSCALL("poll_oneoff",
+				  "(" WASIADDRESS_FORMAT ", " WASIADDRESS_FORMAT ", %u, " WASIADDRESS_FORMAT ")",
+				  inAddress,
+				  outAddress,
+				  numSubscriptions,
+				  outNumEventsAddress);
+
+	Process* process = getProcessFromContextRuntimeData(contextRuntimeData);
+
+	if(numSubscriptions == 0) { return TRACE_SYSCALL_RETURN(__WASI_EINVAL); }
+
+	const __wasi_subscription_t* subscriptions
+		= memoryArrayPtr<const __wasi_subscription_t>(process->memory, inAddress, numSubscriptions);
+	__wasi_event_t* events
+		= memoryArrayPtr<__wasi_event_t>(process->memory, outAddress, numSubscriptions);
+
+	// Clock subscriptions are waited for as a deadline on the realtime or monotonic clock. CPU time
+	// can't be waited for directly, so CPU time deadlines are translated to the monotonic clock.
+	struct ClockSubscription
+	{
+		__wasi_userdata_t userdata;
+		Platform::Clock clock;
+		Time deadline;
+	};
+	std::vector<ClockSubscription> clockSubscriptions;
+	Platform::Clock earliestDeadlineClock = Platform::Clock::monotonic;
+	Time earliestDeadline = Time::infinity();
+	I128 earliestMonotonicDeadlineNS = 0;
+
+	// FD subscriptions are waited for with Platform::pollVFDs. Each FDE is only locked once, even if
+	// it is used by multiple subscriptions.
+	struct FDSubscription
+	{
+		__wasi_userdata_t userdata;
+		__wasi_eventtype_t type;
+	};
+	std::vector<FDSubscription> fdSubscriptions;
+	std::vector<Platform::VFDPoll> vfdPolls;
+	std::vector<__wasi_fd_t> lockedFDs;
+	std::vector<LockedFDE> lockedFDEs;
+
+	Uptr numEvents = 0;
+	for(Uptr subscriptionIndex = 0; subscriptionIndex < numSubscriptions; ++subscriptionIndex)
+	{
+		const __wasi_subscription_t subscription = subscriptions[subscriptionIndex];
+		switch(subscription.type)
+		{
+		case __WASI_EVENTTYPE_CLOCK: {
+			Platform::Clock clock;
+			if(!getPlatformClock(subscription.u.clock.clock_id, clock))
+			{
+				__wasi_event_t& event = events[numEvents++];
+				memset(&event, 0, sizeof(__wasi_event_t));
+				event.userdata = subscription.userdata;
+				event.error = __WASI_EINVAL;
+				event.type = __WASI_EVENTTYPE_CLOCK;
+				break;
+			}
+
+			Time deadline{I128(U64(subscription.u.clock.timeout))};
+			if(!(subscription.u.clock.flags & __WASI_SUBSCRIPTION_CLOCK_ABSTIME))
+			{ deadline.ns = deadline.ns + Platform::getClockTime(clock).ns; }
+			else if(clock == Platform::Clock::processCPUTime)
+			{
+				deadline.ns = deadline.ns + process->processClockOrigin.ns;
+			}
+
+			const I128 monotonicTimeNS = Platform::getClockTime(Platform::Clock::monotonic).ns;
+			if(clock != Platform::Clock::monotonic)
+			{
+				const I128 monotonicDeadlineNS
+					= monotonicTimeNS + (deadline.ns - Platform::getClockTime(clock).ns);
+				if(clock == Platform::Clock::processCPUTime)
+				{
+					clock = Platform::Clock::monotonic;
+					deadline.ns = monotonicDeadlineNS;
+				}
+				if(isInfinity(earliestDeadline) || monotonicDeadlineNS < earliestMonotonicDeadlineNS)
+				{
+					earliestDeadlineClock = clock;
+					earliestDeadline = deadline;
+					earliestMonotonicDeadlineNS = monotonicDeadlineNS;
+				}
+			}
+			else if(isInfinity(earliestDeadline) || deadline.ns < earliestMonotonicDeadlineNS)
+			{
+				earliestDeadlineClock = clock;
+				earliestDeadline = deadline;
+				earliestMonotonicDeadlineNS = deadline.ns;
+			}
+
+			clockSubscriptions.push_back({subscription.userdata, clock, deadline});
+			break;
+		}
+
+		case __WASI_EVENTTYPE_FD_READ:
+		case __WASI_EVENTTYPE_FD_WRITE: {
+			const __wasi_fd_t fd = subscription.u.fd_readwrite.fd;
+			Uptr lockedFDIndex = 0;
+			while(lockedFDIndex < lockedFDs.size() && lockedFDs[lockedFDIndex] != fd)
+			{ ++lockedFDIndex; }
+			if(lockedFDIndex == lockedFDs.size())
+			{
+				LockedFDE lockedFDE
+					= getLockedFDE(process, fd, __WASI_RIGHT_POLL_FD_READWRITE, 0);
+				if(lockedFDE.error != __WASI_ESUCCESS)
+				{
+					__wasi_event_t& event = events[numEvents++];
+					memset(&event, 0, sizeof(__wasi_event_t));
+					event.userdata = subscription.userdata;
+					event.error = lockedFDE.error;
+					event.type = subscription.type;
+					break;
+				}
+				lockedFDs.push_back(fd);
+				lockedFDEs.push_back(std::move(lockedFDE));
+			}
+
+			Platform::VFDPoll vfdPoll;
+			vfdPoll.vfd = lockedFDEs[lockedFDIndex].fde->vfd;
+			vfdPoll.waitForRead = subscription.type == __WASI_EVENTTYPE_FD_READ;
+			vfdPoll.waitForWrite = subscription.type == __WASI_EVENTTYPE_FD_WRITE;
+			vfdPolls.push_back(vfdPoll);
+			fdSubscriptions.push_back({subscription.userdata, subscription.type});
+			break;
+		}
+
+		default: return TRACE_SYSCALL_RETURN(__WASI_EINVAL);
+		};
+	}
+
+	// If any subscriptions have already failed, don't block waiting for the others.
+	if(numEvents)
+	{
+		earliestDeadlineClock = Platform::Clock::monotonic;
+		earliestDeadline = Time{0};
+	}
+
+	while(true)
+	{
+		Uptr numReadyVFDs = 0;
+		const VFS::Result result = Platform::pollVFDs(vfdPolls.data(),
+													  vfdPolls.size(),
+													  earliestDeadlineClock,
+													  earliestDeadline,
+													  numReadyVFDs);
+		if(result != VFS::Result::success) { return TRACE_SYSCALL_RETURN(asWASIErrNo(result)); }
+
+		for(Uptr pollIndex = 0; pollIndex < vfdPolls.size(); ++pollIndex)
+		{
+			const Platform::VFDPoll& vfdPoll = vfdPolls[pollIndex];
+			if(vfdPoll.result == VFS::Result::success && !vfdPoll.isReadable
+			   && !vfdPoll.isWritable && !vfdPoll.isHungUp)
+			{ continue; }
+
+			__wasi_event_t& event = events[numEvents++];
+			memset(&event, 0, sizeof(__wasi_event_t));
+			event.userdata = fdSubscriptions[pollIndex].userdata;
+			event.error = asWASIErrNo(vfdPoll.result);
+			event.type = fdSubscriptions[pollIndex].type;
+			event.u.fd_readwrite.nbytes = vfdPoll.numReadableBytes;
+			event.u.fd_readwrite.flags = vfdPoll.isHungUp ? __WASI_EVENT_FD_READWRITE_HANGUP : 0;
+		}
+
+		for(const ClockSubscription& clockSubscription : clockSubscriptions)
+		{
+			if(Platform::getClockTime(clockSubscription.clock).ns >= clockSubscription.deadline.ns)
+			{
+				__wasi_event_t& event = events[numEvents++];
+				memset(&event, 0, sizeof(__wasi_event_t));
+				event.userdata = clockSubscription.userdata;
+				event.error = __WASI_ESUCCESS;
+				event.type = __WASI_EVENTTYPE_CLOCK;
+			}
+		}
+
+		if(numEvents) { break; }
+	}
+
+	memoryRef<WASIAddress>(process->memory, outNumEventsAddress) = WASIAddress(numEvents);
+	return TRACE_SYSCALL_RETURN(__WASI_ESUCCESS, "(%" WAVM_PRIuPTR ")", numEvents);
+}
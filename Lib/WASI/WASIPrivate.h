@@ -4,6 +4,7 @@
 #include "WAVM/Inline/HashMap.h"
 #include "WAVM/Inline/IndexMap.h"
 #include "WAVM/Inline/Time.h"
+#include "WAVM/Platform/Clock.h"
 #include "WAVM/Platform/Mutex.h"
 #include "WAVM/Platform/RWMutex.h"
 #include "WAVM/Runtime/Intrinsics.h"
@@ -140,6 +141,9 @@ namespace WAVM { namespace WASI {
 									   const char* format,
 									   ...);
 
+	// Translates a WASI clock ID to a platform clock. Returns false if the clock ID is invalid.
+	bool getPlatformClock(__wasi_clockid_t clock, Platform::Clock& outPlatformClock);
+
 	WAVM_DECLARE_INTRINSIC_MODULE(wasi);
 	WAVM_DECLARE_INTRINSIC_MODULE(wasiArgsEnvs);
 	WAVM_DECLARE_INTRINSIC_MODULE(wasiClocks);
@@ -1,4 +1,6 @@
 #include <stdint.h>
+#include <algorithm>
+#include <functional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -1460,131 +1462,149 @@ static void serializeModule(OutputStream& moduleStream, Module& module)
 	serializeCustomSectionsAfterKnownSection(moduleStream, module, OrderedSectionID::data);
 }
 
-static void serializeModule(InputStream& moduleStream, Module& module)
+// The state of a module that is being loaded that persists between its sections.
+struct ModuleLoadState
 {
-	serializeConstant(moduleStream, "magic number", U32(magicNumber));
-	serializeConstant(moduleStream, "version", U32(currentVersion));
-
 	ModuleSerializationState moduleState;
-	moduleState.validationState = IR::createModuleValidationState(module);
-
 	OrderedSectionID lastKnownOrderedSectionID = OrderedSectionID::moduleBeginning;
 	bool hadFunctionDefinitions = false;
 	bool hadDataSection = false;
-	while(moduleStream.capacity())
+
+	ModuleLoadState(Module& module)
 	{
-		SectionID sectionID;
-		serialize(moduleStream, sectionID);
+		moduleState.validationState = IR::createModuleValidationState(module);
+	}
+};
 
-		if(sectionID != SectionID::custom)
-		{
-			OrderedSectionID orderedSectionID;
-			switch(sectionID)
-			{
-			case SectionID::type: orderedSectionID = OrderedSectionID::type; break;
-			case SectionID::import: orderedSectionID = OrderedSectionID::import; break;
-			case SectionID::function: orderedSectionID = OrderedSectionID::function; break;
-			case SectionID::table: orderedSectionID = OrderedSectionID::table; break;
-			case SectionID::memory: orderedSectionID = OrderedSectionID::memory; break;
-			case SectionID::global: orderedSectionID = OrderedSectionID::global; break;
-			case SectionID::export_: orderedSectionID = OrderedSectionID::export_; break;
-			case SectionID::start: orderedSectionID = OrderedSectionID::start; break;
-			case SectionID::elem: orderedSectionID = OrderedSectionID::elem; break;
-			case SectionID::code: orderedSectionID = OrderedSectionID::code; break;
-			case SectionID::data: orderedSectionID = OrderedSectionID::data; break;
-			case SectionID::dataCount: orderedSectionID = OrderedSectionID::dataCount; break;
-			case SectionID::exceptionType:
-				orderedSectionID = OrderedSectionID::exceptionType;
-				break;
+static void serializeModuleHeader(InputStream& moduleStream)
+{
+	serializeConstant(moduleStream, "magic number", U32(magicNumber));
+	serializeConstant(moduleStream, "version", U32(currentVersion));
+}
 
-			case SectionID::custom: WAVM_UNREACHABLE();
-			default:
-				throw FatalSerializationException("unknown section ID ("
-												  + std::to_string(U8(sectionID)));
-			};
+// Checks that a known section follows the known sections that preceded it.
+static void checkKnownSectionOrder(SectionID sectionID, ModuleLoadState& loadState)
+{
+	OrderedSectionID orderedSectionID;
+	switch(sectionID)
+	{
+	case SectionID::type: orderedSectionID = OrderedSectionID::type; break;
+	case SectionID::import: orderedSectionID = OrderedSectionID::import; break;
+	case SectionID::function: orderedSectionID = OrderedSectionID::function; break;
+	case SectionID::table: orderedSectionID = OrderedSectionID::table; break;
+	case SectionID::memory: orderedSectionID = OrderedSectionID::memory; break;
+	case SectionID::global: orderedSectionID = OrderedSectionID::global; break;
+	case SectionID::export_: orderedSectionID = OrderedSectionID::export_; break;
+	case SectionID::start: orderedSectionID = OrderedSectionID::start; break;
+	case SectionID::elem: orderedSectionID = OrderedSectionID::elem; break;
+	case SectionID::code: orderedSectionID = OrderedSectionID::code; break;
+	case SectionID::data: orderedSectionID = OrderedSectionID::data; break;
+	case SectionID::dataCount: orderedSectionID = OrderedSectionID::dataCount; break;
+	case SectionID::exceptionType: orderedSectionID = OrderedSectionID::exceptionType; break;
+
+	case SectionID::custom: WAVM_UNREACHABLE();
+	default:
+		throw FatalSerializationException("unknown section ID (" + std::to_string(U8(sectionID)));
+	};
 
-			if(orderedSectionID > lastKnownOrderedSectionID)
-			{ lastKnownOrderedSectionID = orderedSectionID; }
-			else
-			{
-				throw FatalSerializationException("incorrect order for known section");
-			}
-		}
+	if(orderedSectionID > loadState.lastKnownOrderedSectionID)
+	{ loadState.lastKnownOrderedSectionID = orderedSectionID; }
+	else
+	{
+		throw FatalSerializationException("incorrect order for known section");
+	}
+}
 
-		switch(sectionID)
-		{
-		case SectionID::type:
-			serializeTypeSection(moduleStream, module);
-			IR::validateTypes(*moduleState.validationState);
-			break;
-		case SectionID::import:
-			serializeImportSection(moduleStream, module);
-			IR::validateImports(*moduleState.validationState);
-			break;
-		case SectionID::function:
-			serializeFunctionSection(moduleStream, module);
-			IR::validateFunctionDeclarations(*moduleState.validationState);
-			break;
-		case SectionID::table:
-			serializeTableSection(moduleStream, module);
-			IR::validateTableDefs(*moduleState.validationState);
-			break;
-		case SectionID::memory:
-			serializeMemorySection(moduleStream, module);
-			IR::validateMemoryDefs(*moduleState.validationState);
-			break;
-		case SectionID::global:
-			serializeGlobalSection(moduleStream, module);
-			IR::validateGlobalDefs(*moduleState.validationState);
-			break;
-		case SectionID::exceptionType:
-			serializeExceptionTypeSection(moduleStream, module);
-			IR::validateExceptionTypeDefs(*moduleState.validationState);
-			break;
-		case SectionID::export_:
-			serializeExportSection(moduleStream, module);
-			IR::validateExports(*moduleState.validationState);
-			break;
-		case SectionID::start:
-			serializeStartSection(moduleStream, module);
-			IR::validateStartFunction(*moduleState.validationState);
-			break;
-		case SectionID::elem:
-			serializeElementSection(moduleStream, module);
-			IR::validateElemSegments(*moduleState.validationState);
-			break;
-		case SectionID::dataCount:
-			serializeDataCountSection(moduleStream, module);
-			moduleState.hadDataCountSection = true;
-			break;
-		case SectionID::code:
-			serializeCodeSection(moduleStream, module, moduleState);
-			hadFunctionDefinitions = true;
-			break;
-		case SectionID::data:
-			serializeDataSection(moduleStream, module, moduleState.hadDataCountSection);
-			hadDataSection = true;
-			IR::validateDataSegments(*moduleState.validationState);
-			break;
-		case SectionID::custom: {
-			CustomSection& customSection
-				= *module.customSections.insert(module.customSections.end(), CustomSection());
-			customSection.afterSection = getMaxPresentSection(module, lastKnownOrderedSectionID);
-			serialize(moduleStream, customSection);
-			break;
-		}
-		default: throw FatalSerializationException("unknown section ID");
-		};
+// Loads a section's ID and contents.
+static void serializeModuleSection(InputStream& moduleStream,
+								   Module& module,
+								   ModuleLoadState& loadState)
+{
+	ModuleSerializationState& moduleState = loadState.moduleState;
+
+	SectionID sectionID;
+	serialize(moduleStream, sectionID);
+
+	if(sectionID != SectionID::custom) { checkKnownSectionOrder(sectionID, loadState); }
+
+	switch(sectionID)
+	{
+	case SectionID::type:
+		serializeTypeSection(moduleStream, module);
+		IR::validateTypes(*moduleState.validationState);
+		break;
+	case SectionID::import:
+		serializeImportSection(moduleStream, module);
+		IR::validateImports(*moduleState.validationState);
+		break;
+	case SectionID::function:
+		serializeFunctionSection(moduleStream, module);
+		IR::validateFunctionDeclarations(*moduleState.validationState);
+		break;
+	case SectionID::table:
+		serializeTableSection(moduleStream, module);
+		IR::validateTableDefs(*moduleState.validationState);
+		break;
+	case SectionID::memory:
+		serializeMemorySection(moduleStream, module);
+		IR::validateMemoryDefs(*moduleState.validationState);
+		break;
+	case SectionID::global:
+		serializeGlobalSection(moduleStream, module);
+		IR::validateGlobalDefs(*moduleState.validationState);
+		break;
+	case SectionID::exceptionType:
+		serializeExceptionTypeSection(moduleStream, module);
+		IR::validateExceptionTypeDefs(*moduleState.validationState);
+		break;
+	case SectionID::export_:
+		serializeExportSection(moduleStream, module);
+		IR::validateExports(*moduleState.validationState);
+		break;
+	case SectionID::start:
+		serializeStartSection(moduleStream, module);
+		IR::validateStartFunction(*moduleState.validationState);
+		break;
+	case SectionID::elem:
+		serializeElementSection(moduleStream, module);
+		IR::validateElemSegments(*moduleState.validationState);
+		break;
+	case SectionID::dataCount:
+		serializeDataCountSection(moduleStream, module);
+		moduleState.hadDataCountSection = true;
+		break;
+	case SectionID::code:
+		serializeCodeSection(moduleStream, module, moduleState);
+		loadState.hadFunctionDefinitions = true;
+		break;
+	case SectionID::data:
+		serializeDataSection(moduleStream, module, moduleState.hadDataCountSection);
+		loadState.hadDataSection = true;
+		IR::validateDataSegments(*moduleState.validationState);
+		break;
+	case SectionID::custom: {
+		CustomSection& customSection
+			= *module.customSections.insert(module.customSections.end(), CustomSection());
+		customSection.afterSection
+			= getMaxPresentSection(module, loadState.lastKnownOrderedSectionID);
+		serialize(moduleStream, customSection);
+		break;
+	}
+	default: throw FatalSerializationException("unknown section ID");
 	};
+}
 
-	if(module.functions.defs.size() && !hadFunctionDefinitions)
+// Checks that the sections that must accompany other sections were present.
+static void checkRequiredSections(const Module& module, const ModuleLoadState& loadState)
+{
+	if(module.functions.defs.size() && !loadState.hadFunctionDefinitions)
 	{
 		throw FatalSerializationException(
 			"module contained function declarations, but no corresponding "
 			"function definition section");
 	}
 
-	if(module.dataSegments.size() && !hadDataSection)
+	if(module.dataSegments.size() && !loadState.hadDataSection)
 	{
 		throw FatalSerializationException(
 			"module contained DataCount section with non-zero segment count, but no corresponding "
@@ -1592,6 +1612,16 @@ static void serializeModule(InputStream& moduleStream, Module& module)
 	}
 }
 
+static void serializeModule(InputStream& moduleStream, Module& module)
+{
+	serializeModuleHeader(moduleStream);
+
+	ModuleLoadState loadState(module);
+	while(moduleStream.capacity()) { serializeModuleSection(moduleStream, module, loadState); };
+
+	checkRequiredSections(module, loadState);
+}
+
 std::vector<U8> WASM::saveBinaryModule(const Module& module)
 {
 	try
@@ -1606,27 +1636,19 @@ std::vector<U8> WASM::saveBinaryModule(const Module& module)
 	}
 }
 
-bool WASM::loadBinaryModule(const U8* wasmBytes,
-							Uptr numWASMBytes,
-							IR::Module& outModule,
-							LoadError* outError)
+// Calls load, and translates the exceptions it may throw to a LoadError.
+template<typename Load> static bool catchLoadErrors(WASM::LoadError* outError, Load&& load)
 {
-	// Load the module from a binary WebAssembly file.
 	try
 	{
-		Timing::Timer loadTimer;
-		MemoryInputStream stream(wasmBytes, numWASMBytes);
-
-		serializeModule(stream, outModule);
-
-		Timing::logRatePerSecond("Loaded WASM", loadTimer, numWASMBytes / 1024.0 / 1024.0, "MiB");
+		load();
 		return true;
 	}
 	catch(Serialization::FatalSerializationException const& exception)
 	{
 		if(outError)
 		{
-			outError->type = LoadError::Type::malformed;
+			outError->type = WASM::LoadError::Type::malformed;
 			outError->message = "Module was malformed: " + exception.message;
 		}
 		return false;
@@ -1635,7 +1657,7 @@ bool WASM::loadBinaryModule(const U8* wasmBytes,
 	{
 		if(outError)
 		{
-			outError->type = LoadError::Type::invalid;
+			outError->type = WASM::LoadError::Type::invalid;
 			outError->message = "Module was invalid: " + exception.message;
 		}
 		return false;
@@ -1644,9 +1666,277 @@ bool WASM::loadBinaryModule(const U8* wasmBytes,
 	{
 		if(outError)
 		{
-			outError->type = LoadError::Type::malformed;
+			outError->type = WASM::LoadError::Type::malformed;
 			outError->message = "Memory allocation failed: input is likely malformed";
 		}
 		return false;
 	}
 }
+
+bool WASM::loadBinaryModule(const U8* wasmBytes,
+							Uptr numWASMBytes,
+							IR::Module& outModule,
+							LoadError* outError)
+{
+	// Load the module from a binary WebAssembly file.
+	return catchLoadErrors(outError, [&]() {
+		Timing::Timer loadTimer;
+		MemoryInputStream stream(wasmBytes, numWASMBytes);
+
+		serializeModule(stream, outModule);
+
+		Timing::logRatePerSecond("Loaded WASM", loadTimer, numWASMBytes / 1024.0 / 1024.0, "MiB");
+	});
+}
+
+// Returns the number of bytes in the LEB128 encoded U32 at the beginning of bytes, or 0 if bytes
+// ends before it does. If the first 5 bytes don't end a LEB128, returns 5, and decoding them will
+// throw an exception.
+static Uptr getVarUInt32NumBytes(const U8* bytes, Uptr numBytes)
+{
+	for(Uptr byteIndex = 0; byteIndex < numBytes && byteIndex < 5; ++byteIndex)
+	{
+		if(!(bytes[byteIndex] & 0x80)) { return byteIndex + 1; }
+	}
+	return numBytes >= 5 ? 5 : 0;
+}
+
+namespace WAVM { namespace WASM {
+	struct StreamingLoader
+	{
+		enum class State
+		{
+			header,
+			sectionStart,
+			codeSectionStart,
+			functionBody,
+			failed,
+		};
+
+		Module& module;
+		FunctionDefLoadedCallback onFunctionDefLoaded;
+		ModuleLoadState loadState;
+
+		State state = State::header;
+		LoadError error;
+
+		// The bytes that have been fed, but not yet loaded.
+		std::vector<U8> bytes;
+		Uptr numBytesLoaded = 0;
+
+		// The number of code section bytes that follow the loaded bytes.
+		Uptr numRemainingCodeSectionBytes = 0;
+		Uptr nextFunctionDefIndex = 0;
+
+		Uptr numBytesFed = 0;
+		Timing::Timer loadTimer;
+
+		StreamingLoader(Module& inModule, FunctionDefLoadedCallback&& inOnFunctionDefLoaded)
+		: module(inModule)
+		, onFunctionDefLoaded(std::move(inOnFunctionDefLoaded))
+		, loadState(inModule)
+		{
+		}
+
+		const U8* getUnloadedBytes() const { return bytes.data() + numBytesLoaded; }
+		Uptr getNumUnloadedBytes() const { return bytes.size() - numBytesLoaded; }
+
+		// Loads as much of the module as possible from the bytes that have been fed.
+		void load();
+
+		// Loads the function bodies in the code section individually, so they may be compiled
+		// while the rest of the code section is being fed.
+		bool loadCodeSectionStart();
+		bool loadFunctionBody();
+	};
+}}
+
+void WASM::StreamingLoader::load()
+{
+	while(true)
+	{
+		switch(state)
+		{
+		case State::header: {
+			if(getNumUnloadedBytes() < 8) { return; }
+			MemoryInputStream headerStream(getUnloadedBytes(), 8);
+			serializeModuleHeader(headerStream);
+			numBytesLoaded += 8;
+			state = State::sectionStart;
+			break;
+		}
+		case State::sectionStart: {
+			// Wait until the section ID and size have been fed.
+			if(getNumUnloadedBytes() < 1) { return; }
+			const Uptr numSizeBytes
+				= getVarUInt32NumBytes(getUnloadedBytes() + 1, getNumUnloadedBytes() - 1);
+			if(!numSizeBytes) { return; }
+
+			MemoryInputStream sectionHeaderStream(getUnloadedBytes(), 1 + numSizeBytes);
+			SectionID sectionID;
+			Uptr numSectionBytes = 0;
+			serialize(sectionHeaderStream, sectionID);
+			serializeVarUInt32(sectionHeaderStream, numSectionBytes);
+
+			if(sectionID == SectionID::code)
+			{
+				checkKnownSectionOrder(sectionID, loadState);
+				numBytesLoaded += 1 + numSizeBytes;
+				numRemainingCodeSectionBytes = numSectionBytes;
+				state = State::codeSectionStart;
+			}
+			else
+			{
+				// Wait until the whole section has been fed, and load it.
+				const Uptr numSectionHeaderAndBytes = 1 + numSizeBytes + numSectionBytes;
+				if(getNumUnloadedBytes() < numSectionHeaderAndBytes) { return; }
+				MemoryInputStream sectionStream(getUnloadedBytes(), numSectionHeaderAndBytes);
+				serializeModuleSection(sectionStream, module, loadState);
+				numBytesLoaded += numSectionHeaderAndBytes;
+			}
+			break;
+		}
+		case State::codeSectionStart:
+			if(!loadCodeSectionStart()) { return; }
+			break;
+		case State::functionBody:
+			if(!loadFunctionBody()) { return; }
+			break;
+		case State::failed: return;
+		default: WAVM_UNREACHABLE();
+		};
+	};
+}
+
+bool WASM::StreamingLoader::loadCodeSectionStart()
+{
+	const Uptr numAvailableBytes
+		= std::min(getNumUnloadedBytes(), numRemainingCodeSectionBytes);
+	const Uptr numCountBytes = getVarUInt32NumBytes(getUnloadedBytes(), numAvailableBytes);
+	if(!numCountBytes)
+	{
+		// If the count doesn't fit in the section, report the same error as loadBinaryModule.
+		if(numAvailableBytes == numRemainingCodeSectionBytes)
+		{ throw FatalSerializationException("expected data but found end of stream"); }
+		return false;
+	}
+
+	MemoryInputStream countStream(getUnloadedBytes(), numCountBytes);
+	Uptr numFunctionBodies = 0;
+	serializeVarUInt32(countStream, numFunctionBodies);
+	if(numFunctionBodies != module.functions.defs.size())
+	{
+		throw FatalSerializationException(
+			"function and code sections have mismatched function counts");
+	}
+
+	numBytesLoaded += numCountBytes;
+	numRemainingCodeSectionBytes -= numCountBytes;
+	state = State::functionBody;
+	return true;
+}
+
+bool WASM::StreamingLoader::loadFunctionBody()
+{
+	if(nextFunctionDefIndex == module.functions.defs.size())
+	{
+		if(numRemainingCodeSectionBytes)
+		{ throw FatalSerializationException("section contained more data than expected"); }
+		loadState.hadFunctionDefinitions = true;
+		state = State::sectionStart;
+		return true;
+	}
+
+	// Wait until the function body's size and all of its bytes have been fed.
+	const Uptr numAvailableBytes
+		= std::min(getNumUnloadedBytes(), numRemainingCodeSectionBytes);
+	const Uptr numSizeBytes = getVarUInt32NumBytes(getUnloadedBytes(), numAvailableBytes);
+	if(!numSizeBytes)
+	{
+		if(numAvailableBytes == numRemainingCodeSectionBytes)
+		{ throw FatalSerializationException("expected data but found end of stream"); }
+		return false;
+	}
+
+	MemoryInputStream sizeStream(getUnloadedBytes(), numSizeBytes);
+	Uptr numBodyBytes = 0;
+	serializeVarUInt32(sizeStream, numBodyBytes);
+	if(numBodyBytes > numRemainingCodeSectionBytes - numSizeBytes)
+	{ throw FatalSerializationException("expected data but found end of stream"); }
+	if(getNumUnloadedBytes() < numSizeBytes + numBodyBytes) { return false; }
+
+	// Load the function body, and pass it to the callback.
+	const Uptr functionDefIndex = nextFunctionDefIndex++;
+	MemoryInputStream bodyStream(getUnloadedBytes(), numSizeBytes + numBodyBytes);
+	serializeFunctionBody(
+		bodyStream, module, module.functions.defs[functionDefIndex], loadState.moduleState);
+	numBytesLoaded += numSizeBytes + numBodyBytes;
+	numRemainingCodeSectionBytes -= numSizeBytes + numBodyBytes;
+
+	if(onFunctionDefLoaded) { onFunctionDefLoaded(functionDefIndex); }
+	return true;
+}
+
+WASM::StreamingLoader* WASM::createStreamingLoader(IR::Module& outModule,
+											 FunctionDefLoadedCallback&& onFunctionDefLoaded)
+{
+	return new StreamingLoader(outModule, std::move(onFunctionDefLoaded));
+}
+
+void WASM::destroyStreamingLoader(StreamingLoader* loader) { delete loader; }
+
+bool WASM::feedStreamingLoader(StreamingLoader* loader,
+							   const U8* bytes,
+							   Uptr numBytes,
+							   LoadError* outError)
+{
+	if(loader->state == StreamingLoader::State::failed)
+	{
+		if(outError) { *outError = loader->error; }
+		return false;
+	}
+
+	// Discard the bytes that have already been loaded, and append the new bytes.
+	loader->bytes.erase(loader->bytes.begin(), loader->bytes.begin() + loader->numBytesLoaded);
+	loader->numBytesLoaded = 0;
+	loader->bytes.insert(loader->bytes.end(), bytes, bytes + numBytes);
+	loader->numBytesFed += numBytes;
+
+	if(!catchLoadErrors(&loader->error, [loader]() { loader->load(); }))
+	{
+		loader->state = StreamingLoader::State::failed;
+		if(outError) { *outError = loader->error; }
+		return false;
+	}
+	return true;
+}
+
+bool WASM::finishStreamingLoader(StreamingLoader* loader, LoadError* outError)
+{
+	if(loader->state == StreamingLoader::State::failed)
+	{
+		if(outError) { *outError = loader->error; }
+		return false;
+	}
+
+	return catchLoadErrors(outError, [loader]() {
+		// If the module ended in the middle of the header or a section, report the same error as
+		// loadBinaryModule. A partial header may have a mismatched magic number or version, so load
+		// as much of it as was fed.
+		if(loader->state == StreamingLoader::State::header)
+		{
+			MemoryInputStream headerStream(loader->getUnloadedBytes(),
+										   loader->getNumUnloadedBytes());
+			serializeModuleHeader(headerStream);
+		}
+		if(loader->state != StreamingLoader::State::sectionStart || loader->getNumUnloadedBytes())
+		{ throw FatalSerializationException("expected data but found end of stream"); }
+
+		checkRequiredSections(loader->module, loader->loadState);
+
+		Timing::logRatePerSecond("Loaded streamed WASM",
+								 loader->loadTimer,
+								 loader->numBytesFed / 1024.0 / 1024.0,
+								 "MiB");
+	});
+}
@@ -0,0 +1,135 @@
+// A build tool that converts the lexer's NFA to a DFA, and writes the resulting tables to a C++
+// source file that is compiled into WASTParse. This lets the lexer skip building the DFA every time
+// a process parses WAST text.
+//
+// This is built before libWAVM, so it compiles the NFA and RegExp sources directly, and defines the
+// few Platform and Log functions they use below.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "Lexer.h"
+#include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Inline/Time.h"
+#include "WAVM/Logging/Logging.h"
+#include "WAVM/NFA/NFA.h"
+#include "WAVM/Platform/Clock.h"
+#include "WAVM/Platform/Error.h"
+
+using namespace WAVM;
+
+void Platform::handleAssertionFailure(const AssertMetadata& metadata)
+{
+	fprintf(stderr,
+			"%s(%u): assertion failed: %s\n",
+			metadata.file,
+			metadata.line,
+			metadata.condition);
+	abort();
+}
+
+void Platform::handleFatalError(const char* messageFormat, bool printCallStack, va_list varArgs)
+{
+	vfprintf(stderr, messageFormat, varArgs);
+	fprintf(stderr, "\n");
+	abort();
+}
+
+// The NFA->DFA conversion times itself, but the timing isn't logged, so just return a constant.
+Time Platform::getClockTime(Clock clock) { return Time{0}; }
+
+void Log::vprintf(Category category, const char* format, va_list argList)
+{
+	if(category == Log::error) { vfprintf(stderr, format, argList); }
+}
+
+void Log::printf(Category category, const char* format, ...)
+{
+	va_list argList;
+	va_start(argList, format);
+	Log::vprintf(category, format, argList);
+	va_end(argList);
+}
+
+static void appendTablesToCPP(std::string& outString,
+							  const char* name,
+							  bool allowLegacyInstructionNames)
+{
+	NFA::Machine machine(WAST::createLexerNFA(allowLegacyInstructionNames));
+	NFA::MachineTables tables = machine.getTables();
+
+	const std::string charToOffsetMapName = std::string(name) + "CharToOffsetMap";
+	const std::string stateAndOffsetToNextStateMapName
+		= std::string(name) + "StateAndOffsetToNextStateMap";
+
+	char buffer[64];
+	outString += "static constexpr U32 " + charToOffsetMapName + "[256] = {";
+	for(Uptr charIndex = 0; charIndex < 256; ++charIndex)
+	{
+		if(charIndex % 16 == 0) { outString += "\n\t"; }
+		snprintf(buffer, sizeof(buffer), "%u,", tables.charToOffsetMap[charIndex]);
+		outString += buffer;
+	}
+	outString += "\n};\n\n";
+
+	const Uptr numTransitions = tables.numClasses * tables.numStates;
+	snprintf(buffer, sizeof(buffer), "[%" WAVM_PRIuPTR "] = {", numTransitions);
+	outString += "static constexpr I16 " + stateAndOffsetToNextStateMapName + buffer;
+	for(Uptr transitionIndex = 0; transitionIndex < numTransitions; ++transitionIndex)
+	{
+		if(transitionIndex % 16 == 0) { outString += "\n\t"; }
+		snprintf(buffer,
+				 sizeof(buffer),
+				 "%d,",
+				 I32(tables.stateAndOffsetToNextStateMap[transitionIndex]));
+		outString += buffer;
+	}
+	outString += "\n};\n\n";
+
+	outString += "const NFA::MachineTables WAST::" + std::string(name) + " = {\n\t"
+				 + charToOffsetMapName + ",\n\t" + stateAndOffsetToNextStateMapName + ",\n\t";
+	snprintf(buffer,
+			 sizeof(buffer),
+			 "%" WAVM_PRIuPTR ",\n\t%" WAVM_PRIuPTR ",\n};\n\n",
+			 tables.numClasses,
+			 tables.numStates);
+	outString += buffer;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc != 2)
+	{
+		fprintf(stderr, "Usage: GenerateLexerTables <output .cpp file>\n");
+		return EXIT_FAILURE;
+	}
+
+	std::string outString
+		= "// Generated by GenerateLexerTables from the token definitions in LexerNFA.cpp.\n"
+		  "// Do not edit.\n\n"
+		  "#include \"WAVM/Inline/BasicTypes.h\"\n"
+		  "#include \"WAVM/NFA/NFA.h\"\n\n"
+		  "using namespace WAVM;\n\n"
+		  "namespace WAVM { namespace WAST {\n"
+		  "\textern const NFA::MachineTables lexerTables;\n"
+		  "\textern const NFA::MachineTables legacyLexerTables;\n"
+		  "}}\n\n";
+	appendTablesToCPP(outString, "lexerTables", false);
+	appendTablesToCPP(outString, "legacyLexerTables", true);
+
+	FILE* file = fopen(argv[1], "wb");
+	if(!file)
+	{
+		fprintf(stderr, "Couldn't open %s for writing\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	const bool succeeded = fwrite(outString.data(), 1, outString.size(), file) == outString.size();
+	if(fclose(file) || !succeeded)
+	{
+		fprintf(stderr, "Couldn't write %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -2,6 +2,7 @@
 
 #include "WAVM/IR/Operators.h"
 #include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/NFA/NFA.h"
 #include "WAVM/Platform/Defines.h"
 #include "WAVM/WASTParse/WASTParse.h"
 
@@ -138,4 +139,13 @@ namespace WAVM { namespace WAST {
 	TextFileLocus calcLocusFromOffset(const char* string,
 									  const LineInfo* lineInfo,
 									  Uptr charOffset);
+
+	// Creates a NFA that recognizes the tokens, with the terminal state for each token given by
+	// NFA::maximumTerminalStateIndex - tokenType.
+	NFA::Builder* createLexerNFA(bool allowLegacyInstructionNames);
+
+	// The DFA tables for createLexerNFA(false) and createLexerNFA(true). These are generated by
+	// GenerateLexerTables at build time if WAVM_ENABLE_PRECOMPUTED_LEXER_TABLES is enabled.
+	extern const NFA::MachineTables lexerTables;
+	extern const NFA::MachineTables legacyLexerTables;
 }}
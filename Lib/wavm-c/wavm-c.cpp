@@ -640,7 +640,8 @@ wasm_trap_t* wasm_trap_new(wasm_compartment_t* compartment,
 						   const char* message,
 						   size_t num_message_bytes)
 {
-	return createException(ExceptionTypes::calledAbort, nullptr, 0, Platform::captureCallStack(1));
+	return createException(
+		ExceptionTypes::calledAbort, nullptr, 0, Platform::captureCallStackWithPolicy(1));
 }
 bool wasm_trap_message(const wasm_trap_t* trap, char* out_message, size_t* inout_num_message_bytes)
 {
@@ -849,29 +850,74 @@ void wasm_module_export(const wasm_module_t* module, size_t index, wasm_export_t
 
 IMPLEMENT_SHAREABLE_REF(func, Function)
 
+// Host functions are created with Intrinsics::createHostFunction, which calls a native function
+// with a pointer bound to the host function as the first argument. These native functions use
+// that pointer to call the embedder's callback, and throw any trap it returns.
+static wasm_trap_t* callHostFunction(const wasm_val_t args[], wasm_val_t results[])
+{
+	auto callback = reinterpret_cast<wasm_func_callback_t>(Uptr(args[0].i64));
+	wasm_trap_t* trap = (*callback)(args + 1, results);
+	if(trap) { throwException(trap); }
+	return nullptr;
+}
+
+struct HostFunctionEnv
+{
+	wasm_func_callback_with_env_t callback;
+	void* env;
+	void (*finalizer)(void*);
+};
+
+static wasm_trap_t* callHostFunctionWithEnv(const wasm_val_t args[], wasm_val_t results[])
+{
+	auto hostFunctionEnv = reinterpret_cast<HostFunctionEnv*>(Uptr(args[0].i64));
+	wasm_trap_t* trap = (*hostFunctionEnv->callback)(hostFunctionEnv->env, args + 1, results);
+	if(trap) { throwException(trap); }
+	return nullptr;
+}
+
+static void finalizeHostFunctionEnv(void* userData)
+{
+	auto hostFunctionEnv = (HostFunctionEnv*)userData;
+	if(hostFunctionEnv->finalizer) { (*hostFunctionEnv->finalizer)(hostFunctionEnv->env); }
+	delete hostFunctionEnv;
+}
+
 wasm_func_t* wasm_func_new(wasm_compartment_t* compartment,
 						   const wasm_functype_t* type,
 						   wasm_func_callback_t callback,
 						   const char* debug_name)
 {
-	FunctionType callbackType(
-		type->type.results(), type->type.params(), CallingConvention::cAPICallback);
-	Intrinsics::Module intrinsicModule;
-	Intrinsics::Function intrinsicFunction(
-		&intrinsicModule, debug_name, (void*)callback, callbackType);
-	Instance* instance = Intrinsics::instantiateModule(compartment, {&intrinsicModule}, debug_name);
-	Function* function = getTypedInstanceExport(instance, debug_name, type->type);
-	addGCRoot(function);
+	Function* function = Intrinsics::createHostFunction(compartment,
+														type->type,
+														(void*)&callHostFunction,
+														(void*)callback,
+														nullptr,
+														debug_name);
+	if(function) { addGCRoot(function); }
 	return function;
 }
-wasm_func_t* wasm_func_new_with_env(wasm_compartment_t*,
+wasm_func_t* wasm_func_new_with_env(wasm_compartment_t* compartment,
 									const wasm_functype_t* type,
-									wasm_func_callback_with_env_t,
+									wasm_func_callback_with_env_t callback,
 									void* env,
 									void (*finalizer)(void*),
 									const char* debug_name)
 {
-	Errors::fatal("wasm_func_new_with_env is not yet supported");
+	HostFunctionEnv* hostFunctionEnv = new HostFunctionEnv{callback, env, finalizer};
+	Function* function = Intrinsics::createHostFunction(compartment,
+														type->type,
+														(void*)&callHostFunctionWithEnv,
+														hostFunctionEnv,
+														&finalizeHostFunctionEnv,
+														debug_name);
+	if(!function)
+	{
+		finalizeHostFunctionEnv(hostFunctionEnv);
+		return nullptr;
+	}
+	addGCRoot(function);
+	return function;
 }
 wasm_functype_t* wasm_func_type(const wasm_func_t* function)
 {
@@ -1,6 +1,7 @@
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -15,6 +16,8 @@
 #include "WAVM/Inline/Timing.h"
 #include "WAVM/LLVMJIT/LLVMJIT.h"
 #include "WAVM/Logging/Logging.h"
+#include "WAVM/Platform/Diagnostics.h"
+#include "WAVM/Platform/Memory.h"
 #include "WAVM/Platform/Thread.h"
 #include "WAVM/Runtime/Intrinsics.h"
 #include "WAVM/Runtime/Runtime.h"
@@ -169,6 +172,51 @@ void runInvokeBench()
 			return 0;
 		});
 
+	// Benchmark invokePrepared, with a single unwindSignalsAsExceptions around all the calls.
+	runBenchmarkSingleAndMultiThreaded(
+		compartment, function, "invokePrepared", [](void* argument) -> I64 {
+			ThreadArgs* threadArgs = (ThreadArgs*)argument;
+			ContextRuntimeData* contextRuntimeData = getContextRuntimeData(threadArgs->context);
+
+			const PreparedInvoke prepared = prepareInvoke(
+				threadArgs->function, FunctionType({ValueType::i32}, {ValueType::i32}));
+
+			Timing::Timer timer;
+			unwindSignalsAsExceptions([contextRuntimeData, &prepared] {
+				for(Uptr repeatIndex = 0; repeatIndex < numInvokesPerThread; ++repeatIndex)
+				{
+					UntaggedValue args[1]{I32(0)};
+					UntaggedValue results[1];
+					invokePrepared(contextRuntimeData, prepared, args, results);
+				}
+			});
+			timer.stop();
+
+			threadArgs->elapsedNanoseconds = timer.getNanoseconds() / F64(numInvokesPerThread);
+
+			return 0;
+		});
+
+	// Benchmark TypedPreparedInvoke.
+	runBenchmarkSingleAndMultiThreaded(
+		compartment, function, "TypedPreparedInvoke", [](void* argument) -> I64 {
+			ThreadArgs* threadArgs = (ThreadArgs*)argument;
+			ContextRuntimeData* contextRuntimeData = getContextRuntimeData(threadArgs->context);
+
+			const TypedPreparedInvoke<I32(I32)> nopFunction(threadArgs->function);
+
+			Timing::Timer timer;
+			unwindSignalsAsExceptions([contextRuntimeData, &nopFunction] {
+				for(Uptr repeatIndex = 0; repeatIndex < numInvokesPerThread; ++repeatIndex)
+				{ nopFunction(contextRuntimeData, I32(0)); }
+			});
+			timer.stop();
+
+			threadArgs->elapsedNanoseconds = timer.getNanoseconds() / F64(numInvokesPerThread);
+
+			return 0;
+		});
+
 	// Free the compartment.
 	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
 }
@@ -258,6 +306,552 @@ void runIntrinsicBench()
 	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
 }
 
+static constexpr Uptr numCloneBenchMemoryPages = 3200;
+
+static void runCloneModeBench(const char* description, MemoryCloneMode cloneMode)
+{
+	// Create a compartment with a memory whose pages have all been written.
+	GCPointer<Compartment> compartment = Runtime::createCompartment();
+	Memory* memory = createMemory(
+		compartment, MemoryType(false, SizeConstraints{numCloneBenchMemoryPages, UINT64_MAX}), "");
+	WAVM_ERROR_UNLESS(memory);
+	memset(getMemoryBaseAddress(memory), 0xcc, numCloneBenchMemoryPages * IR::numBytesPerPage);
+
+	// Clone the compartment twice, and write a single byte to each cloned memory. A copy-on-write
+	// clone takes a snapshot of the memory the first time, and the second clone reuses it.
+	const Uptr peakBytesBeforeClone = Platform::getPeakMemoryUsageBytes();
+	GCPointer<Compartment> clonedCompartments[2];
+	F64 cloneMilliseconds[2];
+	for(Uptr cloneIndex = 0; cloneIndex < 2; ++cloneIndex)
+	{
+		Timing::Timer timer;
+		clonedCompartments[cloneIndex] = cloneCompartment(compartment, "", cloneMode);
+		Memory* clonedMemory = remapToClonedCompartment(memory, clonedCompartments[cloneIndex]);
+		getMemoryBaseAddress(clonedMemory)[0] = 0;
+		timer.stop();
+		cloneMilliseconds[cloneIndex] = timer.getMilliseconds();
+	}
+	const Uptr peakBytesAfterClone = Platform::getPeakMemoryUsageBytes();
+
+	Log::printf(Log::output,
+				"%s of %" WAVM_PRIuPTR "MB memory: %.2fms, then %.2fms, +%" WAVM_PRIuPTR
+				"MB peak RSS\n",
+				description,
+				numCloneBenchMemoryPages * IR::numBytesPerPage / (1024 * 1024),
+				cloneMilliseconds[0],
+				cloneMilliseconds[1],
+				(peakBytesAfterClone - peakBytesBeforeClone) / (1024 * 1024));
+
+	for(GCPointer<Compartment>& clonedCompartment : clonedCompartments)
+	{ WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(clonedCompartment))); }
+	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
+}
+
+void runCloneBench()
+{
+	// The peak RSS only increases, so run the copy-on-write benchmark before the copy benchmark.
+	runCloneModeBench("copy-on-write clone", MemoryCloneMode::copyOnWrite);
+	runCloneModeBench("copying clone", MemoryCloneMode::copy);
+}
+
+static constexpr Uptr numTrapsPerBench = 10000;
+
+static constexpr const char* trapBenchModuleWAST
+	= "(module\n"
+	  "  (memory 1)\n"
+	  "  (func (export \"outOfBoundsLoad\") (result i32) (i32.load (i32.const 65536)))\n"
+	  "  (func (export \"unreachable\") (result i32) (unreachable))\n"
+	  ")";
+
+static const char* getCallStackCapturePolicyName(Platform::CallStackCapturePolicy policy)
+{
+	switch(policy)
+	{
+	case Platform::CallStackCapturePolicy::none: return "none";
+	case Platform::CallStackCapturePolicy::innermostFrame: return "innermost";
+	case Platform::CallStackCapturePolicy::framePointers: return "frame-pointers";
+	case Platform::CallStackCapturePolicy::unwind: return "unwind";
+	default: WAVM_UNREACHABLE();
+	};
+}
+
+static void runTrapBenchWithMemories(const ModuleRef& module,
+									 const char* exportName,
+									 const char* description,
+									 Uptr numExtraMemories,
+									 Platform::CallStackCapturePolicy callStackCapturePolicy)
+{
+	GCPointer<Compartment> compartment = Runtime::createCompartment();
+	auto instance = instantiateModule(compartment, module, {}, "trapBenchModule");
+	auto function = asFunction(getInstanceExport(instance, exportName));
+	GCPointer<Context> context = createContext(compartment);
+
+	// Create memories that aren't used by the module, but that the trap handler must search
+	// through to find the memory that owns the faulting address.
+	std::vector<GCPointer<Memory>> extraMemories;
+	for(Uptr memoryIndex = 0; memoryIndex < numExtraMemories; ++memoryIndex)
+	{
+		extraMemories.push_back(createMemory(compartment, MemoryType(false, {0, 1}), ""));
+		WAVM_ERROR_UNLESS(extraMemories.back());
+	}
+
+	Platform::setCallStackCapturePolicy(callStackCapturePolicy);
+
+	Timing::Timer timer;
+	for(Uptr trapIndex = 0; trapIndex < numTrapsPerBench; ++trapIndex)
+	{
+		catchRuntimeExceptions(
+			[&] {
+				UntaggedValue results[1];
+				invokeFunction(context, function, FunctionType({ValueType::i32}, {}), {}, results);
+			},
+			[](Exception* exception) { destroyException(exception); });
+	}
+	timer.stop();
+
+	Platform::setCallStackCapturePolicy(Platform::CallStackCapturePolicy::unwind);
+
+	Log::printf(Log::output,
+				"ns/%s with %" WAVM_PRIuPTR " memories and %s call stacks: %.2f\n",
+				description,
+				numExtraMemories + 1,
+				getCallStackCapturePolicyName(callStackCapturePolicy),
+				timer.getNanoseconds() / F64(numTrapsPerBench));
+
+	extraMemories.clear();
+	context = nullptr;
+	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
+}
+
+void runTrapBench()
+{
+	std::vector<WAST::Error> parseErrors;
+	IR::Module irModule;
+	if(!WAST::parseModule(
+		   trapBenchModuleWAST, strlen(trapBenchModuleWAST) + 1, irModule, parseErrors))
+	{
+		WAST::reportParseErrors("trap benchmark module", trapBenchModuleWAST, parseErrors);
+		Errors::fatal("Failed to parse trap benchmark module WAST");
+	}
+	ModuleRef module = compileModule(irModule);
+
+	// Compare the cost of each call stack capture policy for a trap raised by a signal, and for a
+	// trap raised by an intrinsic.
+	const Platform::CallStackCapturePolicy policies[] = {
+		Platform::CallStackCapturePolicy::none,
+		Platform::CallStackCapturePolicy::innermostFrame,
+		Platform::CallStackCapturePolicy::framePointers,
+		Platform::CallStackCapturePolicy::unwind,
+	};
+	for(Platform::CallStackCapturePolicy policy : policies)
+	{
+		runTrapBenchWithMemories(module, "outOfBoundsLoad", "out-of-bounds memory trap", 0, policy);
+		runTrapBenchWithMemories(module, "unreachable", "unreachable trap", 0, policy);
+	}
+
+	runTrapBenchWithMemories(module,
+							 "outOfBoundsLoad",
+							 "out-of-bounds memory trap",
+							 10000,
+							 Platform::CallStackCapturePolicy::unwind);
+}
+
+static constexpr Uptr numInstantiationsPerBench = 1000;
+
+static constexpr const char* instantiateBenchModuleWAST
+	= "(module\n"
+	  "  (memory 1)\n"
+	  "  (global $base i32 (i32.const 1024))\n"
+	  "  (func $load (param i32) (result i32)\n"
+	  "    (i32.load (i32.add (global.get $base) (local.get 0))))\n"
+	  "  (func (export \"sum\") (param i32) (result i32)\n"
+	  "    (i32.add (call $load (local.get 0)) (call $load (i32.const 4))))\n"
+	  ")";
+
+void runInstantiateBench()
+{
+	std::vector<WAST::Error> parseErrors;
+	IR::Module irModule;
+	if(!WAST::parseModule(instantiateBenchModuleWAST,
+						  strlen(instantiateBenchModuleWAST) + 1,
+						  irModule,
+						  parseErrors))
+	{
+		WAST::reportParseErrors(
+			"instantiate benchmark module", instantiateBenchModuleWAST, parseErrors);
+		Errors::fatal("Failed to parse instantiate benchmark module WAST");
+	}
+	ModuleRef module = compileModule(irModule);
+
+	// Instantiate the module in many compartments that are all alive at the same time. Only the
+	// first instantiation needs to load the module's object code.
+	std::vector<GCPointer<Compartment>> compartments;
+	Timing::Timer timer;
+	for(Uptr instantiationIndex = 0; instantiationIndex < numInstantiationsPerBench;
+		++instantiationIndex)
+	{
+		compartments.push_back(Runtime::createCompartment());
+		WAVM_ERROR_UNLESS(instantiateModule(compartments.back(), module, {}, "instantiateBench"));
+	}
+	timer.stop();
+
+	Log::printf(Log::output,
+				"us/compartment+instantiation: %.2f\n",
+				timer.getMicroseconds() / F64(numInstantiationsPerBench));
+
+	for(GCPointer<Compartment>& compartment : compartments)
+	{ WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment))); }
+
+	// Load the module's object code many times with each debug info policy, instantiating each
+	// loaded module once to make it load its object code.
+	const std::vector<U8> objectCode = getObjectCode(module);
+	const std::pair<const char*, LLVMJIT::DebugInfoPolicy> debugInfoPolicies[] = {
+		{"off", LLVMJIT::DebugInfoPolicy::off},
+		{"lazy", LLVMJIT::DebugInfoPolicy::lazy},
+		{"eager", LLVMJIT::DebugInfoPolicy::eager},
+	};
+	for(const auto& debugInfoPolicy : debugInfoPolicies)
+	{
+		LLVMJIT::setDebugInfoPolicy(debugInfoPolicy.second);
+
+		GCPointer<Compartment> compartment = Runtime::createCompartment();
+		Timing::Timer loadTimer;
+		for(Uptr loadIndex = 0; loadIndex < numInstantiationsPerBench; ++loadIndex)
+		{
+			ModuleRef loadedModule = loadPrecompiledModule(irModule, objectCode);
+			WAVM_ERROR_UNLESS(
+				instantiateModule(compartment, loadedModule, {}, "instantiateBench"));
+		}
+		loadTimer.stop();
+
+		Log::printf(Log::output,
+					"us/object code load+instantiation with %s debug info: %.2f\n",
+					debugInfoPolicy.first,
+					loadTimer.getMicroseconds() / F64(numInstantiationsPerBench));
+
+		WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
+	}
+	LLVMJIT::setDebugInfoPolicy(LLVMJIT::DebugInfoPolicy::lazy);
+}
+
+static constexpr Uptr numHostFunctionsPerBench = 500;
+
+// Adds the data bound to the host function to its argument.
+static void* hostFunctionBenchCallback(const UntaggedValue* args, UntaggedValue* results)
+{
+	results[0].i32 = args[1].i32 + I32(args[0].i64);
+	return nullptr;
+}
+
+void runHostFunctionBench()
+{
+	GCPointer<Compartment> compartment = Runtime::createCompartment();
+	const FunctionType type({ValueType::i32}, {ValueType::i32});
+
+	// The first host function with a type compiles the thunk for the type, so time it separately
+	// from the rest.
+	std::vector<Function*> functions;
+	Timing::Timer firstTimer;
+	functions.push_back(Intrinsics::createHostFunction(compartment,
+													   type,
+													   (void*)&hostFunctionBenchCallback,
+													   nullptr,
+													   nullptr,
+													   "hostFunctionBench"));
+	firstTimer.stop();
+
+	Timing::Timer timer;
+	for(Uptr functionIndex = 1; functionIndex < numHostFunctionsPerBench; ++functionIndex)
+	{
+		functions.push_back(Intrinsics::createHostFunction(compartment,
+														   type,
+														   (void*)&hostFunctionBenchCallback,
+														   reinterpret_cast<void*>(functionIndex),
+														   nullptr,
+														   "hostFunctionBench"));
+	}
+	timer.stop();
+
+	Log::printf(Log::output,
+				"us/host function creation: %.2f (%.2fus for the first)\n",
+				timer.getMicroseconds() / F64(numHostFunctionsPerBench - 1),
+				firstTimer.getMicroseconds());
+
+	// Check that each function calls the native function with its own bound data.
+	GCPointer<Context> context = createContext(compartment);
+	for(Uptr functionIndex = 0; functionIndex < numHostFunctionsPerBench; ++functionIndex)
+	{
+		WAVM_ERROR_UNLESS(functions[functionIndex]);
+		UntaggedValue args[1]{I32(1)};
+		UntaggedValue results[1];
+		invokeFunction(context, functions[functionIndex], type, args, results);
+		WAVM_ERROR_UNLESS(results[0].i32 == I32(functionIndex + 1));
+	}
+
+	functions.clear();
+	context = nullptr;
+	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
+}
+
+static constexpr Uptr numDataSegmentBenchMemoryPages = 64;
+static constexpr Uptr numDataSegmentBenchInstances = 50;
+
+static void runDataSegmentModeBench(const char* description,
+									const ModuleRef& module,
+									bool enableDataSegmentImages)
+{
+	setDataSegmentImages(enableDataSegmentImages);
+
+	// Instantiate the module in many compartments that are all alive at the same time, and write a
+	// single byte to each instance's memory.
+	std::vector<GCPointer<Compartment>> compartments;
+	const Uptr peakBytesBeforeInstantiation = Platform::getPeakMemoryUsageBytes();
+	Timing::Timer timer;
+	for(Uptr instantiationIndex = 0; instantiationIndex < numDataSegmentBenchInstances;
+		++instantiationIndex)
+	{
+		compartments.push_back(Runtime::createCompartment());
+		Instance* instance = instantiateModule(compartments.back(), module, {}, "dataSegmentBench");
+		WAVM_ERROR_UNLESS(instance);
+		getMemoryBaseAddress(getDefaultMemory(instance))[0] = 0;
+	}
+	timer.stop();
+	const Uptr peakBytesAfterInstantiation = Platform::getPeakMemoryUsageBytes();
+
+	Log::printf(Log::output,
+				"%s of %" WAVM_PRIuPTR "MB data segment: %.2fus/instantiation, +%" WAVM_PRIuPTR
+				"MB peak RSS for %" WAVM_PRIuPTR " instances\n",
+				description,
+				numDataSegmentBenchMemoryPages * IR::numBytesPerPage / (1024 * 1024),
+				timer.getMicroseconds() / F64(numDataSegmentBenchInstances),
+				(peakBytesAfterInstantiation - peakBytesBeforeInstantiation) / (1024 * 1024),
+				numDataSegmentBenchInstances);
+
+	for(GCPointer<Compartment>& compartment : compartments)
+	{ WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment))); }
+	setDataSegmentImages(false);
+}
+
+void runDataSegmentBench()
+{
+	// Generate a module with a data segment that fills its memory, except for half of the last
+	// page, which must be copied even if the whole pages are mapped from the data segment image.
+	IR::Module irModule;
+	irModule.memories.defs.push_back(
+		{MemoryType(false, {numDataSegmentBenchMemoryPages, numDataSegmentBenchMemoryPages})});
+	std::shared_ptr<std::vector<U8>> data = std::make_shared<std::vector<U8>>(
+		numDataSegmentBenchMemoryPages * IR::numBytesPerPage - IR::numBytesPerPage / 2);
+	for(Uptr byteIndex = 0; byteIndex < data->size(); ++byteIndex)
+	{ (*data)[byteIndex] = U8(byteIndex * 7 + 1); }
+	irModule.dataSegments.push_back({true, 0, InitializerExpression(I32(0)), data});
+	std::shared_ptr<IR::ModuleValidationState> moduleValidationState
+		= IR::createModuleValidationState(irModule);
+	IR::validatePreCodeSections(*moduleValidationState);
+	IR::validatePostCodeSections(*moduleValidationState);
+	ModuleRef module = compileModule(irModule);
+
+	// The peak RSS only increases, so run the data segment image benchmark before the copying
+	// benchmark.
+	runDataSegmentModeBench("mapped data segment image", module, true);
+	runDataSegmentModeBench("copied data segment", module, false);
+}
+
+static constexpr U32 numBoundsCheckBenchIterations = 10000000;
+
+// Each iteration loads 4 values at consecutive offsets from an address. The load with the highest
+// offset is first, so with memory bounds checks, only it needs to be checked.
+static constexpr const char* boundsCheckBenchModuleWAST
+	= "(module\n"
+	  "  (memory 1 1)\n"
+	  "  (func (export \"sum\") (param $numIterations i32) (result i32)\n"
+	  "    (local $i i32) (local $address i32) (local $sum i32)\n"
+	  "    (loop $loop\n"
+	  "      (local.set $address (i32.and (i32.mul (local.get $i) (i32.const 16))\n"
+	  "                                   (i32.const 0xfff0)))\n"
+	  "      (local.set $sum (i32.add (local.get $sum)\n"
+	  "        (i32.add (i32.add (i32.load offset=12 (local.get $address))\n"
+	  "                          (i32.load offset=0 (local.get $address)))\n"
+	  "                 (i32.add (i32.load offset=4 (local.get $address))\n"
+	  "                          (i32.load offset=8 (local.get $address))))))\n"
+	  "      (local.set $i (i32.add (local.get $i) (i32.const 1)))\n"
+	  "      (br_if $loop (i32.lt_u (local.get $i) (local.get $numIterations))))\n"
+	  "    (local.get $sum))\n"
+	  ")";
+
+static void runBoundsCheckModeBench(const char* description,
+									const IR::Module& irModule,
+									bool enableBoundsChecks)
+{
+	setMemoryBoundsChecks(enableBoundsChecks);
+	ModuleRef module = compileModule(irModule);
+
+	GCPointer<Compartment> compartment = Runtime::createCompartment();
+	Instance* instance = instantiateModule(compartment, module, {}, "boundsCheckBench");
+	WAVM_ERROR_UNLESS(instance);
+	Function* function = asFunction(getInstanceExport(instance, "sum"));
+	GCPointer<Context> context = createContext(compartment);
+
+	UntaggedValue args[1]{numBoundsCheckBenchIterations};
+	UntaggedValue results[1];
+	Timing::Timer timer;
+	invokeFunction(context,
+				   function,
+				   FunctionType({ValueType::i32}, {ValueType::i32}),
+				   args,
+				   results);
+	timer.stop();
+
+	Log::printf(Log::output,
+				"ns/memory access %s: %.3f\n",
+				description,
+				timer.getNanoseconds() / F64(U64(numBoundsCheckBenchIterations) * 4));
+
+	context = nullptr;
+	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
+	setMemoryBoundsChecks(false);
+}
+
+void runBoundsCheckBench()
+{
+	std::vector<WAST::Error> parseErrors;
+	IR::Module irModule;
+	if(!WAST::parseModule(boundsCheckBenchModuleWAST,
+						  strlen(boundsCheckBenchModuleWAST) + 1,
+						  irModule,
+						  parseErrors))
+	{
+		WAST::reportParseErrors(
+			"bounds check benchmark module", boundsCheckBenchModuleWAST, parseErrors);
+		Errors::fatal("Failed to parse bounds check benchmark module WAST");
+	}
+
+	runBoundsCheckModeBench("with guard pages", irModule, false);
+	runBoundsCheckModeBench("with bounds checks", irModule, true);
+}
+
+static constexpr Uptr numTierUpBenchFunctions = 500;
+static constexpr U32 numTierUpBenchCallsToTierUp = 1000;
+static constexpr Uptr numTierUpBenchCalls = 20000;
+static constexpr Uptr numTierUpBenchCallsPerSample = 1000;
+static constexpr U32 numTierUpBenchIterationsPerCall = 1000;
+
+// Creates a module with many functions that each run a loop, so compiling it takes long enough to
+// compare the baseline and optimized tiers, and the first function can be called repeatedly to
+// measure the code before and after it is optimized.
+static std::string createTierUpBenchModuleWAST()
+{
+	std::string wast = "(module\n";
+	for(Uptr functionIndex = 0; functionIndex < numTierUpBenchFunctions; ++functionIndex)
+	{
+		wast += "  (func (export \"f" + std::to_string(functionIndex)
+				+ "\") (param $n i32) (result i32)\n"
+				  "    (local $i i32) (local $hash i32)\n"
+				  "    (loop $loop\n"
+				  "      (local.set $hash (i32.xor (i32.mul (local.get $hash) (i32.const 16777619))\n"
+				  "                                (i32.add (local.get $i) (i32.const "
+				+ std::to_string(functionIndex)
+				+ "))))\n"
+				  "      (local.set $i (i32.add (local.get $i) (i32.const 1)))\n"
+				  "      (br_if $loop (i32.lt_u (local.get $i) (local.get $n))))\n"
+				  "    (local.get $hash))\n";
+	}
+	wast += ")";
+	return wast;
+}
+
+static void runTierUpModeBench(const char* description,
+							   const IR::Module& irModule,
+							   bool enableTieredCompilation)
+{
+	setTieredCompilation(enableTieredCompilation, numTierUpBenchCallsToTierUp);
+
+	Timing::Timer compileTimer;
+	ModuleRef module = compileModule(irModule);
+	compileTimer.stop();
+
+	GCPointer<Compartment> compartment = Runtime::createCompartment();
+	Instance* instance = instantiateModule(compartment, module, {}, "tierUpBench");
+	WAVM_ERROR_UNLESS(instance);
+	Function* function = asFunction(getInstanceExport(instance, "f0"));
+	GCPointer<Context> context = createContext(compartment);
+
+	// Call the function once without running its loop to ensure the time to create the invoke thunk
+	// isn't benchmarked.
+	{
+		UntaggedValue args[1]{U32(0)};
+		UntaggedValue results[1];
+		invokeFunction(
+			context, function, FunctionType({ValueType::i32}, {ValueType::i32}), args, results);
+	}
+
+	// Call the function repeatedly, timing the first and last samples of calls: with tiered
+	// compilation, the first sample runs the baseline code, and the optimized code has been loaded
+	// in the background by the last sample.
+	F64 firstSampleNanoseconds = 0;
+	F64 lastSampleNanoseconds = 0;
+	Timing::Timer totalTimer;
+	for(Uptr sampleIndex = 0; sampleIndex < numTierUpBenchCalls / numTierUpBenchCallsPerSample;
+		++sampleIndex)
+	{
+		Timing::Timer sampleTimer;
+		for(Uptr callIndex = 0; callIndex < numTierUpBenchCallsPerSample; ++callIndex)
+		{
+			UntaggedValue args[1]{numTierUpBenchIterationsPerCall};
+			UntaggedValue results[1];
+			invokeFunction(context,
+						   function,
+						   FunctionType({ValueType::i32}, {ValueType::i32}),
+						   args,
+						   results);
+		}
+		sampleTimer.stop();
+
+		if(sampleIndex == 0) { firstSampleNanoseconds = sampleTimer.getNanoseconds(); }
+		lastSampleNanoseconds = sampleTimer.getNanoseconds();
+	}
+	totalTimer.stop();
+
+	Log::printf(Log::output,
+				"ms/compile %s: %.2f\n"
+				"us/call %s, first %" WAVM_PRIuPTR " calls: %.2f\n"
+				"us/call %s, last %" WAVM_PRIuPTR " calls: %.2f\n"
+				"ms/%" WAVM_PRIuPTR " calls %s: %.2f\n",
+				description,
+				compileTimer.getMilliseconds(),
+				description,
+				numTierUpBenchCallsPerSample,
+				firstSampleNanoseconds / 1000.0 / F64(numTierUpBenchCallsPerSample),
+				description,
+				numTierUpBenchCallsPerSample,
+				lastSampleNanoseconds / 1000.0 / F64(numTierUpBenchCallsPerSample),
+				numTierUpBenchCalls,
+				description,
+				totalTimer.getMilliseconds());
+
+	context = nullptr;
+	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
+	setTieredCompilation(false);
+}
+
+void runTierUpBench()
+{
+	const std::string tierUpBenchModuleWAST = createTierUpBenchModuleWAST();
+	std::vector<WAST::Error> parseErrors;
+	IR::Module irModule;
+	if(!WAST::parseModule(tierUpBenchModuleWAST.c_str(),
+						  tierUpBenchModuleWAST.size() + 1,
+						  irModule,
+						  parseErrors))
+	{
+		WAST::reportParseErrors(
+			"tier-up benchmark module", tierUpBenchModuleWAST.c_str(), parseErrors);
+		Errors::fatal("Failed to parse tier-up benchmark module WAST");
+	}
+
+	runTierUpModeBench("without tiered compilation", irModule, false);
+	runTierUpModeBench("with tiered compilation", irModule, true);
+}
+
 int execBenchmark(int argc, char** argv)
 {
 	if(argc != 0)
@@ -274,6 +868,13 @@ int execBenchmark(int argc, char** argv)
 
 	runInvokeBench();
 	runIntrinsicBench();
+	runCloneBench();
+	runTrapBench();
+	runInstantiateBench();
+	runHostFunctionBench();
+	runDataSegmentBench();
+	runBoundsCheckBench();
+	runTierUpBench();
 
 	return 0;
 }
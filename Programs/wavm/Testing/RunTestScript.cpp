@@ -1406,6 +1406,8 @@ static void showHelp()
 		"                             module was invalid\n"
 		"  --test-cloning             Run each test command in the original compartment\n"
 		"                             and a clone of it, and compare the resulting state\n"
+		"  --bounds-checks            Check the bounds of memory accesses, and only\n"
+		"                             reserve address space for memories' maximum size\n"
 		"  --trace                    Prints instructions to stdout as they are compiled.\n"
 		"  --trace-tests              Prints test commands to stdout as they are executed.\n"
 		"  --trace-llvmir             Prints the LLVM IR for modules as they are compiled.\n"
@@ -1454,6 +1456,10 @@ int execRunTestScript(int argc, char** argv)
 		{
 			config.testCloning = true;
 		}
+		else if(!strcmp(argv[argIndex], "--bounds-checks"))
+		{
+			Runtime::setMemoryBoundsChecks(true);
+		}
 		else if(!strcmp(argv[argIndex], "--trace"))
 		{
 			Log::setCategoryEnabled(Log::traceValidation, true);
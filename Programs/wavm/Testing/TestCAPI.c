@@ -6,6 +6,8 @@
 #define own
 
 static uintptr_t numCallbacks = 0;
+static uintptr_t numEnvCallbacks = 0;
+static uintptr_t numEnvFinalizers = 0;
 
 // A function to be called from Wasm code.
 own wasm_trap_t* hello_callback(const wasm_val_t args[], wasm_val_t results[])
@@ -14,6 +16,37 @@ own wasm_trap_t* hello_callback(const wasm_val_t args[], wasm_val_t results[])
 	return NULL;
 }
 
+// A function with an environment to be called from Wasm code.
+own wasm_trap_t* hello_env_callback(void* env, const wasm_val_t args[], wasm_val_t results[])
+{
+	++*(uintptr_t*)env;
+	return NULL;
+}
+
+static void finalize_hello_env(void* env)
+{
+	if(env == &numEnvCallbacks) { ++numEnvFinalizers; }
+}
+
+// Instantiates the module with the given import, and calls its run export.
+static int run_hello(wasm_store_t* store, wasm_module_t* module, wasm_func_t* hello_func)
+{
+	const wasm_extern_t* imports[1];
+	imports[0] = wasm_func_as_extern(hello_func);
+	own wasm_instance_t* instance = wasm_instance_new(store, module, imports, NULL, "instance");
+	if(!instance) { return 1; }
+
+	wasm_extern_t* run_extern = wasm_instance_export(instance, 0);
+	if(run_extern == NULL) { return 1; }
+	const wasm_func_t* run_func = wasm_extern_as_func(run_extern);
+	if(run_func == NULL) { return 1; }
+
+	wasm_instance_delete(instance);
+
+	if(wasm_func_call(store, run_func, NULL, NULL)) { return 1; }
+	return 0;
+}
+
 int execCAPITest(int argc, char** argv)
 {
 	// Initialize.
@@ -37,36 +70,32 @@ int execCAPITest(int argc, char** argv)
 	own wasm_functype_t* hello_type = wasm_functype_new_0_0();
 	own wasm_func_t* hello_func
 		= wasm_func_new(compartment, hello_type, hello_callback, "hello_callback");
+	own wasm_func_t* hello_env_func = wasm_func_new_with_env(compartment,
+															 hello_type,
+															 hello_env_callback,
+															 &numEnvCallbacks,
+															 finalize_hello_env,
+															 "hello_env_callback");
 
 	wasm_functype_delete(hello_type);
 
-	// Instantiate.
-	const wasm_extern_t* imports[1];
-	imports[0] = wasm_func_as_extern(hello_func);
-	own wasm_instance_t* instance = wasm_instance_new(store, module, imports, NULL, "instance");
-	if(!instance) { return 1; }
+	// Instantiate and call the module with each of the functions.
+	if(run_hello(store, module, hello_func)) { return 1; }
+	if(run_hello(store, module, hello_env_func)) { return 1; }
 
 	wasm_func_delete(hello_func);
-
-	// Extract export.
-	wasm_extern_t* run_extern = wasm_instance_export(instance, 0);
-	if(run_extern == NULL) { return 1; }
-	const wasm_func_t* run_func = wasm_extern_as_func(run_extern);
-	if(run_func == NULL) { return 1; }
-
+	wasm_func_delete(hello_env_func);
 	wasm_module_delete(module);
-	wasm_instance_delete(instance);
-
-	// Call.
-	if(wasm_func_call(store, run_func, NULL, NULL)) { return 1; }
 
 	// Shut down.
 	wasm_store_delete(store);
 	wasm_compartment_delete(compartment);
 	wasm_engine_delete(engine);
 
-	// Assert that the callback was called exactly once.
+	// Assert that each callback was called exactly once, and that the environment was finalized.
 	if(numCallbacks != 1) { return 1; }
+	if(numEnvCallbacks != 1) { return 1; }
+	if(numEnvFinalizers != 1) { return 1; }
 
 	return 0;
 }
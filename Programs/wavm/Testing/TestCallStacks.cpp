@@ -0,0 +1,225 @@
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "WAVM/IR/Module.h"
+#include "WAVM/IR/Types.h"
+#include "WAVM/IR/Value.h"
+#include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Inline/Errors.h"
+#include "WAVM/Logging/Logging.h"
+#include "WAVM/Platform/Defines.h"
+#include "WAVM/Platform/Diagnostics.h"
+#include "WAVM/Runtime/Runtime.h"
+#include "WAVM/WASTParse/WASTParse.h"
+#include "wavm-test.h"
+
+using namespace WAVM;
+using namespace WAVM::IR;
+using namespace WAVM::Runtime;
+
+// Each trap is raised two calls deep: one by a signal, and one by an intrinsic.
+static constexpr const char* callStackTestModuleWAST
+	= "(module\n"
+	  "  (memory 1)\n"
+	  "  (func $loadInner (result i32) (i32.load (i32.const 65536)))\n"
+	  "  (func $loadMiddle (result i32) (call $loadInner))\n"
+	  "  (func $loadOuter (export \"load\") (result i32) (call $loadMiddle))\n"
+	  "  (func $unreachableInner (result i32) (unreachable))\n"
+	  "  (func $unreachableMiddle (result i32) (call $unreachableInner))\n"
+	  "  (func $unreachableOuter (export \"unreachable\") (result i32)\n"
+	  "    (call $unreachableMiddle))\n"
+	  ")";
+
+static const char* getPolicyName(Platform::CallStackCapturePolicy policy)
+{
+	switch(policy)
+	{
+	case Platform::CallStackCapturePolicy::none: return "none";
+	case Platform::CallStackCapturePolicy::innermostFrame: return "innermost";
+	case Platform::CallStackCapturePolicy::framePointers: return "frame-pointers";
+	case Platform::CallStackCapturePolicy::unwind: return "unwind";
+	default: WAVM_UNREACHABLE();
+	};
+}
+
+// Invokes an export that traps, and returns the descriptions of the WebAssembly frames of the
+// trap's call stack, along with the total number of frames.
+static std::vector<std::string> captureTrapFrames(Context* context,
+												  Instance* instance,
+												  const char* exportName,
+												  Platform::CallStackCapturePolicy policy,
+												  Uptr& outNumFrames)
+{
+	Function* function = asFunction(getInstanceExport(instance, exportName));
+
+	std::vector<std::string> wasmFrames;
+	outNumFrames = 0;
+	bool trapped = false;
+
+	Platform::setCallStackCapturePolicy(policy);
+	catchRuntimeExceptions(
+		[&] {
+			UntaggedValue results[1];
+			invokeFunction(context, function, FunctionType({ValueType::i32}, {}), {}, results);
+		},
+		[&](Exception* exception) {
+			trapped = true;
+			const Platform::CallStack& callStack = getExceptionCallStack(exception);
+			outNumFrames = callStack.frames.size();
+			for(const std::string& frame : describeCallStack(callStack))
+			{
+				if(!strncmp(frame.c_str(), "wasm!", 5)) { wasmFrames.push_back(frame); }
+			}
+			destroyException(exception);
+		});
+	Platform::setCallStackCapturePolicy(Platform::CallStackCapturePolicy::unwind);
+
+	WAVM_ERROR_UNLESS(trapped);
+	return wasmFrames;
+}
+
+static bool frameIsInFunction(const std::string& frame, const char* functionName)
+{
+	const std::string prefix = std::string("wasm!callStackTestModule!") + functionName + '+';
+	return !strncmp(frame.c_str(), prefix.c_str(), prefix.size());
+}
+
+static bool testTrap(Context* context,
+					 Instance* instance,
+					 const char* exportName,
+					 const char* innerFunctionName,
+					 const char* middleFunctionName,
+					 const char* outerFunctionName,
+					 bool isSignalTrap)
+{
+	bool succeeded = true;
+	auto fail = [&](Platform::CallStackCapturePolicy policy,
+					const std::vector<std::string>& wasmFrames,
+					const char* message) {
+		std::string frames;
+		for(const std::string& frame : wasmFrames) { frames += "\n  " + frame; }
+		Log::printf(Log::error,
+					"%s trap with %s call stacks: %s. WebAssembly frames:%s\n",
+					exportName,
+					getPolicyName(policy),
+					message,
+					frames.c_str());
+		succeeded = false;
+	};
+
+	Uptr numFrames = 0;
+
+	// No frames are captured if the policy is none.
+	std::vector<std::string> wasmFrames = captureTrapFrames(
+		context, instance, exportName, Platform::CallStackCapturePolicy::none, numFrames);
+	if(numFrames) { fail(Platform::CallStackCapturePolicy::none, wasmFrames, "captured frames"); }
+
+	// Only the innermost frame is captured if the policy is innermostFrame. For a trap raised by a
+	// signal, that's the faulting WebAssembly instruction.
+	wasmFrames = captureTrapFrames(
+		context, instance, exportName, Platform::CallStackCapturePolicy::innermostFrame, numFrames);
+	if(numFrames != 1)
+	{
+		fail(Platform::CallStackCapturePolicy::innermostFrame,
+			 wasmFrames,
+			 "didn't capture exactly one frame");
+	}
+	else if(isSignalTrap
+			&& (wasmFrames.size() != 1 || !frameIsInFunction(wasmFrames[0], innerFunctionName)))
+	{
+		fail(Platform::CallStackCapturePolicy::innermostFrame,
+			 wasmFrames,
+			 "the innermost frame isn't the faulting function");
+	}
+
+	// Walking frame pointers and unwinding must both find the three nested WebAssembly frames, and
+	// must attribute each of them to the same instruction.
+	const std::vector<std::string> unwindFrames = captureTrapFrames(
+		context, instance, exportName, Platform::CallStackCapturePolicy::unwind, numFrames);
+	const std::vector<std::string> framePointerFrames = captureTrapFrames(
+		context, instance, exportName, Platform::CallStackCapturePolicy::framePointers, numFrames);
+	if(unwindFrames.size() != 3 || !frameIsInFunction(unwindFrames[0], innerFunctionName)
+	   || !frameIsInFunction(unwindFrames[1], middleFunctionName)
+	   || !frameIsInFunction(unwindFrames[2], outerFunctionName))
+	{
+		fail(Platform::CallStackCapturePolicy::unwind,
+			 unwindFrames,
+			 "didn't capture the nested WebAssembly frames");
+	}
+	if(framePointerFrames != unwindFrames)
+	{
+		fail(Platform::CallStackCapturePolicy::framePointers,
+			 framePointerFrames,
+			 "the WebAssembly frames don't match the unwound frames");
+	}
+
+	return succeeded;
+}
+
+// Captures the call stack from a single call site, so the call stacks captured by each policy
+// start with the same return address.
+static WAVM_FORCENOINLINE Platform::CallStack
+captureCallStackFromCallSite(Platform::CallStackCapturePolicy policy)
+{
+	Platform::setCallStackCapturePolicy(policy);
+	Platform::CallStack callStack = Platform::captureCallStackWithPolicy(0);
+	Platform::setCallStackCapturePolicy(Platform::CallStackCapturePolicy::unwind);
+	return callStack;
+}
+
+static bool testCaptureCallStackWithPolicy()
+{
+	const Platform::CallStack unwoundCallStack
+		= captureCallStackFromCallSite(Platform::CallStackCapturePolicy::unwind);
+	const Platform::CallStack framePointerCallStack
+		= captureCallStackFromCallSite(Platform::CallStackCapturePolicy::framePointers);
+
+	// The unwinder leaves the innermost frame's return address as it is, but every frame that is
+	// found by walking frame pointers is a return address, and so must be adjusted to point into
+	// the call instruction.
+	if(!unwoundCallStack.frames.size()) { return true; }
+	if(!framePointerCallStack.frames.size()
+	   || framePointerCallStack.frames[0].ip + 1 != unwoundCallStack.frames[0].ip)
+	{
+		Log::printf(Log::error,
+					"The innermost frame found by walking frame pointers doesn't point into the"
+					" call instruction.\n");
+		return false;
+	}
+	return true;
+}
+
+int execCallStackTest(int argc, char** argv)
+{
+	if(!testCaptureCallStackWithPolicy()) { return EXIT_FAILURE; }
+
+	std::vector<WAST::Error> parseErrors;
+	IR::Module irModule;
+	if(!WAST::parseModule(
+		   callStackTestModuleWAST, strlen(callStackTestModuleWAST) + 1, irModule, parseErrors))
+	{
+		WAST::reportParseErrors("call stack test module", callStackTestModuleWAST, parseErrors);
+		Errors::fatal("Failed to parse call stack test module WAST");
+	}
+	ModuleRef module = compileModule(irModule);
+
+	GCPointer<Compartment> compartment = createCompartment();
+	Instance* instance = instantiateModule(compartment, module, {}, "callStackTestModule");
+	GCPointer<Context> context = createContext(compartment);
+
+	bool succeeded = true;
+	succeeded &= testTrap(context, instance, "load", "loadInner", "loadMiddle", "loadOuter", true);
+	succeeded &= testTrap(context,
+						  instance,
+						  "unreachable",
+						  "unreachableInner",
+						  "unreachableMiddle",
+						  "unreachableOuter",
+						  false);
+
+	context = nullptr;
+	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
+
+	return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
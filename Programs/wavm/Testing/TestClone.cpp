@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "WAVM/IR/Types.h"
+#include "WAVM/Inline/Assert.h"
+#include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Runtime/Runtime.h"
+#include "wavm-test.h"
+
+using namespace WAVM;
+using namespace WAVM::IR;
+using namespace WAVM::Runtime;
+
+// More pages than are copied to a memory snapshot at a time.
+static constexpr Uptr numInitialPages = 40;
+
+struct CloneTestCompartment
+{
+	GCPointer<Compartment> compartment;
+	Memory* memory;
+};
+
+static U32 load(const CloneTestCompartment& clone, Uptr pageIndex)
+{
+	U32 value;
+	memcpy(&value, getMemoryBaseAddress(clone.memory) + pageIndex * numBytesPerPage, sizeof(U32));
+	return value;
+}
+
+static void store(const CloneTestCompartment& clone, Uptr pageIndex, U32 value)
+{
+	memcpy(getMemoryBaseAddress(clone.memory) + pageIndex * numBytesPerPage, &value, sizeof(U32));
+}
+
+static CloneTestCompartment cloneCopyOnWrite(const CloneTestCompartment& original)
+{
+	CloneTestCompartment clone;
+	clone.compartment
+		= cloneCompartment(original.compartment, "clone", MemoryCloneMode::copyOnWrite);
+	WAVM_ERROR_UNLESS(clone.compartment);
+	clone.memory = remapToClonedCompartment(original.memory, clone.compartment);
+	WAVM_ERROR_UNLESS(getMemoryNumPages(clone.memory) == getMemoryNumPages(original.memory));
+	return clone;
+}
+
+// Checks that each page of a memory starts with the expected value.
+static void checkPages(const CloneTestCompartment& clone, const std::vector<U32>& expectedValues)
+{
+	WAVM_ERROR_UNLESS(getMemoryNumPages(clone.memory) == expectedValues.size());
+	for(Uptr pageIndex = 0; pageIndex < expectedValues.size(); ++pageIndex)
+	{ WAVM_ERROR_UNLESS(load(clone, pageIndex) == expectedValues[pageIndex]); }
+}
+
+static void collect(CloneTestCompartment& clone)
+{
+	clone.memory = nullptr;
+	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(clone.compartment)));
+}
+
+// Checks that writes to a memory that was cloned copy-on-write aren't visible to its clones, and
+// that writes to the clones aren't visible to the memory or to each other.
+static void testCopyOnWriteClonesAreIsolated()
+{
+	CloneTestCompartment original;
+	original.compartment = createCompartment("original");
+	original.memory = createMemory(
+		original.compartment, MemoryType(false, {numInitialPages, 64}), "memory");
+	WAVM_ERROR_UNLESS(original.memory);
+
+	// Write every other page, so the snapshot has both written pages and zero pages.
+	std::vector<U32> originalValues(numInitialPages, 0);
+	for(Uptr pageIndex = 0; pageIndex < numInitialPages; pageIndex += 2)
+	{
+		originalValues[pageIndex] = U32(pageIndex + 1);
+		store(original, pageIndex, originalValues[pageIndex]);
+	}
+
+	CloneTestCompartment first = cloneCopyOnWrite(original);
+	checkPages(first, originalValues);
+
+	// Writes to the original aren't visible to the clone, and writes to the clone aren't visible
+	// to the original, whether the page was zero or not when the clone was created.
+	std::vector<U32> firstValues = originalValues;
+	store(original, 0, 100);
+	store(original, 1, 101);
+	originalValues[0] = 100;
+	originalValues[1] = 101;
+	store(first, 2, 200);
+	store(first, 3, 201);
+	firstValues[2] = 200;
+	firstValues[3] = 201;
+	checkPages(original, originalValues);
+	checkPages(first, firstValues);
+
+	// A clone created after the original was written has the original's current contents.
+	CloneTestCompartment second = cloneCopyOnWrite(original);
+	checkPages(second, originalValues);
+	checkPages(first, firstValues);
+
+	// A clone created without writing the original since the previous clone shares its snapshot,
+	// but writes to either of them still aren't visible to the other.
+	CloneTestCompartment third = cloneCopyOnWrite(original);
+	std::vector<U32> secondValues = originalValues;
+	std::vector<U32> thirdValues = originalValues;
+	store(second, 4, 300);
+	store(third, 5, 400);
+	secondValues[4] = 300;
+	thirdValues[5] = 400;
+	checkPages(original, originalValues);
+	checkPages(second, secondValues);
+	checkPages(third, thirdValues);
+
+	// Growing the original doesn't change the clones, and the grown pages are cloned.
+	WAVM_ERROR_UNLESS(growMemory(original.memory, 2) == GrowResult::success);
+	store(original, numInitialPages + 1, 500);
+	originalValues.push_back(0);
+	originalValues.push_back(500);
+	CloneTestCompartment fourth = cloneCopyOnWrite(original);
+	checkPages(fourth, originalValues);
+	checkPages(second, secondValues);
+	checkPages(third, thirdValues);
+
+	// Writing the original after growing it isn't visible to the clone of the grown memory.
+	std::vector<U32> fourthValues = originalValues;
+	store(original, numInitialPages + 1, 501);
+	originalValues[numInitialPages + 1] = 501;
+	checkPages(original, originalValues);
+	checkPages(fourth, fourthValues);
+
+	// The clones keep their contents when the original is collected.
+	collect(original);
+	checkPages(first, firstValues);
+	checkPages(second, secondValues);
+	checkPages(third, thirdValues);
+
+	// Clones of a clone are isolated from it in the same way.
+	CloneTestCompartment cloneOfClone = cloneCopyOnWrite(first);
+	checkPages(cloneOfClone, firstValues);
+	store(first, 8, 600);
+	store(cloneOfClone, 9, 700);
+	checkPages(second, secondValues);
+	WAVM_ERROR_UNLESS(load(first, 8) == 600 && load(first, 9) == 0);
+	WAVM_ERROR_UNLESS(load(cloneOfClone, 8) == firstValues[8] && load(cloneOfClone, 9) == 700);
+
+	collect(first);
+	collect(second);
+	collect(third);
+	collect(fourth);
+	collect(cloneOfClone);
+}
+
+int execCloneTest(int argc, char** argv)
+{
+	testCopyOnWriteClonesAreIsolated();
+	return EXIT_SUCCESS;
+}
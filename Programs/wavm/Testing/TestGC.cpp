@@ -0,0 +1,268 @@
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "WAVM/IR/Module.h"
+#include "WAVM/IR/Types.h"
+#include "WAVM/IR/Value.h"
+#include "WAVM/Inline/Assert.h"
+#include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Inline/Errors.h"
+#include "WAVM/Logging/Logging.h"
+#include "WAVM/Platform/Thread.h"
+#include "WAVM/Runtime/Runtime.h"
+#include "WAVM/WASTParse/WASTParse.h"
+#include "wavm-test.h"
+
+using namespace WAVM;
+using namespace WAVM::IR;
+using namespace WAVM::Runtime;
+
+// Counts the objects that have been deleted, by setting a finalizer on them.
+static std::atomic<Uptr> numFinalizedObjects{0};
+
+static void finalizeCountedObject(void*) { ++numFinalizedObjects; }
+
+template<typename ObjectType> static ObjectType* countFinalization(ObjectType* object)
+{
+	WAVM_ERROR_UNLESS(object);
+	setUserData(asObject(object), nullptr, finalizeCountedObject);
+	return object;
+}
+
+// Checks that garbage memories and tables are deleted before collectCompartmentGarbage returns, so
+// their resources are released by then.
+static void testGarbageIsDeletedBeforeCollectReturns()
+{
+	GCPointer<Compartment> compartment = createCompartment();
+	ResourceQuotaRef resourceQuota = createResourceQuota();
+	setResourceQuotaMaxMemoryPages(resourceQuota, 4);
+	setResourceQuotaMaxTableElems(resourceQuota, 4);
+
+	numFinalizedObjects = 0;
+	for(Uptr iteration = 0; iteration < 8; ++iteration)
+	{
+		// Each iteration's objects use the whole quota, so they can only be created if the previous
+		// iteration's objects have been deleted.
+		countFinalization(
+			createMemory(compartment, MemoryType(false, {4, 4}), "memory", resourceQuota));
+		countFinalization(createTable(compartment,
+									  TableType(ReferenceType::externref, false, {4, 4}),
+									  nullptr,
+									  "table",
+									  resourceQuota));
+
+		collectCompartmentGarbage(compartment);
+		WAVM_ERROR_UNLESS(numFinalizedObjects == (iteration + 1) * 2);
+		WAVM_ERROR_UNLESS(getResourceQuotaCurrentMemoryPages(resourceQuota) == 0);
+		WAVM_ERROR_UNLESS(getResourceQuotaCurrentTableElems(resourceQuota) == 0);
+	}
+
+	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
+}
+
+static constexpr Uptr numMovingObjects = 16;
+static constexpr Uptr numMovingObjectIterations = 2000;
+
+struct MutatorArgs
+{
+	Context* context;
+	Table* table;
+	Global* global;
+	std::atomic<bool> isDone{false};
+};
+
+// Moves each object in turn out of the table into a root, then into the global, and moves the
+// object that was in the global into the table. Each object is always either rooted or referenced,
+// but it may be unreferenced when the collector snapshots the roots, and rooted or referenced by
+// the time the collector finishes marking.
+static I64 mutatorThreadEntry(void* argument)
+{
+	MutatorArgs& args = *(MutatorArgs*)argument;
+	for(Uptr iteration = 0; iteration < numMovingObjectIterations; ++iteration)
+	{
+		const Uptr elementIndex = iteration % numMovingObjects;
+
+		GCPointer<Object> object = getTableElement(args.table, elementIndex);
+		WAVM_ERROR_UNLESS(object);
+		setTableElement(args.table, elementIndex, nullptr);
+		Platform::yieldToAnotherThread();
+
+		const Value oldGlobalValue = setGlobalValue(args.context, args.global, Value(object));
+		WAVM_ERROR_UNLESS(oldGlobalValue.object);
+		object = oldGlobalValue.object;
+		Platform::yieldToAnotherThread();
+
+		setTableElement(args.table, elementIndex, object);
+	}
+	args.isDone.store(true, std::memory_order_release);
+	return 0;
+}
+
+// Checks that objects that are rooted or stored in a table or global while the collector is
+// marking aren't deleted.
+static void testConcurrentRootingAndReferencing()
+{
+	GCPointer<Compartment> compartment = createCompartment();
+	GCPointer<Context> context = createContext(compartment);
+
+	GCPointer<Table> table = createTable(compartment,
+										 TableType(ReferenceType::externref, false, {16, 16}),
+										 nullptr,
+										 "table");
+	GCPointer<Global> global
+		= createGlobal(compartment, GlobalType(ValueType::externref, true), "global");
+	WAVM_ERROR_UNLESS(table && global);
+	initializeGlobal(global, Value(ValueType::externref, UntaggedValue()));
+
+	// Fill the table and the global with memories and tables, which are deleted differently from the
+	// other kinds of objects.
+	numFinalizedObjects = 0;
+	for(Uptr elementIndex = 0; elementIndex < numMovingObjects; ++elementIndex)
+	{
+		Object* object;
+		if(elementIndex % 2)
+		{
+			object = asObject(
+				countFinalization(createMemory(compartment, MemoryType(false, {0, 1}), "memory")));
+		}
+		else
+		{
+			object = asObject(countFinalization(
+				createTable(compartment,
+							TableType(ReferenceType::externref, false, {0, 1}),
+							nullptr,
+							"table")));
+		}
+		setTableElement(table, elementIndex, object);
+	}
+	setGlobalValue(context,
+				   global,
+				   Value(asObject(countFinalization(
+					   createMemory(compartment, MemoryType(false, {0, 1}), "memory")))));
+
+	// Collect garbage continuously while the mutator thread moves the objects around.
+	MutatorArgs mutatorArgs;
+	mutatorArgs.context = context;
+	mutatorArgs.table = table;
+	mutatorArgs.global = global;
+	Platform::Thread* mutatorThread
+		= Platform::createThread(0, mutatorThreadEntry, &mutatorArgs);
+	Uptr numCollections = 0;
+	while(!mutatorArgs.isDone.load(std::memory_order_acquire))
+	{
+		collectCompartmentGarbage(compartment);
+		++numCollections;
+		WAVM_ERROR_UNLESS(numFinalizedObjects == 0);
+	}
+	Platform::joinThread(mutatorThread);
+	Log::printf(Log::debug, "Collected garbage %" WAVM_PRIuPTR " times\n", numCollections);
+
+	collectCompartmentGarbage(compartment);
+	WAVM_ERROR_UNLESS(numFinalizedObjects == 0);
+
+	// Once the objects are no longer referenced, they are all deleted.
+	for(Uptr elementIndex = 0; elementIndex < numMovingObjects; ++elementIndex)
+	{ setTableElement(table, elementIndex, nullptr); }
+	setGlobalValue(context, global, Value(ValueType::externref, UntaggedValue()));
+	collectCompartmentGarbage(compartment);
+	WAVM_ERROR_UNLESS(numFinalizedObjects == numMovingObjects + 1);
+
+	table = nullptr;
+	global = nullptr;
+	context = nullptr;
+	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
+}
+
+static constexpr const char* sharedCodeTestModuleWAST
+	= "(module\n"
+	  "  (func $f (export \"f\") (result i32) (i32.const 1))\n"
+	  "  (func (export \"ref\") (result funcref) (ref.func $f))\n"
+	  ")";
+
+struct SharedCodeTestInstance
+{
+	GCPointer<Compartment> compartment;
+	GCPointer<Context> context;
+	Function* function;
+};
+
+static SharedCodeTestInstance instantiateSharedCodeTestModule(ModuleConstRefParam module)
+{
+	SharedCodeTestInstance result;
+	result.compartment = createCompartment();
+	result.context = createContext(result.compartment);
+	Instance* instance = instantiateModule(result.compartment, module, {}, "sharedCodeTestModule");
+	WAVM_ERROR_UNLESS(instance);
+	result.function = countFinalization(asFunction(getInstanceExport(instance, "f")));
+
+	// Calling the function runs the shared code, and a reference to it created by the shared code
+	// is this instance's function.
+	UntaggedValue results[1];
+	invokeFunction(result.context, result.function, FunctionType({ValueType::i32}, {}), {}, results);
+	WAVM_ERROR_UNLESS(results[0].i32 == 1);
+	invokeFunction(result.context,
+				   asFunction(getInstanceExport(instance, "ref")),
+				   FunctionType({ValueType::funcref}, {}),
+				   {},
+				   results);
+	WAVM_ERROR_UNLESS(results[0].function == result.function);
+
+	return result;
+}
+
+// Checks that compartments that share the code loaded for a module can be collected independently,
+// with their own functions.
+static void testCollectingCompartmentsThatShareCode()
+{
+	std::vector<WAST::Error> parseErrors;
+	IR::Module irModule(FeatureLevel::proposed);
+	if(!WAST::parseModule(
+		   sharedCodeTestModuleWAST, strlen(sharedCodeTestModuleWAST) + 1, irModule, parseErrors))
+	{
+		WAST::reportParseErrors("shared code test module", sharedCodeTestModuleWAST, parseErrors);
+		Errors::fatal("Failed to parse shared code test module WAST");
+	}
+	ModuleRef module = compileModule(irModule);
+
+	// Collect the compartment that loaded the code first, and then the one that shares it.
+	for(bool collectFirstCompartmentFirst : {true, false})
+	{
+		numFinalizedObjects = 0;
+		SharedCodeTestInstance first = instantiateSharedCodeTestModule(module);
+		SharedCodeTestInstance second = instantiateSharedCodeTestModule(module);
+		WAVM_ERROR_UNLESS(first.function != second.function);
+		WAVM_ERROR_UNLESS(isInCompartment(asObject(first.function), first.compartment));
+		WAVM_ERROR_UNLESS(!isInCompartment(asObject(first.function), second.compartment));
+		WAVM_ERROR_UNLESS(!isInCompartment(asObject(second.function), first.compartment));
+
+		SharedCodeTestInstance& collected = collectFirstCompartmentFirst ? first : second;
+		SharedCodeTestInstance& kept = collectFirstCompartmentFirst ? second : first;
+
+		// Rooting the kept compartment's function doesn't keep the other compartment alive, and
+		// collecting it finalizes only its function.
+		GCPointer<Function> rootedFunction = kept.function;
+		collected.context = nullptr;
+		WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(collected.compartment)));
+		WAVM_ERROR_UNLESS(numFinalizedObjects == 1);
+
+		// The kept compartment's function still runs the shared code.
+		UntaggedValue results[1];
+		invokeFunction(kept.context, rootedFunction, FunctionType({ValueType::i32}, {}), {}, results);
+		WAVM_ERROR_UNLESS(results[0].i32 == 1);
+
+		rootedFunction = nullptr;
+		kept.context = nullptr;
+		WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(kept.compartment)));
+		WAVM_ERROR_UNLESS(numFinalizedObjects == 2);
+	}
+}
+
+int execGCTest(int argc, char** argv)
+{
+	testGarbageIsDeletedBeforeCollectReturns();
+	testConcurrentRootingAndReferencing();
+	testCollectingCompartmentsThatShareCode();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,247 @@
+#include <stdlib.h>
+#include "WAVM/Inline/Assert.h"
+#include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Inline/Time.h"
+#include "WAVM/Logging/Logging.h"
+#include "WAVM/Platform/Clock.h"
+#include "WAVM/Platform/File.h"
+#include "WAVM/VFS/VFS.h"
+#include "wavm-test.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace WAVM;
+using namespace WAVM::Platform;
+using namespace WAVM::VFS;
+
+#ifndef _WIN32
+
+// A VFD that only exposes a host FD to pollVFDs. If hostFD is negative, it behaves like a VFD that
+// isn't backed by a host FD.
+struct TestVFD : VFD
+{
+	TestVFD(I32 inHostFD) : hostFD(inHostFD) {}
+	virtual ~TestVFD() override {}
+
+	virtual Result close() override { return Result::success; }
+	virtual Result seek(I64, SeekOrigin, U64*) override { return Result::notSupported; }
+	virtual Result readv(const IOReadBuffer*, Uptr, Uptr*, const U64*) override
+	{
+		return Result::notSupported;
+	}
+	virtual Result writev(const IOWriteBuffer*, Uptr, Uptr*, const U64*) override
+	{
+		return Result::notSupported;
+	}
+	virtual Result sync(SyncType) override { return Result::notSupported; }
+	virtual Result getVFDInfo(VFDInfo&) override { return Result::notSupported; }
+	virtual Result getFileInfo(FileInfo&) override { return Result::notSupported; }
+	virtual Result setVFDFlags(const VFDFlags&) override { return Result::notSupported; }
+	virtual Result setFileSize(U64) override { return Result::notSupported; }
+	virtual Result setFileTimes(bool, Time, bool, Time) override { return Result::notSupported; }
+	virtual Result openDir(DirEntStream*&) override { return Result::notSupported; }
+
+	virtual bool getHostFD(I32& outHostFD) override
+	{
+		if(hostFD < 0) { return false; }
+		outHostFD = hostFD;
+		return true;
+	}
+
+private:
+	I32 hostFD;
+};
+
+struct TestPipe
+{
+	I32 readFD = -1;
+	I32 writeFD = -1;
+
+	TestPipe()
+	{
+		int fds[2];
+		WAVM_ERROR_UNLESS(!pipe(fds));
+		readFD = fds[0];
+		writeFD = fds[1];
+	}
+	~TestPipe()
+	{
+		closeRead();
+		closeWrite();
+	}
+
+	void closeRead()
+	{
+		if(readFD >= 0) { WAVM_ERROR_UNLESS(!::close(readFD)); }
+		readFD = -1;
+	}
+	void closeWrite()
+	{
+		if(writeFD >= 0) { WAVM_ERROR_UNLESS(!::close(writeFD)); }
+		writeFD = -1;
+	}
+	void write(const char* string, Uptr numBytes)
+	{
+		WAVM_ERROR_UNLESS(::write(writeFD, string, numBytes) == ssize_t(numBytes));
+	}
+};
+
+static VFDPoll makeVFDPoll(VFD* vfd, bool waitForRead, bool waitForWrite)
+{
+	VFDPoll vfdPoll;
+	vfdPoll.vfd = vfd;
+	vfdPoll.waitForRead = waitForRead;
+	vfdPoll.waitForWrite = waitForWrite;
+
+	// Fill in the outputs with garbage to check that pollVFDs overwrites them.
+	vfdPoll.result = Result::ioDeviceError;
+	vfdPoll.isReadable = true;
+	vfdPoll.isWritable = true;
+	vfdPoll.isHungUp = true;
+	vfdPoll.numReadableBytes = 12345;
+	return vfdPoll;
+}
+
+static Time getDeadline(Clock clock, I128 nsFromNow)
+{
+	return Time{getClockTime(clock).ns + nsFromNow};
+}
+
+static void testReadablePipe()
+{
+	TestPipe testPipe;
+	TestVFD readVFD(testPipe.readFD);
+	TestVFD writeVFD(testPipe.writeFD);
+
+	// An empty pipe's write end is writable, but its read end isn't readable.
+	VFDPoll vfdPolls[2] = {makeVFDPoll(&readVFD, true, false), makeVFDPoll(&writeVFD, false, true)};
+	Uptr numReadyVFDs = 0;
+	WAVM_ERROR_UNLESS(pollVFDs(vfdPolls, 2, Clock::monotonic, Time::infinity(), numReadyVFDs)
+					  == Result::success);
+	WAVM_ERROR_UNLESS(numReadyVFDs == 1);
+	WAVM_ERROR_UNLESS(vfdPolls[0].result == Result::success);
+	WAVM_ERROR_UNLESS(!vfdPolls[0].isReadable && !vfdPolls[0].isHungUp);
+	WAVM_ERROR_UNLESS(vfdPolls[0].numReadableBytes == 0);
+	WAVM_ERROR_UNLESS(vfdPolls[1].result == Result::success);
+	WAVM_ERROR_UNLESS(vfdPolls[1].isWritable && !vfdPolls[1].isReadable);
+
+	// After writing to the pipe, its read end is readable, and reports the number of bytes.
+	testPipe.write("hello", 5);
+	VFDPoll readPoll = makeVFDPoll(&readVFD, true, false);
+	WAVM_ERROR_UNLESS(pollVFDs(&readPoll, 1, Clock::monotonic, Time::infinity(), numReadyVFDs)
+					  == Result::success);
+	WAVM_ERROR_UNLESS(numReadyVFDs == 1);
+	WAVM_ERROR_UNLESS(readPoll.result == Result::success);
+	WAVM_ERROR_UNLESS(readPoll.isReadable && !readPoll.isWritable && !readPoll.isHungUp);
+	WAVM_ERROR_UNLESS(readPoll.numReadableBytes == 5);
+
+	// Several VFDPolls on the same host FD each get the events they waited for.
+	VFDPoll duplicatePolls[3] = {makeVFDPoll(&readVFD, true, false),
+								 makeVFDPoll(&readVFD, false, false),
+								 makeVFDPoll(&readVFD, true, false)};
+	WAVM_ERROR_UNLESS(
+		pollVFDs(duplicatePolls, 3, Clock::monotonic, Time::infinity(), numReadyVFDs)
+		== Result::success);
+	WAVM_ERROR_UNLESS(numReadyVFDs == 2);
+	WAVM_ERROR_UNLESS(duplicatePolls[0].isReadable && duplicatePolls[0].numReadableBytes == 5);
+	WAVM_ERROR_UNLESS(!duplicatePolls[1].isReadable);
+	WAVM_ERROR_UNLESS(duplicatePolls[2].isReadable && duplicatePolls[2].numReadableBytes == 5);
+}
+
+static void testHangUp()
+{
+	TestPipe testPipe;
+	TestVFD readVFD(testPipe.readFD);
+
+	// Closing the write end of the pipe hangs up the read end, which is then readable (at EOF).
+	testPipe.closeWrite();
+	VFDPoll readPoll = makeVFDPoll(&readVFD, true, false);
+	Uptr numReadyVFDs = 0;
+	WAVM_ERROR_UNLESS(pollVFDs(&readPoll, 1, Clock::monotonic, Time::infinity(), numReadyVFDs)
+					  == Result::success);
+	WAVM_ERROR_UNLESS(numReadyVFDs == 1);
+	WAVM_ERROR_UNLESS(readPoll.result == Result::success);
+	WAVM_ERROR_UNLESS(readPoll.isHungUp && readPoll.isReadable);
+	WAVM_ERROR_UNLESS(readPoll.numReadableBytes == 0);
+}
+
+static void testTimeout()
+{
+	TestPipe testPipe;
+	TestVFD readVFD(testPipe.readFD);
+
+	for(Clock clock : {Clock::monotonic, Clock::realtime, Clock::processCPUTime})
+	{
+		// A deadline that has already passed returns immediately.
+		VFDPoll readPoll = makeVFDPoll(&readVFD, true, false);
+		Uptr numReadyVFDs = 1;
+		WAVM_ERROR_UNLESS(pollVFDs(&readPoll, 1, clock, getDeadline(clock, -1000000), numReadyVFDs)
+						  == Result::success);
+		WAVM_ERROR_UNLESS(numReadyVFDs == 0);
+		WAVM_ERROR_UNLESS(readPoll.result == Result::success && !readPoll.isReadable);
+
+		// A deadline in the future doesn't return until the deadline has passed.
+		static constexpr I128 timeoutNS = 20000000;
+		const Time startTime = getClockTime(Clock::monotonic);
+		readPoll = makeVFDPoll(&readVFD, true, false);
+		numReadyVFDs = 1;
+		WAVM_ERROR_UNLESS(pollVFDs(&readPoll, 1, clock, getDeadline(clock, timeoutNS), numReadyVFDs)
+						  == Result::success);
+		const Time endTime = getClockTime(Clock::monotonic);
+		WAVM_ERROR_UNLESS(numReadyVFDs == 0);
+		WAVM_ERROR_UNLESS(readPoll.result == Result::success && !readPoll.isReadable);
+
+		// The process CPU time clock doesn't advance while waiting, so it's translated to a
+		// monotonic deadline, and only guaranteed to wait for at least the requested duration.
+		WAVM_ERROR_UNLESS(endTime.ns - startTime.ns >= timeoutNS);
+	}
+
+	// A pipe that becomes readable before the deadline isn't reported as timed out.
+	testPipe.write("x", 1);
+	VFDPoll readPoll = makeVFDPoll(&readVFD, true, false);
+	Uptr numReadyVFDs = 0;
+	WAVM_ERROR_UNLESS(
+		pollVFDs(
+			&readPoll, 1, Clock::monotonic, getDeadline(Clock::monotonic, 1000000000), numReadyVFDs)
+		== Result::success);
+	WAVM_ERROR_UNLESS(numReadyVFDs == 1 && readPoll.isReadable);
+}
+
+static void testVFDsWithoutHostFD()
+{
+	TestPipe testPipe;
+	TestVFD readVFD(testPipe.readFD);
+	TestVFD noHostFDVFD(-1);
+
+	// A VFD without a host FD is returned immediately with notSupported, without waiting for the
+	// other VFDs or the deadline.
+	VFDPoll vfdPolls[2] = {makeVFDPoll(&noHostFDVFD, true, true), makeVFDPoll(&readVFD, true, false)};
+	Uptr numReadyVFDs = 0;
+	WAVM_ERROR_UNLESS(pollVFDs(vfdPolls, 2, Clock::monotonic, Time::infinity(), numReadyVFDs)
+					  == Result::success);
+	WAVM_ERROR_UNLESS(numReadyVFDs == 1);
+	WAVM_ERROR_UNLESS(vfdPolls[0].result == Result::notSupported);
+	WAVM_ERROR_UNLESS(!vfdPolls[0].isReadable && !vfdPolls[0].isWritable);
+	WAVM_ERROR_UNLESS(vfdPolls[1].result == Result::success && !vfdPolls[1].isReadable);
+}
+
+I32 execPollTest(int argc, char** argv)
+{
+	testReadablePipe();
+	testHangUp();
+	testTimeout();
+	testVFDsWithoutHostFD();
+	return EXIT_SUCCESS;
+}
+
+#else
+
+I32 execPollTest(int argc, char** argv)
+{
+	Log::printf(Log::error, "The poll test isn't supported on Windows.\n");
+	return EXIT_FAILURE;
+}
+
+#endif
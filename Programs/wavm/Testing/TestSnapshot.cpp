@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "WAVM/IR/Module.h"
+#include "WAVM/IR/Types.h"
+#include "WAVM/IR/Value.h"
+#include "WAVM/Inline/Assert.h"
+#include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Inline/Errors.h"
+#include "WAVM/Logging/Logging.h"
+#include "WAVM/Platform/File.h"
+#include "WAVM/Runtime/Runtime.h"
+#include "WAVM/VFS/VFS.h"
+#include "WAVM/WASTParse/WASTParse.h"
+#include "wavm-test.h"
+
+using namespace WAVM;
+using namespace WAVM::IR;
+using namespace WAVM::Runtime;
+
+// "mutate" changes the state that is saved in a snapshot, and "check" returns a value that depends
+// on all of it.
+static constexpr const char* snapshotTestModuleWAST
+	= "(module\n"
+	  "  (memory (export \"memory\") 1 4)\n"
+	  "  (table (export \"table\") 4 funcref)\n"
+	  "  (global $counter (export \"counter\") (mut i32) (i32.const 0))\n"
+	  "  (global (export \"constant\") i64 (i64.const 1234))\n"
+	  "  (global $ref (export \"ref\") (mut funcref) (ref.null func))\n"
+	  "  (global (export \"extern\") (mut externref) (ref.null extern))\n"
+	  "  (elem (i32.const 0) $one)\n"
+	  "  (elem declare func $two)\n"
+	  "  (data (i32.const 8) \"snapshot\")\n"
+	  "  (func $one (result i32) (i32.const 1))\n"
+	  "  (func $two (result i32) (i32.const 2))\n"
+	  "  (func (export \"mutate\")\n"
+	  "    (drop (memory.grow (i32.const 2)))\n"
+	  "    (i32.store (i32.const 65540) (i32.const 0x12345678))\n"
+	  "    (i64.store (i32.const 196600) (i64.const -1))\n"
+	  "    (global.set $counter (i32.const 42))\n"
+	  "    (table.set (i32.const 3) (ref.func $two))\n"
+	  "    (global.set $ref (ref.func $two)))\n"
+	  "  (func (export \"check\") (result i32)\n"
+	  "    (i32.add (i32.add (i32.add (i32.load (i32.const 65540)) (global.get $counter))\n"
+	  "                      (call_indirect (result i32) (i32.const 0)))\n"
+	  "             (i32.add (call_indirect (result i32) (i32.const 3)) (memory.size))))\n"
+	  "  (func (export \"store\") (param i32 i32) (i32.store (local.get 0) (local.get 1)))\n"
+	  "  (func (export \"increment\") (result i32)\n"
+	  "    (global.set $counter (i32.add (global.get $counter) (i32.const 1)))\n"
+	  "    (global.get $counter))\n"
+	  ")";
+
+static constexpr I32 expectedCheckResult = 0x12345678 + 42 + 1 + 2 + 3;
+
+// The offsets of the header fields that locate the object descriptions in a snapshot file.
+static constexpr Uptr objectsOffsetFieldOffset = 16;
+static constexpr Uptr numObjectsBytesFieldOffset = 24;
+
+static std::vector<U8> readFileBytes(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	WAVM_ERROR_UNLESS(file);
+	std::vector<U8> bytes;
+	U8 buffer[4096];
+	Uptr numBytesRead;
+	while((numBytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{ bytes.insert(bytes.end(), buffer, buffer + numBytesRead); }
+	WAVM_ERROR_UNLESS(!fclose(file));
+	return bytes;
+}
+
+static void writeFileBytes(const std::string& path, const U8* bytes, Uptr numBytes)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	WAVM_ERROR_UNLESS(file);
+	WAVM_ERROR_UNLESS(!numBytes || fwrite(bytes, 1, numBytes, file) == numBytes);
+	WAVM_ERROR_UNLESS(!fclose(file));
+}
+
+static bool fileExists(const std::string& path)
+{
+	VFS::FileInfo fileInfo;
+	return Platform::getHostFS().getFileInfo(path, fileInfo) == VFS::Result::success;
+}
+
+static I32 invokeI32(Context* context, Instance* instance, const char* exportName)
+{
+	UntaggedValue results[1];
+	invokeFunction(context,
+				   asFunction(getInstanceExport(instance, exportName)),
+				   FunctionType({ValueType::i32}, {}),
+				   {},
+				   results);
+	return results[0].i32;
+}
+
+static void invokeStore(Context* context, Instance* instance, U32 address, I32 value)
+{
+	UntaggedValue args[2] = {address, value};
+	invokeFunction(context,
+				   asFunction(getInstanceExport(instance, "store")),
+				   FunctionType({}, {ValueType::i32, ValueType::i32}),
+				   args);
+}
+
+static std::vector<U8> getMemoryBytes(Instance* instance)
+{
+	Memory* memory = asMemory(getInstanceExport(instance, "memory"));
+	const U8* baseAddress = getMemoryBaseAddress(memory);
+	return std::vector<U8>(baseAddress, baseAddress + getMemoryNumPages(memory) * numBytesPerPage);
+}
+
+struct RestoredCompartment
+{
+	GCPointer<Compartment> compartment;
+	Instance* instance = nullptr;
+};
+
+static RestoredCompartment restore(const std::string& path, ModuleConstRefParam module)
+{
+	RestoredCompartment result;
+	std::vector<Instance*> instances;
+	result.compartment = restoreCompartmentSnapshot(
+		path.c_str(), {module}, nullptr, "restored", ResourceQuotaRef(), &instances);
+	if(instances.size() == 1) { result.instance = instances[0]; }
+	return result;
+}
+
+static void collect(RestoredCompartment& restored)
+{
+	restored.instance = nullptr;
+	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(restored.compartment)));
+}
+
+// Checks that a restored compartment has the memory, table, and global contents of the snapshotted
+// compartment, and that it runs independently of the snapshotted compartment.
+static void testRoundTrip(const std::string& path,
+						  ModuleConstRefParam module,
+						  Context* context,
+						  Instance* instance)
+{
+	WAVM_ERROR_UNLESS(saveCompartmentSnapshot(getCompartment(context), path.c_str(), context));
+	WAVM_ERROR_UNLESS(!fileExists(path + ".tmp"));
+
+	RestoredCompartment restored = restore(path, module);
+	WAVM_ERROR_UNLESS(restored.compartment && restored.instance);
+	GCPointer<Context> restoredContext = createContext(restored.compartment);
+
+	WAVM_ERROR_UNLESS(getMemoryBytes(restored.instance) == getMemoryBytes(instance));
+
+	Global* counter = asGlobal(getInstanceExport(restored.instance, "counter"));
+	Global* constant = asGlobal(getInstanceExport(restored.instance, "constant"));
+	Global* ref = asGlobal(getInstanceExport(restored.instance, "ref"));
+	WAVM_ERROR_UNLESS(getGlobalValue(restoredContext, counter).i32 == 42);
+	WAVM_ERROR_UNLESS(getGlobalValue(restoredContext, constant).i64 == 1234);
+
+	Table* table = asTable(getInstanceExport(restored.instance, "table"));
+	WAVM_ERROR_UNLESS(getTableNumElements(table) == 4);
+	WAVM_ERROR_UNLESS(getTableElement(table, 0));
+	WAVM_ERROR_UNLESS(!getTableElement(table, 1) && !getTableElement(table, 2));
+	WAVM_ERROR_UNLESS(getTableElement(table, 3));
+	WAVM_ERROR_UNLESS(getTableElement(table, 3) != getTableElement(table, 0));
+	WAVM_ERROR_UNLESS(asObject(getGlobalValue(restoredContext, ref).function)
+					  == getTableElement(table, 3));
+	WAVM_ERROR_UNLESS(isInCompartment(getTableElement(table, 3), restored.compartment));
+
+	// The restored compartment runs, and changing its state doesn't change the snapshotted
+	// compartment's state.
+	WAVM_ERROR_UNLESS(invokeI32(restoredContext, restored.instance, "check") == expectedCheckResult);
+	WAVM_ERROR_UNLESS(invokeI32(restoredContext, restored.instance, "increment") == 43);
+	invokeStore(restoredContext, restored.instance, 65540, 0);
+	WAVM_ERROR_UNLESS(invokeI32(restoredContext, restored.instance, "check")
+					  == expectedCheckResult - 0x12345678 + 1);
+	WAVM_ERROR_UNLESS(invokeI32(context, instance, "check") == expectedCheckResult);
+
+	// Nor does it change the snapshot, so restoring it again has the snapshotted state.
+	RestoredCompartment restoredAgain = restore(path, module);
+	WAVM_ERROR_UNLESS(restoredAgain.compartment && restoredAgain.instance);
+	GCPointer<Context> restoredAgainContext = createContext(restoredAgain.compartment);
+	WAVM_ERROR_UNLESS(invokeI32(restoredAgainContext, restoredAgain.instance, "check")
+					  == expectedCheckResult);
+
+	restoredContext = nullptr;
+	restoredAgainContext = nullptr;
+	collect(restored);
+	collect(restoredAgain);
+}
+
+// Checks that saving a snapshot over an existing snapshot doesn't change a compartment that was
+// restored from it, and doesn't change the existing snapshot if saving fails.
+static void testOverwrite(const std::string& path,
+						  ModuleConstRefParam module,
+						  Context* context,
+						  Instance* instance)
+{
+	WAVM_ERROR_UNLESS(saveCompartmentSnapshot(getCompartment(context), path.c_str(), context));
+	const std::vector<U8> snapshotBytes = readFileBytes(path);
+
+	// Restore the snapshot without accessing its memory, so its pages are still mapped from the
+	// file when the snapshot is overwritten.
+	RestoredCompartment restored = restore(path, module);
+	WAVM_ERROR_UNLESS(restored.compartment && restored.instance);
+	const std::vector<U8> originalMemoryBytes = getMemoryBytes(instance);
+
+	invokeStore(context, instance, 65540, 1);
+	WAVM_ERROR_UNLESS(saveCompartmentSnapshot(getCompartment(context), path.c_str(), context));
+	WAVM_ERROR_UNLESS(!fileExists(path + ".tmp"));
+	WAVM_ERROR_UNLESS(getMemoryBytes(restored.instance) == originalMemoryBytes);
+	collect(restored);
+
+	// Saving a compartment that references a foreign object fails, and leaves the existing
+	// snapshot as it was.
+	writeFileBytes(path, snapshotBytes.data(), snapshotBytes.size());
+	Global* externGlobal = asGlobal(getInstanceExport(instance, "extern"));
+	setGlobalValue(
+		context,
+		externGlobal,
+		Value(asObject(createForeign(getCompartment(context), nullptr, nullptr, "foreign"))));
+	WAVM_ERROR_UNLESS(!saveCompartmentSnapshot(getCompartment(context), path.c_str(), context));
+	WAVM_ERROR_UNLESS(!fileExists(path + ".tmp"));
+	WAVM_ERROR_UNLESS(readFileBytes(path) == snapshotBytes);
+
+	setGlobalValue(context, externGlobal, Value(ValueType::externref, UntaggedValue()));
+	invokeStore(context, instance, 65540, 0x12345678);
+}
+
+// Checks that restoring truncated or corrupt snapshots fails cleanly.
+static void testCorruptSnapshots(const std::string& path, ModuleConstRefParam module)
+{
+	const std::vector<U8> snapshotBytes = readFileBytes(path);
+	U64 objectsOffset;
+	U64 numObjectsBytes;
+	memcpy(&objectsOffset, snapshotBytes.data() + objectsOffsetFieldOffset, sizeof(U64));
+	memcpy(&numObjectsBytes, snapshotBytes.data() + numObjectsBytesFieldOffset, sizeof(U64));
+	WAVM_ERROR_UNLESS(objectsOffset + numObjectsBytes == snapshotBytes.size());
+
+	const std::string corruptPath = path + ".corrupt";
+	auto expectRestoreFails = [&](const std::vector<U8>& bytes, Uptr numBytes) {
+		writeFileBytes(corruptPath, bytes.data(), numBytes);
+		RestoredCompartment restored = restore(corruptPath, module);
+		WAVM_ERROR_UNLESS(!restored.compartment);
+	};
+
+	// Truncate the snapshot in the header, in the memory contents, and in the object descriptions.
+	for(Uptr numBytes : {Uptr(0),
+						 Uptr(8),
+						 Uptr(numObjectsBytesFieldOffset),
+						 Uptr(numBytesPerPage),
+						 Uptr(objectsOffset),
+						 Uptr(objectsOffset + numObjectsBytes / 2),
+						 snapshotBytes.size() - 1})
+	{ expectRestoreFails(snapshotBytes, numBytes); }
+
+	// Point the header at object descriptions that aren't in the file.
+	for(U64 corruptObjectsOffset : {U64(0), objectsOffset + 1, U64(snapshotBytes.size() + 1)})
+	{
+		std::vector<U8> corruptBytes = snapshotBytes;
+		memcpy(corruptBytes.data() + objectsOffsetFieldOffset, &corruptObjectsOffset, sizeof(U64));
+		expectRestoreFails(corruptBytes, corruptBytes.size());
+	}
+	for(U64 corruptNumObjectsBytes : {numObjectsBytes + 1, U64(1) << 62, ~U64(0)})
+	{
+		std::vector<U8> corruptBytes = snapshotBytes;
+		memcpy(
+			corruptBytes.data() + numObjectsBytesFieldOffset, &corruptNumObjectsBytes, sizeof(U64));
+		expectRestoreFails(corruptBytes, corruptBytes.size());
+	}
+
+	// Corrupt each byte of the object descriptions. Restoring may succeed if the corrupt byte is
+	// still a valid description, but mustn't crash.
+	Uptr numRestoredCompartments = 0;
+	for(Uptr byteIndex = Uptr(objectsOffset); byteIndex < snapshotBytes.size(); ++byteIndex)
+	{
+		for(U8 mask : {U8(0x01), U8(0xff)})
+		{
+			std::vector<U8> corruptBytes = snapshotBytes;
+			corruptBytes[byteIndex] ^= mask;
+			writeFileBytes(corruptPath, corruptBytes.data(), corruptBytes.size());
+			RestoredCompartment restored = restore(corruptPath, module);
+			if(restored.compartment)
+			{
+				++numRestoredCompartments;
+				collect(restored);
+			}
+		}
+	}
+	Log::printf(Log::debug,
+				"Restored %" WAVM_PRIuPTR " compartments from corrupt snapshots\n",
+				numRestoredCompartments);
+
+	WAVM_ERROR_UNLESS(Platform::getHostFS().unlinkFile(corruptPath) == VFS::Result::success);
+}
+
+int execSnapshotTest(int argc, char** argv)
+{
+	if(argc != 1)
+	{
+		Log::printf(Log::error, "Usage: wavm test snapshot <snapshot path>\n");
+		return EXIT_FAILURE;
+	}
+	const std::string path = argv[0];
+
+	std::vector<WAST::Error> parseErrors;
+	IR::Module irModule(FeatureLevel::proposed);
+	if(!WAST::parseModule(
+		   snapshotTestModuleWAST, strlen(snapshotTestModuleWAST) + 1, irModule, parseErrors))
+	{
+		WAST::reportParseErrors("snapshot test module", snapshotTestModuleWAST, parseErrors);
+		Errors::fatal("Failed to parse snapshot test module WAST");
+	}
+	ModuleRef module = compileModule(irModule);
+
+	GCPointer<Compartment> compartment = createCompartment();
+	GCPointer<Context> context = createContext(compartment);
+	Instance* instance = instantiateModule(compartment, module, {}, "snapshotTestModule");
+	WAVM_ERROR_UNLESS(instance);
+	invokeFunction(context, asFunction(getInstanceExport(instance, "mutate")));
+	WAVM_ERROR_UNLESS(invokeI32(context, instance, "check") == expectedCheckResult);
+
+	testRoundTrip(path, module, context, instance);
+	testOverwrite(path, module, context, instance);
+	testCorruptSnapshots(path, module);
+
+	WAVM_ERROR_UNLESS(Platform::getHostFS().unlinkFile(path) == VFS::Result::success);
+	context = nullptr;
+	WAVM_ERROR_UNLESS(tryCollectCompartment(std::move(compartment)));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include "WAVM/IR/FeatureSpec.h"
+#include "WAVM/IR/Module.h"
+#include "WAVM/Inline/Assert.h"
+#include "WAVM/Inline/BasicTypes.h"
+#include "WAVM/Inline/CLI.h"
+#include "WAVM/Logging/Logging.h"
+#include "WAVM/WASM/WASM.h"
+#include "WAVM/WASTParse/TestScript.h"
+#include "WAVM/WASTParse/WASTParse.h"
+#include "wavm-test.h"
+
+using namespace WAVM;
+using namespace WAVM::IR;
+using namespace WAVM::WAST;
+
+// The sizes of the chunks the test feeds the streaming loader. A chunk size of 0 means the whole
+// module is fed in one chunk.
+static const Uptr chunkSizes[] = {1, 2, 3, 7, 64, 0};
+
+static const char* describeLoadErrorType(WASM::LoadError::Type type)
+{
+	switch(type)
+	{
+	case WASM::LoadError::Type::malformed: return "malformed";
+	case WASM::LoadError::Type::invalid: return "invalid";
+	default: WAVM_UNREACHABLE();
+	};
+}
+
+// Loads a binary module by feeding it to a streaming loader in chunks of the given size, and
+// checks that the result matches loading the whole module with loadBinaryModule.
+static bool testStreamingLoad(const U8* wasmBytes,
+							  Uptr numWASMBytes,
+							  const FeatureSpec& featureSpec,
+							  Uptr chunkSize)
+{
+	Module expectedModule(featureSpec);
+	WASM::LoadError expectedError;
+	const bool expectedSuccess
+		= WASM::loadBinaryModule(wasmBytes, numWASMBytes, expectedModule, &expectedError);
+
+	Module streamingModule(featureSpec);
+	WASM::LoadError streamingError;
+	std::vector<Uptr> loadedFunctionDefIndices;
+	WASM::StreamingLoader* loader = WASM::createStreamingLoader(
+		streamingModule, [&loadedFunctionDefIndices](Uptr functionDefIndex) {
+			loadedFunctionDefIndices.push_back(functionDefIndex);
+		});
+
+	bool streamingSuccess = true;
+	if(!chunkSize) { chunkSize = numWASMBytes; }
+	for(Uptr chunkOffset = 0; streamingSuccess && chunkOffset < numWASMBytes;
+		chunkOffset += chunkSize)
+	{
+		const Uptr numChunkBytes = std::min(chunkSize, numWASMBytes - chunkOffset);
+		streamingSuccess = WASM::feedStreamingLoader(
+			loader, wasmBytes + chunkOffset, numChunkBytes, &streamingError);
+	}
+	if(streamingSuccess)
+	{ streamingSuccess = WASM::finishStreamingLoader(loader, &streamingError); }
+	WASM::destroyStreamingLoader(loader);
+
+	if(streamingSuccess != expectedSuccess)
+	{
+		Log::printf(Log::error,
+					"Streaming load with %" WAVM_PRIuPTR "-byte chunks %s, but loadBinaryModule %s:"
+					" %s\n",
+					chunkSize,
+					streamingSuccess ? "succeeded" : "failed",
+					expectedSuccess ? "succeeded" : "failed",
+					(expectedSuccess ? streamingError : expectedError).message.c_str());
+		return false;
+	}
+	else if(!expectedSuccess)
+	{
+		if(streamingError.type != expectedError.type
+		   || streamingError.message != expectedError.message)
+		{
+			Log::printf(Log::error,
+						"Streaming load with %" WAVM_PRIuPTR
+						"-byte chunks failed with a different error than loadBinaryModule:\n"
+						"  streaming: %s: %s\n"
+						"  loadBinaryModule: %s: %s\n",
+						chunkSize,
+						describeLoadErrorType(streamingError.type),
+						streamingError.message.c_str(),
+						describeLoadErrorType(expectedError.type),
+						expectedError.message.c_str());
+			return false;
+		}
+	}
+	else
+	{
+		// Each function definition should have been passed to the callback once, in order.
+		bool loadedAllFunctionDefs
+			= loadedFunctionDefIndices.size() == streamingModule.functions.defs.size();
+		for(Uptr index = 0; loadedAllFunctionDefs && index < loadedFunctionDefIndices.size();
+			++index)
+		{ loadedAllFunctionDefs = loadedFunctionDefIndices[index] == index; }
+		if(!loadedAllFunctionDefs)
+		{
+			Log::printf(Log::error,
+						"Streaming load with %" WAVM_PRIuPTR
+						"-byte chunks didn't report each function definition once, in order\n",
+						chunkSize);
+			return false;
+		}
+
+		if(WASM::saveBinaryModule(streamingModule) != WASM::saveBinaryModule(expectedModule))
+		{
+			Log::printf(Log::error,
+						"Streaming load with %" WAVM_PRIuPTR
+						"-byte chunks loaded a different module than loadBinaryModule\n",
+						chunkSize);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool testStreamingLoadWithAllChunkSizes(const char* filename,
+											   const TextFileLocus& locus,
+											   const U8* wasmBytes,
+											   Uptr numWASMBytes,
+											   const FeatureSpec& featureSpec)
+{
+	for(Uptr chunkSize : chunkSizes)
+	{
+		if(!testStreamingLoad(wasmBytes, numWASMBytes, featureSpec, chunkSize))
+		{
+			Log::printf(Log::error, "  in module at %s:%s\n", filename, locus.describe().c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool testStreamingLoadOfModule(const char* filename,
+									  const TextFileLocus& locus,
+									  const Module& module)
+{
+	const std::vector<U8> wasmBytes = WASM::saveBinaryModule(module);
+	return testStreamingLoadWithAllChunkSizes(
+		filename, locus, wasmBytes.data(), wasmBytes.size(), module.featureSpec);
+}
+
+static bool testCommandModules(const char* filename,
+							   const Command* command,
+							   const FeatureSpec& featureSpec,
+							   Uptr& outNumModules)
+{
+	switch(command->type)
+	{
+	case Command::action: {
+		auto actionCommand = (ActionCommand*)command;
+		if(actionCommand->action->type != ActionType::_module) { return true; }
+
+		auto moduleAction = (ModuleAction*)actionCommand->action.get();
+		++outNumModules;
+		return testStreamingLoadOfModule(filename, moduleAction->locus, *moduleAction->module);
+	}
+	case Command::assert_unlinkable: {
+		auto assertUnlinkableCommand = (AssertUnlinkableCommand*)command;
+		++outNumModules;
+		return testStreamingLoadOfModule(filename,
+										 assertUnlinkableCommand->locus,
+										 *assertUnlinkableCommand->moduleAction->module);
+	}
+	case Command::assert_invalid:
+	case Command::assert_malformed: {
+		// Malformed and invalid binary modules test that the streaming loader fails with the same
+		// error as loadBinaryModule.
+		auto assertInvalidOrMalformedCommand = (AssertInvalidOrMalformedCommand*)command;
+		if(assertInvalidOrMalformedCommand->quotedModuleType != QuotedModuleType::binary)
+		{ return true; }
+
+		++outNumModules;
+		const std::string& wasmString = assertInvalidOrMalformedCommand->quotedModuleString;
+		return testStreamingLoadWithAllChunkSizes(filename,
+												  assertInvalidOrMalformedCommand->locus,
+												  (const U8*)wasmString.data(),
+												  wasmString.size(),
+												  featureSpec);
+	}
+
+	case Command::_register:
+	case Command::assert_return:
+	case Command::assert_return_arithmetic_nan:
+	case Command::assert_return_canonical_nan:
+	case Command::assert_return_arithmetic_nan_f32x4:
+	case Command::assert_return_canonical_nan_f32x4:
+	case Command::assert_return_arithmetic_nan_f64x2:
+	case Command::assert_return_canonical_nan_f64x2:
+	case Command::assert_return_func:
+	case Command::assert_trap:
+	case Command::assert_throws:
+	case Command::benchmark:
+	default: return true;
+	};
+}
+
+int execStreamingLoadTest(int argc, char** argv)
+{
+	if(argc < 1)
+	{
+		Log::printf(Log::error, "Usage: wavm test streamingload <input .wast> [...]\n");
+		return EXIT_FAILURE;
+	}
+
+	Uptr numModules = 0;
+	for(int argIndex = 0; argIndex < argc; ++argIndex)
+	{
+		const char* filename = argv[argIndex];
+
+		// Read the file into a vector, and make sure it is null terminated.
+		std::vector<U8> testScriptBytes;
+		if(!loadFile(filename, testScriptBytes)) { return EXIT_FAILURE; }
+		testScriptBytes.push_back(0);
+
+		// Parse the test script.
+		std::vector<std::unique_ptr<Command>> testCommands;
+		std::vector<WAST::Error> testErrors;
+		FeatureSpec featureSpec(FeatureLevel::wavm);
+		WAST::parseTestCommands((const char*)testScriptBytes.data(),
+								testScriptBytes.size(),
+								featureSpec,
+								testCommands,
+								testErrors);
+		if(testErrors.size())
+		{
+			reportParseErrors(filename, (const char*)testScriptBytes.data(), testErrors);
+			return EXIT_FAILURE;
+		}
+
+		for(auto& command : testCommands)
+		{
+			if(!testCommandModules(filename, command.get(), featureSpec, numModules))
+			{ return EXIT_FAILURE; }
+		}
+	}
+
+	Log::printf(Log::output,
+				"Streaming loads of %" WAVM_PRIuPTR
+				" modules matched loadBinaryModule with all chunk sizes.\n",
+				numModules);
+	return EXIT_SUCCESS;
+}
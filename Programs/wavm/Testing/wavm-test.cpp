@@ -13,11 +13,17 @@ enum class TestCommand
 	hashMap,
 	hashSet,
 	i128,
+	poll,
+	streamingLoad,
 
 #if WAVM_ENABLE_RUNTIME
 	cAPI,
 	benchmark,
+	callStacks,
+	clone,
+	gc,
 	script,
+	snapshot,
 #endif
 };
 
@@ -31,9 +37,15 @@ static const char* getTestCommandListHelpText()
 		   "  hashmap       Test HashMap\n"
 		   "  hashset       Test HashSet\n"
 		   "  i128          Test I128\n"
+		   "  poll          Test Platform::pollVFDs\n"
+		   "  streamingload Test the streaming WASM loader on WAST test scripts\n"
 #if WAVM_ENABLE_RUNTIME
 		   "  benchmark     Benchmark WAVM\n"
+		   "  callstacks    Test the call stack capture policies\n"
+		   "  clone         Test cloning compartments\n"
+		   "  gc            Test the garbage collector\n"
 		   "  script        Run WAST test scripts\n"
+		   "  snapshot      Test saving and restoring compartment snapshots\n"
 #endif
 		;
 }
@@ -62,6 +74,14 @@ static TestCommand parseTestCommand(const char* string)
 	{
 		return TestCommand::i128;
 	}
+	else if(!strcmp(string, "poll"))
+	{
+		return TestCommand::poll;
+	}
+	else if(!strcmp(string, "streamingload"))
+	{
+		return TestCommand::streamingLoad;
+	}
 #if WAVM_ENABLE_RUNTIME
 	else if(!strcmp(string, "c-api"))
 	{
@@ -71,10 +91,26 @@ static TestCommand parseTestCommand(const char* string)
 	{
 		return TestCommand::benchmark;
 	}
+	else if(!strcmp(string, "callstacks"))
+	{
+		return TestCommand::callStacks;
+	}
+	else if(!strcmp(string, "clone"))
+	{
+		return TestCommand::clone;
+	}
+	else if(!strcmp(string, "gc"))
+	{
+		return TestCommand::gc;
+	}
 	else if(!strcmp(string, "script"))
 	{
 		return TestCommand::script;
 	}
+	else if(!strcmp(string, "snapshot"))
+	{
+		return TestCommand::snapshot;
+	}
 #endif
 	else
 	{
@@ -98,10 +134,16 @@ int execTestCommand(int argc, char** argv)
 		case TestCommand::hashMap: return execHashMapTest(argc - 1, argv + 1);
 		case TestCommand::hashSet: return execHashSetTest(argc - 1, argv + 1);
 		case TestCommand::i128: return execI128Test(argc - 1, argv + 1);
+		case TestCommand::poll: return execPollTest(argc - 1, argv + 1);
+		case TestCommand::streamingLoad: return execStreamingLoadTest(argc - 1, argv + 1);
 #if WAVM_ENABLE_RUNTIME
 		case TestCommand::cAPI: return execCAPITest(argc - 1, argv + 1);
 		case TestCommand::benchmark: return execBenchmark(argc - 1, argv + 1);
+		case TestCommand::callStacks: return execCallStackTest(argc - 1, argv + 1);
+		case TestCommand::clone: return execCloneTest(argc - 1, argv + 1);
+		case TestCommand::gc: return execGCTest(argc - 1, argv + 1);
 		case TestCommand::script: return execRunTestScript(argc - 1, argv + 1);
+		case TestCommand::snapshot: return execSnapshotTest(argc - 1, argv + 1);
 #endif
 
 		case TestCommand::invalid:
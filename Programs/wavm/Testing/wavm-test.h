@@ -6,10 +6,16 @@ int execDumpTestModules(int argc, char** argv);
 int execHashMapTest(int argc, char** argv);
 int execHashSetTest(int argc, char** argv);
 int execI128Test(int argc, char** argv);
+int execPollTest(int argc, char** argv);
+int execStreamingLoadTest(int argc, char** argv);
 
 #if WAVM_ENABLE_RUNTIME
 int execBenchmark(int argc, char** argv);
+int execCallStackTest(int argc, char** argv);
+int execCloneTest(int argc, char** argv);
+int execGCTest(int argc, char** argv);
 int execRunTestScript(int argc, char** argv);
+int execSnapshotTest(int argc, char** argv);
 
 #ifdef __cplusplus
 extern "C"
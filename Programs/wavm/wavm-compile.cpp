@@ -77,6 +77,11 @@ void showCompileHelp(Log::Category outputCategory)
 				"                            supported features below.\n"
 				"  --format=<format>         Specifies the format of the output file. See the\n"
 				"                            list of supported output formats below.\n"
+				"  --compile-shards=<n>      Partition the module's functions into <n> shards\n"
+				"                            that are compiled in parallel (default: 1). The\n"
+				"                            object format requires 1 shard.\n"
+				"  --opt-level=<level>       Set how much the code is optimized: none, fast,\n"
+				"                            default, or aggressive (default: default)\n"
 				"\n"
 				"Output formats:\n"
 				"%s"
@@ -114,6 +119,9 @@ int execCompileCommand(int argc, char** argv)
 	LLVMJIT::TargetSpec targetSpec;
 	IR::FeatureSpec featureSpec;
 	OutputFormat outputFormat = OutputFormat::unspecified;
+	Uptr numCompileShards = 0;
+	bool hasOptimizationLevel = false;
+	LLVMJIT::OptimizationLevel optimizationLevel = LLVMJIT::OptimizationLevel::standard;
 	for(int argIndex = 0; argIndex < argc; ++argIndex)
 	{
 		if(!strcmp(argv[argIndex], "--target-triple"))
@@ -191,6 +199,31 @@ int execCompileCommand(int argc, char** argv)
 				return EXIT_FAILURE;
 			}
 		}
+		else if(stringStartsWith(argv[argIndex], "--compile-shards="))
+		{
+			if(!parseCompileShardsArgument(argv[argIndex], numCompileShards))
+			{ return EXIT_FAILURE; }
+		}
+		else if(stringStartsWith(argv[argIndex], "--opt-level="))
+		{
+			if(hasOptimizationLevel)
+			{
+				Log::printf(Log::error,
+							"'--opt-level=' may only occur once on the command line.\n");
+				return EXIT_FAILURE;
+			}
+
+			const char* levelString = argv[argIndex] + strlen("--opt-level=");
+			if(!parseOptimizationLevel(levelString, optimizationLevel))
+			{
+				Log::printf(Log::error,
+							"Invalid optimization level '%s'. Expected none, fast, default, or"
+							" aggressive.\n",
+							levelString);
+				return EXIT_FAILURE;
+			}
+			hasOptimizationLevel = true;
+		}
 		else if(!inputFilename)
 		{
 			inputFilename = argv[argIndex];
@@ -214,6 +247,7 @@ int execCompileCommand(int argc, char** argv)
 	}
 
 	if(useHostTargetSpec) { targetSpec = LLVMJIT::getHostTargetSpec(); }
+	targetSpec.optimizationLevel = optimizationLevel;
 
 	// Validate the target.
 	switch(LLVMJIT::validateTarget(targetSpec, featureSpec))
@@ -245,6 +279,15 @@ int execCompileCommand(int argc, char** argv)
 	if(outputFormat == OutputFormat::unspecified)
 	{ outputFormat = OutputFormat::precompiledModule; }
 
+	// Object code compiled in multiple shards contains multiple object files, so it can't be
+	// written as a single object file.
+	if(!numCompileShards) { numCompileShards = 1; }
+	if(numCompileShards > 1 && outputFormat == OutputFormat::object)
+	{
+		Log::printf(Log::error, "The object format requires --compile-shards=1.\n");
+		return EXIT_FAILURE;
+	}
+
 	// Load the module IR.
 	IR::Module irModule(featureSpec);
 	if(!loadTextOrBinaryModule(inputFilename, irModule)) { return EXIT_FAILURE; }
@@ -253,7 +296,8 @@ int execCompileCommand(int argc, char** argv)
 	{
 	case OutputFormat::precompiledModule: {
 		// Compile the module to object code.
-		std::vector<U8> objectCode = LLVMJIT::compileModule(irModule, targetSpec);
+		std::vector<U8> objectCode
+			= LLVMJIT::compileModule(irModule, targetSpec, numCompileShards);
 
 		// Extract the compiled object code and add it to the IR module as a user section.
 		irModule.customSections.push_back(CustomSection{
@@ -280,7 +324,8 @@ int execCompileCommand(int argc, char** argv)
 	}
 	case OutputFormat::assembly: {
 		// Compile the module to object code.
-		std::vector<U8> objectCode = LLVMJIT::compileModule(irModule, targetSpec);
+		std::vector<U8> objectCode
+			= LLVMJIT::compileModule(irModule, targetSpec, numCompileShards);
 
 		// Disassemble the object code.
 		std::string disassembly = LLVMJIT::disassembleObject(targetSpec, objectCode);
@@ -23,6 +23,7 @@
 #include "WAVM/LLVMJIT/LLVMJIT.h"
 #include "WAVM/Logging/Logging.h"
 #include "WAVM/ObjectCache/ObjectCache.h"
+#include "WAVM/Platform/Diagnostics.h"
 #include "WAVM/Platform/File.h"
 #include "WAVM/Platform/Memory.h"
 #include "WAVM/Runtime/Linker.h"
@@ -128,26 +129,135 @@ static bool loadPrecompiledModule(std::vector<U8>&& fileBytes,
 	}
 
 	// Check for a precompiled object section.
-	const CustomSection* precompiledObjectSection = nullptr;
-	for(const CustomSection& customSection : irModule.customSections)
+	auto precompiledObjectSectionIt = irModule.customSections.begin();
+	while(precompiledObjectSectionIt != irModule.customSections.end()
+		  && precompiledObjectSectionIt->name != "wavm.precompiled_object")
+	{ ++precompiledObjectSectionIt; }
+	if(precompiledObjectSectionIt == irModule.customSections.end())
 	{
-		if(customSection.name == "wavm.precompiled_object")
+		Log::printf(Log::error, "Input file did not contain 'wavm.precompiled_object' section.\n");
+		return false;
+	}
+	else
+	{
+		// Move the object code out of the IR module, and load the IR + precompiled object code as
+		// a runtime module without copying either.
+		std::shared_ptr<const Runtime::ObjectCodeView> objectCode
+			= Runtime::createObjectCodeView(std::move(precompiledObjectSectionIt->data));
+		irModule.customSections.erase(precompiledObjectSectionIt);
+		outModule = Runtime::loadPrecompiledModule(std::move(irModule), std::move(objectCode));
+		return true;
+	}
+}
+
+// The number of bytes that are read from a program file at a time.
+static constexpr Uptr numProgramFileChunkBytes = 64 * 1024;
+
+// Loads a module from a program file, or from stdin if the filename is "-". If the file is a binary
+// module that isn't precompiled, each chunk that is read is fed to a streaming module loader, so
+// the module's functions are compiled while the rest of the file is being read. Otherwise, the
+// whole file is read before the module is loaded.
+static bool loadProgramFile(const char* filename,
+							bool precompiled,
+							const IR::FeatureSpec& featureSpec,
+							ModuleRef& outModule)
+{
+	const bool isStdin = !strcmp(filename, "-");
+	VFS::VFD* vfd = nullptr;
+	VFS::Result result;
+	if(isStdin) { vfd = Platform::getStdFD(Platform::StdDevice::in); }
+	else
+	{
+		result = Platform::getHostFS().open(
+			filename, VFS::FileAccessMode::readOnly, VFS::FileCreateMode::openExisting, vfd);
+		if(result != VFS::Result::success)
 		{
-			precompiledObjectSection = &customSection;
+			Log::printf(
+				Log::error, "Error loading '%s': %s\n", filename, VFS::describeResult(result));
+			return false;
+		}
+	}
+
+	// Read the file in chunks. Until it's known whether the file is a binary module, or if it
+	// isn't streamed, the chunks are appended to fileBytes.
+	std::vector<U8> fileBytes;
+	std::vector<U8> chunkBytes(numProgramFileChunkBytes);
+	StreamingModuleLoader* loader = nullptr;
+	bool isStreamed = false;
+	WASM::LoadError loadError;
+	bool succeeded = true;
+	while(true)
+	{
+		Uptr numChunkBytes = 0;
+		result = vfd->read(chunkBytes.data(), chunkBytes.size(), &numChunkBytes);
+		if(result != VFS::Result::success)
+		{
+			Log::printf(
+				Log::error, "Error loading '%s': %s\n", filename, VFS::describeResult(result));
+			succeeded = false;
 			break;
 		}
+		else if(!numChunkBytes)
+		{
+			break;
+		}
+
+		if(loader)
+		{
+			if(!feedStreamingModuleLoader(loader, chunkBytes.data(), numChunkBytes, &loadError))
+			{
+				succeeded = false;
+				break;
+			}
+			continue;
+		}
+
+		fileBytes.insert(fileBytes.end(), chunkBytes.data(), chunkBytes.data() + numChunkBytes);
+
+		// Once the file is long enough to contain the WASM binary magic number, start streaming it
+		// if it's a binary module that isn't precompiled.
+		if(!isStreamed && !precompiled && fileBytes.size() >= sizeof(WASM::magicNumber)
+		   && !memcmp(fileBytes.data(), WASM::magicNumber, sizeof(WASM::magicNumber)))
+		{
+			isStreamed = true;
+			loader = createStreamingModuleLoader(featureSpec);
+			if(!feedStreamingModuleLoader(loader, fileBytes.data(), fileBytes.size(), &loadError))
+			{
+				succeeded = false;
+				break;
+			}
+			fileBytes.clear();
+		}
 	}
-	if(!precompiledObjectSection)
+
+	if(!isStdin)
 	{
-		Log::printf(Log::error, "Input file did not contain 'wavm.precompiled_object' section.\n");
-		return false;
+		const VFS::Result closeResult = vfd->close();
+		if(succeeded && closeResult != VFS::Result::success)
+		{
+			Log::printf(
+				Log::error, "Error loading '%s': %s\n", filename, VFS::describeResult(closeResult));
+			succeeded = false;
+		}
 	}
-	else
+
+	if(!loader)
 	{
-		// Load the IR + precompiled object code as a runtime module.
-		outModule = Runtime::loadPrecompiledModule(irModule, precompiledObjectSection->data);
-		return true;
+		if(!succeeded) { return false; }
+		return precompiled
+				   ? loadPrecompiledModule(std::move(fileBytes), featureSpec, outModule)
+				   : loadTextOrBinaryModule(filename, std::move(fileBytes), featureSpec, outModule);
+	}
+
+	if(succeeded) { succeeded = finishStreamingModuleLoader(loader, outModule, &loadError); }
+	else if(result == VFS::Result::success)
+	{
+		// If feeding the loader failed, report the load error.
+		Log::printf(
+			Log::error, "Error loading WebAssembly binary file: %s\n", loadError.message.c_str());
 	}
+	destroyStreamingModuleLoader(loader);
+	return succeeded;
 }
 
 static void reportLinkErrors(const LinkResult& linkResult)
@@ -181,6 +291,20 @@ void showRunHelp(Log::Category outputCategory)
 				"  --function=<name>     Specify function name to run in module (default:main)\n"
 				"  --precompiled         Use precompiled object code in program file\n"
 				"  --nocache             Don't use the WAVM object cache\n"
+				"  --compile-shards=<n>  Partition the module's functions into <n> shards that\n"
+				"                        are compiled in parallel (default: 1)\n"
+				"  --tiered              Start running quickly compiled code, and optimize\n"
+				"                        frequently called functions in the background\n"
+				"  --bounds-checks       Check the bounds of memory accesses, so memories may\n"
+				"                        reserve less address space\n"
+				"  --call-stacks=<mode>  Set how call stacks are captured for traps and\n"
+				"                        exceptions: none, innermost, frame-pointers, or\n"
+				"                        unwind (default: unwind)\n"
+				"  --debug-info=<mode>   Set how much debug info is kept for JIT code: off,\n"
+				"                        lazy, or eager (default: lazy). eager also registers\n"
+				"                        the code with GDB.\n"
+				"  --opt-level=<level>   Set how much the code is optimized: none, fast,\n"
+				"                        default, or aggressive (default: default)\n"
 				"  --enable <feature>    Enable the specified feature. See the list of supported\n"
 				"                        features below.\n"
 				"  --abi=<abi>           Specifies the ABI used by the WASM module. See the list\n"
@@ -227,6 +351,14 @@ struct State
 	ABI abi = ABI::detect;
 	bool precompiled = false;
 	bool allowCaching = true;
+	Uptr numCompileShards = 0;
+	bool tieredCompilation = false;
+	bool memoryBoundsChecks = false;
+	Platform::CallStackCapturePolicy callStackCapturePolicy
+		= Platform::CallStackCapturePolicy::unwind;
+	LLVMJIT::DebugInfoPolicy debugInfoPolicy = LLVMJIT::DebugInfoPolicy::lazy;
+	bool hasOptimizationLevel = false;
+	LLVMJIT::OptimizationLevel optimizationLevel = LLVMJIT::OptimizationLevel::standard;
 	WASI::SyscallTraceLevel wasiTraceLavel = WASI::SyscallTraceLevel::none;
 
 	// Objects that need to be cleaned up before exiting.
@@ -316,6 +448,80 @@ struct State
 			{
 				allowCaching = false;
 			}
+			else if(stringStartsWith(*nextArg, "--compile-shards="))
+			{
+				if(!parseCompileShardsArgument(*nextArg, numCompileShards)) { return false; }
+			}
+			else if(!strcmp(*nextArg, "--tiered"))
+			{
+				tieredCompilation = true;
+			}
+			else if(!strcmp(*nextArg, "--bounds-checks"))
+			{
+				memoryBoundsChecks = true;
+			}
+			else if(stringStartsWith(*nextArg, "--call-stacks="))
+			{
+				const char* modeString = *nextArg + strlen("--call-stacks=");
+				if(!strcmp(modeString, "none"))
+				{ callStackCapturePolicy = Platform::CallStackCapturePolicy::none; }
+				else if(!strcmp(modeString, "innermost"))
+				{
+					callStackCapturePolicy = Platform::CallStackCapturePolicy::innermostFrame;
+				}
+				else if(!strcmp(modeString, "frame-pointers"))
+				{
+					callStackCapturePolicy = Platform::CallStackCapturePolicy::framePointers;
+				}
+				else if(!strcmp(modeString, "unwind"))
+				{
+					callStackCapturePolicy = Platform::CallStackCapturePolicy::unwind;
+				}
+				else
+				{
+					Log::printf(Log::error,
+								"Invalid call stack capture mode '%s'. Expected none, innermost,"
+								" frame-pointers, or unwind.\n",
+								modeString);
+					return false;
+				}
+			}
+			else if(stringStartsWith(*nextArg, "--debug-info="))
+			{
+				const char* modeString = *nextArg + strlen("--debug-info=");
+				if(!strcmp(modeString, "off")) { debugInfoPolicy = LLVMJIT::DebugInfoPolicy::off; }
+				else if(!strcmp(modeString, "lazy"))
+				{ debugInfoPolicy = LLVMJIT::DebugInfoPolicy::lazy; }
+				else if(!strcmp(modeString, "eager"))
+				{ debugInfoPolicy = LLVMJIT::DebugInfoPolicy::eager; }
+				else
+				{
+					Log::printf(Log::error,
+								"Invalid debug info mode '%s'. Expected off, lazy, or eager.\n",
+								modeString);
+					return false;
+				}
+			}
+			else if(stringStartsWith(*nextArg, "--opt-level="))
+			{
+				if(hasOptimizationLevel)
+				{
+					Log::printf(Log::error,
+								"'--opt-level=' may only occur once on the command line.\n");
+					return false;
+				}
+
+				const char* levelString = *nextArg + strlen("--opt-level=");
+				if(!parseOptimizationLevel(levelString, optimizationLevel))
+				{
+					Log::printf(Log::error,
+								"Invalid optimization level '%s'. Expected none, fast, default,"
+								" or aggressive.\n",
+								levelString);
+					return false;
+				}
+				hasOptimizationLevel = true;
+			}
 			else if(!strcmp(*nextArg, "--mount-root"))
 			{
 				if(rootMountPath)
@@ -402,6 +608,13 @@ struct State
 		default: WAVM_UNREACHABLE();
 		};
 
+		if(numCompileShards) { Runtime::setNumCompileShards(numCompileShards); }
+		if(tieredCompilation) { Runtime::setTieredCompilation(true); }
+		if(memoryBoundsChecks) { Runtime::setMemoryBoundsChecks(true); }
+		Platform::setCallStackCapturePolicy(callStackCapturePolicy);
+		LLVMJIT::setDebugInfoPolicy(debugInfoPolicy);
+		Runtime::setOptimizationLevel(optimizationLevel);
+
 		const char* objectCachePath
 			= WAVM_SCOPED_DISABLE_SECURE_CRT_WARNINGS(getenv("WAVM_OBJECT_CACHE_DIR"));
 		if(allowCaching && objectCachePath && *objectCachePath)
@@ -437,6 +650,8 @@ struct State
 			codeKey = Hash<U64>()(WAVM_VERSION_MAJOR, codeKey);
 			codeKey = Hash<U64>()(WAVM_VERSION_MINOR, codeKey);
 			codeKey = Hash<U64>()(WAVM_VERSION_PATCH, codeKey);
+			codeKey = Hash<U64>()(tieredCompilation, codeKey);
+			codeKey = Hash<U64>()(U64(optimizationLevel), codeKey);
 
 			// Initialize the object cache.
 			std::shared_ptr<Runtime::ObjectCacheInterface> objectCache;
@@ -8,6 +8,10 @@
 #include "WAVM/Inline/Version.h"
 #include "WAVM/Logging/Logging.h"
 
+#if WAVM_ENABLE_RUNTIME
+#include "WAVM/LLVMJIT/LLVMJIT.h"
+#endif
+
 using namespace WAVM;
 
 enum class Command
@@ -144,6 +148,51 @@ bool parseAndSetFeature(const char* featureName, IR::FeatureSpec& featureSpec, b
 	return false;
 }
 
+#if WAVM_ENABLE_RUNTIME
+bool parseOptimizationLevel(const char* string, LLVMJIT::OptimizationLevel& outOptimizationLevel)
+{
+	if(!strcmp(string, "none")) { outOptimizationLevel = LLVMJIT::OptimizationLevel::none; }
+	else if(!strcmp(string, "fast"))
+	{
+		outOptimizationLevel = LLVMJIT::OptimizationLevel::fast;
+	}
+	else if(!strcmp(string, "default"))
+	{
+		outOptimizationLevel = LLVMJIT::OptimizationLevel::standard;
+	}
+	else if(!strcmp(string, "aggressive"))
+	{
+		outOptimizationLevel = LLVMJIT::OptimizationLevel::aggressive;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+bool parseCompileShardsArgument(const char* argument, Uptr& inOutNumCompileShards)
+{
+	WAVM_ASSERT(!strncmp(argument, "--compile-shards=", strlen("--compile-shards=")));
+	if(inOutNumCompileShards)
+	{
+		Log::printf(Log::error, "'--compile-shards=' may only occur once on the command line.\n");
+		return false;
+	}
+
+	const char* numShardsString = argument + strlen("--compile-shards=");
+	char* numShardsEnd = nullptr;
+	const unsigned long long numShards = strtoull(numShardsString, &numShardsEnd, 10);
+	if(!*numShardsString || *numShardsEnd || numShards == 0 || numShards > UINT32_MAX)
+	{
+		Log::printf(Log::error, "Invalid number of compile shards: %s\n", numShardsString);
+		return false;
+	}
+	inOutNumCompileShards = Uptr(numShards);
+	return true;
+}
+#endif
+
 static void showTopLevelHelp(Log::Category outputCategory)
 {
 	Log::printf(outputCategory,
@@ -7,6 +7,9 @@ namespace WAVM { namespace IR {
 	struct Module;
 	struct FeatureSpec;
 }};
+namespace WAVM { namespace LLVMJIT {
+	enum class OptimizationLevel;
+}};
 
 int execAssembleCommand(int argc, char** argv);
 int execDisassembleCommand(int argc, char** argv);
@@ -24,6 +27,13 @@ int execRunCommand(int argc, char** argv);
 
 void showCompileHelp(WAVM::Log::Category outputCategory);
 void showRunHelp(WAVM::Log::Category outputCategory);
+
+bool parseOptimizationLevel(const char* string,
+							WAVM::LLVMJIT::OptimizationLevel& outOptimizationLevel);
+
+// Parses a --compile-shards=<n> argument. Logs an error and returns false if the number is invalid,
+// or if inOutNumCompileShards was already set by an earlier occurrence of the argument.
+bool parseCompileShardsArgument(const char* argument, WAVM::Uptr& inOutNumCompileShards);
 #endif
 
 std::string getFeatureListHelpText();
@@ -0,0 +1,66 @@
+(module
+  (import "threadTest" "createThread" (func $threadTest.createThread (param funcref i32) (result i64)))
+  (import "threadTest" "joinThread" (func $threadTest.joinThread (param i64) (result i64)))
+
+  (memory 1 1 shared)
+
+  (elem declare $worker)
+
+  ;; The thread IDs of the workers are stored starting at this address.
+  (global $threadIdsAddress i32 (i32.const 1024))
+
+  ;; Each worker increments the counter at its address, notifies one other thread waiting on the
+  ;; address, and then waits for another thread to increment the counter. The wait has a short
+  ;; timeout, so the workers can't deadlock if all the other threads are waiting.
+  (func $worker (param $address i32) (result i64)
+    (local $i i32)
+    (local $value i32)
+    loop $loop
+      (local.set $value (i32.add
+        (i32.atomic.rmw.add (local.get $address) (i32.const 1))
+        (i32.const 1)
+      ))
+      (drop (memory.atomic.notify (local.get $address) (i32.const 1)))
+      (drop (memory.atomic.wait32 (local.get $address) (local.get $value) (i64.const 10000)))
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $loop (i32.lt_u (local.get $i) (i32.const 256)))
+    end
+    (i64.const 0)
+  )
+
+  ;; Runs $numThreads workers against $numAddresses addresses, and waits for them to finish.
+  (func (export "contended wait/notify") (param $numThreads i32) (param $numAddresses i32)
+    (local $i i32)
+    loop $createLoop
+      (i64.store
+        (i32.add (global.get $threadIdsAddress) (i32.shl (local.get $i) (i32.const 3)))
+        (call $threadTest.createThread
+          (ref.func $worker)
+          (i32.shl (i32.rem_u (local.get $i) (local.get $numAddresses)) (i32.const 2))
+        )
+      )
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $createLoop (i32.lt_u (local.get $i) (local.get $numThreads)))
+    end
+
+    (local.set $i (i32.const 0))
+    loop $joinLoop
+      (drop (call $threadTest.joinThread (i64.load
+        (i32.add (global.get $threadIdsAddress) (i32.shl (local.get $i) (i32.const 3)))
+      )))
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $joinLoop (i32.lt_u (local.get $i) (local.get $numThreads)))
+    end
+  )
+
+  (func (export "memory.atomic.notify") (param $address i32) (result i32)
+    (memory.atomic.notify (local.get $address) (i32.const 1))
+  )
+)
+
+(benchmark "memory.atomic.notify with no waiters" (invoke "memory.atomic.notify" (i32.const 0)))
+
+(benchmark "contended wait/notify (4 threads, 1 address)" (invoke "contended wait/notify" (i32.const 4) (i32.const 1)))
+(benchmark "contended wait/notify (16 threads, 1 address)" (invoke "contended wait/notify" (i32.const 16) (i32.const 1)))
+(benchmark "contended wait/notify (16 threads, 4 addresses)" (invoke "contended wait/notify" (i32.const 16) (i32.const 4)))
+(benchmark "contended wait/notify (64 threads, 4 addresses)" (invoke "contended wait/notify" (i32.const 64) (i32.const 4)))